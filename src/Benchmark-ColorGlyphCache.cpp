@@ -0,0 +1,233 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "ColorGlyphCache.hpp"
+#include "Win32Helpers.hpp"
+
+#include <skia/core/SkFontMgr.h>
+#include <skia/core/SkGraphics.h>
+#include <skia/ports/SkFontMgr_empty.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t FrameCount = 300;
+constexpr size_t MessageCount = 2'000;
+constexpr SkScalar RowHeight = 28;
+constexpr SkScalar ScrollPerFrame = 12;
+// Inline emoji, and the larger emoji of messages that are only emoji
+constexpr SkScalar InlineSize = 20;
+constexpr SkScalar JumboSize = 40;
+// The 'Emoticons' block
+constexpr SkUnichar FirstEmoji = 0x1f600;
+constexpr size_t EmojiCount = 80;
+
+using Clock = std::chrono::steady_clock;
+
+struct Message {
+  std::string mText;
+  std::vector<SkGlyphID> mEmoji;
+  // Only emoji, drawn larger
+  bool mJumbo {false};
+};
+
+std::vector<Message> CreateMessages(std::span<const SkGlyphID> emoji) {
+  std::mt19937 random {42};
+  // Most conversations use a few emoji much more than the rest
+  std::geometric_distribution<size_t> emojiIndex {0.08};
+  std::uniform_int_distribution<size_t> emojiPerMessage {0, 4};
+  std::uniform_int_distribution<int> percent {0, 99};
+
+  std::vector<Message> ret;
+  ret.reserve(MessageCount);
+  for (size_t i = 0; i < MessageCount; ++i) {
+    Message message {
+      .mJumbo = percent(random) < 10,
+    };
+    if (!message.mJumbo) {
+      message.mText = std::format("Message {}: see you at {}", i, i % 24);
+    }
+    const auto count
+      = std::max<size_t>(emojiPerMessage(random), message.mJumbo ? 1 : 0);
+    for (size_t j = 0; j < count; ++j) {
+      message.mEmoji.push_back(
+        emoji[std::min(emojiIndex(random), emoji.size() - 1)]);
+    }
+    ret.push_back(std::move(message));
+  }
+  return ret;
+}
+
+struct FrameTimes {
+  FrameDuration mMean {};
+  FrameDuration mWorst {};
+};
+
+/** A chat history, scrolling by `ScrollPerFrame` each frame.
+ *
+ * Emoji are drawn with `SkCanvas::drawGlyphs()` if `cache` is null.
+ */
+FrameTimes MeasureChat(
+  const BenchmarkBackend& backend,
+  const SkFont& textFont,
+  const SkFont& emojiFont,
+  std::span<const Message> messages,
+  ColorGlyphCache* cache) {
+  // Start cold, so that the first appearance of each emoji is measured
+  SkGraphics::PurgeFontCache();
+  if (backend.mContext) {
+    backend.mContext->freeGpuResources();
+  }
+
+  auto canvas = backend.mSurface->getCanvas();
+  const auto height = static_cast<SkScalar>(backend.mSurface->height());
+  SkPaint textPaint;
+  textPaint.setColor(SK_ColorWHITE);
+  std::vector<SkPoint> positions;
+
+  FrameTimes ret;
+  for (size_t frame = 0; frame < FrameCount; ++frame) {
+    const auto start = Clock::now();
+    if (cache) {
+      cache->BeginFrame();
+    }
+    canvas->clear(SK_ColorBLACK);
+
+    const auto scroll = frame * ScrollPerFrame;
+    const auto first = static_cast<size_t>(scroll / RowHeight);
+    for (auto i = first; i < messages.size(); ++i) {
+      const auto y = ((i + 1) * RowHeight) - scroll;
+      if (y - RowHeight > height) {
+        break;
+      }
+      const auto& message = messages[i];
+      SkScalar x = 10;
+      if (!message.mText.empty()) {
+        canvas->drawSimpleText(
+          message.mText.data(),
+          message.mText.size(),
+          SkTextEncoding::kUTF8,
+          x,
+          y,
+          textFont,
+          textPaint);
+        x += textFont.measureText(
+               message.mText.data(),
+               message.mText.size(),
+               SkTextEncoding::kUTF8)
+          + 4;
+      }
+
+      auto font = emojiFont;
+      font.setSize(message.mJumbo ? JumboSize : InlineSize);
+      positions.clear();
+      for (size_t j = 0; j < message.mEmoji.size(); ++j) {
+        positions.push_back({j * (font.getSize() + 2), 0});
+      }
+      const SkPoint origin {x, y};
+      if (cache) {
+        cache->DrawGlyphs(canvas, message.mEmoji, positions, origin, font);
+      } else {
+        canvas->drawGlyphs(
+          static_cast<int>(positions.size()),
+          message.mEmoji.data(),
+          positions.data(),
+          origin,
+          font,
+          SkPaint {});
+      }
+    }
+    backend.Flush();
+
+    const auto elapsed
+      = std::chrono::duration_cast<FrameDuration>(Clock::now() - start);
+    ret.mMean += elapsed;
+    ret.mWorst = std::max(ret.mWorst, elapsed);
+  }
+  ret.mMean /= FrameCount;
+  return ret;
+}
+
+}// namespace
+
+void BenchmarkColorGlyphCache(const BenchmarkEnvironment& env) {
+  const auto fontPath = GetKnownFolderPath<FOLDERID_Fonts>();
+  const auto typeface = fontPath.empty()
+    ? nullptr
+    : SkFontMgr_New_Custom_Empty()->makeFromFile(
+        (fontPath / "seguiemj.ttf").string().c_str());
+  if (!typeface) {
+    std::cout << "Segoe UI Emoji (seguiemj.ttf) is not installed\n";
+    return;
+  }
+  if (!ColorGlyphCache::HasColorGlyphs(*typeface)) {
+    std::cout << "Segoe UI Emoji has no color glyph tables\n";
+  }
+  const SkFont emojiFont {typeface, InlineSize};
+  auto textFont = env.mFont;
+  textFont.setSize(14);
+
+  std::array<SkUnichar, EmojiCount> codepoints {};
+  for (size_t i = 0; i < EmojiCount; ++i) {
+    codepoints[i] = FirstEmoji + static_cast<SkUnichar>(i);
+  }
+  std::array<SkGlyphID, EmojiCount> glyphs {};
+  emojiFont.unicharsToGlyphs(
+    codepoints.data(), static_cast<int>(EmojiCount), glyphs.data());
+  const auto messages = CreateMessages(glyphs);
+
+  std::cout << std::format(
+    "{} frames of a scrolling chat; {} messages using {} distinct emoji at "
+    "{}px and {}px\n",
+    FrameCount,
+    MessageCount,
+    EmojiCount,
+    InlineSize,
+    JumboSize);
+  const auto report = [](std::string_view name, const FrameTimes& times) {
+    std::cout << std::format(
+      "    {}: {:.3f}ms per frame, worst {:.3f}ms\n",
+      name,
+      times.mMean.count(),
+      times.mWorst.count());
+  };
+
+  for (const auto& backend: env.mBackends) {
+    std::cout << std::format("  {}:\n", backend.mName);
+    report(
+      "drawGlyphs()",
+      MeasureChat(backend, textFont, emojiFont, messages, nullptr));
+
+    for (const size_t budget: {16 * 1024 * 1024, 512 * 1024}) {
+      ColorGlyphCache cache {
+        backend.mSurface.get(),
+        {.mBudgetBytes = budget},
+      };
+      const auto times
+        = MeasureChat(backend, textFont, emojiFont, messages, &cache);
+      const auto stats = cache.GetStats();
+      report(std::format("ColorGlyphCache, {}KiB", budget / 1024), times);
+      std::cout << std::format(
+        "      {:.2f}% of lookups not ready; {} rasterized ({:.0f}us each) "
+        "on workers; {} plots evicted\n",
+        (100.0 * stats.mMisses) / std::max<size_t>(stats.mLookups, 1),
+        stats.mRasterized,
+        stats.mRasterized
+          ? std::chrono::duration<double, std::micro>(stats.mRasterizeTime)
+                .count()
+            / stats.mRasterized
+          : 0.0,
+        stats.mPlotEvictions);
+    }
+  }
+}
@@ -0,0 +1,247 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "DeepZoomViewer.hpp"
+#include "TileCache.hpp"
+#include "TileContainer.hpp"
+
+#include <skia/effects/SkGradientShader.h>
+
+#include <cmath>
+#include <filesystem>
+#include <format>
+#include <iostream>
+
+namespace {
+
+constexpr SkISize ImageSize {16384, 16384};
+constexpr uint32_t TileSize = 256;
+
+// Something with detail at every zoom level
+void DrawSource(SkCanvas* canvas) {
+  const SkPoint points[] {
+    {0, 0},
+    {static_cast<SkScalar>(ImageSize.width()),
+     static_cast<SkScalar>(ImageSize.height())},
+  };
+  const SkColor colors[] {
+    SkColorSetRGB(0x22, 0x22, 0x44), SkColorSetRGB(0x44, 0x22, 0x22)};
+  SkPaint paint;
+  paint.setShader(SkGradientShader::MakeLinear(
+    points, colors, nullptr, 2, SkTileMode::kClamp));
+  canvas->drawRect(SkRect::Make(ImageSize), paint);
+
+  paint.setShader(nullptr);
+  paint.setAntiAlias(true);
+  static constexpr int Cells = 64;
+  const auto cellSize = static_cast<SkScalar>(ImageSize.width()) / Cells;
+  for (int y = 0; y < Cells; ++y) {
+    for (int x = 0; x < Cells; ++x) {
+      paint.setColor(SkColorSetRGB(0x66 + x, 0x66 + y, 0xcc));
+      paint.setStyle(SkPaint::kFill_Style);
+      canvas->drawCircle(
+        (x + 0.5f) * cellSize, (y + 0.5f) * cellSize, cellSize / 3, paint);
+      paint.setStyle(SkPaint::kStroke_Style);
+      paint.setStrokeWidth(1);
+      canvas->drawRect(
+        SkRect::MakeXYWH(x * cellSize, y * cellSize, cellSize, cellSize)
+          .makeInset(4, 4),
+        paint);
+    }
+  }
+}
+
+/* Zoom in to full resolution, pan across, then zoom back out */
+DeepZoomViewer::View GetScriptedView(
+  const DeepZoomViewer::View& fit,
+  const size_t frame) {
+  static constexpr size_t PhaseFrames = 200;
+  static constexpr SkScalar PanPerFrame = 20;
+  const SkPoint target {
+    ImageSize.width() * 0.3f, ImageSize.height() * 0.6f};
+  const SkPoint panEnd {target.x() + (PanPerFrame * PhaseFrames), target.y()};
+
+  const auto zoom = [&fit](SkPoint from, SkPoint to, SkScalar t) {
+    // Interpolate the scale exponentially, so that zoom speed looks constant
+    return DeepZoomViewer::View {
+      .mCenter
+      = {std::lerp(from.x(), to.x(), t), std::lerp(from.y(), to.y(), t)},
+      .mScale = std::exp2(std::lerp(std::log2(fit.mScale), 0.0f, t)),
+    };
+  };
+
+  const auto phase = frame / PhaseFrames;
+  const auto t = static_cast<SkScalar>(frame % PhaseFrames) / PhaseFrames;
+  switch (phase) {
+    case 0:
+      return zoom(fit.mCenter, target, t);
+    case 1:
+      return {
+        .mCenter = {std::lerp(target.x(), panEnd.x(), t), target.y()},
+        .mScale = 1,
+      };
+    case 2:
+      return zoom(fit.mCenter, panEnd, 1 - t);
+    default:
+      return fit;
+  }
+}
+
+std::unique_ptr<TileContainer> OpenOrWriteContainer() {
+  const auto path
+    = std::filesystem::temp_directory_path() / "HelloSkia-DeepZoom.tiles";
+  if (auto container = TileContainer::Open(path)) {
+    return container;
+  }
+
+  std::cout << std::format("writing {}...\n", path.string());
+  const auto start = std::chrono::steady_clock::now();
+  if (!TileContainer::Write(path, ImageSize, TileSize, &DrawSource)) {
+    std::cout << "failed to write tile container\n";
+    return nullptr;
+  }
+  std::cout << std::format(
+    "wrote {}MiB in {:.1f}s\n",
+    std::filesystem::file_size(path) / (1024 * 1024),
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count());
+  auto container = TileContainer::Open(path);
+  if (!container) {
+    std::cout << "failed to open tile container\n";
+  }
+  return container;
+}
+
+double GetMeanMicroseconds(std::chrono::nanoseconds total, size_t count) {
+  if (count == 0) {
+    return 0;
+  }
+  return std::chrono::duration<double, std::micro>(total).count() / count;
+}
+
+}// namespace
+
+void BenchmarkDeepZoom(const BenchmarkEnvironment& env) {
+  static constexpr size_t FrameCount = 600;
+
+  const auto container = OpenOrWriteContainer();
+  if (!container) {
+    return;
+  }
+
+  for (const auto& backend: env.mBackends) {
+    for (const auto prefetch: {false, true}) {
+      TileCache cache {*container, backend.mContext.get(), {}};
+      DeepZoomViewer viewer {*container, cache};
+      viewer.SetPrefetchEnabled(prefetch);
+      const auto fit = viewer.GetFitView(env.mSize);
+
+      DeepZoomViewer::Stats totals;
+      const auto render = [&](SkCanvas* canvas, size_t frame) {
+        viewer.SetView(GetScriptedView(fit, frame));
+        viewer.Render(canvas, env.mSize);
+        const auto stats = viewer.GetStats();
+        totals.mVisibleTiles += stats.mVisibleTiles;
+        totals.mMissingTiles += stats.mMissingTiles;
+        totals.mFallbackTiles += stats.mFallbackTiles;
+        totals.mPrefetchRequests += stats.mPrefetchRequests;
+      };
+      const auto frameTime = MeasureFrames(backend, FrameCount, render);
+
+      const auto cacheStats = cache.GetStats();
+      std::cout << std::format(
+        "{}, prefetch {}: {:.3f}ms per frame; {:.1f}% of visible tiles missing "
+        "({} drawn from a coarser level); {} decodes, {} prefetch requests, "
+        "{}MiB CPU, {}MiB GPU\n",
+        backend.mName,
+        prefetch ? "on" : "off",
+        frameTime.count(),
+        (100.0 * totals.mMissingTiles) / totals.mVisibleTiles,
+        totals.mFallbackTiles,
+        cacheStats.mDecodes,
+        totals.mPrefetchRequests,
+        cacheStats.mCPUBytes / (1024 * 1024),
+        cacheStats.mGPUBytes / (1024 * 1024));
+    }
+  }
+}
+
+void BenchmarkTileCompression(const BenchmarkEnvironment& env) {
+  // Pan right at full resolution, then back again over the same tiles
+  static constexpr size_t FrameCount = 400;
+  static constexpr SkScalar PanPerFrame = 20;
+  // Much smaller than the tiles covered by the pan, so that most of them
+  // are evicted from the CPU tier before we pan back
+  static constexpr TileCache::Budget CacheBudget {
+    .mGPUBytes = 16 * 1024 * 1024,
+    .mCPUBytes = 24 * 1024 * 1024,
+  };
+
+  const auto container = OpenOrWriteContainer();
+  if (!container) {
+    return;
+  }
+
+  const SkPoint start {ImageSize.width() * 0.3f, ImageSize.height() * 0.6f};
+  const auto getView = [&](size_t frame) {
+    const auto half = FrameCount / 2;
+    const auto distance = (frame < half) ? frame : (FrameCount - frame);
+    return DeepZoomViewer::View {
+      .mCenter = {start.x() + (PanPerFrame * distance), start.y()},
+      .mScale = 1,
+    };
+  };
+
+  struct Config {
+    std::string_view mName;
+    bool mEnabled {};
+    bool mDecompressOnRenderThread {};
+    SkColorType mColorType {kN32_SkColorType};
+  };
+  static constexpr Config Configs[] {
+    {"compression off", false, false},
+    {"decompress on render thread", true, true},
+    {"decompress on workers", true, false},
+    {"decompress on workers, rgb565", true, false, kRGB_565_SkColorType},
+  };
+
+  for (const auto& backend: env.mBackends) {
+    for (const auto& config: Configs) {
+      TileCache cache {*container, backend.mContext.get(), CacheBudget};
+      cache.SetCompressionPolicy({
+        .mEnabled = config.mEnabled,
+        .mDecompressOnRenderThread = config.mDecompressOnRenderThread,
+      });
+      cache.SetColorType(config.mColorType);
+      DeepZoomViewer viewer {*container, cache};
+
+      DeepZoomViewer::Stats totals;
+      const auto render = [&](SkCanvas* canvas, size_t frame) {
+        viewer.SetView(getView(frame));
+        viewer.Render(canvas, env.mSize);
+        const auto stats = viewer.GetStats();
+        totals.mVisibleTiles += stats.mVisibleTiles;
+        totals.mMissingTiles += stats.mMissingTiles;
+      };
+      const auto frameTime = MeasureFrames(backend, FrameCount, render);
+
+      const auto stats = cache.GetStats();
+      std::cout << std::format(
+        "{}, {}: {:.3f}ms per frame; {:.1f}% of visible tiles missing; "
+        "{} decodes ({:.0f}us each), {} decompressions ({:.0f}us each); "
+        "{}MiB CPU + {}MiB compressed, holding {}MiB of pixels\n",
+        backend.mName,
+        config.mName,
+        frameTime.count(),
+        (100.0 * totals.mMissingTiles) / totals.mVisibleTiles,
+        stats.mDecodes,
+        GetMeanMicroseconds(stats.mDecodeTime, stats.mDecodes),
+        stats.mDecompressions,
+        GetMeanMicroseconds(stats.mDecompressTime, stats.mDecompressions),
+        stats.mCPUBytes / (1024 * 1024),
+        stats.mCompressedBytes / (1024 * 1024),
+        (stats.mCPUBytes + stats.mCompressedSourceBytes) / (1024 * 1024));
+    }
+  }
+}
@@ -0,0 +1,101 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "DisplayList.hpp"
+
+#include <skia/effects/SkGradientShader.h>
+
+#include <format>
+#include <iostream>
+
+namespace {
+
+/* A grid of 'cards'; each card is a gradient-filled background, a border, and
+ * a label. Cards do not overlap each other, but the parts of a card do, so
+ * this interleaves three kinds of draw in the same way a typical UI does.
+ */
+void RecordCardGrid(
+  DisplayList& dl,
+  const BenchmarkEnvironment& env,
+  const size_t frame) {
+  static constexpr SkScalar CardWidth = 64;
+  static constexpr SkScalar CardHeight = 24;
+  static constexpr SkScalar Gap = 4;
+
+  const SkPoint gradientPoints[] {{0, 0}, {0, CardHeight}};
+  const SkColor gradientColors[] {
+    SkColorSetRGB(0x33, 0x33, 0x66), SkColorSetRGB(0x22, 0x22, 0x44)};
+  SkPaint background;
+  background.setShader(SkGradientShader::MakeLinear(
+    gradientPoints, gradientColors, nullptr, 2, SkTileMode::kClamp));
+
+  SkPaint border;
+  border.setAntiAlias(true);
+  border.setStyle(SkPaint::kStroke_Style);
+  border.setStrokeWidth(1);
+  border.setColor(SkColorSetRGB(0x66, 0x66, 0xcc));
+
+  SkPaint text;
+  text.setColor(SK_ColorWHITE);
+
+  SkFont font = env.mFont;
+  font.setSize(12);
+
+  size_t index = 0;
+  for (SkScalar y = Gap; y + CardHeight < env.mSize.height();
+       y += CardHeight + Gap) {
+    for (SkScalar x = Gap; x + CardWidth < env.mSize.width();
+         x += CardWidth + Gap) {
+      const auto rect = SkRect::MakeXYWH(x, y, CardWidth, CardHeight);
+      dl.DrawRect(rect, background);
+      dl.DrawRoundRect(rect.makeInset(1, 1), 4, 4, border);
+      dl.DrawString(
+        std::format("{}", (index++ + frame) % 1000),
+        x + 4,
+        y + CardHeight - 8,
+        font,
+        text);
+    }
+  }
+}
+
+}// namespace
+
+void BenchmarkReorder(const BenchmarkEnvironment& env) {
+  static constexpr size_t FrameCount = 100;
+
+  {
+    DisplayList dl;
+    RecordCardGrid(dl, env, 0);
+    const auto stats = dl.ReorderForBatching();
+    std::cout << std::format(
+      "draws: {}; batches: {} -> {} ({:.1f}% fewer)\n",
+      stats.mDraws,
+      stats.mBatchesBefore,
+      stats.mBatchesAfter,
+      100.0 - ((100.0 * stats.mBatchesAfter) / stats.mBatchesBefore));
+  }
+
+  for (const auto& backend: env.mBackends) {
+    DisplayList dl;
+    const auto baseline
+      = MeasureFrames(backend, FrameCount, [&](SkCanvas* canvas, size_t frame) {
+          dl.Clear();
+          RecordCardGrid(dl, env, frame);
+          dl.Replay(canvas);
+        });
+    const auto reordered
+      = MeasureFrames(backend, FrameCount, [&](SkCanvas* canvas, size_t frame) {
+          dl.Clear();
+          RecordCardGrid(dl, env, frame);
+          dl.ReorderForBatching();
+          dl.Replay(canvas);
+        });
+    std::cout << std::format(
+      "{}: {:.3f}ms -> {:.3f}ms per frame\n",
+      backend.mName,
+      baseline.count(),
+      reordered.count());
+  }
+}
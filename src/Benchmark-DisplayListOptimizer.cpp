@@ -0,0 +1,150 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "DisplayList.hpp"
+#include "DisplayListRecorder.hpp"
+#include "SyntheticScene.hpp"
+
+#include <Windows.h>
+#include <skia/core/SkPictureRecorder.h>
+#include <skia/core/SkStream.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Capture {
+  std::string mName;
+  sk_sp<SkPicture> mPicture;
+};
+
+/// Every `.skp` in `HELLOSKIA_SKP_DIR`, if set
+std::vector<Capture> LoadCaptures() {
+  wchar_t buffer[MAX_PATH] {};
+  const auto length
+    = GetEnvironmentVariableW(L"HELLOSKIA_SKP_DIR", buffer, MAX_PATH);
+  if (length == 0 || length >= MAX_PATH) {
+    return {};
+  }
+  const std::filesystem::path directory {std::wstring_view {buffer, length}};
+  std::error_code ec;
+  if (!std::filesystem::is_directory(directory, ec)) {
+    std::cout << std::format(
+      "HELLOSKIA_SKP_DIR `{}` is not a directory\n", directory.string());
+    return {};
+  }
+
+  std::vector<Capture> ret;
+  for (const auto& entry:
+       std::filesystem::directory_iterator {directory, ec}) {
+    if (entry.path().extension() != ".skp") {
+      continue;
+    }
+    // `string()` is in the active code page; Skia's Windows file functions
+    // expect UTF-8
+    const std::string utf8Path {
+      reinterpret_cast<const char*>(entry.path().u8string().c_str())};
+    SkFILEStream stream {utf8Path.c_str()};
+    auto picture = SkPicture::MakeFromStream(&stream);
+    if (!picture) {
+      std::cout << std::format("Failed to load `{}`\n", utf8Path);
+      continue;
+    }
+    ret.push_back({entry.path().filename().string(), std::move(picture)});
+  }
+  std::ranges::sort(ret, {}, &Capture::mName);
+  return ret;
+}
+
+/// The standard synthetic scenes, as if they had been captured
+std::vector<Capture> RecordSyntheticScenes(const BenchmarkEnvironment& env) {
+  std::vector<Capture> ret;
+  for (const auto& [name, config]: SyntheticScene::GetStandardCorpus()) {
+    const SyntheticScene scene {config, env.mSize, env.mFont};
+    SkPictureRecorder recorder;
+    scene.Draw(
+      recorder.beginRecording(SkRect::Make(env.mSize)), /* frame = */ 0);
+    ret.push_back(
+      {std::format("{} (synthetic)", name),
+       recorder.finishRecordingAsPicture()});
+  }
+  return ret;
+}
+
+}// namespace
+
+void BenchmarkDisplayListOptimizer(const BenchmarkEnvironment& env) {
+  static constexpr size_t OptimizeIterations = 100;
+  static constexpr size_t FrameCount = 50;
+
+  auto captures = LoadCaptures();
+  if (captures.empty()) {
+    std::cout
+      << "No captures; set HELLOSKIA_SKP_DIR to a directory of .skp files. "
+         "Using synthetic scenes instead.\n";
+    captures = RecordSyntheticScenes(env);
+  }
+
+  const auto viewport = SkRect::Make(env.mSize);
+  for (const auto& [name, picture]: captures) {
+    DisplayList original;
+    size_t unsupported {};
+    {
+      DisplayListRecorder recorder {
+        &original, picture->cullRect().roundOut()};
+      picture->playback(&recorder);
+      unsupported = recorder.GetUnsupportedCount();
+    }
+
+    auto optimized = original;
+    const auto stats = optimized.Optimize(viewport);
+
+    FrameDuration optimizeCost {};
+    for (size_t i = 0; i < OptimizeIterations; ++i) {
+      auto copy = original;
+      const auto start = std::chrono::steady_clock::now();
+      copy.Optimize(viewport);
+      optimizeCost += std::chrono::steady_clock::now() - start;
+    }
+    optimizeCost /= OptimizeIterations;
+
+    std::cout << std::format(
+      "{}: {} -> {} commands; {} culled draws, {} redundant clips, {} folded "
+      "layers, {} empty saves; {:.3f}ms to optimize\n",
+      name,
+      stats.mCommandsBefore,
+      stats.mCommandsAfter,
+      stats.mCulledDraws,
+      stats.mRedundantClips,
+      stats.mFoldedLayers,
+      stats.mEmptySaves,
+      optimizeCost.count());
+    if (unsupported) {
+      std::cout << std::format(
+        "  {} commands could not be imported, and were dropped\n",
+        unsupported);
+    }
+
+    for (const auto& backend: env.mBackends) {
+      const auto baseline = MeasureFrames(
+        backend, FrameCount, [&](SkCanvas* canvas, size_t) {
+          original.Replay(canvas);
+        });
+      const auto after = MeasureFrames(
+        backend, FrameCount, [&](SkCanvas* canvas, size_t) {
+          optimized.Replay(canvas);
+        });
+      std::cout << std::format(
+        "  {}: {:.3f}ms -> {:.3f}ms per frame\n",
+        backend.mName,
+        baseline.count(),
+        after.count());
+    }
+  }
+}
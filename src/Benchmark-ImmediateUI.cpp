@@ -0,0 +1,75 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "ImmediateUI.hpp"
+
+#include <format>
+#include <iostream>
+
+namespace {
+
+/* Rows of a label, a progress bar, and a button; about 1% of the progress
+ * bars change each frame, as in a typical dashboard.
+ */
+void DeclareWidgets(ImmediateUI& ui, const size_t rowCount, size_t frame) {
+  static constexpr size_t ChangesPerFrame = 100;// per 10k rows
+
+  for (size_t i = 0; i < rowCount; ++i) {
+    ui.PushID(i);
+    ui.Label(ImmediateUI::MakeID("label"), std::format("Item {}", i));
+    ui.SameLine();
+    const auto changing = ((i + frame) % 10'000) < ChangesPerFrame;
+    ui.ProgressBar(
+      ImmediateUI::MakeID("progress"),
+      changing ? static_cast<float>(frame % 100) / 100 : 0.5f,
+      100);
+    ui.SameLine();
+    ui.Button(ImmediateUI::MakeID("button"), "Go");
+    ui.PopID();
+  }
+}
+
+}// namespace
+
+void BenchmarkImmediateUI(const BenchmarkEnvironment& env) {
+  static constexpr size_t FrameCount = 100;
+
+  SkFont font = env.mFont;
+  font.setSize(12);
+  const auto area = SkRect::Make(env.mSize);
+
+  for (const size_t rowCount: {100, 1'000, 10'000}) {
+    for (const auto& backend: env.mBackends) {
+      const auto measure = [&](ImmediateUI& ui, ImmediateUI::Stats* stats) {
+        return MeasureFrames(
+          backend, FrameCount, [&](SkCanvas* canvas, size_t frame) {
+            ui.BeginFrame(canvas, area);
+            DeclareWidgets(ui, rowCount, frame);
+            if (stats) {
+              *stats = ui.GetStats();
+            }
+            ui.EndFrame();
+          });
+      };
+
+      ImmediateUI uncachedUI {font, /* enableCaching = */ false};
+      const auto uncached = measure(uncachedUI, nullptr);
+
+      ImmediateUI cachedUI {font};
+      ImmediateUI::Stats stats;
+      const auto cached = measure(cachedUI, &stats);
+
+      std::cout << std::format(
+        "{} rows, {}: {:.3f}ms -> {:.3f}ms per frame "
+        "(last frame: {} widgets, {} layout misses, {} picture misses)\n",
+        rowCount,
+        backend.mName,
+        uncached.count(),
+        cached.count(),
+        stats.mWidgets,
+        stats.mLayoutMisses,
+        stats.mPictureMisses);
+    }
+  }
+}
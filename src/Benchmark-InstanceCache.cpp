@@ -0,0 +1,123 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "DisplayList.hpp"
+#include "InstanceCache.hpp"
+#include "Interner.hpp"
+
+#include <format>
+#include <iostream>
+
+namespace {
+
+constexpr size_t Columns = 100;
+constexpr size_t Rows = 50;
+
+/* One of a handful of card variants; paths and text are interned so that
+ * identical cards have identical content hashes.
+ */
+void RecordCard(
+  DisplayList& dl,
+  Interner& interner,
+  const SkFont& font,
+  const SkSize& size,
+  const size_t variant) {
+  static constexpr SkColor Accents[] {
+    SkColorSetRGB(0x66, 0xcc, 0x66),
+    SkColorSetRGB(0xcc, 0xcc, 0x66),
+    SkColorSetRGB(0xcc, 0x66, 0x66),
+    SkColorSetRGB(0x66, 0x66, 0xcc),
+  };
+  static constexpr std::string_view Labels[] {"ok", "warn", "err", "info"};
+  const auto accent = Accents[variant % std::size(Accents)];
+  const auto label = Labels[variant % std::size(Labels)];
+
+  const auto rect = SkRect::MakeSize(size);
+
+  SkPaint paint;
+  paint.setAntiAlias(true);
+  paint.setColor(SkColorSetRGB(0x22, 0x22, 0x33));
+  dl.DrawRect(rect, interner.Intern(paint).mValue);
+
+  paint.setColor(accent);
+  paint.setStyle(SkPaint::kStroke_Style);
+  dl.DrawRoundRect(rect.makeInset(1, 1), 2, 2, interner.Intern(paint).mValue);
+
+  SkPath icon;
+  icon.addCircle(size.width() - 4, 4, 2);
+  paint.setStyle(SkPaint::kFill_Style);
+  dl.DrawPath(interner.Intern(icon).mValue, interner.Intern(paint).mValue);
+
+  paint.setColor(SK_ColorWHITE);
+  dl.DrawTextBlob(
+    interner.InternText(label, font).mValue,
+    2,
+    size.height() - 3,
+    font,
+    interner.Intern(paint).mValue);
+}
+
+}// namespace
+
+void BenchmarkInstanceCache(const BenchmarkEnvironment& env) {
+  static constexpr size_t FrameCount = 50;
+
+  const auto cardSize = SkSize::Make(
+    static_cast<SkScalar>(env.mSize.width()) / Columns,
+    static_cast<SkScalar>(env.mSize.height()) / Rows);
+  SkFont font = env.mFont;
+  font.setSize(cardSize.height() / 2);
+
+  for (const auto& backend: env.mBackends) {
+    Interner interner;
+    DisplayList dl;
+
+    const auto baseline
+      = MeasureFrames(backend, FrameCount, [&](SkCanvas* canvas, size_t) {
+          dl.Clear();
+          for (size_t i = 0; i < Columns * Rows; ++i) {
+            dl.Save();
+            dl.Translate(
+              (i % Columns) * cardSize.width(),
+              (i / Columns) * cardSize.height());
+            RecordCard(dl, interner, font, cardSize, i % 7);
+            dl.Restore();
+          }
+          dl.Replay(canvas);
+          interner.EndFrame();
+        });
+    const auto rawCommands = dl.GetCommands().size();
+
+    InstanceCache instances;
+    DisplayList card;
+    const auto instanced
+      = MeasureFrames(backend, FrameCount, [&](SkCanvas* canvas, size_t) {
+          dl.Clear();
+          for (size_t i = 0; i < Columns * Rows; ++i) {
+            card.Clear();
+            RecordCard(card, interner, font, cardSize, i % 7);
+            dl.DrawPicture(
+              instances.GetPicture(card),
+              SkMatrix::Translate(
+                (i % Columns) * cardSize.width(),
+                (i / Columns) * cardSize.height()));
+          }
+          dl.Replay(canvas);
+          interner.EndFrame();
+          instances.EndFrame();
+        });
+    const auto stats = instances.GetStats();
+
+    std::cout << std::format(
+      "{}: {:.3f}ms -> {:.3f}ms per frame; {} -> {} commands; {} pictures, "
+      "{:.1f}% hits\n",
+      backend.mName,
+      baseline.count(),
+      instanced.count(),
+      rawCommands,
+      dl.GetCommands().size(),
+      stats.mEntries,
+      (100.0 * stats.mHits) / stats.mLookups);
+  }
+}
@@ -0,0 +1,149 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "DisplayList.hpp"
+#include "Interner.hpp"
+
+#include <skia/effects/SkGradientShader.h>
+
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <numbers>
+
+namespace {
+
+SkPath MakeStar(SkScalar cx, SkScalar cy, SkScalar radius) {
+  SkPath path;
+  static constexpr int Points = 5;
+  for (int i = 0; i < Points * 2; ++i) {
+    const auto r = (i % 2) ? radius / 2 : radius;
+    const auto theta = (i * std::numbers::pi_v<SkScalar>) / Points;
+    const auto x = cx + (r * std::sin(theta));
+    const auto y = cy - (r * std::cos(theta));
+    if (i == 0) {
+      path.moveTo(x, y);
+    } else {
+      path.lineTo(x, y);
+    }
+  }
+  path.close();
+  return path;
+}
+
+/* Like the content of HelloSkiaWindow::RenderSkiaContent(), this creates new
+ * paints, shaders, paths, and text each frame, even though most of them are
+ * identical to the previous frame.
+ */
+void RecordFrame(
+  DisplayList& dl,
+  const BenchmarkEnvironment& env,
+  Interner* interner) {
+  static constexpr SkScalar CardSize = 48;
+  static constexpr SkColor Accents[] {
+    SkColorSetRGB(0x66, 0x66, 0xcc),
+    SkColorSetRGB(0xcc, 0x66, 0x66),
+    SkColorSetRGB(0x66, 0xcc, 0x66),
+    SkColorSetRGB(0xcc, 0xcc, 0x66),
+  };
+  static constexpr std::string_view Labels[] {
+    "CPU",
+    "GPU",
+    "Memory",
+    "Disk",
+    "Network",
+    "Frames",
+    "Errors",
+    "Queue",
+  };
+
+  SkFont font = env.mFont;
+  font.setSize(10);
+
+  size_t index = 0;
+  for (SkScalar y = 0; y + CardSize <= env.mSize.height(); y += CardSize) {
+    for (SkScalar x = 0; x + CardSize <= env.mSize.width();
+         x += CardSize, ++index) {
+      const auto accent = Accents[index % std::size(Accents)];
+      const SkPoint points[] {{0, 0}, {0, CardSize}};
+      const SkColor colors[] {accent, SK_ColorBLACK};
+
+      SkPaint icon;
+      icon.setAntiAlias(true);
+      // Local coordinates, so that the shader is identical for every card
+      icon.setShader(SkGradientShader::MakeLinear(
+        points, colors, nullptr, 2, SkTileMode::kClamp));
+      // Rebuilt each frame, so gets a new generation ID each frame
+      auto star = MakeStar(CardSize / 2, CardSize / 2 - 6, CardSize / 3);
+
+      SkPaint text;
+      text.setColor(SK_ColorWHITE);
+
+      const auto label = Labels[index % std::size(Labels)];
+
+      dl.Save();
+      dl.Translate(x, y);
+      if (interner) {
+        dl.DrawPath(
+          interner->Intern(star).mValue, interner->Intern(icon).mValue);
+        dl.DrawTextBlob(
+          interner->InternText(label, font).mValue,
+          4,
+          CardSize - 4,
+          font,
+          interner->Intern(text).mValue);
+      } else {
+        dl.DrawPath(star, icon);
+        dl.DrawString(label, 4, CardSize - 4, font, text);
+      }
+      dl.Restore();
+    }
+  }
+}
+
+void PrintStats(std::string_view name, const Interner::TableStats& stats) {
+  std::cout << std::format(
+    "  {}: {:.1f}% hits ({} lookups, {} entries, {} evictions)\n",
+    name,
+    stats.GetHitRate() * 100,
+    stats.mLookups,
+    stats.mEntries,
+    stats.mEvictions);
+}
+
+}// namespace
+
+void BenchmarkInterner(const BenchmarkEnvironment& env) {
+  static constexpr size_t FrameCount = 100;
+
+  for (const auto& backend: env.mBackends) {
+    DisplayList dl;
+    const auto baseline
+      = MeasureFrames(backend, FrameCount, [&](SkCanvas* canvas, size_t) {
+          dl.Clear();
+          RecordFrame(dl, env, nullptr);
+          dl.Replay(canvas);
+        });
+
+    Interner interner;
+    const auto interned
+      = MeasureFrames(backend, FrameCount, [&](SkCanvas* canvas, size_t) {
+          dl.Clear();
+          RecordFrame(dl, env, &interner);
+          dl.Replay(canvas);
+          interner.EndFrame();
+        });
+
+    std::cout << std::format(
+      "{}: {:.3f}ms -> {:.3f}ms per frame\n",
+      backend.mName,
+      baseline.count(),
+      interned.count());
+    const auto stats = interner.GetStats();
+    PrintStats("paths", stats.mPaths);
+    PrintStats("shaders", stats.mShaders);
+    PrintStats("paints", stats.mPaints);
+    PrintStats("text blobs", stats.mTextBlobs);
+  }
+}
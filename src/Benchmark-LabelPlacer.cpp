@@ -0,0 +1,137 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "LabelPlacer.hpp"
+
+#include <algorithm>
+#include <format>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+namespace {
+
+using Label = LabelPlacer::Label;
+
+/* The same greedy placement as LabelPlacer, but each candidate is tested
+ * against every label placed so far, and nothing is reused between calls.
+ */
+size_t PlaceNaive(std::span<const Label> labels, const SkRect& viewport) {
+  std::vector<uint32_t> order(labels.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::stable_sort(order, [labels](uint32_t a, uint32_t b) {
+    return labels[a].mPriority > labels[b].mPriority;
+  });
+
+  static constexpr auto Gap = LabelPlacer::AnchorGap;
+  std::vector<SkRect> placed;
+  for (const auto i: order) {
+    const auto& [id, anchor, size, priority] = labels[i];
+    const auto [x, y] = anchor;
+    const auto w = size.width();
+    const auto h = size.height();
+    for (const auto& bounds: {
+           SkRect::MakeXYWH(x + Gap, y - Gap - h, w, h),
+           SkRect::MakeXYWH(x - Gap - w, y - Gap - h, w, h),
+           SkRect::MakeXYWH(x + Gap, y + Gap, w, h),
+           SkRect::MakeXYWH(x - Gap - w, y + Gap, w, h),
+         }) {
+      if (!viewport.contains(bounds)) {
+        continue;
+      }
+      const auto collides = std::ranges::any_of(placed, [&](const SkRect& it) {
+        return SkRect::Intersects(it, bounds);
+      });
+      if (!collides) {
+        placed.push_back(bounds);
+        break;
+      }
+    }
+  }
+  return placed.size();
+}
+
+template <class F>
+FrameDuration Measure(F&& f) {
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration_cast<FrameDuration>(
+    std::chrono::steady_clock::now() - start);
+}
+
+}// namespace
+
+void BenchmarkLabelPlacer(const BenchmarkEnvironment& env) {
+  static constexpr size_t LabelCount = 100'000;
+  static constexpr size_t FrameCount = 20;
+
+  const auto viewport = SkRect::Make(env.mSize);
+
+  std::mt19937 rng {0};
+  std::uniform_real_distribution<SkScalar> x(0, viewport.width());
+  std::uniform_real_distribution<SkScalar> y(0, viewport.height());
+  std::uniform_real_distribution<SkScalar> width(20, 80);
+  std::uniform_real_distribution<float> priority(0, 1);
+  std::vector<Label> labels;
+  labels.reserve(LabelCount);
+  for (size_t i = 0; i < LabelCount; ++i) {
+    labels.push_back({
+      .mID = i,
+      .mAnchor = {x(rng), y(rng)},
+      .mSize = {width(rng), 14},
+      .mPriority = priority(rng),
+    });
+  }
+
+  size_t naivePlaced {};
+  const auto naive
+    = Measure([&]() { naivePlaced = PlaceNaive(labels, viewport); });
+  std::cout << std::format(
+    "naive: {:.3f}ms ({} of {} placed)\n",
+    naive.count(),
+    naivePlaced,
+    LabelCount);
+
+  LabelPlacer placer;
+  const auto report = [&](std::string_view name, FrameDuration duration) {
+    const auto stats = placer.GetStats();
+    std::cout << std::format(
+      "{}: {:.3f}ms per frame ({} placed, {} kept their position, {} "
+      "collision tests)\n",
+      name,
+      duration.count(),
+      stats.mPlaced,
+      stats.mKeptPosition,
+      stats.mCollisionTests);
+  };
+
+  report("first frame", Measure([&]() { placer.Place(labels, viewport); }));
+
+  report("unchanged", Measure([&]() {
+           for (size_t i = 0; i < FrameCount; ++i) {
+             placer.Place(labels, viewport);
+           }
+         }) / FrameCount);
+
+  // Below LabelPlacer::CoherenceThreshold, like a slow pan
+  report("panning", Measure([&]() {
+           for (size_t i = 0; i < FrameCount; ++i) {
+             for (auto& label: labels) {
+               label.mAnchor.fX += 1;
+             }
+             placer.Place(labels, viewport);
+           }
+         }) / FrameCount);
+
+  // Above the threshold
+  std::uniform_real_distribution<SkScalar> jitter(-20, 20);
+  report("jumping", Measure([&]() {
+           for (size_t i = 0; i < FrameCount; ++i) {
+             for (auto& label: labels) {
+               label.mAnchor.offset(jitter(rng), jitter(rng));
+             }
+             placer.Place(labels, viewport);
+           }
+         }) / FrameCount);
+}
@@ -0,0 +1,76 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "Layout.hpp"
+
+#include <format>
+#include <iostream>
+#include <random>
+
+void BenchmarkLayout(const BenchmarkEnvironment& env) {
+  // 1 + 100 + (100 * 50) + (100 * 50 * 9) = 50,101 nodes
+  static constexpr size_t Sections = 100;
+  static constexpr size_t RowsPerSection = 50;
+  static constexpr size_t CellsPerRow = 9;
+  static constexpr size_t Iterations = 1000;
+
+  SkFont font = env.mFont;
+  font.setSize(12);
+
+  LayoutNode root({.mGap = 4});
+  std::vector<LayoutNode*> leaves;
+  leaves.reserve(Sections * RowsPerSection * CellsPerRow);
+  for (size_t section = 0; section < Sections; ++section) {
+    auto sectionNode
+      = root.AppendChild({.mPadding = LayoutNode::Insets::All(4)});
+    for (size_t row = 0; row < RowsPerSection; ++row) {
+      auto rowNode = sectionNode->AppendChild({
+        .mDirection = LayoutNode::Direction::Row,
+        .mJustifyContent = LayoutNode::Justify::SpaceBetween,
+        .mAlignItems = LayoutNode::Align::Center,
+        .mGap = 8,
+      });
+      for (size_t cell = 0; cell < CellsPerRow; ++cell) {
+        auto leaf = rowNode->AppendChild();
+        leaf->SetText(std::format("{}.{}.{}", section, row, cell), font);
+        leaves.push_back(leaf);
+      }
+    }
+  }
+
+  // Unbounded height, like a scrolling list
+  const LayoutNode::Constraints constraints {
+    .mMinWidth = static_cast<SkScalar>(env.mSize.width()),
+    .mMaxWidth = static_cast<SkScalar>(env.mSize.width()),
+  };
+
+  const auto fullStart = std::chrono::steady_clock::now();
+  const auto fullStats = root.Layout(constraints);
+  const auto fullDuration = std::chrono::duration_cast<FrameDuration>(
+    std::chrono::steady_clock::now() - fullStart);
+
+  std::mt19937 rng {0};
+  std::uniform_int_distribution<size_t> leafIndex(0, leaves.size() - 1);
+  LayoutNode::Stats incrementalStats;
+  FrameDuration incrementalDuration {};
+  for (size_t i = 0; i < Iterations; ++i) {
+    auto leaf = leaves.at(leafIndex(rng));
+    leaf->SetText(std::format("changed {}", i), font);
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto stats = root.Layout(constraints);
+    incrementalDuration += std::chrono::steady_clock::now() - start;
+    incrementalStats.mLayouts += stats.mLayouts;
+    incrementalStats.mCacheHits += stats.mCacheHits;
+  }
+
+  std::cout << std::format(
+    "full layout: {:.3f}ms ({} nodes laid out); one changed leaf: {:.3f}ms "
+    "({} nodes laid out, {} cache hits)\n",
+    fullDuration.count(),
+    fullStats.mLayouts,
+    incrementalDuration.count() / Iterations,
+    incrementalStats.mLayouts / Iterations,
+    incrementalStats.mCacheHits / Iterations);
+}
@@ -0,0 +1,120 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "OutputColorType.hpp"
+#include "SyntheticScene.hpp"
+
+#include <skia/core/SkBitmap.h>
+#include <skia/core/SkCanvas.h>
+
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr size_t FrameCount = 30;
+constexpr size_t CopyIterations = 200;
+constexpr size_t ConvertIterations = 20;
+constexpr std::string_view SceneNames[] {
+  "ui-dense",
+  "vector-paths",
+  "images",
+};
+
+using Clock = std::chrono::steady_clock;
+
+/// Frames per second that can be copied, e.g. to another process or device
+double MeasureCopiesPerSecond(size_t frameBytes) {
+  const std::vector<std::byte> source(frameBytes, std::byte {0x55});
+  std::vector<std::byte> dest(frameBytes);
+  // Read from the copies, so that they can't be optimized out
+  size_t checksum = 0;
+  const auto start = Clock::now();
+  for (size_t i = 0; i < CopyIterations; ++i) {
+    memcpy(dest.data(), source.data(), frameBytes);
+    checksum += static_cast<size_t>(dest.at(i % frameBytes));
+  }
+  const auto seconds
+    = std::chrono::duration<double>(Clock::now() - start).count();
+  if (checksum == 0) {
+    return 0;
+  }
+  return CopyIterations / seconds;
+}
+
+}// namespace
+
+void BenchmarkOutputColorTypes(const BenchmarkEnvironment& env) {
+  const auto rgbaInfo = SkImageInfo::Make(
+    env.mSize, kRGBA_8888_SkColorType, kPremul_SkAlphaType);
+
+  // The source for conversions: a frame rendered at 32 bits, as the GPU
+  // would, that is converted when it leaves the pipeline
+  SkBitmap rgbaFrame;
+  rgbaFrame.allocPixels(rgbaInfo);
+  {
+    const SyntheticScene scene {
+      *SyntheticScene::FindInStandardCorpus("images"), env.mSize, env.mFont};
+    auto canvas = SkCanvas::MakeRasterDirect(
+      rgbaInfo, rgbaFrame.getPixels(), rgbaFrame.rowBytes());
+    canvas->clear(SK_ColorBLACK);
+    scene.Draw(canvas.get(), 0);
+  }
+
+  std::cout << std::format(
+    "{}x{}, {} frames per scene\n",
+    env.mSize.width(),
+    env.mSize.height(),
+    FrameCount);
+  for (const auto& [name, colorType]: GetOutputColorTypes()) {
+    const auto info = MakeOutputInfo(rgbaInfo, colorType);
+    const auto frameBytes = info.computeMinByteSize();
+    std::cout << std::format(
+      "  {}: {} KiB per frame\n", name, frameBytes / 1024);
+
+    const BenchmarkBackend backend {
+      .mName = std::string {name},
+      .mSurface = SkSurfaces::Raster(info),
+    };
+    if (!backend.mSurface) {
+      std::cout << "    raster surfaces are not supported\n";
+      continue;
+    }
+    for (const auto sceneName: SceneNames) {
+      const SyntheticScene scene {
+        *SyntheticScene::FindInStandardCorpus(sceneName),
+        env.mSize,
+        env.mFont};
+      const auto duration = MeasureFrames(
+        backend, FrameCount, [&scene](SkCanvas* canvas, size_t frame) {
+          scene.Draw(canvas, frame);
+        });
+      std::cout << std::format(
+        "    {}: {:.3f}ms per frame\n", sceneName, duration.count());
+    }
+
+    const auto copies = MeasureCopiesPerSecond(frameBytes);
+    std::cout << std::format(
+      "    copy: {:.0f} frames/s ({:.2f} GB/s)\n",
+      copies,
+      (copies * frameBytes) / 1e9);
+
+    SkBitmap converted;
+    converted.allocPixels(info);
+    FrameDuration convertTime {};
+    for (size_t i = 0; i < ConvertIterations; ++i) {
+      const auto start = Clock::now();
+      ConvertPixels(rgbaFrame.pixmap(), converted.pixmap());
+      convertTime += Clock::now() - start;
+    }
+    std::cout << std::format(
+      "    convert from rgba8888: {:.3f}ms per frame\n",
+      (convertTime / ConvertIterations).count());
+  }
+}
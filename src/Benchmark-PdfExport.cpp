@@ -0,0 +1,187 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "PdfExporter.hpp"
+
+#include <Windows.h>
+#include <psapi.h>
+#include <skia/core/SkImage.h>
+#include <skia/effects/SkGradientShader.h>
+
+#include <filesystem>
+#include <format>
+#include <iostream>
+
+namespace {
+
+/* Rendered again for every page, so each page draws a different `SkImage`
+ * with identical pixels, as a report that decodes its logo per page would.
+ */
+sk_sp<SkImage> MakeLogo() {
+  static constexpr int Size = 128;
+  auto surface = SkSurfaces::Raster(SkImageInfo::MakeN32Premul(Size, Size));
+  auto canvas = surface->getCanvas();
+  const SkPoint points[] {{0, 0}, {Size, Size}};
+  const SkColor colors[] {
+    SkColorSetRGB(0x66, 0x66, 0xcc), SkColorSetRGB(0xcc, 0x66, 0x66)};
+  SkPaint paint;
+  paint.setAntiAlias(true);
+  paint.setShader(SkGradientShader::MakeLinear(
+    points, colors, nullptr, 2, SkTileMode::kClamp));
+  canvas->clear(SK_ColorTRANSPARENT);
+  canvas->drawCircle(Size / 2, Size / 2, Size / 2, paint);
+  return surface->makeImageSnapshot();
+}
+
+/* A different chart for every page, as a report with per-page data would
+ * have; these can't be deduplicated, so they test that memory use stays flat
+ * when every page has its own images.
+ */
+sk_sp<SkImage> MakeChart(size_t pageIndex) {
+  static constexpr int Width = 512;
+  static constexpr int Height = 256;
+  static constexpr int Bars = 16;
+  auto surface = SkSurfaces::Raster(SkImageInfo::MakeN32Premul(Width, Height));
+  auto canvas = surface->getCanvas();
+  canvas->clear(SK_ColorWHITE);
+  SkPaint paint;
+  paint.setColor(SkColorSetRGB(0x66, 0x66, 0xcc));
+  for (int i = 0; i < Bars; ++i) {
+    const auto value = ((pageIndex + 1) * (i + 3) * 37) % Height;
+    canvas->drawRect(
+      SkRect::MakeXYWH(
+        i * (Width / Bars) + 4,
+        static_cast<SkScalar>(Height - value),
+        (Width / Bars) - 8,
+        static_cast<SkScalar>(value)),
+      paint);
+  }
+  return surface->makeImageSnapshot();
+}
+
+/// A header with a logo, then an optional chart, then a table of cards
+void DrawPage(
+  const SkFont& baseFont,
+  SkCanvas* canvas,
+  size_t pageIndex,
+  bool withChart) {
+  static constexpr SkScalar Margin = 36;
+  static constexpr SkScalar CardWidth = 120;
+  static constexpr SkScalar CardHeight = 48;
+  static constexpr SkScalar Gap = 12;
+  static constexpr SkScalar ChartHeight = 270;
+  static constexpr SkSize PageSize {612, 792};
+
+  SkFont titleFont = baseFont;
+  titleFont.setSize(24);
+  SkFont font = baseFont;
+  font.setSize(10);
+
+  SkPaint text;
+  text.setAntiAlias(true);
+  text.setColor(SK_ColorBLACK);
+
+  canvas->drawImageRect(
+    MakeLogo(),
+    SkRect::MakeXYWH(Margin, Margin, 48, 48),
+    SkSamplingOptions {SkFilterMode::kLinear});
+  canvas->drawString(
+    std::format("Report page {}", pageIndex + 1).c_str(),
+    Margin + 60,
+    Margin + 32,
+    titleFont,
+    text);
+
+  SkPaint border;
+  border.setAntiAlias(true);
+  border.setStyle(SkPaint::kStroke_Style);
+  border.setColor(SkColorSetRGB(0x66, 0x66, 0xcc));
+
+  SkScalar top = Margin + 72;
+  if (withChart) {
+    canvas->drawImageRect(
+      MakeChart(pageIndex),
+      SkRect::MakeXYWH(Margin, top, PageSize.width() - (2 * Margin), 256),
+      SkSamplingOptions {SkFilterMode::kLinear});
+    top += ChartHeight;
+  }
+
+  size_t index = 0;
+  for (SkScalar y = top; y + CardHeight < PageSize.height() - Margin;
+       y += CardHeight + Gap) {
+    for (SkScalar x = Margin; x + CardWidth < PageSize.width() - Margin;
+         x += CardWidth + Gap, ++index) {
+      canvas->drawRoundRect(
+        SkRect::MakeXYWH(x, y, CardWidth, CardHeight), 4, 4, border);
+      canvas->drawString(
+        std::format("Item {}", (pageIndex * 100) + index).c_str(),
+        x + 8,
+        y + 18,
+        font,
+        text);
+      canvas->drawString(
+        std::format("{:.2f}", ((pageIndex + 1) * (index + 1)) / 7.0).c_str(),
+        x + 8,
+        y + 36,
+        font,
+        text);
+    }
+  }
+}
+
+size_t GetPeakWorkingSetMiB() {
+  PROCESS_MEMORY_COUNTERS counters {sizeof(counters)};
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    return 0;
+  }
+  return counters.PeakWorkingSetSize / (1024 * 1024);
+}
+
+}// namespace
+
+void BenchmarkPdfExport(const BenchmarkEnvironment& env) {
+  const auto path
+    = std::filesystem::temp_directory_path() / "HelloSkia-Export.pdf";
+
+  // The peak working set is for the whole process, so it can only grow; if
+  // memory use is independent of page count, it stays flat across runs.
+  // Shared logos run first, as distinct charts need more memory per page.
+  for (const auto withChart: {false, true}) {
+    std::cout << (withChart ? "Shared logo and a distinct chart per page:\n"
+                            : "Shared logo:\n");
+    const auto drawPage
+      = [&env, withChart](SkCanvas* canvas, size_t pageIndex) {
+          DrawPage(env.mFont, canvas, pageIndex, withChart);
+        };
+    for (const auto pageCount: {10, 100, 1000}) {
+      for (const auto threads: {1, 0}) {
+        PdfExporter::Options options {.mTitle = "HelloSkia benchmark"};
+        options.mThreads = threads;
+        const auto start = std::chrono::steady_clock::now();
+        const auto stats
+          = PdfExporter::Export(path, pageCount, drawPage, options);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        if (!stats) {
+          std::cout << std::format("failed to write {}\n", path.string());
+          return;
+        }
+        std::cout << std::format(
+          "  {} pages, {} record threads: {:.3f}ms per page; {}KiB; "
+          "{}/{} images deduplicated, {} released; peak {} pages in flight; "
+          "peak working set {}MiB\n",
+          pageCount,
+          threads ? std::format("{}", threads) : std::string {"auto"},
+          std::chrono::duration<double, std::milli>(elapsed).count()
+            / pageCount,
+          stats->mBytesWritten / 1024,
+          stats->mImagesDeduplicated,
+          stats->mImageDraws,
+          stats->mImagesReleased,
+          stats->mPeakPagesInFlight,
+          GetPeakWorkingSetMiB());
+      }
+    }
+  }
+  std::filesystem::remove(path);
+}
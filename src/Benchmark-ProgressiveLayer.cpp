@@ -0,0 +1,136 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "ProgressiveLayer.hpp"
+#include "SyntheticScene.hpp"
+
+#include <skia/core/SkBBHFactory.h>
+#include <skia/core/SkPictureRecorder.h>
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <numeric>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::chrono::nanoseconds FrameBudget {1'000'000'000 / 60};
+constexpr size_t FrameCount = 180;
+// The heavy content changes this often
+constexpr size_t VersionInterval = 45;
+
+struct Config {
+  std::string_view mName;
+  ProgressiveLayer::Options mOptions;
+};
+
+/// The rest of the UI, which should stay at full rate
+void DrawLightContent(SkCanvas* canvas, size_t frame) {
+  SkPaint paint;
+  paint.setColor(SkColorSetARGB(0xcc, 0x66, 0x66, 0xcc));
+  for (size_t i = 0; i < 100; ++i) {
+    canvas->drawRect(
+      SkRect::MakeXYWH(
+        static_cast<SkScalar>((i * 37 + frame * 4) % 1000),
+        static_cast<SkScalar>((i * 53) % 700),
+        24,
+        24),
+      paint);
+  }
+}
+
+}// namespace
+
+void BenchmarkProgressiveLayer(const BenchmarkEnvironment& env) {
+  const auto sceneConfig = SyntheticScene::FindInStandardCorpus("mixed-large");
+  const SyntheticScene scene {*sceneConfig, env.mSize, env.mFont};
+
+  std::vector<sk_sp<SkPicture>> versions;
+  for (size_t i = 0; i < FrameCount; i += VersionInterval) {
+    SkRTreeFactory bbh;
+    SkPictureRecorder recorder;
+    scene.Draw(recorder.beginRecording(SkRect::Make(env.mSize), &bbh), i);
+    versions.push_back(recorder.finishRecordingAsPicture());
+  }
+
+  const auto fullSize = std::max(env.mSize.width(), env.mSize.height());
+  // Rendering everything as a single tile in one frame is equivalent to
+  // re-rendering the layer whenever it changes
+  const Config configs[] {
+    {"all at once", {fullSize, std::chrono::hours {1}}},
+    {"256px tiles, 4ms slices", {256, std::chrono::milliseconds {4}}},
+    {"256px tiles, 2ms slices", {256, std::chrono::milliseconds {2}}},
+  };
+
+  std::cout << std::format(
+    "'mixed-large' changing every {} frames, at 60Hz\n", VersionInterval);
+  for (const auto& backend: env.mBackends) {
+    for (const auto& [name, options]: configs) {
+      ProgressiveLayer layer {
+        backend.mContext.get(), backend.mSurface.get(), env.mSize, options};
+      auto canvas = backend.mSurface->getCanvas();
+
+      std::vector<double> frameTimes;
+      frameTimes.reserve(FrameCount);
+      FrameDuration timeToComplete {};
+      size_t advancesToComplete {};
+
+      auto deadline = Clock::now() + FrameBudget;
+      for (size_t frame = 0; frame < FrameCount; ++frame) {
+        if (frame % VersionInterval == 0) {
+          layer.SetContent(versions.at(frame / VersionInterval));
+        }
+
+        const auto start = Clock::now();
+        canvas->clear(SK_ColorBLACK);
+        if (layer.Advance()) {
+          const auto stats = layer.GetStats();
+          timeToComplete += stats.mLastTimeToComplete;
+          advancesToComplete += stats.mLastAdvancesToComplete;
+        }
+        layer.Draw(canvas, 0, 0);
+        DrawLightContent(canvas, frame);
+        backend.Flush();
+        frameTimes.push_back(
+          std::chrono::duration_cast<FrameDuration>(Clock::now() - start)
+            .count());
+
+        while (deadline < Clock::now()) {
+          deadline += FrameBudget;
+        }
+        std::this_thread::sleep_until(deadline);
+      }
+
+      std::ranges::sort(frameTimes);
+      const auto mean
+        = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0)
+        / frameTimes.size();
+      double variance {};
+      for (const auto it: frameTimes) {
+        variance += (it - mean) * (it - mean);
+      }
+      variance /= frameTimes.size();
+      const auto completed = layer.GetStats().mVersionsCompleted;
+
+      std::cout << std::format(
+        "  {}, {}: {:.2f}ms mean, {:.2f}ms p99, {:.2f}ms max frame time "
+        "(stddev {:.2f}ms); {} versions took {:.1f} frames and {:.1f}ms "
+        "on average to complete\n",
+        backend.mName,
+        name,
+        mean,
+        frameTimes.at((frameTimes.size() * 99) / 100),
+        frameTimes.back(),
+        std::sqrt(variance),
+        completed,
+        static_cast<double>(advancesToComplete)
+          / std::max<size_t>(completed, 1),
+        timeToComplete.count() / std::max<size_t>(completed, 1));
+    }
+  }
+}
@@ -0,0 +1,160 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "RefreshScheduler.hpp"
+#include "SyntheticScene.hpp"
+
+#include <Windows.h>
+
+#include <cmath>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <tuple>
+
+namespace {
+
+using Clock = RefreshScheduler::Clock;
+
+constexpr auto Duration = std::chrono::seconds {3};
+constexpr Clock::duration Interval120Hz {std::chrono::nanoseconds {
+  1'000'000'000 / 120}};
+constexpr Clock::duration Interval10Hz {std::chrono::milliseconds {100}};
+
+constexpr SkIRect CursorBounds {0, 0, 256, 256};
+constexpr SkIRect ListBounds {960, 0, 1280, 720};
+constexpr SkIRect DashboardBounds {0, 256, 960, 720};
+
+/// User and kernel time of every thread in the process
+std::chrono::nanoseconds GetProcessCPUTime() {
+  FILETIME creation {}, exit {}, kernel {}, user {};
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+    return {};
+  }
+  const auto toNanoseconds = [](const FILETIME& time) {
+    const auto ticks = (static_cast<uint64_t>(time.dwHighDateTime) << 32)
+      | time.dwLowDateTime;
+    // FILETIME is in 100ns units
+    return std::chrono::nanoseconds {ticks * 100};
+  };
+  return toNanoseconds(kernel) + toNanoseconds(user);
+}
+
+void DrawCursor(SkCanvas* canvas, uint64_t frame) {
+  const auto angle = static_cast<SkScalar>(frame) * 0.05f;
+  const SkPoint center {
+    128 + (std::cos(angle) * 96),
+    128 + (std::sin(angle) * 96),
+  };
+  SkPaint paint;
+  paint.setAntiAlias(true);
+  paint.setColor(SK_ColorWHITE);
+  canvas->drawCircle(center.x(), center.y(), 8, paint);
+}
+
+void DrawList(SkCanvas* canvas, const SkFont& font, uint64_t frame) {
+  static constexpr SkScalar RowHeight = 24;
+  SkPaint paint;
+  paint.setAntiAlias(true);
+  paint.setColor(SK_ColorWHITE);
+  // Scroll by 2px per frame
+  const auto firstRow = (frame * 2) / static_cast<uint64_t>(RowHeight);
+  const auto offset = std::fmod(static_cast<SkScalar>(frame * 2), RowHeight);
+  for (int i = 0; i <= ListBounds.height() / RowHeight; ++i) {
+    canvas->drawString(
+      std::format("Row {}", firstRow + i).c_str(),
+      8,
+      ((i + 1) * RowHeight) - offset,
+      font,
+      paint);
+  }
+}
+
+}// namespace
+
+void BenchmarkRefreshScheduler(const BenchmarkEnvironment& env) {
+  const auto config = SyntheticScene::FindInStandardCorpus("ui-dense");
+  const SyntheticScene dashboard {
+    *config,
+    {DashboardBounds.width(), DashboardBounds.height()},
+    env.mFont};
+
+  const auto drawCursor = [](SkCanvas* canvas, uint64_t frame) {
+    DrawCursor(canvas, frame);
+  };
+  const auto drawList = [&env](SkCanvas* canvas, uint64_t frame) {
+    DrawList(canvas, env.mFont, frame);
+  };
+  const auto drawDashboard = [&dashboard](SkCanvas* canvas, uint64_t frame) {
+    dashboard.Draw(canvas, frame);
+  };
+  // Everything in a single domain, at the fastest rate
+  const auto drawAll = [&](SkCanvas* canvas, uint64_t frame) {
+    const std::tuple<const SkIRect&, std::function<void(SkCanvas*, uint64_t)>>
+      parts[] {
+        {CursorBounds, drawCursor},
+        {ListBounds, drawList},
+        {DashboardBounds, drawDashboard},
+      };
+    for (const auto& [bounds, draw]: parts) {
+      SkAutoCanvasRestore restore {canvas, true};
+      canvas->translate(bounds.x(), bounds.y());
+      canvas->clipIRect(SkIRect::MakeWH(bounds.width(), bounds.height()));
+      draw(canvas, frame);
+    }
+  };
+
+  std::cout << std::format(
+    "{}s of a 120Hz cursor and list, and a 10Hz dashboard\n",
+    Duration.count());
+  for (const auto& backend: env.mBackends) {
+    for (const auto separateDomains: {false, true}) {
+      RefreshScheduler scheduler {
+        backend.mContext.get(), backend.mSurface.get()};
+      if (separateDomains) {
+        scheduler.AddDomain(
+          {"cursor", CursorBounds, Interval120Hz, true, drawCursor});
+        scheduler.AddDomain(
+          {"list", ListBounds, Interval120Hz, true, drawList});
+        scheduler.AddDomain(
+          {"dashboard", DashboardBounds, Interval10Hz, true, drawDashboard});
+      } else {
+        scheduler.AddDomain(
+          {"all",
+           SkIRect::MakeSize(env.mSize),
+           Interval120Hz,
+           true,
+           drawAll});
+      }
+
+      auto canvas = backend.mSurface->getCanvas();
+      const auto cpuStart = GetProcessCPUTime();
+      const auto start = Clock::now();
+      const auto end = start + Duration;
+      while (true) {
+        const auto deadline = scheduler.GetNextDeadline();
+        if (deadline >= end) {
+          break;
+        }
+        std::this_thread::sleep_until(deadline);
+        if (scheduler.Update()) {
+          canvas->clear(SK_ColorBLACK);
+          scheduler.Composite(canvas);
+          backend.Flush();
+        }
+      }
+      const auto cpuTime = GetProcessCPUTime() - cpuStart;
+      const auto wallTime = Clock::now() - start;
+
+      std::cout << std::format(
+        "  {}, {}: {:.1f}ms CPU per second; {} composites\n",
+        backend.mName,
+        separateDomains ? "separate domains" : "everything at 120Hz",
+        std::chrono::duration<double, std::milli>(cpuTime).count()
+          / std::chrono::duration<double>(wallTime).count(),
+        scheduler.GetCompositeCount());
+    }
+  }
+}
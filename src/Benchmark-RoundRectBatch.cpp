@@ -0,0 +1,99 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "RoundRectBatch.hpp"
+
+#include <format>
+#include <iostream>
+#include <random>
+
+namespace {
+
+struct Shape {
+  SkRect mRect;
+  SkScalar mRadius {};
+  // 0 for fills
+  SkScalar mStrokeWidth {};
+  SkColor mColor {};
+};
+
+std::vector<Shape> MakeShapes(const SkISize& size, const size_t count) {
+  std::mt19937 rng {static_cast<std::mt19937::result_type>(count)};
+  std::uniform_real_distribution<SkScalar> x(0, size.width());
+  std::uniform_real_distribution<SkScalar> y(0, size.height());
+  std::uniform_real_distribution<SkScalar> extent(8, 40);
+  std::uniform_real_distribution<SkScalar> radius(2, 12);
+  std::uniform_int_distribution<uint32_t> channel(0x40, 0xff);
+
+  std::vector<Shape> ret;
+  ret.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    ret.push_back({
+      .mRect = SkRect::MakeXYWH(x(rng), y(rng), extent(rng), extent(rng)),
+      .mRadius = radius(rng),
+      .mStrokeWidth = (i % 2) ? 2.0f : 0.0f,
+      .mColor = SkColorSetRGB(channel(rng), channel(rng), channel(rng)),
+    });
+  }
+  return ret;
+}
+
+}// namespace
+
+void BenchmarkRoundRectBatch(const BenchmarkEnvironment& env) {
+  static constexpr size_t FrameCount = 20;
+
+  for (const size_t count: {1'000, 10'000, 100'000}) {
+    const auto shapes = MakeShapes(env.mSize, count);
+
+    for (const auto& backend: env.mBackends) {
+      FrameDuration perShapeCPU {};
+      const auto perShape
+        = MeasureFrames(backend, FrameCount, [&](SkCanvas* canvas, size_t) {
+            const auto start = std::chrono::steady_clock::now();
+            SkPaint paint;
+            paint.setAntiAlias(true);
+            for (const auto& shape: shapes) {
+              paint.setColor(shape.mColor);
+              paint.setStyle(
+                shape.mStrokeWidth ? SkPaint::kStroke_Style
+                                   : SkPaint::kFill_Style);
+              paint.setStrokeWidth(shape.mStrokeWidth);
+              canvas->drawRoundRect(
+                shape.mRect, shape.mRadius, shape.mRadius, paint);
+            }
+            perShapeCPU += std::chrono::steady_clock::now() - start;
+          });
+
+      RoundRectBatch batch;
+      FrameDuration batchedCPU {};
+      const auto batched
+        = MeasureFrames(backend, FrameCount, [&](SkCanvas* canvas, size_t) {
+            const auto start = std::chrono::steady_clock::now();
+            batch.Clear();
+            for (const auto& shape: shapes) {
+              if (shape.mStrokeWidth) {
+                batch.AddStroke(
+                  shape.mRect, shape.mRadius, shape.mStrokeWidth, shape.mColor);
+              } else {
+                batch.AddFill(shape.mRect, shape.mRadius, shape.mColor);
+              }
+            }
+            batch.Draw(canvas);
+            batchedCPU += std::chrono::steady_clock::now() - start;
+          });
+
+      // MeasureFrames() also renders some warmup frames; this is close enough
+      std::cout << std::format(
+        "{} shapes, {}: per-shape {:.3f}ms CPU, {:.3f}ms frame; batched "
+        "{:.3f}ms CPU, {:.3f}ms frame\n",
+        count,
+        backend.mName,
+        perShapeCPU.count() / FrameCount,
+        perShape.count(),
+        batchedCPU.count() / FrameCount,
+        batched.count());
+    }
+  }
+}
@@ -0,0 +1,161 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "PersistentVector.hpp"
+#include "TripleBuffer.hpp"
+
+#include <algorithm>
+#include <format>
+#include <iostream>
+#include <random>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Microseconds = std::chrono::duration<double, std::micro>;
+
+struct SceneElement {
+  SkRect mBounds {};
+  SkColor mColor {};
+};
+
+struct Snapshot {
+  PersistentVector<SceneElement> mElements;
+  uint64_t mVersion {};
+  Clock::time_point mPublished {};
+};
+
+SceneElement MakeElement(std::mt19937& random) {
+  const auto x = static_cast<SkScalar>(random() % 1280);
+  const auto y = static_cast<SkScalar>(random() % 720);
+  return {SkRect::MakeXYWH(x, y, 32, 32), random() | 0xff000000};
+}
+
+void BenchmarkPublishCost() {
+  static constexpr size_t Publishes = 50;
+
+  std::cout << "Publish cost, structural sharing vs copying a std::vector\n";
+  std::mt19937 random {42};
+  for (const size_t sceneSize: {1'000, 100'000, 1'000'000}) {
+    PersistentVector<SceneElement> persistent;
+    std::vector<SceneElement> flat;
+    flat.reserve(sceneSize);
+    for (size_t i = 0; i < sceneSize; ++i) {
+      const auto element = MakeElement(random);
+      persistent = persistent.PushBack(element);
+      flat.push_back(element);
+    }
+
+    for (const size_t changes: {1, 100, 10'000}) {
+      if (changes > sceneSize) {
+        continue;
+      }
+      TripleBuffer<PersistentVector<SceneElement>> persistentBuffer;
+      TripleBuffer<std::vector<SceneElement>> flatBuffer;
+
+      auto start = Clock::now();
+      for (size_t i = 0; i < Publishes; ++i) {
+        for (size_t j = 0; j < changes; ++j) {
+          persistent
+            = persistent.Set(random() % sceneSize, MakeElement(random));
+        }
+        persistentBuffer.Publish(persistent);
+      }
+      const auto persistentCost
+        = std::chrono::duration_cast<Microseconds>(Clock::now() - start)
+        / Publishes;
+
+      start = Clock::now();
+      for (size_t i = 0; i < Publishes; ++i) {
+        for (size_t j = 0; j < changes; ++j) {
+          flat[random() % sceneSize] = MakeElement(random);
+        }
+        // The reader may be using the previous copy
+        flatBuffer.Publish(flat);
+      }
+      const auto flatCost
+        = std::chrono::duration_cast<Microseconds>(Clock::now() - start)
+        / Publishes;
+
+      std::cout << std::format(
+        "  {} elements, {} changes: {:.1f}us shared, {:.1f}us copied\n",
+        sceneSize,
+        changes,
+        persistentCost.count(),
+        flatCost.count());
+    }
+  }
+}
+
+void BenchmarkReaderLatency() {
+  static constexpr size_t SceneSize = 100'000;
+  static constexpr size_t ChangesPerPublish = 100;
+  static constexpr auto Duration = std::chrono::seconds {1};
+  static constexpr auto PublishInterval = std::chrono::milliseconds {1};
+
+  std::mt19937 random {42};
+  Snapshot initial;
+  for (size_t i = 0; i < SceneSize; ++i) {
+    initial.mElements = initial.mElements.PushBack(MakeElement(random));
+  }
+  TripleBuffer<Snapshot> buffer {initial};
+
+  std::atomic<uint64_t> published {};
+  std::jthread writer([&](std::stop_token stopToken) {
+    auto snapshot = initial;
+    while (!stopToken.stop_requested()) {
+      for (size_t i = 0; i < ChangesPerPublish; ++i) {
+        snapshot.mElements = snapshot.mElements.Set(
+          random() % SceneSize, MakeElement(random));
+      }
+      ++snapshot.mVersion;
+      snapshot.mPublished = Clock::now();
+      buffer.Publish(snapshot);
+      published.store(snapshot.mVersion, std::memory_order_relaxed);
+      std::this_thread::sleep_for(PublishInterval);
+    }
+  });
+
+  // The reader polls continuously, so this measures the hand-off, not a
+  // frame interval
+  std::vector<double> latencies;
+  uint64_t lastVersion {};
+  const auto end = Clock::now() + Duration;
+  while (Clock::now() < end) {
+    const auto& snapshot = buffer.Acquire();
+    if (snapshot.mVersion == lastVersion) {
+      continue;
+    }
+    lastVersion = snapshot.mVersion;
+    latencies.push_back(std::chrono::duration_cast<Microseconds>(
+                          Clock::now() - snapshot.mPublished)
+                          .count());
+  }
+  writer.request_stop();
+  writer.join();
+  if (latencies.empty()) {
+    return;
+  }
+
+  std::ranges::sort(latencies);
+  std::cout << std::format(
+    "Reader latency, {} elements with {} changes every {}ms: {:.1f}us "
+    "median, {:.1f}us p99, {:.1f}us max; saw {} of {} versions\n",
+    SceneSize,
+    ChangesPerPublish,
+    PublishInterval.count(),
+    latencies.at(latencies.size() / 2),
+    latencies.at((latencies.size() * 99) / 100),
+    latencies.back(),
+    latencies.size(),
+    published.load());
+}
+
+}// namespace
+
+void BenchmarkSceneSnapshots(const BenchmarkEnvironment&) {
+  BenchmarkPublishCost();
+  BenchmarkReaderLatency();
+}
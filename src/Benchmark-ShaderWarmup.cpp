@@ -0,0 +1,184 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "ShaderWarmup.hpp"
+#include "SyntheticScene.hpp"
+
+#include <Windows.h>
+#include <d3d12.h>
+#include <dxgi1_4.h>
+#include <skia/core/SkPictureRecorder.h>
+#include <skia/gpu/d3d/GrD3DBackendContext.h>
+#include <skia/gpu/ganesh/SkSurfaceGanesh.h>
+#include <wil/com.h>
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Each scene is shown this many times
+constexpr size_t VisitsPerScene = 2;
+
+using Clock = std::chrono::steady_clock;
+
+/// WARP is Direct3D's software rasterizer; pipeline creation is slow, and
+/// doesn't depend on the machine's GPU or driver caches
+struct WarpDevice {
+  wil::com_ptr<IDXGIAdapter1> mAdapter;
+  wil::com_ptr<ID3D12Device> mDevice;
+};
+
+std::optional<WarpDevice> CreateWarpDevice() {
+  wil::com_ptr<IDXGIFactory4> factory;
+  if (FAILED(CreateDXGIFactory2(0, IID_PPV_ARGS(factory.put())))) {
+    return std::nullopt;
+  }
+  WarpDevice ret;
+  if (FAILED(factory->EnumWarpAdapter(IID_PPV_ARGS(ret.mAdapter.put())))) {
+    return std::nullopt;
+  }
+  if (FAILED(D3D12CreateDevice(
+        ret.mAdapter.get(),
+        D3D_FEATURE_LEVEL_11_0,
+        IID_PPV_ARGS(ret.mDevice.put())))) {
+    return std::nullopt;
+  }
+  return ret;
+}
+
+sk_sp<GrDirectContext> CreateContext(
+  const WarpDevice& device,
+  const GrContextOptions& options) {
+  wil::com_ptr<ID3D12CommandQueue> queue;
+  D3D12_COMMAND_QUEUE_DESC desc {
+    .Type = D3D12_COMMAND_LIST_TYPE_DIRECT,
+    .Flags = D3D12_COMMAND_QUEUE_FLAG_NONE,
+  };
+  if (FAILED(device.mDevice->CreateCommandQueue(
+        &desc, IID_PPV_ARGS(queue.put())))) {
+    return nullptr;
+  }
+  GrD3DBackendContext backendContext {};
+  backendContext.fAdapter.retain(device.mAdapter.get());
+  backendContext.fDevice.retain(device.mDevice.get());
+  backendContext.fQueue.retain(queue.get());
+  return GrDirectContext::MakeDirect3D(backendContext, options);
+}
+
+struct FirstFrames {
+  size_t mFrames {};
+  FrameDuration mTotal {};
+  FrameDuration mWorst {};
+};
+
+/// The first frames rendered by a new context, as at startup
+FirstFrames MeasureFirstFrames(
+  const WarpDevice& device,
+  ShaderWarmup::Cache* cache,
+  const BenchmarkEnvironment& env,
+  const std::vector<std::unique_ptr<SyntheticScene>>& scenes) {
+  GrContextOptions options;
+  options.fPersistentCache = cache;
+  auto context = CreateContext(device, options);
+  auto surface = context ? SkSurfaces::RenderTarget(
+                             context.get(),
+                             skgpu::Budgeted::kNo,
+                             SkImageInfo::Make(
+                               env.mSize,
+                               kRGBA_8888_SkColorType,
+                               kPremul_SkAlphaType))
+                         : nullptr;
+  if (!surface) {
+    return {};
+  }
+
+  FirstFrames ret;
+  auto canvas = surface->getCanvas();
+  for (size_t i = 0; i < scenes.size() * VisitsPerScene; ++i) {
+    const auto start = Clock::now();
+    canvas->clear(SK_ColorBLACK);
+    scenes.at(i % scenes.size())->Draw(canvas, i);
+    context->flushAndSubmit(surface.get(), GrSyncCpu::kYes);
+    const auto elapsed
+      = std::chrono::duration_cast<FrameDuration>(Clock::now() - start);
+    ++ret.mFrames;
+    ret.mTotal += elapsed;
+    ret.mWorst = std::max(ret.mWorst, elapsed);
+  }
+  return ret;
+}
+
+}// namespace
+
+void BenchmarkShaderWarmup(const BenchmarkEnvironment& env) {
+  const auto device = CreateWarpDevice();
+  if (!device) {
+    std::cout << "WARP (the Direct3D 12 software adapter) is unavailable\n";
+    return;
+  }
+
+  // There are no bundled captures; use the first frame of each standard
+  // scene, as if it had been captured
+  std::vector<std::unique_ptr<SyntheticScene>> scenes;
+  std::vector<sk_sp<SkPicture>> corpus;
+  for (const auto& [name, config]: SyntheticScene::GetStandardCorpus()) {
+    auto& scene = scenes.emplace_back(
+      std::make_unique<SyntheticScene>(config, env.mSize, env.mFont));
+    SkPictureRecorder recorder;
+    scene->Draw(
+      recorder.beginRecording(SkRect::Make(env.mSize)), /* frame = */ 0);
+    corpus.push_back(recorder.finishRecordingAsPicture());
+  }
+
+  const auto report = [&](std::string_view name, const FirstFrames& frames) {
+    std::cout << std::format(
+      "  {}: {:.1f}ms for the first {} frames, worst {:.1f}ms\n",
+      name,
+      frames.mTotal.count(),
+      frames.mFrames,
+      frames.mWorst.count());
+  };
+
+  std::cout << std::format(
+    "WARP, {} scenes at {}x{}, each shown {} times:\n",
+    scenes.size(),
+    env.mSize.width(),
+    env.mSize.height(),
+    VisitsPerScene);
+
+  // Warm first, so that any caching below Skia favors the cold run
+  ShaderWarmup::Cache warmCache;
+  {
+    ShaderWarmup warmup {
+      &warmCache,
+      [&device](const GrContextOptions& options) {
+        return CreateContext(*device, options);
+      },
+      corpus,
+      ShaderWarmup::Options {},
+    };
+    warmup.Wait();
+    const auto stats = warmup.GetStats();
+    const auto cacheStats = warmCache.GetStats();
+    std::cout << std::format(
+      "  warmup: {} captures, {} tiles in {:.1f}ms; {} programs cached ({} "
+      "bytes)\n",
+      stats.mPictures,
+      stats.mTiles,
+      std::chrono::duration_cast<FrameDuration>(stats.mDuration).count(),
+      cacheStats.mEntries,
+      cacheStats.mBytes);
+  }
+  report("warm", MeasureFirstFrames(*device, &warmCache, env, scenes));
+
+  ShaderWarmup::Cache coldCache;
+  report("cold", MeasureFirstFrames(*device, &coldCache, env, scenes));
+}
@@ -0,0 +1,108 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "SpeculativeRenderer.hpp"
+#include "SyntheticScene.hpp"
+
+#include <format>
+#include <iostream>
+#include <random>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::chrono::nanoseconds FrameBudget {1'000'000'000 / 60};
+constexpr size_t FrameCount = 240;
+// Leave time to notice the deadline is coming before it has passed
+constexpr std::chrono::microseconds RenderAheadMargin {1000};
+
+/** Other work on the render thread, arriving in bursts.
+ *
+ * Bursts last a few frames, and take most of each frame's budget; the same
+ * seed is used for each run, so they are the same for each configuration.
+ */
+class BurstyLoad final {
+ public:
+  BurstyLoad() = default;
+
+  void Run() {
+    if (mRemainingFrames == 0) {
+      if (mRandom() % 100 >= BurstPercent) {
+        return;
+      }
+      mRemainingFrames = 3 + (mRandom() % 6);
+    }
+    --mRemainingFrames;
+
+    const auto load = FrameBudget * (60 + (mRandom() % 31)) / 100;
+    const auto end = Clock::now() + load;
+    while (Clock::now() < end) {
+      // Busy-wait, to simulate CPU work
+    }
+  }
+
+ private:
+  static constexpr uint32_t BurstPercent = 5;
+
+  std::mt19937 mRandom {42};
+  uint64_t mRemainingFrames {};
+};
+
+}// namespace
+
+void BenchmarkSpeculativeRenderer(const BenchmarkEnvironment& env) {
+  const auto config = SyntheticScene::FindInStandardCorpus("animated");
+  const SyntheticScene scene {*config, env.mSize, env.mFont};
+
+  std::cout << std::format(
+    "{} frames of 'animated' at 60Hz, with bursts of load on the render "
+    "thread\n",
+    FrameCount);
+  for (const auto& backend: env.mBackends) {
+    for (const size_t framesAhead: {0, 1, 3}) {
+      SpeculativeRenderer renderer {
+        backend.mContext.get(),
+        [&scene](SkCanvas* canvas, uint64_t frame) {
+          scene.Draw(canvas, frame);
+        },
+        framesAhead,
+      };
+      BurstyLoad load;
+
+      auto surface = backend.mSurface.get();
+      auto canvas = surface->getCanvas();
+      size_t missed {};
+      auto deadline = Clock::now() + FrameBudget;
+      for (uint64_t frame = 0; frame < FrameCount; ++frame) {
+        load.Run();
+        canvas->clear(SK_ColorBLACK);
+        renderer.DrawFrame(canvas, frame);
+        backend.Flush();
+
+        if (Clock::now() > deadline) {
+          // Like missing a vsync: the frame is shown at the next one
+          ++missed;
+          while (deadline < Clock::now()) {
+            deadline += FrameBudget;
+          }
+        }
+        renderer.RenderAhead(surface, frame, deadline - RenderAheadMargin);
+        std::this_thread::sleep_until(deadline);
+        deadline += FrameBudget;
+      }
+
+      const auto stats = renderer.GetStats();
+      std::cout << std::format(
+        "  {}, {} frames ahead: {:.1f}% missed deadlines ({} pre-rendered "
+        "frames used, {} discarded)\n",
+        backend.mName,
+        framesAhead,
+        (100.0 * missed) / FrameCount,
+        stats.mHits,
+        stats.mDiscarded);
+    }
+  }
+}
@@ -0,0 +1,30 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "SyntheticScene.hpp"
+
+#include <format>
+#include <iostream>
+
+void BenchmarkSyntheticScenes(const BenchmarkEnvironment& env) {
+  static constexpr size_t FrameCount = 50;
+
+  for (const auto& [name, config]: SyntheticScene::GetStandardCorpus()) {
+    const SyntheticScene scene {config, env.mSize, env.mFont};
+    std::cout << std::format(
+      "{}: {} elements in {} groups, depth {}\n",
+      name,
+      config.mElementCount,
+      scene.GetGroupCount(),
+      config.mDepth);
+    for (const auto& backend: env.mBackends) {
+      const auto duration = MeasureFrames(
+        backend, FrameCount, [&](SkCanvas* canvas, size_t frame) {
+          scene.Draw(canvas, frame);
+        });
+      std::cout << std::format(
+        "  {}: {:.3f}ms per frame\n", backend.mName, duration.count());
+    }
+  }
+}
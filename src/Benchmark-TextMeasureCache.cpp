@@ -0,0 +1,70 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "TextMeasureCache.hpp"
+
+#include <format>
+#include <iostream>
+
+void BenchmarkTextMeasureCache(const BenchmarkEnvironment& env) {
+  static constexpr size_t StringCount = 50'000;
+  static constexpr size_t Iterations = 10;
+
+  SkFont font = env.mFont;
+  font.setSize(12);
+
+  // Mostly ASCII, like typical UI labels; every tenth string is not
+  std::vector<std::string> strings;
+  strings.reserve(StringCount);
+  for (size_t i = 0; i < StringCount; ++i) {
+    strings.push_back(
+      (i % 10) ? std::format("Item {}: {}%", i, i % 100)
+               // "Größe", escaped as MSVC does not assume UTF-8 source
+               : std::format("Gr\xc3\xb6\xc3\x9f" "e {}", i));
+  }
+
+  // Stop the compiler from discarding the results
+  SkScalar total {};
+
+  const auto baselineStart = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < Iterations; ++i) {
+    for (const auto& it: strings) {
+      total += font.measureText(it.data(), it.size(), SkTextEncoding::kUTF8);
+    }
+  }
+  const auto baseline = std::chrono::duration_cast<FrameDuration>(
+    std::chrono::steady_clock::now() - baselineStart);
+
+  for (const size_t budget:
+       {TextMeasureCache::DefaultByteBudget / 16,
+        TextMeasureCache::DefaultByteBudget}) {
+    TextMeasureCache cache {budget};
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < Iterations; ++i) {
+      for (const auto& it: strings) {
+        total += cache.MeasureText(it, font);
+      }
+    }
+    const auto cached = std::chrono::duration_cast<FrameDuration>(
+      std::chrono::steady_clock::now() - start);
+
+    const auto stats = cache.GetStats();
+    std::cout << std::format(
+      "{}KiB budget: {:.3f}ms -> {:.3f}ms per {} strings; {:.1f}% hits "
+      "({} via advance tables), {} strings cached in {}KiB, {} evictions\n",
+      budget / 1024,
+      baseline.count() / Iterations,
+      cached.count() / Iterations,
+      StringCount,
+      stats.GetHitRate() * 100,
+      stats.mTableHits,
+      stats.mStrings,
+      stats.mBytes / 1024,
+      stats.mEvictions);
+  }
+
+  if (total < 0) {
+    std::cout << "unreachable\n";
+  }
+}
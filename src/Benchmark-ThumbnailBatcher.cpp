@@ -0,0 +1,116 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+#include "SyntheticScene.hpp"
+#include "ThumbnailBatcher.hpp"
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr size_t ThumbnailCount = 2'000;
+constexpr SkISize ThumbnailSize {160, 120};
+// Thumbnails cycle through this many distinct scenes
+constexpr size_t SceneCount = 16;
+
+using Clock = std::chrono::steady_clock;
+
+/// A surface, flush, and readback per thumbnail
+size_t RenderIndividually(
+  const BenchmarkBackend& backend,
+  std::span<const ThumbnailBatcher::Thumbnail> thumbnails) {
+  size_t rendered = 0;
+  for (const auto& thumbnail: thumbnails) {
+    const auto info = backend.mSurface->imageInfo().makeWH(
+      thumbnail.mSize.width(), thumbnail.mSize.height());
+    auto surface = backend.mSurface->makeSurface(info);
+    SkBitmap bitmap;
+    if (!(surface && bitmap.tryAllocPixels(info))) {
+      continue;
+    }
+    auto canvas = surface->getCanvas();
+    canvas->clear(SK_ColorTRANSPARENT);
+    thumbnail.mDraw(canvas);
+    if (backend.mContext) {
+      backend.mContext->flushAndSubmit(surface.get(), GrSyncCpu::kYes);
+    }
+    if (surface->readPixels(bitmap, 0, 0)) {
+      ++rendered;
+    }
+  }
+  return rendered;
+}
+
+}// namespace
+
+void BenchmarkThumbnailBatcher(const BenchmarkEnvironment& env) {
+  // Small scenes, so that per-surface overhead is visible
+  std::vector<std::unique_ptr<SyntheticScene>> scenes;
+  for (size_t i = 0; i < SceneCount; ++i) {
+    auto config = *SyntheticScene::FindInStandardCorpus("ui-sparse");
+    config.mSeed = i;
+    config.mElementCount = 20;
+    scenes.push_back(
+      std::make_unique<SyntheticScene>(config, ThumbnailSize, env.mFont));
+  }
+
+  std::vector<ThumbnailBatcher::Thumbnail> thumbnails;
+  thumbnails.reserve(ThumbnailCount);
+  for (size_t i = 0; i < ThumbnailCount; ++i) {
+    thumbnails.push_back({
+      ThumbnailSize,
+      [scene = scenes.at(i % SceneCount).get(), i](SkCanvas* canvas) {
+        scene->Draw(canvas, i);
+      },
+    });
+  }
+
+  std::cout << std::format(
+    "{} thumbnails of {}x{}\n",
+    ThumbnailCount,
+    ThumbnailSize.width(),
+    ThumbnailSize.height());
+  const auto report = [](
+                        std::string_view name,
+                        size_t rendered,
+                        Clock::duration elapsed) {
+    const auto seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << std::format(
+      "    {}: {:.0f} thumbnails/s ({} rendered)\n",
+      name,
+      rendered / seconds,
+      rendered);
+  };
+
+  for (const auto& backend: env.mBackends) {
+    std::cout << std::format("  {}:\n", backend.mName);
+    {
+      const auto start = Clock::now();
+      const auto rendered = RenderIndividually(backend, thumbnails);
+      report("one surface each", rendered, Clock::now() - start);
+    }
+
+    for (const auto atlasSize: {1024, 4096}) {
+      ThumbnailBatcher batcher {
+        backend.mContext.get(),
+        backend.mSurface.get(),
+        {.mAtlasSize = {atlasSize, atlasSize}},
+      };
+      const auto start = Clock::now();
+      const auto results = batcher.Render(thumbnails);
+      const auto elapsed = Clock::now() - start;
+      const auto stats = batcher.GetStats();
+      report(
+        std::format("{}px atlases ({} atlases)", atlasSize, stats.mAtlases),
+        stats.mThumbnails - stats.mFailed,
+        elapsed);
+    }
+  }
+}
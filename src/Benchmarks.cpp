@@ -0,0 +1,119 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Benchmarks.hpp"
+
+#include "OutputColorType.hpp"
+#include "Win32Helpers.hpp"
+
+#include <skia/core/SkFontMgr.h>
+#include <skia/gpu/ganesh/SkSurfaceGanesh.h>
+#include <skia/ports/SkFontMgr_empty.h>
+
+#include <format>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+void BenchmarkBackend::Flush() const {
+  if (mContext) {
+    mContext->flushAndSubmit(mSurface.get(), GrSyncCpu::kYes);
+  }
+}
+
+namespace {
+
+BenchmarkEnvironment CreateEnvironment() {
+  BenchmarkEnvironment env {.mSize = {1280, 720}};
+
+  const auto fontPath = GetKnownFolderPath<FOLDERID_Fonts>();
+  if (!fontPath.empty()) {
+    env.mFont = SkFont {SkFontMgr_New_Custom_Empty()->makeFromFile(
+      (fontPath / "segoeui.ttf").string().c_str())};
+  }
+
+  const auto info = SkImageInfo::Make(
+    env.mSize, kRGBA_8888_SkColorType, kPremul_SkAlphaType);
+
+  // e.g. `rgb565`, to measure a reduced-bandwidth raster backend; see
+  // GetOutputColorTypes()
+  auto rasterInfo = info;
+  char colorType[32] {};
+  const auto colorTypeLength = GetEnvironmentVariableA(
+    "HELLOSKIA_RASTER_COLOR_TYPE", colorType, sizeof(colorType));
+  if (colorTypeLength > 0 && colorTypeLength < sizeof(colorType)) {
+    const std::string_view name {colorType, colorTypeLength};
+    if (const auto parsed = ParseOutputColorType(name)) {
+      rasterInfo = MakeOutputInfo(info, *parsed);
+    } else {
+      std::cout << std::format(
+        "Unknown HELLOSKIA_RASTER_COLOR_TYPE `{}`; using rgba8888\n", name);
+    }
+  }
+  env.mBackends.push_back({
+    .mName = (rasterInfo.colorType() == info.colorType())
+      ? std::string {"raster"}
+      : std::format(
+          "raster-{}", GetOutputColorTypeName(rasterInfo.colorType())),
+    .mSurface = SkSurfaces::Raster(rasterInfo),
+  });
+
+  auto mockContext = GrDirectContext::MakeMock(nullptr);
+  auto mockSurface
+    = SkSurfaces::RenderTarget(mockContext.get(), skgpu::Budgeted::kNo, info);
+  env.mBackends.push_back({
+    .mName = "mock",
+    .mContext = std::move(mockContext),
+    .mSurface = std::move(mockSurface),
+  });
+
+  return env;
+}
+
+}// namespace
+
+int main(int argc, char** argv) {
+  using Benchmark = void (*)(const BenchmarkEnvironment&);
+  static constexpr std::pair<std::string_view, Benchmark> Benchmarks[] {
+    {"reorder", &BenchmarkReorder},
+    {"interner", &BenchmarkInterner},
+    {"instances", &BenchmarkInstanceCache},
+    {"rrect-batch", &BenchmarkRoundRectBatch},
+    {"layout", &BenchmarkLayout},
+    {"immediate-ui", &BenchmarkImmediateUI},
+    {"text-measure", &BenchmarkTextMeasureCache},
+    {"labels", &BenchmarkLabelPlacer},
+    {"deep-zoom", &BenchmarkDeepZoom},
+    {"tile-compression", &BenchmarkTileCompression},
+    {"pdf-export", &BenchmarkPdfExport},
+    {"scenes", &BenchmarkSyntheticScenes},
+    {"speculation", &BenchmarkSpeculativeRenderer},
+    {"progressive", &BenchmarkProgressiveLayer},
+    {"refresh-domains", &BenchmarkRefreshScheduler},
+    {"snapshots", &BenchmarkSceneSnapshots},
+    {"optimize", &BenchmarkDisplayListOptimizer},
+    {"thumbnails", &BenchmarkThumbnailBatcher},
+    {"warmup", &BenchmarkShaderWarmup},
+    {"color-types", &BenchmarkOutputColorTypes},
+    {"emoji", &BenchmarkColorGlyphCache},
+  };
+
+  const auto env = CreateEnvironment();
+
+  for (const auto& [name, benchmark]: Benchmarks) {
+    if (argc > 1) {
+      bool selected = false;
+      for (int i = 1; i < argc; ++i) {
+        selected |= (name == argv[i]);
+      }
+      if (!selected) {
+        continue;
+      }
+    }
+    std::cout << std::format("## {}\n", name);
+    benchmark(env);
+    std::cout << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,80 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkFont.h>
+#include <skia/core/SkSurface.h>
+#include <skia/gpu/GrDirectContext.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using FrameDuration = std::chrono::duration<double, std::milli>;
+
+/** A surface to render benchmark frames into.
+ *
+ * - 'raster': Skia's software backend
+ * - 'mock': Ganesh with the mock GPU backend; this measures Ganesh's CPU-side
+ *   costs (op creation, batching, flushing) without depending on a real GPU
+ */
+struct BenchmarkBackend {
+  std::string mName;
+  sk_sp<GrDirectContext> mContext;// nullptr for raster
+  sk_sp<SkSurface> mSurface;
+
+  void Flush() const;
+};
+
+struct BenchmarkEnvironment {
+  SkFont mFont;
+  SkISize mSize {};
+  std::vector<BenchmarkBackend> mBackends;
+};
+
+/// Mean frame time, including flushing the backend
+template <class F>
+FrameDuration MeasureFrames(
+  const BenchmarkBackend& backend,
+  const size_t frameCount,
+  F&& renderFrame) {
+  static constexpr size_t WarmupFrames = 3;
+  auto canvas = backend.mSurface->getCanvas();
+  for (size_t i = 0; i < WarmupFrames; ++i) {
+    canvas->clear(SK_ColorBLACK);
+    renderFrame(canvas, i);
+    backend.Flush();
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < frameCount; ++i) {
+    canvas->clear(SK_ColorBLACK);
+    renderFrame(canvas, WarmupFrames + i);
+    backend.Flush();
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration_cast<FrameDuration>(elapsed) / frameCount;
+}
+
+void BenchmarkReorder(const BenchmarkEnvironment&);
+void BenchmarkInterner(const BenchmarkEnvironment&);
+void BenchmarkInstanceCache(const BenchmarkEnvironment&);
+void BenchmarkRoundRectBatch(const BenchmarkEnvironment&);
+void BenchmarkLayout(const BenchmarkEnvironment&);
+void BenchmarkImmediateUI(const BenchmarkEnvironment&);
+void BenchmarkTextMeasureCache(const BenchmarkEnvironment&);
+void BenchmarkLabelPlacer(const BenchmarkEnvironment&);
+void BenchmarkDeepZoom(const BenchmarkEnvironment&);
+void BenchmarkTileCompression(const BenchmarkEnvironment&);
+void BenchmarkPdfExport(const BenchmarkEnvironment&);
+void BenchmarkSyntheticScenes(const BenchmarkEnvironment&);
+void BenchmarkSpeculativeRenderer(const BenchmarkEnvironment&);
+void BenchmarkProgressiveLayer(const BenchmarkEnvironment&);
+void BenchmarkRefreshScheduler(const BenchmarkEnvironment&);
+void BenchmarkSceneSnapshots(const BenchmarkEnvironment&);
+void BenchmarkDisplayListOptimizer(const BenchmarkEnvironment&);
+void BenchmarkThumbnailBatcher(const BenchmarkEnvironment&);
+void BenchmarkShaderWarmup(const BenchmarkEnvironment&);
+void BenchmarkOutputColorTypes(const BenchmarkEnvironment&);
+void BenchmarkColorGlyphCache(const BenchmarkEnvironment&);
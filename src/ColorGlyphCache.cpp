@@ -0,0 +1,362 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "ColorGlyphCache.hpp"
+
+#include "HashCombine.hpp"
+
+#include <Windows.h>
+#include <skia/core/SkTypeface.h>
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+
+size_t std::hash<ColorGlyphKey>::operator()(
+  const ColorGlyphKey& key) const noexcept {
+  size_t seed {};
+  HashCombine(seed, key.mTypeface);
+  HashCombine(seed, key.mGlyph);
+  HashCombine(seed, key.mSize);
+  return seed;
+}
+
+ColorGlyphCache::ColorGlyphCache(SkSurface* compatible, const Options& options)
+  : mOptions(options) {
+  const auto plotSize = mOptions.mPlotSize;
+  const auto plotBytes = static_cast<size_t>(plotSize) * plotSize * 4;
+  // Round down, so that the atlas stays within the budget
+  const auto plotCount
+    = std::max<size_t>(1, mOptions.mBudgetBytes / plotBytes);
+  const auto columns = static_cast<int>(std::sqrt(plotCount));
+  const auto rows = static_cast<int>(plotCount / columns);
+
+  mAtlas = compatible->makeSurface(SkImageInfo::Make(
+    columns * plotSize,
+    rows * plotSize,
+    kRGBA_8888_SkColorType,
+    kPremul_SkAlphaType));
+  if (!mAtlas) {
+    OutputDebugStringA(
+      std::format(
+        "Failed to create {}x{} color glyph atlas\n",
+        columns * plotSize,
+        rows * plotSize)
+        .c_str());
+  } else {
+    mAtlas->getCanvas()->clear(SK_ColorTRANSPARENT);
+    mAtlasImage = mAtlas->makeImageSnapshot();
+    for (int y = 0; y < rows; ++y) {
+      for (int x = 0; x < columns; ++x) {
+        mPlots.push_back({
+          .mBounds = SkIRect::MakeXYWH(
+            x * plotSize, y * plotSize, plotSize, plotSize),
+        });
+      }
+    }
+  }
+
+  auto workerThreads = mOptions.mWorkerThreads;
+  if (workerThreads == 0) {
+    // Leave a core for the render thread
+    workerThreads
+      = std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 3) - 1;
+  }
+  for (size_t i = 0; i < workerThreads; ++i) {
+    mWorkers.emplace_back(std::bind_front(&ColorGlyphCache::RunJobs, this));
+  }
+}
+
+ColorGlyphCache::~ColorGlyphCache() {
+  // Request stop and join before anything the workers use is destroyed
+  mWorkers.clear();
+}
+
+bool ColorGlyphCache::HasColorGlyphs(const SkTypeface& typeface) {
+  static constexpr SkFontTableTag ColorTables[] {
+    SkSetFourByteTag('C', 'O', 'L', 'R'),
+    SkSetFourByteTag('C', 'B', 'D', 'T'),
+    SkSetFourByteTag('s', 'b', 'i', 'x'),
+    SkSetFourByteTag('S', 'V', 'G', ' '),
+  };
+  std::vector<SkFontTableTag> tags(typeface.countTables());
+  typeface.readTableTags(tags.data());
+  return std::ranges::find_first_of(tags, ColorTables) != tags.end();
+}
+
+void ColorGlyphCache::BeginFrame() {
+  ++mFrame;
+
+  decltype(mRasterized) rasterized;
+  {
+    std::unique_lock lock(mMutex);
+    rasterized = std::exchange(mRasterized, {});
+    for (const auto& it: rasterized) {
+      mPending.erase(it.mKey);
+    }
+
+    const auto workerStats = std::exchange(mWorkerStats, {});
+    mStats.mRasterized += workerStats.mRasterized;
+    mStats.mRasterizeTime += workerStats.mRasterizeTime;
+  }
+  if (rasterized.empty() || !mAtlas) {
+    return;
+  }
+
+  // If we're the only reference to the snapshot, writing to the atlas
+  // doesn't need to copy it first
+  mAtlasImage.reset();
+  for (auto&& it: rasterized) {
+    this->Insert(std::move(it));
+  }
+  mAtlasImage = mAtlas->makeImageSnapshot();
+}
+
+void ColorGlyphCache::DrawGlyphs(
+  SkCanvas* canvas,
+  std::span<const SkGlyphID> glyphs,
+  std::span<const SkPoint> positions,
+  SkPoint origin,
+  const SkFont& font,
+  const SkPaint& paint) {
+  const auto count = std::min(glyphs.size(), positions.size());
+  const auto typeface = font.getTypeface();
+  if (!(typeface && mAtlasImage)) {
+    canvas->drawGlyphs(
+      static_cast<int>(count),
+      glyphs.data(),
+      positions.data(),
+      origin,
+      font,
+      paint);
+    return;
+  }
+
+  mTransforms.clear();
+  mSourceRects.clear();
+  for (size_t i = 0; i < count; ++i) {
+    const ColorGlyphKey key {
+      typeface->uniqueID(),
+      glyphs[i],
+      font.getSize(),
+    };
+    ++mStats.mLookups;
+
+    const auto it = mEntries.find(key);
+    if (it == mEntries.end()) {
+      ++mStats.mMisses;
+      this->Request(key, font);
+      if (mOptions.mDrawMissingDirectly) {
+        canvas->drawGlyphs(1, &glyphs[i], &positions[i], origin, font, paint);
+      }
+      continue;
+    }
+
+    const auto& entry = it->second;
+    if (entry.mOversized) {
+      ++mStats.mOversized;
+      canvas->drawGlyphs(1, &glyphs[i], &positions[i], origin, font, paint);
+      continue;
+    }
+    ++mStats.mHits;
+    // e.g. a space
+    if (entry.mRect.isEmpty()) {
+      continue;
+    }
+
+    mPlots.at(entry.mPlot).mLastUsedFrame = mFrame;
+    const auto position = origin + positions[i] + entry.mOffset;
+    mTransforms.push_back(SkRSXform::Make(1, 0, position.x(), position.y()));
+    mSourceRects.push_back(SkRect::Make(entry.mRect));
+  }
+
+  if (mTransforms.empty()) {
+    return;
+  }
+  canvas->drawAtlas(
+    mAtlasImage.get(),
+    mTransforms.data(),
+    mSourceRects.data(),
+    /* colors = */ nullptr,
+    static_cast<int>(mTransforms.size()),
+    SkBlendMode::kModulate,
+    SkSamplingOptions {},
+    /* cullRect = */ nullptr,
+    &paint);
+}
+
+ColorGlyphCache::Stats ColorGlyphCache::GetStats() const {
+  auto ret = mStats;
+  ret.mGlyphs = mEntries.size();
+  if (mAtlas) {
+    ret.mAtlasBytes = mAtlas->imageInfo().computeMinByteSize();
+  }
+  return ret;
+}
+
+void ColorGlyphCache::ResetStats() {
+  mStats = {};
+}
+
+void ColorGlyphCache::Request(const ColorGlyphKey& key, const SkFont& font) {
+  {
+    std::unique_lock lock(mMutex);
+    if (!mPending.insert(key).second) {
+      return;
+    }
+    mQueue.push_back({key, font.refTypeface()});
+  }
+  mWorkAvailable.notify_one();
+}
+
+void ColorGlyphCache::RunJobs(std::stop_token stopToken) {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock lock(mMutex);
+      const auto haveWork = mWorkAvailable.wait(
+        lock, stopToken, [this]() { return !mQueue.empty(); });
+      if (!haveWork) {
+        // Stop requested
+        return;
+      }
+      job = std::move(mQueue.front());
+      mQueue.pop_front();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto rasterized = Rasterize(job, mOptions.mPlotSize);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    std::unique_lock lock(mMutex);
+    ++mWorkerStats.mRasterized;
+    mWorkerStats.mRasterizeTime += elapsed;
+    mRasterized.push_back(std::move(rasterized));
+  }
+}
+
+ColorGlyphCache::Rasterized ColorGlyphCache::Rasterize(
+  const Job& job,
+  int plotSize) {
+  const SkFont font {job.mTypeface, job.mKey.mSize};
+  SkRect bounds {};
+  font.getBounds(&job.mKey.mGlyph, 1, &bounds, nullptr);
+  const auto glyphBounds = bounds.roundOut();
+
+  Rasterized ret {
+    .mKey = job.mKey,
+    .mOffset = SkPoint::Make(glyphBounds.left(), glyphBounds.top()),
+  };
+  if (glyphBounds.isEmpty()) {
+    return ret;
+  }
+
+  const auto info = SkImageInfo::Make(
+    glyphBounds.width() + (2 * GlyphPadding),
+    glyphBounds.height() + (2 * GlyphPadding),
+    kRGBA_8888_SkColorType,
+    kPremul_SkAlphaType);
+  if (
+    info.width() > plotSize || info.height() > plotSize
+    || !ret.mPixels.tryAllocPixels(info)) {
+    ret.mOversized = true;
+    return ret;
+  }
+  // Includes the padding, so that it overwrites anything left behind by an
+  // evicted glyph
+  ret.mPixels.eraseColor(SK_ColorTRANSPARENT);
+
+  auto canvas = SkCanvas::MakeRasterDirect(
+    info, ret.mPixels.getPixels(), ret.mPixels.rowBytes());
+  const SkPoint position {0, 0};
+  canvas->drawGlyphs(
+    1,
+    &job.mKey.mGlyph,
+    &position,
+    SkPoint::Make(
+      GlyphPadding - glyphBounds.left(), GlyphPadding - glyphBounds.top()),
+    font,
+    SkPaint {});
+  ret.mPixels.setImmutable();
+  return ret;
+}
+
+void ColorGlyphCache::Insert(Rasterized&& rasterized) {
+  Entry entry {
+    .mOversized = rasterized.mOversized,
+    .mOffset = rasterized.mOffset,
+  };
+  if (rasterized.mOversized || rasterized.mPixels.drawsNothing()) {
+    mEntries.insert_or_assign(rasterized.mKey, entry);
+    return;
+  }
+
+  const auto& pixels = rasterized.mPixels;
+  const auto allocation = this->Allocate(pixels.info().dimensions());
+  if (!allocation) {
+    // Not cached, so it's requested again if it's still needed
+    return;
+  }
+  const auto& [plot, origin] = *allocation;
+  mAtlas->writePixels(pixels, origin.x(), origin.y());
+
+  entry.mPlot = plot;
+  entry.mRect = SkIRect::MakeXYWH(
+    origin.x() + GlyphPadding,
+    origin.y() + GlyphPadding,
+    pixels.width() - (2 * GlyphPadding),
+    pixels.height() - (2 * GlyphPadding));
+  mPlots.at(plot).mGlyphs.push_back(rasterized.mKey);
+  mPlots.at(plot).mLastUsedFrame = mFrame;
+  mEntries.insert_or_assign(rasterized.mKey, entry);
+}
+
+std::optional<std::pair<size_t, SkIPoint>> ColorGlyphCache::Allocate(
+  const SkISize& size) {
+  const auto plotSize = mOptions.mPlotSize;
+  if (mPlots.empty() || size.width() > plotSize || size.height() > plotSize) {
+    return std::nullopt;
+  }
+
+  // Shelf packing, as in ThumbnailBatcher
+  const auto tryAllocate = [&size, plotSize](Plot& plot) {
+    auto& cursor = plot.mCursor;
+    if (cursor.x() + size.width() > plotSize) {
+      cursor = {0, cursor.y() + plot.mShelfHeight};
+      plot.mShelfHeight = 0;
+    }
+    if (cursor.y() + size.height() > plotSize) {
+      return std::optional<SkIPoint> {};
+    }
+    const auto ret = std::optional {SkIPoint::Make(
+      plot.mBounds.left() + cursor.x(), plot.mBounds.top() + cursor.y())};
+    cursor.fX += size.width();
+    plot.mShelfHeight = std::max(plot.mShelfHeight, size.height());
+    return ret;
+  };
+
+  for (size_t i = 0; i < mPlots.size(); ++i) {
+    if (const auto origin = tryAllocate(mPlots.at(i))) {
+      return std::pair {i, *origin};
+    }
+  }
+
+  const auto lru = std::ranges::min_element(mPlots, {}, &Plot::mLastUsedFrame);
+  const auto index = static_cast<size_t>(lru - mPlots.begin());
+  this->EvictPlot(index);
+  // An empty plot always has room, as the size is no larger than a plot
+  return std::pair {index, *tryAllocate(*lru)};
+}
+
+void ColorGlyphCache::EvictPlot(size_t index) {
+  auto& plot = mPlots.at(index);
+  for (const auto& key: plot.mGlyphs) {
+    mEntries.erase(key);
+  }
+  ++mStats.mPlotEvictions;
+  mStats.mGlyphEvictions += plot.mGlyphs.size();
+  plot.mGlyphs.clear();
+  plot.mCursor = {};
+  plot.mShelfHeight = 0;
+  plot.mLastUsedFrame = mFrame;
+}
@@ -0,0 +1,194 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkBitmap.h>
+#include <skia/core/SkCanvas.h>
+#include <skia/core/SkFont.h>
+#include <skia/core/SkImage.h>
+#include <skia/core/SkRSXform.h>
+#include <skia/core/SkSurface.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct ColorGlyphKey {
+  SkTypefaceID mTypeface {};
+  SkGlyphID mGlyph {};
+  SkScalar mSize {};
+
+  bool operator==(const ColorGlyphKey&) const noexcept = default;
+};
+
+template <>
+struct std::hash<ColorGlyphKey> {
+  size_t operator()(const ColorGlyphKey&) const noexcept;
+};
+
+/** Caches color glyphs - e.g. emoji - in a shared RGBA atlas.
+ *
+ * Color glyphs (COLR, CBDT, sbix, or SVG) are rasterized as images rather
+ * than as A8 coverage masks, which is much more expensive. Here, each
+ * (glyph, size) is rasterized once by a worker thread, and copied into the
+ * atlas by `BeginFrame()`; each `DrawGlyphs()` is then a single
+ * `drawAtlas()` of the glyphs that are ready.
+ *
+ * The atlas is split into square plots, each filled with shelves of glyphs.
+ * When no plot has room for a new glyph, the least recently used plot is
+ * emptied, so the atlas never exceeds the byte budget.
+ *
+ * Glyphs are rasterized at the font size, in device pixels; draw with a
+ * transform that doesn't scale, and include any scale in the font size.
+ *
+ * Apart from the worker threads, not thread-safe.
+ */
+class ColorGlyphCache final {
+ public:
+  struct Options {
+    // Of the atlas, which is allocated up front
+    size_t mBudgetBytes {16 * 1024 * 1024};
+    // Glyphs larger than a plot are drawn directly, without caching
+    int mPlotSize {256};
+    // If false, glyphs that are not ready yet are not drawn
+    bool mDrawMissingDirectly {false};
+    // 0 picks a count based on the number of cores
+    size_t mWorkerThreads {0};
+  };
+
+  struct Stats {
+    size_t mLookups {};
+    size_t mHits {};
+    // Not rasterized yet
+    size_t mMisses {};
+    // Too large for a plot, so drawn directly
+    size_t mOversized {};
+
+    size_t mRasterized {};
+    size_t mPlotEvictions {};
+    size_t mGlyphEvictions {};
+    // Total time spent by the workers
+    std::chrono::nanoseconds mRasterizeTime {};
+
+    size_t mGlyphs {};
+    size_t mAtlasBytes {};
+  };
+
+  /// The atlas is created by `compatible->makeSurface()`
+  ColorGlyphCache(SkSurface* compatible, const Options&);
+  ~ColorGlyphCache();
+
+  ColorGlyphCache() = delete;
+  ColorGlyphCache(const ColorGlyphCache&) = delete;
+  ColorGlyphCache(ColorGlyphCache&&) = delete;
+  ColorGlyphCache& operator=(const ColorGlyphCache&) = delete;
+  ColorGlyphCache& operator=(ColorGlyphCache&&) = delete;
+
+  /// True if the typeface has any color glyph tables
+  static bool HasColorGlyphs(const SkTypeface&);
+
+  /** Copies newly-rasterized glyphs into the atlas.
+   *
+   * Call after the previous frame has been flushed, as this may overwrite
+   * glyphs that it used.
+   */
+  void BeginFrame();
+
+  /** Like `SkCanvas::drawGlyphs()`, but from the atlas.
+   *
+   * Glyphs that are not in the atlas are requested. `paint` is used for
+   * the whole run, e.g. for alpha, but not for its color.
+   */
+  void DrawGlyphs(
+    SkCanvas*,
+    std::span<const SkGlyphID> glyphs,
+    std::span<const SkPoint> positions,
+    SkPoint origin,
+    const SkFont&,
+    const SkPaint& paint = {});
+
+  [[nodiscard]] Stats GetStats() const;
+  void ResetStats();
+
+ private:
+  // Transparent pixels around each glyph, so that sampling doesn't bleed
+  // into neighbors
+  static constexpr int GlyphPadding = 1;
+
+  struct Plot {
+    SkIRect mBounds {};
+    SkIPoint mCursor {};
+    int mShelfHeight {};
+    uint64_t mLastUsedFrame {};
+    std::vector<ColorGlyphKey> mGlyphs;
+  };
+
+  struct Entry {
+    // For oversized glyphs, not in the atlas
+    bool mOversized {false};
+    size_t mPlot {};
+    // In the atlas, excluding padding
+    SkIRect mRect {};
+    // From the glyph origin to the top left of `mRect`
+    SkPoint mOffset {};
+  };
+
+  struct Job {
+    ColorGlyphKey mKey;
+    sk_sp<SkTypeface> mTypeface;
+  };
+
+  struct Rasterized {
+    ColorGlyphKey mKey;
+    // Empty for oversized glyphs
+    SkBitmap mPixels;
+    SkPoint mOffset {};
+    bool mOversized {false};
+  };
+
+  Options mOptions;
+  sk_sp<SkSurface> mAtlas;
+  // Snapshot of mAtlas; reset before writing to it, so that writes don't
+  // copy the atlas
+  sk_sp<SkImage> mAtlasImage;
+  std::vector<Plot> mPlots;
+  std::unordered_map<ColorGlyphKey, Entry> mEntries;
+  uint64_t mFrame {};
+  Stats mStats;
+
+  // Scratch space for DrawGlyphs()
+  std::vector<SkRSXform> mTransforms;
+  std::vector<SkRect> mSourceRects;
+
+  // Shared with the workers
+  mutable std::mutex mMutex;
+  std::condition_variable_any mWorkAvailable;
+  std::deque<Job> mQueue;
+  // Queued or in progress
+  std::unordered_set<ColorGlyphKey> mPending;
+  std::vector<Rasterized> mRasterized;
+  // Added to mStats by BeginFrame()
+  Stats mWorkerStats;
+
+  std::vector<std::jthread> mWorkers;
+
+  void Request(const ColorGlyphKey&, const SkFont&);
+  void RunJobs(std::stop_token);
+  static Rasterized Rasterize(const Job&, int plotSize);
+
+  void Insert(Rasterized&&);
+  /** Evicts the least recently used plot if none have room.
+   *
+   * `std::nullopt` if there is no atlas, or the size is larger than a plot.
+   */
+  std::optional<std::pair<size_t, SkIPoint>> Allocate(const SkISize&);
+  void EvictPlot(size_t index);
+};
@@ -0,0 +1,194 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "DeepZoomViewer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Weight of the latest frame in the smoothed velocity
+constexpr SkScalar VelocitySmoothing = 0.5f;
+
+SkScalar GetLevelScale(uint32_t level) {
+  return std::ldexp(1.0f, static_cast<int>(level));
+}
+
+}// namespace
+
+DeepZoomViewer::DeepZoomViewer(
+  const TileContainer& container,
+  TileCache& cache)
+  : mContainer(container),
+    mCache(cache) {
+}
+
+void DeepZoomViewer::SetPrefetchEnabled(bool enabled) noexcept {
+  mPrefetchEnabled = enabled;
+}
+
+void DeepZoomViewer::SetView(const View& view) {
+  if (mHaveView) {
+    const auto pan = view.mCenter - mView.mCenter;
+    const auto zoom = std::log2(view.mScale / mView.mScale);
+    mPanVelocity = SkVector::Make(
+      std::lerp(mPanVelocity.x(), pan.x(), VelocitySmoothing),
+      std::lerp(mPanVelocity.y(), pan.y(), VelocitySmoothing));
+    mZoomVelocity = std::lerp(mZoomVelocity, zoom, VelocitySmoothing);
+  }
+  mView = view;
+  mHaveView = true;
+}
+
+DeepZoomViewer::View DeepZoomViewer::GetView() const noexcept {
+  return mView;
+}
+
+DeepZoomViewer::View DeepZoomViewer::GetFitView(
+  const SkISize& viewport) const {
+  const auto size = mContainer.GetSize();
+  return {
+    .mCenter = {size.width() / 2.0f, size.height() / 2.0f},
+    .mScale = std::min(
+      static_cast<SkScalar>(viewport.width()) / size.width(),
+      static_cast<SkScalar>(viewport.height()) / size.height()),
+  };
+}
+
+uint32_t DeepZoomViewer::GetLevel(SkScalar scale) const {
+  const auto maxLevel = mContainer.GetLevels().size() - 1;
+  if (scale >= 1) {
+    return 0;
+  }
+  // The coarsest level with at least one texel per screen pixel
+  const auto level = static_cast<size_t>(std::floor(-std::log2(scale)));
+  return static_cast<uint32_t>(std::min(level, maxLevel));
+}
+
+SkRect DeepZoomViewer::GetVisibleRect(
+  const View& view,
+  const SkISize& viewport) const {
+  const auto halfWidth = viewport.width() / (2 * view.mScale);
+  const auto halfHeight = viewport.height() / (2 * view.mScale);
+  return SkRect::MakeLTRB(
+    view.mCenter.x() - halfWidth,
+    view.mCenter.y() - halfHeight,
+    view.mCenter.x() + halfWidth,
+    view.mCenter.y() + halfHeight);
+}
+
+template <class F>
+void DeepZoomViewer::ForEachTile(uint32_t level, const SkRect& rect, F&& f)
+  const {
+  auto clipped = rect;
+  if (!clipped.intersect(SkRect::Make(mContainer.GetSize()))) {
+    return;
+  }
+
+  const auto& levelInfo = mContainer.GetLevels()[level];
+  const auto span = mContainer.GetTileSize() * GetLevelScale(level);
+  const auto left = static_cast<uint32_t>(clipped.left() / span);
+  const auto top = static_cast<uint32_t>(clipped.top() / span);
+  const auto right = std::min(
+    static_cast<uint32_t>(std::ceil(clipped.right() / span)),
+    levelInfo.mColumns);
+  const auto bottom = std::min(
+    static_cast<uint32_t>(std::ceil(clipped.bottom() / span)),
+    levelInfo.mRows);
+  for (auto y = top; y < bottom; ++y) {
+    for (auto x = left; x < right; ++x) {
+      f(TileKey {level, x, y});
+    }
+  }
+}
+
+void DeepZoomViewer::Render(SkCanvas* canvas, const SkISize& viewport) {
+  mStats = {};
+  mCache.BeginFrame();
+
+  const auto level = this->GetLevel(mView.mScale);
+  mStats.mLevel = level;
+
+  // The coarsest level is a single tile, and is the fallback for everything
+  mCache.Request(
+    {static_cast<uint32_t>(mContainer.GetLevels().size() - 1), 0, 0},
+    TileCache::Priority::Visible);
+
+  canvas->save();
+  canvas->translate(viewport.width() / 2.0f, viewport.height() / 2.0f);
+  canvas->scale(mView.mScale, mView.mScale);
+  canvas->translate(-mView.mCenter.x(), -mView.mCenter.y());
+  this->ForEachTile(
+    level, this->GetVisibleRect(mView, viewport), [&](const TileKey& key) {
+      ++mStats.mVisibleTiles;
+      this->DrawTile(canvas, key);
+    });
+  canvas->restore();
+
+  if (mPrefetchEnabled) {
+    this->Prefetch(viewport);
+  }
+}
+
+void DeepZoomViewer::DrawTile(SkCanvas* canvas, const TileKey& key) {
+  const SkSamplingOptions sampling {SkFilterMode::kLinear};
+  const auto bounds = mContainer.GetTileBounds(key);
+  if (const auto image = mCache.Get(key)) {
+    canvas->drawImageRect(
+      image,
+      SkRect::Make(image->dimensions()),
+      bounds,
+      sampling,
+      nullptr,
+      SkCanvas::kFast_SrcRectConstraint);
+    return;
+  }
+
+  ++mStats.mMissingTiles;
+  const auto levelCount = mContainer.GetLevels().size();
+  for (auto level = key.mLevel + 1; level < levelCount; ++level) {
+    const auto shift = level - key.mLevel;
+    const TileKey parent {level, key.mX >> shift, key.mY >> shift};
+    const auto image = mCache.Find(parent);
+    if (!image) {
+      continue;
+    }
+    // From level 0 pixels to the parent's pixels
+    const auto parentBounds = mContainer.GetTileBounds(parent);
+    const auto scale = 1 / GetLevelScale(level);
+    const auto src = SkRect::MakeLTRB(
+      (bounds.left() - parentBounds.left()) * scale,
+      (bounds.top() - parentBounds.top()) * scale,
+      (bounds.right() - parentBounds.left()) * scale,
+      (bounds.bottom() - parentBounds.top()) * scale);
+    canvas->drawImageRect(
+      image, src, bounds, sampling, nullptr, SkCanvas::kFast_SrcRectConstraint);
+    ++mStats.mFallbackTiles;
+    return;
+  }
+}
+
+void DeepZoomViewer::Prefetch(const SkISize& viewport) {
+  const auto frames = static_cast<SkScalar>(PrefetchFrames);
+  const View predicted {
+    .mCenter = mView.mCenter + (mPanVelocity * frames),
+    .mScale = mView.mScale * std::exp2(mZoomVelocity * frames),
+  };
+  const auto level = this->GetLevel(predicted.mScale);
+  // Include a ring of tiles around the predicted view, so that we also
+  // prefetch something useful when the view is still
+  const auto margin = mContainer.GetTileSize() * GetLevelScale(level);
+  const auto rect
+    = this->GetVisibleRect(predicted, viewport).makeOutset(margin, margin);
+
+  this->ForEachTile(level, rect, [this](const TileKey& key) {
+    if (mCache.Request(key, TileCache::Priority::Prefetch)) {
+      ++mStats.mPrefetchRequests;
+    }
+  });
+}
+
+DeepZoomViewer::Stats DeepZoomViewer::GetStats() const noexcept {
+  return mStats;
+}
@@ -0,0 +1,85 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "TileCache.hpp"
+#include "TileContainer.hpp"
+
+#include <skia/core/SkCanvas.h>
+
+/** Renders the visible part of a tile pyramid.
+ *
+ * Only tiles that intersect the viewport are drawn, from the coarsest level
+ * that still has at least one texel per screen pixel. Tiles that have not
+ * been decoded yet are requested from the `TileCache`, and drawn from the
+ * nearest coarser level that is available in the meantime.
+ *
+ * While the view is moving, tiles around where the view is predicted to be
+ * after `PrefetchFrames` are requested at a lower priority, based on the
+ * recent pan and zoom velocity.
+ */
+class DeepZoomViewer final {
+ public:
+  static constexpr size_t PrefetchFrames = 10;
+
+  struct View {
+    // In level 0 pixels
+    SkPoint mCenter {};
+    // Screen pixels per level 0 pixel
+    SkScalar mScale {1};
+  };
+
+  struct Stats {
+    uint32_t mLevel {};
+    size_t mVisibleTiles {};
+    // Visible tiles that were not available at the right level
+    size_t mMissingTiles {};
+    // Missing tiles that were drawn from a coarser level instead
+    size_t mFallbackTiles {};
+    size_t mPrefetchRequests {};
+  };
+
+  DeepZoomViewer(const TileContainer&, TileCache&);
+  DeepZoomViewer(const DeepZoomViewer&) = delete;
+  DeepZoomViewer(DeepZoomViewer&&) = delete;
+  DeepZoomViewer& operator=(const DeepZoomViewer&) = delete;
+  DeepZoomViewer& operator=(DeepZoomViewer&&) = delete;
+
+  void SetPrefetchEnabled(bool) noexcept;
+
+  /// Call once per frame, before `Render()`
+  void SetView(const View&);
+  [[nodiscard]] View GetView() const noexcept;
+  /// A view that shows the whole image
+  [[nodiscard]] View GetFitView(const SkISize& viewport) const;
+
+  void Render(SkCanvas*, const SkISize& viewport);
+
+  /// For the last call to `Render()`
+  [[nodiscard]] Stats GetStats() const noexcept;
+
+ private:
+  const TileContainer& mContainer;
+  TileCache& mCache;
+  bool mPrefetchEnabled {true};
+
+  View mView;
+  bool mHaveView {false};
+  // Smoothed per-frame change; zoom is in powers of 2
+  SkVector mPanVelocity {};
+  SkScalar mZoomVelocity {};
+
+  Stats mStats;
+
+  [[nodiscard]] uint32_t GetLevel(SkScalar scale) const;
+  [[nodiscard]] SkRect GetVisibleRect(const View&, const SkISize& viewport)
+    const;
+
+  /// Calls `f(TileKey)` for each tile of `level` intersecting `rect`
+  template <class F>
+  void ForEachTile(uint32_t level, const SkRect& rect, F&& f) const;
+
+  void DrawTile(SkCanvas*, const TileKey&);
+  void Prefetch(const SkISize& viewport);
+};
@@ -0,0 +1,839 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "DisplayList.hpp"
+
+#include "HashCombine.hpp"
+
+#include <skia/core/SkTypeface.h>
+
+#include <algorithm>
+#include <concepts>
+#include <type_traits>
+
+namespace {
+
+// Layers have a paint, but are not draws
+template <class T>
+concept PaintedDrawOp = requires(const T& op) { op.mPaint; }
+  && !std::same_as<T, DisplayList::SaveLayerOp>;
+
+template <class T>
+concept DrawOp
+  = PaintedDrawOp<T> || std::same_as<T, DisplayList::DrawPictureOp>;
+
+/* Draws that share a key can usually be merged into a single GPU op by Ganesh;
+ * colors and geometry do not matter, but anything that changes the pipeline
+ * does.
+ */
+struct BatchKey {
+  size_t mType {};
+  SkPaint::Style mStyle {};
+  bool mAntiAlias {};
+  const void* mShader {};
+  const void* mColorFilter {};
+  const void* mMaskFilter {};
+  const void* mPathEffect {};
+  const void* mImageFilter {};
+  const void* mBlender {};
+  SkTypefaceID mTypefaceID {};
+  // Instances of the same picture replay the same ops
+  const void* mPicture {};
+  const void* mImage {};
+
+  bool operator==(const BatchKey&) const noexcept = default;
+};
+
+bool IsDraw(const DisplayList::Command& command) {
+  return std::visit(
+    [](const auto& op) { return DrawOp<std::decay_t<decltype(op)>>; },
+    command);
+}
+
+BatchKey GetBatchKey(const DisplayList::Command& command) {
+  return std::visit(
+    [index = command.index()](const auto& op) {
+      using T = std::decay_t<decltype(op)>;
+      BatchKey key {.mType = index};
+      if constexpr (PaintedDrawOp<T>) {
+        const auto& paint = op.mPaint;
+        key.mStyle = paint.getStyle();
+        key.mAntiAlias = paint.isAntiAlias();
+        key.mShader = paint.getShader();
+        key.mColorFilter = paint.getColorFilter();
+        key.mMaskFilter = paint.getMaskFilter();
+        key.mPathEffect = paint.getPathEffect();
+        key.mImageFilter = paint.getImageFilter();
+        key.mBlender = paint.getBlender();
+      }
+      if constexpr (std::is_same_v<T, DisplayList::DrawTextBlobOp>) {
+        key.mTypefaceID = op.mTypefaceID;
+      }
+      if constexpr (std::is_same_v<T, DisplayList::DrawPictureOp>) {
+        key.mPicture = op.mPicture.get();
+      }
+      if constexpr (std::is_same_v<T, DisplayList::DrawImageRectOp>) {
+        key.mImage = op.mImage.get();
+      }
+      return key;
+    },
+    command);
+}
+
+void HashRect(size_t& seed, const SkRect& rect) {
+  HashCombine(seed, rect.fLeft);
+  HashCombine(seed, rect.fTop);
+  HashCombine(seed, rect.fRight);
+  HashCombine(seed, rect.fBottom);
+}
+
+void HashPaint(size_t& seed, const SkPaint& paint) {
+  const auto color = paint.getColor4f();
+  HashCombine(seed, color.fR);
+  HashCombine(seed, color.fG);
+  HashCombine(seed, color.fB);
+  HashCombine(seed, color.fA);
+  HashCombine(seed, static_cast<int>(paint.getStyle()));
+  HashCombine(seed, paint.getStrokeWidth());
+  HashCombine(seed, paint.getStrokeMiter());
+  HashCombine(seed, static_cast<int>(paint.getStrokeCap()));
+  HashCombine(seed, static_cast<int>(paint.getStrokeJoin()));
+  HashCombine(seed, paint.isAntiAlias());
+  HashCombine(seed, paint.isDither());
+  HashCombine<const void*>(seed, paint.getShader());
+  HashCombine<const void*>(seed, paint.getColorFilter());
+  HashCombine<const void*>(seed, paint.getMaskFilter());
+  HashCombine<const void*>(seed, paint.getPathEffect());
+  HashCombine<const void*>(seed, paint.getImageFilter());
+  HashCombine<const void*>(seed, paint.getBlender());
+}
+
+size_t CountBatches(const std::vector<DisplayList::Command>& commands) {
+  size_t count = 0;
+  std::optional<BatchKey> previous;
+  for (const auto& command: commands) {
+    if (!IsDraw(command)) {
+      previous = std::nullopt;
+      continue;
+    }
+    const auto key = GetBatchKey(command);
+    if (key != previous) {
+      ++count;
+      previous = key;
+    }
+  }
+  return count;
+}
+
+using Commands = std::vector<DisplayList::Command>;
+
+bool IsSave(const DisplayList::Command& command) {
+  return std::holds_alternative<DisplayList::SaveOp>(command)
+    || std::holds_alternative<DisplayList::SaveLayerOp>(command);
+}
+
+SkPaint* GetDrawPaint(DisplayList::Command& command) {
+  return std::visit(
+    [](auto& op) -> SkPaint* {
+      if constexpr (PaintedDrawOp<std::decay_t<decltype(op)>>) {
+        return &op.mPaint;
+      } else {
+        return nullptr;
+      }
+    },
+    command);
+}
+
+// The paint only affects alpha and coverage
+bool IsAlphaOnly(const SkPaint& paint) {
+  return !(
+    paint.getShader() || paint.getColorFilter() || paint.getMaskFilter()
+    || paint.getPathEffect() || paint.getImageFilter() || paint.getBlender());
+}
+
+/* Layers that do more than apply an alpha can change pixels that nothing was
+ * drawn to; for example, an image filter can move or generate content, and a
+ * blend mode can clear the destination.
+ */
+bool IsComplexLayer(const DisplayList::Command& command) {
+  const auto layer = std::get_if<DisplayList::SaveLayerOp>(&command);
+  return layer && !IsAlphaOnly(layer->mPaint);
+}
+
+/* Clips may have fractional edges, and anti-aliased draws and clips touch
+ * every pixel that they partially cover; compare against rects that are a
+ * pixel larger or smaller so that every pixel that is touched is unaffected.
+ * As this only handles translations, pixels are the same size in every
+ * coordinate space.
+ */
+constexpr SkScalar PixelMargin = 1;
+
+size_t CullDraws(Commands& commands, const SkRect& viewport) {
+  struct State {
+    SkPoint mOffset {};
+    // In the coordinate space of the first command; `std::nullopt` if
+    // nothing can be culled, e.g. inside a layer with an image filter
+    std::optional<SkRect> mCull;
+  };
+  std::vector<State> stack {{{0, 0}, viewport}};
+  size_t culled = 0;
+
+  Commands kept;
+  kept.reserve(commands.size());
+  for (auto& command: commands) {
+    auto& state = stack.back();
+    if (IsSave(command)) {
+      auto next = state;
+      if (IsComplexLayer(command)) {
+        next.mCull = std::nullopt;
+      }
+      stack.push_back(next);
+    } else if (std::holds_alternative<DisplayList::RestoreOp>(command)) {
+      if (stack.size() > 1) {
+        stack.pop_back();
+      }
+    } else if (
+      const auto translate = std::get_if<DisplayList::TranslateOp>(&command)) {
+      state.mOffset.offset(translate->mX, translate->mY);
+    } else if (
+      const auto clip = std::get_if<DisplayList::ClipRectOp>(&command)) {
+      const auto rect
+        = clip->mRect.makeOffset(state.mOffset.x(), state.mOffset.y());
+      if (state.mCull && !state.mCull->intersect(rect)) {
+        state.mCull->setEmpty();
+      }
+    } else if (IsDraw(command) && state.mCull) {
+      const auto bounds = DisplayList::GetBounds(command);
+      if (
+        bounds
+        && (state.mCull->isEmpty()
+            || !SkRect::Intersects(
+              state.mCull->makeOutset(PixelMargin, PixelMargin),
+              bounds->makeOffset(state.mOffset.x(), state.mOffset.y())))) {
+        ++culled;
+        continue;
+      }
+    }
+    kept.push_back(std::move(command));
+  }
+  commands = std::move(kept);
+  return culled;
+}
+
+size_t RemoveRedundantClips(Commands& commands) {
+  // Bound the forward search so that worst-case cost stays linear
+  static constexpr size_t MaxClipLookahead = 256;
+
+  const auto isRedundant = [&commands](size_t clipIndex) {
+    const auto clip = std::get<DisplayList::ClipRectOp>(commands.at(clipIndex))
+                        .mRect.makeInset(PixelMargin, PixelMargin);
+    // Relative to the clip
+    std::vector<SkPoint> offsets {{0, 0}};
+    const auto end
+      = std::min(commands.size(), clipIndex + 1 + MaxClipLookahead);
+    for (size_t i = clipIndex + 1; i < end; ++i) {
+      const auto& command = commands.at(i);
+      if (IsSave(command)) {
+        if (IsComplexLayer(command)) {
+          return false;
+        }
+        offsets.push_back(offsets.back());
+      } else if (std::holds_alternative<DisplayList::RestoreOp>(command)) {
+        if (offsets.size() == 1) {
+          // The clip is no longer in effect
+          return true;
+        }
+        offsets.pop_back();
+      } else if (
+        const auto translate
+        = std::get_if<DisplayList::TranslateOp>(&command)) {
+        offsets.back().offset(translate->mX, translate->mY);
+      } else if (IsDraw(command)) {
+        const auto bounds = DisplayList::GetBounds(command);
+        const auto& offset = offsets.back();
+        if (!(bounds
+              && clip.contains(bounds->makeOffset(offset.x(), offset.y())))) {
+          return false;
+        }
+      }
+    }
+    return end == commands.size();
+  };
+
+  std::vector<bool> redundant(commands.size(), false);
+  size_t count = 0;
+  for (size_t i = 0; i < commands.size(); ++i) {
+    if (
+      std::holds_alternative<DisplayList::ClipRectOp>(commands.at(i))
+      && isRedundant(i)) {
+      redundant.at(i) = true;
+      ++count;
+    }
+  }
+  if (count == 0) {
+    return 0;
+  }
+
+  Commands kept;
+  kept.reserve(commands.size() - count);
+  for (size_t i = 0; i < commands.size(); ++i) {
+    if (!redundant.at(i)) {
+      kept.push_back(std::move(commands.at(i)));
+    }
+  }
+  commands = std::move(kept);
+  return count;
+}
+
+size_t FoldLayerAlpha(Commands& commands) {
+  const auto canFold = [](
+                         const DisplayList::SaveLayerOp& layer,
+                         DisplayList::Command& draw) {
+    const auto paint = GetDrawPaint(draw);
+    if (!(paint && IsAlphaOnly(layer.mPaint))) {
+      return false;
+    }
+    // The alpha must be applied after any other effects in the draw's paint,
+    // and the result must be blended in the same way as the layer. Skia
+    // applies paint alpha before the color filter, so a color filter that
+    // sets or remaps alpha would lose or change the fade.
+    if (
+      paint->getColorFilter() || paint->getImageFilter()
+      || paint->getBlender()) {
+      return false;
+    }
+    // Glyphs can overlap; per-glyph alpha differs from a group alpha where
+    // they do
+    if (std::holds_alternative<DisplayList::DrawTextBlobOp>(draw)) {
+      return false;
+    }
+    if (!layer.mBounds) {
+      return true;
+    }
+    // Layer bounds also clip
+    const auto bounds = DisplayList::GetBounds(draw);
+    return bounds && layer.mBounds->contains(*bounds);
+  };
+
+  size_t folded = 0;
+  Commands kept;
+  kept.reserve(commands.size());
+  for (size_t i = 0; i < commands.size(); ++i) {
+    auto& command = commands.at(i);
+    const auto layer = std::get_if<DisplayList::SaveLayerOp>(&command);
+    if (
+      layer && (i + 2 < commands.size())
+      && std::holds_alternative<DisplayList::RestoreOp>(commands.at(i + 2))
+      && canFold(*layer, commands.at(i + 1))) {
+      auto& draw = commands.at(i + 1);
+      auto paint = GetDrawPaint(draw);
+      paint->setAlphaf(paint->getAlphaf() * layer->mPaint.getAlphaf());
+      kept.push_back(std::move(draw));
+      i += 2;
+      ++folded;
+      continue;
+    }
+    kept.push_back(std::move(command));
+  }
+  commands = std::move(kept);
+  return folded;
+}
+
+size_t RemoveEmptySaves(Commands& commands) {
+  struct OpenSave {
+    // In `kept`
+    size_t mIndex {};
+    size_t mDrawsBefore {};
+    bool mRemovable {};
+  };
+  std::vector<OpenSave> saves;
+  size_t draws = 0;
+  size_t removed = 0;
+
+  Commands kept;
+  kept.reserve(commands.size());
+  for (auto& command: commands) {
+    if (IsSave(command)) {
+      const auto complex = IsComplexLayer(command);
+      if (complex) {
+        // The layer can produce content without any draws, e.g. with an
+        // image filter, so nothing around it can be removed either
+        for (auto& save: saves) {
+          save.mRemovable = false;
+        }
+      }
+      saves.push_back({kept.size(), draws, !complex});
+    } else if (
+      std::holds_alternative<DisplayList::RestoreOp>(command)
+      && !saves.empty()) {
+      const auto save = saves.back();
+      saves.pop_back();
+      if (save.mRemovable && draws == save.mDrawsBefore) {
+        // Also drops any translates and clips inside
+        kept.erase(
+          kept.begin() + static_cast<ptrdiff_t>(save.mIndex), kept.end());
+        ++removed;
+        continue;
+      }
+      if (!save.mRemovable) {
+        // A kept complex layer - or a save around one - is content
+        ++draws;
+      }
+    } else if (IsDraw(command)) {
+      ++draws;
+    }
+    kept.push_back(std::move(command));
+  }
+  commands = std::move(kept);
+  return removed;
+}
+
+}// namespace
+
+void DisplayList::Clear() {
+  mCommands.clear();
+}
+
+void DisplayList::Save() {
+  mCommands.push_back(SaveOp {});
+}
+
+void DisplayList::SaveLayer(const SkRect* bounds, const SkPaint& paint) {
+  mCommands.push_back(SaveLayerOp {
+    bounds ? std::optional {*bounds} : std::nullopt,
+    paint,
+  });
+}
+
+void DisplayList::Restore() {
+  mCommands.push_back(RestoreOp {});
+}
+
+void DisplayList::Translate(SkScalar x, SkScalar y) {
+  mCommands.push_back(TranslateOp {x, y});
+}
+
+void DisplayList::ClipRect(const SkRect& rect, bool antiAlias) {
+  mCommands.push_back(ClipRectOp {rect, antiAlias});
+}
+
+void DisplayList::DrawPaint(const SkPaint& paint) {
+  mCommands.push_back(DrawPaintOp {paint});
+}
+
+void DisplayList::DrawRect(const SkRect& rect, const SkPaint& paint) {
+  mCommands.push_back(DrawRectOp {rect, paint});
+}
+
+void DisplayList::DrawRRect(const SkRRect& rrect, const SkPaint& paint) {
+  mCommands.push_back(DrawRRectOp {rrect, paint});
+}
+
+void DisplayList::DrawRoundRect(
+  const SkRect& rect,
+  SkScalar rx,
+  SkScalar ry,
+  const SkPaint& paint) {
+  this->DrawRRect(SkRRect::MakeRectXY(rect, rx, ry), paint);
+}
+
+void DisplayList::DrawPath(const SkPath& path, const SkPaint& paint) {
+  mCommands.push_back(DrawPathOp {path, paint});
+}
+
+void DisplayList::DrawTextBlob(
+  sk_sp<SkTextBlob> blob,
+  SkScalar x,
+  SkScalar y,
+  const SkFont& font,
+  const SkPaint& paint) {
+  if (!blob) {
+    return;
+  }
+  const auto typeface = font.getTypeface();
+  mCommands.push_back(DrawTextBlobOp {
+    std::move(blob),
+    {x, y},
+    paint,
+    typeface ? typeface->uniqueID() : SkTypefaceID {},
+  });
+}
+
+void DisplayList::DrawString(
+  std::string_view text,
+  SkScalar x,
+  SkScalar y,
+  const SkFont& font,
+  const SkPaint& paint) {
+  this->DrawTextBlob(
+    SkTextBlob::MakeFromText(
+      text.data(), text.size(), font, SkTextEncoding::kUTF8),
+    x,
+    y,
+    font,
+    paint);
+}
+
+void DisplayList::DrawImageRect(
+  sk_sp<SkImage> image,
+  const SkRect& source,
+  const SkRect& destination,
+  const SkSamplingOptions& sampling,
+  const SkPaint& paint,
+  SkCanvas::SrcRectConstraint constraint) {
+  if (!image) {
+    return;
+  }
+  mCommands.push_back(DrawImageRectOp {
+    std::move(image),
+    source,
+    destination,
+    sampling,
+    paint,
+    constraint,
+  });
+}
+
+void DisplayList::DrawPicture(
+  sk_sp<SkPicture> picture,
+  const SkMatrix& matrix) {
+  mCommands.push_back(DrawPictureOp {std::move(picture), matrix});
+}
+
+std::optional<SkRect> DisplayList::GetBounds(const Command& command) {
+  return std::visit(
+    [](const auto& op) -> std::optional<SkRect> {
+      using T = std::decay_t<decltype(op)>;
+      if constexpr (!DrawOp<T> || std::is_same_v<T, DrawPaintOp>) {
+        return std::nullopt;
+      } else if constexpr (std::is_same_v<T, DrawPictureOp>) {
+        return op.mMatrix.mapRect(op.mPicture->cullRect());
+      } else {
+        SkRect raw;
+        if constexpr (std::is_same_v<T, DrawRectOp>) {
+          raw = op.mRect;
+        } else if constexpr (std::is_same_v<T, DrawRRectOp>) {
+          raw = op.mRRect.getBounds();
+        } else if constexpr (std::is_same_v<T, DrawPathOp>) {
+          if (op.mPath.isInverseFillType()) {
+            return std::nullopt;
+          }
+          raw = op.mPath.getBounds();
+        } else if constexpr (std::is_same_v<T, DrawImageRectOp>) {
+          raw = op.mDestination;
+        } else {
+          static_assert(std::is_same_v<T, DrawTextBlobOp>);
+          raw = op.mBlob->bounds().makeOffset(op.mOrigin.x(), op.mOrigin.y());
+        }
+        if (!op.mPaint.canComputeFastBounds()) {
+          return std::nullopt;
+        }
+        SkRect storage;
+        return op.mPaint.computeFastBounds(raw, &storage);
+      }
+    },
+    command);
+}
+
+std::optional<SkRect> DisplayList::GetConservativeBounds() const {
+  SkRect ret = SkRect::MakeEmpty();
+  std::vector<SkPoint> offsets {{0, 0}};
+  for (const auto& command: mCommands) {
+    if (
+      std::holds_alternative<SaveOp>(command)
+      || std::holds_alternative<SaveLayerOp>(command)) {
+      offsets.push_back(offsets.back());
+      continue;
+    }
+    if (std::holds_alternative<RestoreOp>(command)) {
+      if (offsets.size() > 1) {
+        offsets.pop_back();
+      }
+      continue;
+    }
+    if (const auto translate = std::get_if<TranslateOp>(&command)) {
+      offsets.back().offset(translate->mX, translate->mY);
+      continue;
+    }
+    if (!IsDraw(command)) {
+      continue;
+    }
+    const auto bounds = GetBounds(command);
+    if (!bounds) {
+      return std::nullopt;
+    }
+    ret.join(bounds->makeOffset(offsets.back().x(), offsets.back().y()));
+  }
+  return ret;
+}
+
+size_t DisplayList::GetContentHash() const {
+  size_t seed = mCommands.size();
+  for (const auto& command: mCommands) {
+    HashCombine(seed, command.index());
+    std::visit(
+      [&seed](const auto& op) {
+        using T = std::decay_t<decltype(op)>;
+        if constexpr (PaintedDrawOp<T>) {
+          HashPaint(seed, op.mPaint);
+        }
+
+        if constexpr (std::is_same_v<T, SaveLayerOp>) {
+          HashPaint(seed, op.mPaint);
+          HashCombine(seed, op.mBounds.has_value());
+          if (op.mBounds) {
+            HashRect(seed, *op.mBounds);
+          }
+        } else if constexpr (std::is_same_v<T, TranslateOp>) {
+          HashCombine(seed, op.mX);
+          HashCombine(seed, op.mY);
+        } else if constexpr (std::is_same_v<T, ClipRectOp>) {
+          HashRect(seed, op.mRect);
+          HashCombine(seed, op.mAntiAlias);
+        } else if constexpr (std::is_same_v<T, DrawRectOp>) {
+          HashRect(seed, op.mRect);
+        } else if constexpr (std::is_same_v<T, DrawRRectOp>) {
+          HashRect(seed, op.mRRect.rect());
+          for (const auto corner: {
+                 SkRRect::kUpperLeft_Corner,
+                 SkRRect::kUpperRight_Corner,
+                 SkRRect::kLowerRight_Corner,
+                 SkRRect::kLowerLeft_Corner,
+               }) {
+            const auto radii = op.mRRect.radii(corner);
+            HashCombine(seed, radii.fX);
+            HashCombine(seed, radii.fY);
+          }
+        } else if constexpr (std::is_same_v<T, DrawPathOp>) {
+          HashCombine(seed, op.mPath.getGenerationID());
+        } else if constexpr (std::is_same_v<T, DrawTextBlobOp>) {
+          HashCombine(seed, op.mBlob->uniqueID());
+          HashCombine(seed, op.mOrigin.fX);
+          HashCombine(seed, op.mOrigin.fY);
+        } else if constexpr (std::is_same_v<T, DrawImageRectOp>) {
+          HashCombine(seed, op.mImage->uniqueID());
+          HashRect(seed, op.mSource);
+          HashRect(seed, op.mDestination);
+          HashCombine(seed, op.mSampling.useCubic);
+          HashCombine(seed, op.mSampling.cubic.B);
+          HashCombine(seed, op.mSampling.cubic.C);
+          HashCombine(seed, static_cast<int>(op.mSampling.filter));
+          HashCombine(seed, static_cast<int>(op.mSampling.mipmap));
+          HashCombine(seed, op.mSampling.maxAniso);
+          HashCombine(seed, static_cast<int>(op.mConstraint));
+        } else if constexpr (std::is_same_v<T, DrawPictureOp>) {
+          HashCombine(seed, op.mPicture->uniqueID());
+          SkScalar matrix[9];
+          op.mMatrix.get9(matrix);
+          for (const auto value: matrix) {
+            HashCombine(seed, value);
+          }
+        }
+      },
+      command);
+  }
+  return seed;
+}
+
+bool DisplayList::HasSameContent(const DisplayList& other) const {
+  if (mCommands.size() != other.mCommands.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < mCommands.size(); ++i) {
+    const auto same = std::visit(
+      [](const auto& a, const auto& b) {
+        using T = std::decay_t<decltype(a)>;
+        if constexpr (!std::is_same_v<T, std::decay_t<decltype(b)>>) {
+          return false;
+        } else if constexpr (std::is_same_v<T, SaveLayerOp>) {
+          return a.mPaint == b.mPaint && a.mBounds == b.mBounds;
+        } else if constexpr (std::is_same_v<T, TranslateOp>) {
+          return a.mX == b.mX && a.mY == b.mY;
+        } else if constexpr (std::is_same_v<T, ClipRectOp>) {
+          return a.mRect == b.mRect && a.mAntiAlias == b.mAntiAlias;
+        } else if constexpr (std::is_same_v<T, DrawPaintOp>) {
+          return a.mPaint == b.mPaint;
+        } else if constexpr (std::is_same_v<T, DrawRectOp>) {
+          return a.mPaint == b.mPaint && a.mRect == b.mRect;
+        } else if constexpr (std::is_same_v<T, DrawRRectOp>) {
+          return a.mPaint == b.mPaint && a.mRRect == b.mRRect;
+        } else if constexpr (std::is_same_v<T, DrawPathOp>) {
+          return a.mPaint == b.mPaint
+            && a.mPath.getGenerationID() == b.mPath.getGenerationID();
+        } else if constexpr (std::is_same_v<T, DrawTextBlobOp>) {
+          return a.mPaint == b.mPaint
+            && a.mBlob->uniqueID() == b.mBlob->uniqueID()
+            && a.mOrigin == b.mOrigin;
+        } else if constexpr (std::is_same_v<T, DrawImageRectOp>) {
+          return a.mPaint == b.mPaint
+            && a.mImage->uniqueID() == b.mImage->uniqueID()
+            && a.mSource == b.mSource && a.mDestination == b.mDestination
+            && a.mSampling == b.mSampling && a.mConstraint == b.mConstraint;
+        } else if constexpr (std::is_same_v<T, DrawPictureOp>) {
+          return a.mPicture->uniqueID() == b.mPicture->uniqueID()
+            && a.mMatrix == b.mMatrix;
+        } else {
+          // Save and restore
+          return true;
+        }
+      },
+      mCommands.at(i),
+      other.mCommands.at(i));
+    if (!same) {
+      return false;
+    }
+  }
+  return true;
+}
+
+DisplayList::ReorderStats DisplayList::ReorderForBatching() {
+  // Each draw tests at most MaxBatchLookback batches of at most
+  // MaxDrawsPerBatch draws for overlap, so the worst-case cost is linear in
+  // the number of draws
+  static constexpr size_t MaxBatchLookback = 64;
+  static constexpr size_t MaxDrawsPerBatch = 256;
+
+  struct Batch {
+    BatchKey mKey;
+    SkRect mBounds;
+    std::vector<std::pair<size_t, SkRect>> mDraws;
+
+    bool Intersects(const SkRect& rect) const {
+      if (!SkRect::Intersects(mBounds, rect)) {
+        return false;
+      }
+      for (const auto& [index, bounds]: mDraws) {
+        if (SkRect::Intersects(bounds, rect)) {
+          return true;
+        }
+      }
+      return false;
+    }
+  };
+
+  ReorderStats stats {.mBatchesBefore = CountBatches(mCommands)};
+
+  std::vector<Command> reordered;
+  reordered.reserve(mCommands.size());
+  std::vector<Batch> batches;
+
+  const auto flush = [&]() {
+    for (const auto& batch: batches) {
+      for (const auto& [index, bounds]: batch.mDraws) {
+        reordered.push_back(std::move(mCommands.at(index)));
+      }
+    }
+    batches.clear();
+  };
+
+  for (size_t i = 0; i < mCommands.size(); ++i) {
+    auto& command = mCommands.at(i);
+    if (!IsDraw(command)) {
+      // State change; nothing can move across this
+      flush();
+      reordered.push_back(std::move(command));
+      continue;
+    }
+
+    ++stats.mDraws;
+    const auto bounds = GetBounds(command);
+    if (!bounds) {
+      // Unbounded; treat as overlapping everything
+      flush();
+      reordered.push_back(std::move(command));
+      continue;
+    }
+
+    const auto key = GetBatchKey(command);
+    Batch* target = nullptr;
+    const auto searchEnd = batches.size() > MaxBatchLookback
+      ? batches.size() - MaxBatchLookback
+      : 0;
+    for (auto it = batches.size(); it > searchEnd; --it) {
+      auto& batch = batches.at(it - 1);
+      if (batch.mKey == key) {
+        target = &batch;
+        break;
+      }
+      if (batch.Intersects(*bounds)) {
+        break;
+      }
+    }
+
+    if (target && target->mDraws.size() < MaxDrawsPerBatch) {
+      target->mBounds.join(*bounds);
+    } else {
+      // Starting a new batch at the end never moves the draw, so it's always
+      // safe, even if it overlaps earlier batches
+      batches.push_back({key, *bounds, {}});
+      target = &batches.back();
+    }
+    target->mDraws.emplace_back(i, *bounds);
+  }
+  flush();
+
+  mCommands = std::move(reordered);
+  stats.mBatchesAfter = CountBatches(mCommands);
+  return stats;
+}
+
+DisplayList::OptimizeStats DisplayList::Optimize(const SkRect& viewport) {
+  OptimizeStats stats {.mCommandsBefore = mCommands.size()};
+  // Culling first leaves more clips and saves with nothing to affect
+  stats.mCulledDraws = CullDraws(mCommands, viewport);
+  stats.mRedundantClips = RemoveRedundantClips(mCommands);
+  // Removing clips can leave a layer around just one draw
+  stats.mFoldedLayers = FoldLayerAlpha(mCommands);
+  stats.mEmptySaves = RemoveEmptySaves(mCommands);
+  stats.mCommandsAfter = mCommands.size();
+  return stats;
+}
+
+void DisplayList::Replay(SkCanvas* canvas) const {
+  for (const auto& command: mCommands) {
+    std::visit(
+      [canvas](const auto& op) {
+        using T = std::decay_t<decltype(op)>;
+        if constexpr (std::is_same_v<T, SaveOp>) {
+          canvas->save();
+        } else if constexpr (std::is_same_v<T, SaveLayerOp>) {
+          canvas->saveLayer(
+            op.mBounds ? &*op.mBounds : nullptr, &op.mPaint);
+        } else if constexpr (std::is_same_v<T, RestoreOp>) {
+          canvas->restore();
+        } else if constexpr (std::is_same_v<T, TranslateOp>) {
+          canvas->translate(op.mX, op.mY);
+        } else if constexpr (std::is_same_v<T, ClipRectOp>) {
+          canvas->clipRect(op.mRect, op.mAntiAlias);
+        } else if constexpr (std::is_same_v<T, DrawPaintOp>) {
+          canvas->drawPaint(op.mPaint);
+        } else if constexpr (std::is_same_v<T, DrawRectOp>) {
+          canvas->drawRect(op.mRect, op.mPaint);
+        } else if constexpr (std::is_same_v<T, DrawRRectOp>) {
+          canvas->drawRRect(op.mRRect, op.mPaint);
+        } else if constexpr (std::is_same_v<T, DrawPathOp>) {
+          canvas->drawPath(op.mPath, op.mPaint);
+        } else if constexpr (std::is_same_v<T, DrawTextBlobOp>) {
+          canvas->drawTextBlob(
+            op.mBlob, op.mOrigin.x(), op.mOrigin.y(), op.mPaint);
+        } else if constexpr (std::is_same_v<T, DrawImageRectOp>) {
+          canvas->drawImageRect(
+            op.mImage,
+            op.mSource,
+            op.mDestination,
+            op.mSampling,
+            &op.mPaint,
+            op.mConstraint);
+        } else {
+          static_assert(std::is_same_v<T, DrawPictureOp>);
+          canvas->drawPicture(op.mPicture, &op.mMatrix, nullptr);
+        }
+      },
+      command);
+  }
+}
+
+const std::vector<DisplayList::Command>& DisplayList::GetCommands()
+  const noexcept {
+  return mCommands;
+}
@@ -0,0 +1,204 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkCanvas.h>
+#include <skia/core/SkFont.h>
+#include <skia/core/SkImage.h>
+#include <skia/core/SkPaint.h>
+#include <skia/core/SkPath.h>
+#include <skia/core/SkPicture.h>
+#include <skia/core/SkRRect.h>
+#include <skia/core/SkTextBlob.h>
+
+#include <optional>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+/** A minimal list of recorded draw commands.
+ *
+ * Content is recorded here instead of directly into an `SkCanvas` so that
+ * passes such as `ReorderForBatching()` can look at the whole frame before it
+ * is replayed into the real canvas.
+ */
+class DisplayList final {
+ public:
+  struct SaveOp {};
+  struct SaveLayerOp {
+    std::optional<SkRect> mBounds;
+    SkPaint mPaint;
+  };
+  struct RestoreOp {};
+  struct TranslateOp {
+    SkScalar mX {};
+    SkScalar mY {};
+  };
+  struct ClipRectOp {
+    SkRect mRect;
+    bool mAntiAlias {true};
+  };
+  struct DrawPaintOp {
+    SkPaint mPaint;
+  };
+  struct DrawRectOp {
+    SkRect mRect;
+    SkPaint mPaint;
+  };
+  struct DrawRRectOp {
+    SkRRect mRRect;
+    SkPaint mPaint;
+  };
+  struct DrawPathOp {
+    SkPath mPath;
+    SkPaint mPaint;
+  };
+  struct DrawTextBlobOp {
+    sk_sp<SkTextBlob> mBlob;
+    SkPoint mOrigin;
+    SkPaint mPaint;
+    SkTypefaceID mTypefaceID {};
+  };
+  struct DrawImageRectOp {
+    sk_sp<SkImage> mImage;
+    SkRect mSource;
+    SkRect mDestination;
+    SkSamplingOptions mSampling;
+    SkPaint mPaint;
+    SkCanvas::SrcRectConstraint mConstraint {
+      SkCanvas::kStrict_SrcRectConstraint};
+  };
+  struct DrawPictureOp {
+    sk_sp<SkPicture> mPicture;
+    SkMatrix mMatrix;
+  };
+
+  using Command = std::variant<
+    SaveOp,
+    SaveLayerOp,
+    RestoreOp,
+    TranslateOp,
+    ClipRectOp,
+    DrawPaintOp,
+    DrawRectOp,
+    DrawRRectOp,
+    DrawPathOp,
+    DrawTextBlobOp,
+    DrawImageRectOp,
+    DrawPictureOp>;
+
+  struct ReorderStats {
+    size_t mDraws {};
+    // Number of runs of adjacent draws that share a BatchKey
+    size_t mBatchesBefore {};
+    size_t mBatchesAfter {};
+  };
+
+  struct OptimizeStats {
+    size_t mCommandsBefore {};
+    size_t mCommandsAfter {};
+    // Draws entirely outside the viewport or the current clip
+    size_t mCulledDraws {};
+    // Clips that contain everything drawn while they are in effect
+    size_t mRedundantClips {};
+    // Alpha-only layers around a single draw, folded into its paint
+    size_t mFoldedLayers {};
+    // Saves or layers that are restored without drawing anything
+    size_t mEmptySaves {};
+  };
+
+  void Clear();
+
+  void Save();
+  /// `bounds` can be `nullptr`
+  void SaveLayer(const SkRect* bounds, const SkPaint&);
+  void Restore();
+  void Translate(SkScalar x, SkScalar y);
+  void ClipRect(const SkRect&, bool antiAlias = true);
+  void DrawPaint(const SkPaint&);
+  void DrawRect(const SkRect&, const SkPaint&);
+  void DrawRRect(const SkRRect&, const SkPaint&);
+  void DrawRoundRect(const SkRect&, SkScalar rx, SkScalar ry, const SkPaint&);
+  void DrawPath(const SkPath&, const SkPaint&);
+  void DrawTextBlob(
+    sk_sp<SkTextBlob>,
+    SkScalar x,
+    SkScalar y,
+    const SkFont&,
+    const SkPaint&);
+  void DrawString(
+    std::string_view text,
+    SkScalar x,
+    SkScalar y,
+    const SkFont&,
+    const SkPaint&);
+  void DrawImageRect(
+    sk_sp<SkImage>,
+    const SkRect& source,
+    const SkRect& destination,
+    const SkSamplingOptions&,
+    const SkPaint&,
+    SkCanvas::SrcRectConstraint);
+  /// See InstanceCache
+  void DrawPicture(sk_sp<SkPicture>, const SkMatrix&);
+
+  /** Remove or rewrite commands that do not change the output.
+   *
+   * In order:
+   * - draws that are entirely outside `viewport` or the current clip are
+   *   removed; `viewport` is in the coordinate space of the first command,
+   *   and is usually the bounds of the canvas
+   * - clips that contain the bounds of every draw they affect are removed
+   * - a layer that only has an alpha, around a single draw without a color
+   *   filter, image filter, or blender, is removed, and the alpha is applied
+   *   to the draw's paint instead; text is never folded, as glyphs can
+   *   overlap
+   * - saves and layers that are restored without any draws in between are
+   *   removed, along with any state changes inside them, unless they
+   *   contain a layer that can produce content on its own, e.g. with an
+   *   image filter
+   *
+   * Call this before `ReorderForBatching()`, as it removes state changes that
+   * would otherwise prevent draws from being batched.
+   */
+  OptimizeStats Optimize(const SkRect& viewport);
+
+  /** Group draws that share GPU state, without changing the output.
+   *
+   * Only draws between state changes (save/restore/clip/translate) are
+   * reordered; a draw is only moved before another draw if their bounds do
+   * not intersect, so painter's order is preserved for overlapping content.
+   */
+  ReorderStats ReorderForBatching();
+
+  void Replay(SkCanvas*) const;
+
+  [[nodiscard]] const std::vector<Command>& GetCommands() const noexcept;
+
+  /// `std::nullopt` if the command is not a draw, or is unbounded
+  [[nodiscard]] static std::optional<SkRect> GetBounds(const Command&);
+
+  /** Bounds of every draw, in the coordinate space of the first command.
+   *
+   * Clips are ignored, so this may be larger than what is actually drawn.
+   * `std::nullopt` if any draw is unbounded.
+   */
+  [[nodiscard]] std::optional<SkRect> GetConservativeBounds() const;
+
+  /** A hash of everything that affects the output of `Replay()`.
+   *
+   * Paths, text blobs, and pictures are hashed by identity rather than by
+   * content; use an `Interner` so that identical content shares an identity.
+   */
+  [[nodiscard]] size_t GetContentHash() const;
+
+  /** True if both lists have the same content, as `GetContentHash()`.
+   *
+   * Use this to confirm that content with the same hash really is the same.
+   */
+  [[nodiscard]] bool HasSameContent(const DisplayList&) const;
+
+ private:
+  std::vector<Command> mCommands;
+};
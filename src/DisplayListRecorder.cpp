@@ -0,0 +1,389 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "DisplayListRecorder.hpp"
+
+#include <skia/core/SkDrawable.h>
+#include <skia/core/SkM44.h>
+#include <skia/core/SkTypeface.h>
+
+DisplayListRecorder::DisplayListRecorder(
+  DisplayList* displayList,
+  const SkIRect& bounds)
+  : SkNoDrawCanvas(bounds),
+    mDisplayList(displayList) {
+}
+
+size_t DisplayListRecorder::GetUnsupportedCount() const noexcept {
+  return mUnsupported;
+}
+
+void DisplayListRecorder::DropUntilRestore() {
+  ++mUnsupported;
+  if (!mDropUntilDepth) {
+    mDropUntilDepth = mSaveDepth;
+  }
+}
+
+bool DisplayListRecorder::ShouldDrop() {
+  if (!mDropUntilDepth) {
+    return false;
+  }
+  ++mUnsupported;
+  return true;
+}
+
+void DisplayListRecorder::willSave() {
+  ++mSaveDepth;
+  if (!mDropUntilDepth) {
+    mDisplayList->Save();
+  }
+}
+
+SkCanvas::SaveLayerStrategy DisplayListRecorder::getSaveLayerStrategy(
+  const SaveLayerRec& rec) {
+  ++mSaveDepth;
+  if (this->ShouldDrop()) {
+    return kNoLayer_SaveLayerStrategy;
+  }
+  // Still recorded, so that saves and restores stay balanced
+  if (rec.fBackdrop) {
+    ++mUnsupported;
+  }
+  mDisplayList->SaveLayer(rec.fBounds, rec.fPaint ? *rec.fPaint : SkPaint {});
+  return kNoLayer_SaveLayerStrategy;
+}
+
+bool DisplayListRecorder::onDoSaveBehind(const SkRect*) {
+  ++mUnsupported;
+  // `SkCanvas` still calls `willRestore()` for the matching restore, so
+  // record it as a plain save
+  ++mSaveDepth;
+  if (!mDropUntilDepth) {
+    mDisplayList->Save();
+  }
+  return false;
+}
+
+void DisplayListRecorder::willRestore() {
+  if (mSaveDepth == 0) {
+    return;
+  }
+  --mSaveDepth;
+  if (mDropUntilDepth) {
+    if (mSaveDepth >= *mDropUntilDepth) {
+      // Saved while dropping, so the save wasn't recorded either
+      return;
+    }
+    // Restores the matrix from before the unsupported one
+    mDropUntilDepth.reset();
+  }
+  mDisplayList->Restore();
+}
+
+void DisplayListRecorder::didTranslate(SkScalar dx, SkScalar dy) {
+  if (this->ShouldDrop()) {
+    return;
+  }
+  mDisplayList->Translate(dx, dy);
+}
+
+void DisplayListRecorder::didConcat44(const SkM44& matrix) {
+  const auto m33 = matrix.asM33();
+  if (!m33.isTranslate()) {
+    this->DropUntilRestore();
+    return;
+  }
+  if (this->ShouldDrop()) {
+    return;
+  }
+  mDisplayList->Translate(m33.getTranslateX(), m33.getTranslateY());
+}
+
+void DisplayListRecorder::didSetM44(const SkM44&) {
+  // We only record relative translations
+  this->DropUntilRestore();
+}
+
+void DisplayListRecorder::didScale(SkScalar sx, SkScalar sy) {
+  if (sx != 1 || sy != 1) {
+    this->DropUntilRestore();
+  }
+}
+
+void DisplayListRecorder::onClipRect(
+  const SkRect& rect,
+  SkClipOp op,
+  ClipEdgeStyle edgeStyle) {
+  if (this->ShouldDrop()) {
+    return;
+  }
+  if (op != SkClipOp::kIntersect) {
+    ++mUnsupported;
+    return;
+  }
+  mDisplayList->ClipRect(rect, edgeStyle == kSoft_ClipEdgeStyle);
+}
+
+void DisplayListRecorder::onClipRRect(
+  const SkRRect& rrect,
+  SkClipOp op,
+  ClipEdgeStyle edgeStyle) {
+  if (!rrect.isRect()) {
+    ++mUnsupported;
+    return;
+  }
+  this->onClipRect(rrect.rect(), op, edgeStyle);
+}
+
+void DisplayListRecorder::onClipPath(
+  const SkPath& path,
+  SkClipOp op,
+  ClipEdgeStyle edgeStyle) {
+  SkRect rect;
+  if (path.isInverseFillType() || !path.isRect(&rect)) {
+    ++mUnsupported;
+    return;
+  }
+  this->onClipRect(rect, op, edgeStyle);
+}
+
+void DisplayListRecorder::onClipShader(sk_sp<SkShader>, SkClipOp) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onClipRegion(const SkRegion&, SkClipOp) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onResetClip() {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawPaint(const SkPaint& paint) {
+  if (this->ShouldDrop()) {
+    return;
+  }
+  mDisplayList->DrawPaint(paint);
+}
+
+void DisplayListRecorder::onDrawBehind(const SkPaint&) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawRect(const SkRect& rect, const SkPaint& paint) {
+  if (this->ShouldDrop()) {
+    return;
+  }
+  mDisplayList->DrawRect(rect, paint);
+}
+
+void DisplayListRecorder::onDrawRRect(
+  const SkRRect& rrect,
+  const SkPaint& paint) {
+  if (this->ShouldDrop()) {
+    return;
+  }
+  mDisplayList->DrawRRect(rrect, paint);
+}
+
+void DisplayListRecorder::onDrawDRRect(
+  const SkRRect& outer,
+  const SkRRect& inner,
+  const SkPaint& paint) {
+  if (this->ShouldDrop()) {
+    return;
+  }
+  SkPath path;
+  path.addRRect(outer);
+  path.addRRect(inner);
+  path.setFillType(SkPathFillType::kEvenOdd);
+  mDisplayList->DrawPath(path, paint);
+}
+
+void DisplayListRecorder::onDrawOval(const SkRect& rect, const SkPaint& paint) {
+  if (this->ShouldDrop()) {
+    return;
+  }
+  mDisplayList->DrawRRect(SkRRect::MakeOval(rect), paint);
+}
+
+void DisplayListRecorder::onDrawArc(
+  const SkRect&,
+  SkScalar,
+  SkScalar,
+  bool,
+  const SkPaint&) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawPath(const SkPath& path, const SkPaint& paint) {
+  if (this->ShouldDrop()) {
+    return;
+  }
+  mDisplayList->DrawPath(path, paint);
+}
+
+void DisplayListRecorder::onDrawRegion(const SkRegion&, const SkPaint&) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawPoints(
+  PointMode,
+  size_t,
+  const SkPoint[],
+  const SkPaint&) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawTextBlob(
+  const SkTextBlob* blob,
+  SkScalar x,
+  SkScalar y,
+  const SkPaint& paint) {
+  if (this->ShouldDrop()) {
+    return;
+  }
+  // The display list uses the font's typeface for batching
+  SkFont font;
+  SkTextBlob::Iter it {*blob};
+  SkTextBlob::Iter::Run run {};
+  if (it.next(&run)) {
+    font.setTypeface(sk_ref_sp(run.fTypeface));
+  }
+  mDisplayList->DrawTextBlob(sk_ref_sp(blob), x, y, font, paint);
+}
+
+void DisplayListRecorder::onDrawImage2(
+  const SkImage* image,
+  SkScalar x,
+  SkScalar y,
+  const SkSamplingOptions& sampling,
+  const SkPaint* paint) {
+  if (this->ShouldDrop()) {
+    return;
+  }
+  mDisplayList->DrawImageRect(
+    sk_ref_sp(image),
+    SkRect::Make(image->bounds()),
+    SkRect::MakeXYWH(x, y, image->width(), image->height()),
+    sampling,
+    paint ? *paint : SkPaint {},
+    kFast_SrcRectConstraint);
+}
+
+void DisplayListRecorder::onDrawImageRect2(
+  const SkImage* image,
+  const SkRect& src,
+  const SkRect& dst,
+  const SkSamplingOptions& sampling,
+  const SkPaint* paint,
+  SrcRectConstraint constraint) {
+  if (this->ShouldDrop()) {
+    return;
+  }
+  mDisplayList->DrawImageRect(
+    sk_ref_sp(image),
+    src,
+    dst,
+    sampling,
+    paint ? *paint : SkPaint {},
+    constraint);
+}
+
+void DisplayListRecorder::onDrawImageLattice2(
+  const SkImage*,
+  const Lattice&,
+  const SkRect&,
+  SkFilterMode,
+  const SkPaint*) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawAtlas2(
+  const SkImage*,
+  const SkRSXform[],
+  const SkRect[],
+  const SkColor[],
+  int,
+  SkBlendMode,
+  const SkSamplingOptions&,
+  const SkRect*,
+  const SkPaint*) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawEdgeAAImageSet2(
+  const ImageSetEntry[],
+  int,
+  const SkPoint[],
+  const SkMatrix[],
+  const SkSamplingOptions&,
+  const SkPaint*,
+  SrcRectConstraint) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawEdgeAAQuad(
+  const SkRect&,
+  const SkPoint[4],
+  QuadAAFlags,
+  const SkColor4f&,
+  SkBlendMode) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawPatch(
+  const SkPoint[12],
+  const SkColor[4],
+  const SkPoint[4],
+  SkBlendMode,
+  const SkPaint&) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawVerticesObject(
+  const SkVertices*,
+  SkBlendMode,
+  const SkPaint&) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawMesh(
+  const SkMesh&,
+  sk_sp<SkBlender>,
+  const SkPaint&) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawShadowRec(
+  const SkPath&,
+  const SkDrawShadowRec&) {
+  ++mUnsupported;
+}
+
+void DisplayListRecorder::onDrawPicture(
+  const SkPicture* picture,
+  const SkMatrix* matrix,
+  const SkPaint* paint) {
+  if (this->ShouldDrop()) {
+    return;
+  }
+  const auto& m = matrix ? *matrix : SkMatrix::I();
+  // As SkCanvas does, apply the paint to a layer around the picture
+  if (paint) {
+    const auto bounds = m.mapRect(picture->cullRect());
+    mDisplayList->SaveLayer(&bounds, *paint);
+  }
+  mDisplayList->DrawPicture(sk_ref_sp(picture), m);
+  if (paint) {
+    mDisplayList->Restore();
+  }
+}
+
+void DisplayListRecorder::onDrawDrawable(
+  SkDrawable* drawable,
+  const SkMatrix* matrix) {
+  // Draws the drawable's content back into this canvas
+  SkCanvas::onDrawDrawable(drawable, matrix);
+}
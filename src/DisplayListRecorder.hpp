@@ -0,0 +1,147 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "DisplayList.hpp"
+
+#include <skia/utils/SkNoDrawCanvas.h>
+
+#include <optional>
+
+/** An `SkCanvas` that records into a `DisplayList`.
+ *
+ * Use this to import existing content - e.g. `.skp` captures, via
+ * `SkPicture::playback()` - or to record code that draws to an `SkCanvas`.
+ *
+ * Matrices must be translations, and clips must be intersections with rects;
+ * anything else that a `DisplayList` can't represent is dropped, and counted
+ * by `GetUnsupportedCount()`. After any other matrix, every command is dropped
+ * until the matching restore, as it would be in the wrong coordinate space.
+ */
+class DisplayListRecorder final : public SkNoDrawCanvas {
+ public:
+  DisplayListRecorder() = delete;
+  DisplayListRecorder(DisplayList*, const SkIRect& bounds);
+  DisplayListRecorder(const DisplayListRecorder&) = delete;
+  DisplayListRecorder(DisplayListRecorder&&) = delete;
+  DisplayListRecorder& operator=(const DisplayListRecorder&) = delete;
+  DisplayListRecorder& operator=(DisplayListRecorder&&) = delete;
+
+  [[nodiscard]] size_t GetUnsupportedCount() const noexcept;
+
+ protected:
+  void willSave() override;
+  SaveLayerStrategy getSaveLayerStrategy(const SaveLayerRec&) override;
+  bool onDoSaveBehind(const SkRect*) override;
+  void willRestore() override;
+
+  void didTranslate(SkScalar dx, SkScalar dy) override;
+  void didConcat44(const SkM44&) override;
+  void didSetM44(const SkM44&) override;
+  void didScale(SkScalar sx, SkScalar sy) override;
+
+  void onClipRect(const SkRect&, SkClipOp, ClipEdgeStyle) override;
+  void onClipRRect(const SkRRect&, SkClipOp, ClipEdgeStyle) override;
+  void onClipPath(const SkPath&, SkClipOp, ClipEdgeStyle) override;
+  void onClipShader(sk_sp<SkShader>, SkClipOp) override;
+  void onClipRegion(const SkRegion&, SkClipOp) override;
+  void onResetClip() override;
+
+  void onDrawPaint(const SkPaint&) override;
+  void onDrawBehind(const SkPaint&) override;
+  void onDrawRect(const SkRect&, const SkPaint&) override;
+  void onDrawRRect(const SkRRect&, const SkPaint&) override;
+  void onDrawDRRect(
+    const SkRRect& outer,
+    const SkRRect& inner,
+    const SkPaint&) override;
+  void onDrawOval(const SkRect&, const SkPaint&) override;
+  void onDrawArc(
+    const SkRect&,
+    SkScalar startAngle,
+    SkScalar sweepAngle,
+    bool useCenter,
+    const SkPaint&) override;
+  void onDrawPath(const SkPath&, const SkPaint&) override;
+  void onDrawRegion(const SkRegion&, const SkPaint&) override;
+  void onDrawPoints(
+    PointMode,
+    size_t count,
+    const SkPoint points[],
+    const SkPaint&) override;
+  void onDrawTextBlob(
+    const SkTextBlob*,
+    SkScalar x,
+    SkScalar y,
+    const SkPaint&) override;
+  void onDrawImage2(
+    const SkImage*,
+    SkScalar x,
+    SkScalar y,
+    const SkSamplingOptions&,
+    const SkPaint*) override;
+  void onDrawImageRect2(
+    const SkImage*,
+    const SkRect& src,
+    const SkRect& dst,
+    const SkSamplingOptions&,
+    const SkPaint*,
+    SrcRectConstraint) override;
+  void onDrawImageLattice2(
+    const SkImage*,
+    const Lattice&,
+    const SkRect& dst,
+    SkFilterMode,
+    const SkPaint*) override;
+  void onDrawAtlas2(
+    const SkImage*,
+    const SkRSXform[],
+    const SkRect src[],
+    const SkColor[],
+    int count,
+    SkBlendMode,
+    const SkSamplingOptions&,
+    const SkRect* cull,
+    const SkPaint*) override;
+  void onDrawEdgeAAImageSet2(
+    const ImageSetEntry[],
+    int count,
+    const SkPoint dstClips[],
+    const SkMatrix preViewMatrices[],
+    const SkSamplingOptions&,
+    const SkPaint*,
+    SrcRectConstraint) override;
+  void onDrawEdgeAAQuad(
+    const SkRect&,
+    const SkPoint clip[4],
+    QuadAAFlags,
+    const SkColor4f&,
+    SkBlendMode) override;
+  void onDrawPatch(
+    const SkPoint cubics[12],
+    const SkColor colors[4],
+    const SkPoint texCoords[4],
+    SkBlendMode,
+    const SkPaint&) override;
+  void onDrawVerticesObject(const SkVertices*, SkBlendMode, const SkPaint&)
+    override;
+  void onDrawMesh(const SkMesh&, sk_sp<SkBlender>, const SkPaint&) override;
+  void onDrawShadowRec(const SkPath&, const SkDrawShadowRec&) override;
+  void onDrawPicture(const SkPicture*, const SkMatrix*, const SkPaint*)
+    override;
+  void onDrawDrawable(SkDrawable*, const SkMatrix*) override;
+
+ private:
+  DisplayList* mDisplayList {nullptr};
+  size_t mUnsupported {};
+  // Number of saves and layers that haven't been restored yet
+  size_t mSaveDepth {};
+  // Set by an unsupported matrix; commands are dropped until the save depth
+  // is less than this
+  std::optional<size_t> mDropUntilDepth;
+
+  void DropUntilRestore();
+  /// True, and counted as unsupported, while commands are being dropped
+  [[nodiscard]] bool ShouldDrop();
+};
@@ -0,0 +1,11 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <functional>
+
+template <class T>
+void HashCombine(size_t& seed, const T& value) {
+  seed ^= std::hash<T> {}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
@@ -0,0 +1,278 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "ImmediateUI.hpp"
+
+#include "HashCombine.hpp"
+
+#include <skia/core/SkPictureRecorder.h>
+#include <skia/core/SkTypeface.h>
+
+#include <algorithm>
+
+namespace {
+
+enum class WidgetKind {
+  Label,
+  Button,
+  ProgressBar,
+};
+
+size_t HashFont(const SkFont& font) {
+  size_t seed {};
+  const auto typeface = font.getTypeface();
+  HashCombine(seed, typeface ? typeface->uniqueID() : SkTypefaceID {});
+  HashCombine(seed, font.getSize());
+  HashCombine(seed, font.getScaleX());
+  HashCombine(seed, font.getSkewX());
+  return seed;
+}
+
+SkSize MeasureText(const SkFont& font, const SkTextBlob* blob) {
+  SkFontMetrics metrics {};
+  font.getMetrics(&metrics);
+  return SkSize::Make(
+    blob ? blob->bounds().width() : 0, metrics.fDescent - metrics.fAscent);
+}
+
+SkScalar GetBaseline(const SkFont& font) {
+  SkFontMetrics metrics {};
+  font.getMetrics(&metrics);
+  return -metrics.fAscent;
+}
+
+}// namespace
+
+ImmediateUI::ImmediateUI(const SkFont& font, bool enableCaching)
+  : mFont(font),
+    mCachingEnabled(enableCaching) {
+}
+
+void ImmediateUI::SetPointerState(const PointerState& state) {
+  mPointer = state;
+}
+
+void ImmediateUI::BeginFrame(
+  SkCanvas* canvas,
+  const SkRect& area,
+  FrameKind kind) {
+  mCanvas = canvas;
+  mFrameKind = kind;
+  mArea = area;
+  mCursor = {area.left(), area.top()};
+  mLineHeight = 0;
+  mPreviousWidget = SkRect::MakeXYWH(area.left(), area.top(), 0, 0);
+  mSameLine = false;
+  mIDStack.clear();
+  mStats = {};
+}
+
+void ImmediateUI::EndFrame() {
+  mCanvas = nullptr;
+  if (mFrameKind == FrameKind::Presented) {
+    this->AdvanceFrame();
+  }
+}
+
+void ImmediateUI::AdvanceFrame() {
+  mPreviousPointer = mPointer;
+  ++mFrame;
+  std::erase_if(mEntries, [this](const auto& it) {
+    return it.second.mLastUsedFrame + MaxUnusedFrames < mFrame;
+  });
+}
+
+ImmediateUI::WidgetID ImmediateUI::MakeID(std::string_view name) {
+  return std::hash<std::string_view> {}(name);
+}
+
+void ImmediateUI::PushID(WidgetID id) {
+  mIDStack.push_back(this->ScopedID(id));
+}
+
+void ImmediateUI::PopID() {
+  mIDStack.pop_back();
+}
+
+ImmediateUI::WidgetID ImmediateUI::ScopedID(WidgetID id) const {
+  if (mIDStack.empty()) {
+    return id;
+  }
+  auto seed = mIDStack.back();
+  HashCombine(seed, id);
+  return seed;
+}
+
+void ImmediateUI::SameLine() {
+  mSameLine = true;
+}
+
+SkRect ImmediateUI::Place(const SkSize& size) {
+  if (mSameLine) {
+    mSameLine = false;
+    const auto ret = SkRect::MakeXYWH(
+      mPreviousWidget.right() + Spacing,
+      mPreviousWidget.top(),
+      size.width(),
+      size.height());
+    mLineHeight = std::max(mLineHeight, size.height());
+    mCursor.fY = ret.top() + mLineHeight + Spacing;
+    mPreviousWidget = ret;
+    return ret;
+  }
+
+  const auto ret
+    = SkRect::MakeXYWH(mArea.left(), mCursor.y(), size.width(), size.height());
+  mLineHeight = size.height();
+  mCursor.fY = ret.bottom() + Spacing;
+  mPreviousWidget = ret;
+  return ret;
+}
+
+bool ImmediateUI::IsHovered(const SkRect& rect) const noexcept {
+  return rect.contains(mPointer.mPosition.x(), mPointer.mPosition.y());
+}
+
+template <class TLayout>
+ImmediateUI::PlacedWidget
+ImmediateUI::LayoutWidget(WidgetID id, size_t layoutHash, TLayout&& layout) {
+  ++mStats.mWidgets;
+  auto& entry = mEntries[this->ScopedID(id)];
+  entry.mLastUsedFrame = mFrame;
+
+  HashCombine(layoutHash, HashFont(mFont));
+  if (mCachingEnabled && entry.mHasLayout && entry.mLayoutHash == layoutHash) {
+    ++mStats.mLayoutHits;
+  } else {
+    ++mStats.mLayoutMisses;
+    layout(entry);
+    entry.mLayoutHash = layoutHash;
+    entry.mHasLayout = true;
+    // The picture depends on the layout
+    entry.mPicture = nullptr;
+  }
+
+  return {&entry, this->Place(entry.mSize)};
+}
+
+template <class TDraw>
+void ImmediateUI::PaintWidget(
+  const PlacedWidget& widget,
+  size_t paintHash,
+  TDraw&& draw) {
+  auto& entry = *widget.mEntry;
+  const auto& rect = widget.mRect;
+
+  if (!mCachingEnabled) {
+    mCanvas->save();
+    mCanvas->translate(rect.x(), rect.y());
+    draw(mCanvas, entry);
+    mCanvas->restore();
+    return;
+  }
+
+  if (entry.mPicture && entry.mPaintHash == paintHash) {
+    ++mStats.mPictureHits;
+  } else {
+    ++mStats.mPictureMisses;
+    SkPictureRecorder recorder;
+    draw(recorder.beginRecording(SkRect::MakeSize(entry.mSize)), entry);
+    entry.mPicture = recorder.finishRecordingAsPicture();
+    entry.mPaintHash = paintHash;
+  }
+
+  const auto matrix = SkMatrix::Translate(rect.x(), rect.y());
+  mCanvas->drawPicture(entry.mPicture, &matrix, nullptr);
+}
+
+void ImmediateUI::Label(WidgetID id, std::string_view text, SkColor color) {
+  size_t layoutHash = std::hash<std::string_view> {}(text);
+  HashCombine(layoutHash, WidgetKind::Label);
+  const auto widget = this->LayoutWidget(id, layoutHash, [&](Entry& entry) {
+    entry.mBlob = SkTextBlob::MakeFromText(
+      text.data(), text.size(), mFont, SkTextEncoding::kUTF8);
+    entry.mSize = MeasureText(mFont, entry.mBlob.get());
+  });
+
+  size_t paintHash {};
+  HashCombine(paintHash, color);
+  this->PaintWidget(widget, paintHash, [&](SkCanvas* canvas, const Entry& e) {
+    if (!e.mBlob) {
+      return;
+    }
+    SkPaint paint;
+    paint.setColor(color);
+    canvas->drawTextBlob(
+      e.mBlob, -e.mBlob->bounds().left(), GetBaseline(mFont), paint);
+  });
+}
+
+bool ImmediateUI::Button(WidgetID id, std::string_view text) {
+  size_t layoutHash = std::hash<std::string_view> {}(text);
+  HashCombine(layoutHash, WidgetKind::Button);
+  const auto widget = this->LayoutWidget(id, layoutHash, [&](Entry& entry) {
+    entry.mBlob = SkTextBlob::MakeFromText(
+      text.data(), text.size(), mFont, SkTextEncoding::kUTF8);
+    const auto textSize = MeasureText(mFont, entry.mBlob.get());
+    entry.mSize = SkSize::Make(
+      textSize.width() + (2 * Padding), textSize.height() + (2 * Padding));
+  });
+
+  const auto hovered = this->IsHovered(widget.mRect);
+  const auto pressed = hovered && mPointer.mPressed;
+  const auto clicked
+    = hovered && mPreviousPointer.mPressed && !mPointer.mPressed;
+
+  size_t paintHash {};
+  HashCombine(paintHash, hovered);
+  HashCombine(paintHash, pressed);
+  this->PaintWidget(widget, paintHash, [&](SkCanvas* canvas, const Entry& e) {
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    if (pressed) {
+      paint.setColor(SkColorSetRGB(0x44, 0x44, 0x99));
+    } else if (hovered) {
+      paint.setColor(SkColorSetRGB(0x77, 0x77, 0xdd));
+    } else {
+      paint.setColor(SkColorSetRGB(0x66, 0x66, 0xcc));
+    }
+    canvas->drawRoundRect(SkRect::MakeSize(e.mSize), 4, 4, paint);
+    if (e.mBlob) {
+      paint.setColor(SK_ColorWHITE);
+      canvas->drawTextBlob(
+        e.mBlob,
+        Padding - e.mBlob->bounds().left(),
+        Padding + GetBaseline(mFont),
+        paint);
+    }
+  });
+
+  return clicked;
+}
+
+void ImmediateUI::ProgressBar(WidgetID id, float fraction, SkScalar width) {
+  size_t layoutHash {};
+  HashCombine(layoutHash, WidgetKind::ProgressBar);
+  HashCombine(layoutHash, width);
+  const auto widget = this->LayoutWidget(id, layoutHash, [&](Entry& entry) {
+    entry.mSize = SkSize::Make(width, MeasureText(mFont, nullptr).height());
+  });
+
+  fraction = std::clamp(fraction, 0.0f, 1.0f);
+  size_t paintHash {};
+  HashCombine(paintHash, fraction);
+  this->PaintWidget(widget, paintHash, [&](SkCanvas* canvas, const Entry& e) {
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    const auto rect = SkRect::MakeSize(e.mSize);
+    paint.setColor(SkColorSetRGB(0x22, 0x22, 0x44));
+    canvas->drawRoundRect(rect, 2, 2, paint);
+    paint.setColor(SkColorSetRGB(0x66, 0x66, 0xcc));
+    canvas->drawRoundRect(
+      SkRect::MakeWH(rect.width() * fraction, rect.height()), 2, 2, paint);
+  });
+}
+
+ImmediateUI::Stats ImmediateUI::GetStats() const noexcept {
+  return mStats;
+}
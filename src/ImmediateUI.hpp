@@ -0,0 +1,132 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkCanvas.h>
+#include <skia/core/SkFont.h>
+#include <skia/core/SkPicture.h>
+#include <skia/core/SkTextBlob.h>
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/** An immediate-mode widget API with retained caches.
+ *
+ * Widgets are declared every frame, and identified by an ID that must be
+ * stable across frames; IDs are scoped by `PushID()`/`PopID()`.
+ *
+ * For each widget, we cache:
+ * - its size and text blob, reused while its layout inputs (e.g. text and
+ *   font) hash the same as the previous frame
+ * - a picture of its content, reused while its layout inputs and visual
+ *   inputs (e.g. colors, hover state) hash the same
+ *
+ * Widgets are placed top-to-bottom; `SameLine()` places the next widget to
+ * the right of the previous one instead.
+ */
+class ImmediateUI final {
+ public:
+  using WidgetID = size_t;
+  static constexpr uint64_t MaxUnusedFrames = 60;
+
+  struct Stats {
+    size_t mWidgets {};
+    size_t mLayoutHits {};
+    size_t mLayoutMisses {};
+    size_t mPictureHits {};
+    size_t mPictureMisses {};
+  };
+
+  enum class FrameKind {
+    // Consumes input, and ages the caches in `EndFrame()`
+    Presented,
+    // Drawn ahead of time, and may never be shown; call `AdvanceFrame()`
+    // once for each frame that is shown instead
+    Speculative,
+  };
+
+  struct PointerState {
+    SkPoint mPosition {-1, -1};
+    bool mPressed {false};
+  };
+
+  explicit ImmediateUI(const SkFont&, bool enableCaching = true);
+
+  void SetPointerState(const PointerState&);
+
+  void BeginFrame(
+    SkCanvas*,
+    const SkRect& area,
+    FrameKind = FrameKind::Presented);
+  void EndFrame();
+  /// Called by `EndFrame()` for `FrameKind::Presented`
+  void AdvanceFrame();
+
+  static WidgetID MakeID(std::string_view);
+  void PushID(WidgetID);
+  void PopID();
+
+  void SameLine();
+
+  void Label(WidgetID, std::string_view text, SkColor = SK_ColorWHITE);
+  /// Returns true if the button was clicked
+  bool Button(WidgetID, std::string_view text);
+  void ProgressBar(WidgetID, float fraction, SkScalar width);
+
+  /// Counters since the last call to `BeginFrame()`
+  [[nodiscard]] Stats GetStats() const noexcept;
+
+ private:
+  static constexpr SkScalar Spacing = 4;
+  static constexpr SkScalar Padding = 6;
+
+  struct Entry {
+    bool mHasLayout {false};
+    size_t mLayoutHash {};
+    SkSize mSize {};
+    sk_sp<SkTextBlob> mBlob;
+
+    size_t mPaintHash {};
+    sk_sp<SkPicture> mPicture;
+
+    uint64_t mLastUsedFrame {};
+  };
+
+  SkFont mFont;
+  bool mCachingEnabled {true};
+
+  SkCanvas* mCanvas {nullptr};
+  FrameKind mFrameKind {FrameKind::Presented};
+  SkRect mArea {};
+  SkPoint mCursor {};
+  SkScalar mLineHeight {};
+  SkRect mPreviousWidget {};
+  bool mSameLine {false};
+
+  PointerState mPointer;
+  PointerState mPreviousPointer;
+
+  std::vector<WidgetID> mIDStack;
+  std::unordered_map<WidgetID, Entry> mEntries;
+  uint64_t mFrame {};
+  Stats mStats;
+
+  struct PlacedWidget {
+    Entry* mEntry {nullptr};
+    SkRect mRect {};
+  };
+
+  WidgetID ScopedID(WidgetID) const;
+  SkRect Place(const SkSize&);
+
+  /// `layout` must set the entry's size, and text blob if needed
+  template <class TLayout>
+  PlacedWidget LayoutWidget(WidgetID, size_t layoutHash, TLayout&& layout);
+  /// `draw` is called in the widget's coordinate space
+  template <class TDraw>
+  void PaintWidget(const PlacedWidget&, size_t paintHash, TDraw&& draw);
+
+  [[nodiscard]] bool IsHovered(const SkRect&) const noexcept;
+};
@@ -0,0 +1,45 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "InstanceCache.hpp"
+
+#include <skia/core/SkPictureRecorder.h>
+
+sk_sp<SkPicture> InstanceCache::GetPicture(const DisplayList& subtree) {
+  ++mStats.mLookups;
+  const auto hash = subtree.GetContentHash();
+  const auto it = mEntries.find(hash);
+  if (it != mEntries.end()) {
+    if (it->second.mSubtree.HasSameContent(subtree)) {
+      ++mStats.mHits;
+      it->second.mLastUsedFrame = mFrame;
+      return it->second.mPicture;
+    }
+    // Replaced below
+    ++mStats.mCollisions;
+  }
+
+  // If any content is unbounded, the picture can't be culled, but it can
+  // still be shared
+  const auto bounds
+    = subtree.GetConservativeBounds().value_or(SkRect::MakeLargest());
+
+  SkPictureRecorder recorder;
+  subtree.Replay(recorder.beginRecording(bounds));
+  auto picture = recorder.finishRecordingAsPicture();
+  mEntries.insert_or_assign(hash, Entry {subtree, picture, mFrame});
+  return picture;
+}
+
+void InstanceCache::EndFrame() {
+  ++mFrame;
+  std::erase_if(mEntries, [this](const auto& it) {
+    return it.second.mLastUsedFrame + MaxUnusedFrames < mFrame;
+  });
+}
+
+InstanceCache::Stats InstanceCache::GetStats() const noexcept {
+  auto ret = mStats;
+  ret.mEntries = mEntries.size();
+  return ret;
+}
@@ -0,0 +1,54 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "DisplayList.hpp"
+
+#include <skia/core/SkPicture.h>
+
+#include <unordered_map>
+
+/** Records identical subtrees once, so that they can be drawn as instances.
+ *
+ * Subtrees are looked up by `DisplayList::GetContentHash()`; each distinct
+ * subtree is recorded into an `SkPicture` the first time it is seen, and the
+ * same picture is returned for every later identical subtree. Each entry
+ * keeps a copy of its subtree, so hash collisions are detected with
+ * `DisplayList::HasSameContent()`, and re-recorded as a miss. Add it to the
+ * scene with `DisplayList::DrawPicture()` and a per-instance matrix.
+ *
+ * Pictures that have not been used for `MaxUnusedFrames` are dropped by
+ * `EndFrame()`.
+ *
+ * Not thread-safe.
+ */
+class InstanceCache final {
+ public:
+  static constexpr uint64_t MaxUnusedFrames = 60;
+
+  struct Stats {
+    size_t mLookups {};
+    size_t mHits {};
+    // Same hash, different content
+    size_t mCollisions {};
+    size_t mEntries {};
+  };
+
+  [[nodiscard]] sk_sp<SkPicture> GetPicture(const DisplayList& subtree);
+
+  void EndFrame();
+
+  [[nodiscard]] Stats GetStats() const noexcept;
+
+ private:
+  struct Entry {
+    DisplayList mSubtree;
+    sk_sp<SkPicture> mPicture;
+    uint64_t mLastUsedFrame {};
+  };
+
+  uint64_t mFrame {};
+  std::unordered_map<size_t, Entry> mEntries;
+  Stats mStats;
+};
@@ -0,0 +1,183 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Interner.hpp"
+
+#include "HashCombine.hpp"
+
+#include <skia/core/SkData.h>
+#include <skia/core/SkTypeface.h>
+
+#include <bit>
+
+double Interner::TableStats::GetHitRate() const noexcept {
+  if (mLookups == 0) {
+    return 0;
+  }
+  return static_cast<double>(mHits) / mLookups;
+}
+
+size_t Interner::Hash::operator()(const PaintKey& key) const noexcept {
+  size_t seed {};
+  HashCombine(seed, std::bit_cast<uint32_t>(key.mColor.fR));
+  HashCombine(seed, std::bit_cast<uint32_t>(key.mColor.fG));
+  HashCombine(seed, std::bit_cast<uint32_t>(key.mColor.fB));
+  HashCombine(seed, std::bit_cast<uint32_t>(key.mColor.fA));
+  HashCombine(seed, static_cast<int>(key.mStyle));
+  HashCombine(seed, key.mStrokeWidth);
+  HashCombine(seed, key.mShader);
+  HashCombine(seed, key.mColorFilter);
+  HashCombine(seed, key.mMaskFilter);
+  HashCombine(seed, key.mPathEffect);
+  HashCombine(seed, key.mImageFilter);
+  HashCombine(seed, key.mBlender);
+  return seed;
+}
+
+size_t Interner::Hash::operator()(const TextKey& key) const noexcept {
+  size_t seed = std::hash<std::string> {}(key.mText);
+  HashCombine(seed, key.mTypefaceID);
+  HashCombine(seed, key.mSize);
+  HashCombine(seed, key.mScaleX);
+  HashCombine(seed, key.mSkewX);
+  HashCombine(seed, static_cast<int>(key.mEdging));
+  return seed;
+}
+
+size_t Interner::Hash::operator()(const std::string& key) const noexcept {
+  return std::hash<std::string> {}(key);
+}
+
+template <class TKey, class TValue, class TMakeValue>
+Interner::Interned<TValue> Interner::Lookup(
+  Table<TKey, TValue>& table,
+  TKey&& key,
+  TMakeValue&& makeValue) {
+  ++table.mStats.mLookups;
+  if (auto it = table.mEntries.find(key); it != table.mEntries.end()) {
+    ++table.mStats.mHits;
+    it->second.mLastUsedFrame = mFrame;
+    return {it->second.mID, it->second.mValue};
+  }
+
+  const auto id = mNextID++;
+  auto value = makeValue();
+  table.mEntries.emplace(
+    std::move(key),
+    typename Table<TKey, TValue>::Entry {id, value, mFrame});
+  return {id, std::move(value)};
+}
+
+Interner::Interned<SkPath> Interner::Intern(const SkPath& path) {
+  std::string key(path.writeToMemory(nullptr), '\0');
+  path.writeToMemory(key.data());
+  return this->Lookup(mPaths, std::move(key), [&path]() {
+    SkPath copy {path};
+    // Let Skia cache tessellations and masks for this path
+    copy.setIsVolatile(false);
+    return copy;
+  });
+}
+
+Interner::Interned<sk_sp<SkShader>> Interner::Intern(
+  const sk_sp<SkShader>& shader) {
+  if (!shader) {
+    return {};
+  }
+  const auto data = shader->serialize();
+  if (!data) {
+    // Not serializable; we can't tell if it's equivalent to anything else
+    ++mShaders.mStats.mLookups;
+    return {mNextID++, shader};
+  }
+  std::string key {reinterpret_cast<const char*>(data->data()), data->size()};
+  return this->Lookup(
+    mShaders, std::move(key), [&shader]() { return shader; });
+}
+
+Interner::Interned<SkPaint> Interner::Intern(const SkPaint& paint) {
+  const auto shader = this->Intern(paint.refShader()).mValue;
+  PaintKey key {
+    .mColor = paint.getColor4f(),
+    .mStyle = paint.getStyle(),
+    .mStrokeWidth = paint.getStrokeWidth(),
+    .mStrokeMiter = paint.getStrokeMiter(),
+    .mStrokeCap = paint.getStrokeCap(),
+    .mStrokeJoin = paint.getStrokeJoin(),
+    .mAntiAlias = paint.isAntiAlias(),
+    .mDither = paint.isDither(),
+    .mShader = shader.get(),
+    .mColorFilter = paint.getColorFilter(),
+    .mMaskFilter = paint.getMaskFilter(),
+    .mPathEffect = paint.getPathEffect(),
+    .mImageFilter = paint.getImageFilter(),
+    .mBlender = paint.getBlender(),
+  };
+  return this->Lookup(mPaints, std::move(key), [&]() {
+    SkPaint copy {paint};
+    copy.setShader(shader);
+    return copy;
+  });
+}
+
+Interner::Interned<sk_sp<SkTextBlob>> Interner::InternText(
+  std::string_view text,
+  const SkFont& font) {
+  const auto typeface = font.getTypeface();
+  TextKey key {
+    .mText = std::string {text},
+    .mTypefaceID = typeface ? typeface->uniqueID() : SkTypefaceID {},
+    .mSize = font.getSize(),
+    .mScaleX = font.getScaleX(),
+    .mSkewX = font.getSkewX(),
+    .mEdging = font.getEdging(),
+    .mHinting = font.getHinting(),
+    .mEmbolden = font.isEmbolden(),
+    .mSubpixel = font.isSubpixel(),
+    .mLinearMetrics = font.isLinearMetrics(),
+  };
+  return this->Lookup(mTextBlobs, std::move(key), [&]() {
+    return SkTextBlob::MakeFromText(
+      text.data(), text.size(), font, SkTextEncoding::kUTF8);
+  });
+}
+
+template <class TKey, class TValue>
+void Interner::Evict(Table<TKey, TValue>& table) {
+  std::erase_if(table.mEntries, [this, &table](const auto& it) {
+    if (it.second.mLastUsedFrame + MaxUnusedFrames >= mFrame) {
+      return false;
+    }
+    ++table.mStats.mEvictions;
+    return true;
+  });
+}
+
+void Interner::EndFrame() {
+  ++mFrame;
+  this->Evict(mPaths);
+  this->Evict(mShaders);
+  this->Evict(mPaints);
+  this->Evict(mTextBlobs);
+}
+
+Interner::Stats Interner::GetStats() const noexcept {
+  Stats ret {
+    mPaths.mStats,
+    mShaders.mStats,
+    mPaints.mStats,
+    mTextBlobs.mStats,
+  };
+  ret.mPaths.mEntries = mPaths.mEntries.size();
+  ret.mShaders.mEntries = mShaders.mEntries.size();
+  ret.mPaints.mEntries = mPaints.mEntries.size();
+  ret.mTextBlobs.mEntries = mTextBlobs.mEntries.size();
+  return ret;
+}
+
+void Interner::ResetStats() noexcept {
+  mPaths.mStats = {};
+  mShaders.mStats = {};
+  mPaints.mStats = {};
+  mTextBlobs.mStats = {};
+}
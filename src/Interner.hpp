@@ -0,0 +1,134 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkFont.h>
+#include <skia/core/SkPaint.h>
+#include <skia/core/SkPath.h>
+#include <skia/core/SkShader.h>
+#include <skia/core/SkTextBlob.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/** Hash-conses Skia objects so that identical content is shared across
+ * frames.
+ *
+ * Skia caches tessellations, masks, and text blob glyph runs keyed on object
+ * identity (e.g. `SkPath::getGenerationID()` or `SkTextBlob::uniqueID()`);
+ * objects that are rebuilt each frame get new identities, so never hit these
+ * caches. Interned values are immutable and are copied cheaply, as Skia
+ * shares their underlying storage.
+ *
+ * Entries that have not been used for `MaxUnusedFrames` are dropped by
+ * `EndFrame()`.
+ *
+ * Not thread-safe.
+ */
+class Interner final {
+ public:
+  static constexpr uint64_t MaxUnusedFrames = 60;
+
+  template <class T>
+  struct Interned {
+    // Unique across all kinds of value, and stable for as long as the value
+    // stays interned
+    uint32_t mID {};
+    T mValue;
+  };
+
+  struct TableStats {
+    size_t mLookups {};
+    size_t mHits {};
+    size_t mEntries {};
+    size_t mEvictions {};
+
+    [[nodiscard]] double GetHitRate() const noexcept;
+  };
+
+  struct Stats {
+    TableStats mPaths;
+    TableStats mShaders;
+    TableStats mPaints;
+    TableStats mTextBlobs;
+  };
+
+  Interned<SkPath> Intern(const SkPath&);
+  Interned<sk_sp<SkShader>> Intern(const sk_sp<SkShader>&);
+  /// The paint's shader is also interned
+  Interned<SkPaint> Intern(const SkPaint&);
+  Interned<sk_sp<SkTextBlob>> InternText(std::string_view, const SkFont&);
+
+  void EndFrame();
+
+  [[nodiscard]] Stats GetStats() const noexcept;
+  void ResetStats() noexcept;
+
+ private:
+  struct PaintKey {
+    SkColor4f mColor {};
+    SkPaint::Style mStyle {};
+    SkScalar mStrokeWidth {};
+    SkScalar mStrokeMiter {};
+    SkPaint::Cap mStrokeCap {};
+    SkPaint::Join mStrokeJoin {};
+    bool mAntiAlias {};
+    bool mDither {};
+    const void* mShader {};
+    const void* mColorFilter {};
+    const void* mMaskFilter {};
+    const void* mPathEffect {};
+    const void* mImageFilter {};
+    const void* mBlender {};
+
+    bool operator==(const PaintKey&) const noexcept = default;
+  };
+  struct TextKey {
+    std::string mText;
+    SkTypefaceID mTypefaceID {};
+    SkScalar mSize {};
+    SkScalar mScaleX {};
+    SkScalar mSkewX {};
+    SkFont::Edging mEdging {};
+    SkFontHinting mHinting {};
+    bool mEmbolden {};
+    bool mSubpixel {};
+    bool mLinearMetrics {};
+
+    bool operator==(const TextKey&) const noexcept = default;
+  };
+  struct Hash {
+    size_t operator()(const PaintKey&) const noexcept;
+    size_t operator()(const TextKey&) const noexcept;
+    size_t operator()(const std::string&) const noexcept;
+  };
+
+  template <class TKey, class TValue>
+  struct Table {
+    struct Entry {
+      uint32_t mID {};
+      TValue mValue;
+      uint64_t mLastUsedFrame {};
+    };
+    std::unordered_map<TKey, Entry, Hash> mEntries;
+    TableStats mStats;
+  };
+
+  uint64_t mFrame {};
+  uint32_t mNextID {1};
+
+  // Paths and shaders are keyed on their serialized form
+  Table<std::string, SkPath> mPaths;
+  Table<std::string, sk_sp<SkShader>> mShaders;
+  Table<PaintKey, SkPaint> mPaints;
+  Table<TextKey, sk_sp<SkTextBlob>> mTextBlobs;
+
+  template <class TKey, class TValue, class TMakeValue>
+  Interned<TValue> Lookup(Table<TKey, TValue>&, TKey&& key, TMakeValue&&);
+
+  template <class TKey, class TValue>
+  void Evict(Table<TKey, TValue>&);
+};
@@ -0,0 +1,213 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "LabelPlacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+using Position = LabelPlacer::Position;
+
+constexpr Position Candidates[] {
+  Position::TopRight,
+  Position::TopLeft,
+  Position::BottomRight,
+  Position::BottomLeft,
+};
+
+SkRect GetBounds(const LabelPlacer::Label& label, Position position) {
+  static constexpr auto Gap = LabelPlacer::AnchorGap;
+  const auto [x, y] = label.mAnchor;
+  const auto w = label.mSize.width();
+  const auto h = label.mSize.height();
+  switch (position) {
+    case Position::TopRight:
+      return SkRect::MakeXYWH(x + Gap, y - Gap - h, w, h);
+    case Position::TopLeft:
+      return SkRect::MakeXYWH(x - Gap - w, y - Gap - h, w, h);
+    case Position::BottomRight:
+      return SkRect::MakeXYWH(x + Gap, y + Gap, w, h);
+    case Position::BottomLeft:
+      return SkRect::MakeXYWH(x - Gap - w, y + Gap, w, h);
+    case Position::Hidden:
+      break;
+  }
+  return SkRect::MakeEmpty();
+}
+
+// Everything apart from the anchor
+bool IsSameLabel(const LabelPlacer::Label& a, const LabelPlacer::Label& b) {
+  return a.mID == b.mID && a.mSize == b.mSize && a.mPriority == b.mPriority;
+}
+
+bool IsCoherent(const SkPoint& a, const SkPoint& b) {
+  return (a - b).length() < LabelPlacer::CoherenceThreshold;
+}
+
+}// namespace
+
+LabelPlacer::LabelPlacer(SkScalar cellSize) : mCellSize(cellSize) {
+}
+
+std::span<const LabelPlacer::Placement> LabelPlacer::Place(
+  std::span<const Label> labels,
+  const SkRect& viewport) {
+  mStats = {.mLabels = labels.size()};
+
+  const auto sameLabels = std::ranges::equal(labels, mLabels, &IsSameLabel);
+  const auto sameAnchors = sameLabels
+    && std::ranges::equal(
+      labels, mLabels, {}, &Label::mAnchor, &Label::mAnchor);
+  if (sameAnchors && viewport == mViewport) {
+    mStats.mReusedResult = true;
+    mStats.mReusedOrder = true;
+    mStats.mPlaced = std::ranges::count_if(mPlacements, [](const auto& it) {
+      return it.mPosition != Position::Hidden;
+    });
+    mStats.mKeptPosition = mStats.mPlaced;
+    return mPlacements;
+  }
+
+  // Find where each label was placed by the previous call, if it hasn't
+  // moved far
+  mPreferred.assign(labels.size(), Position::Hidden);
+  if (sameLabels) {
+    for (size_t i = 0; i < labels.size(); ++i) {
+      if (IsCoherent(labels[i].mAnchor, mLabels[i].mAnchor)) {
+        mPreferred[i] = mPlacements[i].mPosition;
+      }
+    }
+  } else {
+    mPrevious.clear();
+    for (size_t i = 0; i < mLabels.size(); ++i) {
+      if (mPlacements[i].mPosition != Position::Hidden) {
+        mPrevious.emplace(
+          mLabels[i].mID,
+          PreviousPlacement {mLabels[i].mAnchor, mPlacements[i].mPosition});
+      }
+    }
+    for (size_t i = 0; i < labels.size(); ++i) {
+      const auto it = mPrevious.find(labels[i].mID);
+      if (it != mPrevious.end()
+          && IsCoherent(labels[i].mAnchor, it->second.mAnchor)) {
+        mPreferred[i] = it->second.mPosition;
+      }
+    }
+  }
+
+  if (sameLabels) {
+    mStats.mReusedOrder = true;
+  } else {
+    mOrder.resize(labels.size());
+    std::iota(mOrder.begin(), mOrder.end(), 0);
+    // Stable, so that ties are broken consistently between calls
+    std::ranges::stable_sort(mOrder, [labels](uint32_t a, uint32_t b) {
+      return labels[a].mPriority > labels[b].mPriority;
+    });
+  }
+
+  mLabels.assign(labels.begin(), labels.end());
+  mViewport = viewport;
+  mPlacements.assign(labels.size(), {});
+  this->ResetGrid(viewport);
+
+  for (const auto i: mOrder) {
+    const auto& label = mLabels[i];
+    const auto preferred = mPreferred[i];
+
+    const auto tryPosition = [&](Position position) {
+      const auto bounds = GetBounds(label, position);
+      if (!viewport.contains(bounds) || this->Collides(bounds)) {
+        return false;
+      }
+      this->Insert(bounds);
+      mPlacements[i] = {position, bounds};
+      ++mStats.mPlaced;
+      return true;
+    };
+
+    if (preferred != Position::Hidden && tryPosition(preferred)) {
+      ++mStats.mKeptPosition;
+      continue;
+    }
+    for (const auto position: Candidates) {
+      if (position != preferred && tryPosition(position)) {
+        break;
+      }
+    }
+  }
+
+  return mPlacements;
+}
+
+void LabelPlacer::ResetGrid(const SkRect& viewport) {
+  mPlaced.clear();
+  mGrid.mBounds = viewport;
+  mGrid.mColumns
+    = std::max(1, static_cast<int>(std::ceil(viewport.width() / mCellSize)));
+  mGrid.mRows
+    = std::max(1, static_cast<int>(std::ceil(viewport.height() / mCellSize)));
+  mGrid.mCells.resize(mGrid.mColumns * mGrid.mRows);
+  // Keep the capacity of each cell
+  for (auto& cell: mGrid.mCells) {
+    cell.clear();
+  }
+}
+
+template <class F>
+void LabelPlacer::ForEachCell(const SkRect& rect, F&& f) {
+  // `rect` is always inside the viewport, but clamp in case of rounding
+  const auto column = [this](SkScalar x) {
+    return std::clamp(
+      static_cast<int>((x - mGrid.mBounds.left()) / mCellSize),
+      0,
+      mGrid.mColumns - 1);
+  };
+  const auto row = [this](SkScalar y) {
+    return std::clamp(
+      static_cast<int>((y - mGrid.mBounds.top()) / mCellSize),
+      0,
+      mGrid.mRows - 1);
+  };
+
+  const auto right = column(rect.right());
+  const auto bottom = row(rect.bottom());
+  for (auto y = row(rect.top()); y <= bottom; ++y) {
+    for (auto x = column(rect.left()); x <= right; ++x) {
+      if (f(mGrid.mCells[(y * mGrid.mColumns) + x])) {
+        return;
+      }
+    }
+  }
+}
+
+bool LabelPlacer::Collides(const SkRect& rect) {
+  bool collides = false;
+  this->ForEachCell(rect, [&](const std::vector<uint32_t>& cell) {
+    for (const auto index: cell) {
+      ++mStats.mCollisionTests;
+      if (SkRect::Intersects(mPlaced[index], rect)) {
+        collides = true;
+        return true;
+      }
+    }
+    return false;
+  });
+  return collides;
+}
+
+void LabelPlacer::Insert(const SkRect& rect) {
+  const auto index = static_cast<uint32_t>(mPlaced.size());
+  mPlaced.push_back(rect);
+  this->ForEachCell(rect, [index](std::vector<uint32_t>& cell) {
+    cell.push_back(index);
+    return false;
+  });
+}
+
+LabelPlacer::Stats LabelPlacer::GetStats() const noexcept {
+  return mStats;
+}
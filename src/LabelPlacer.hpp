@@ -0,0 +1,116 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkRect.h>
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+/** Places labels next to their anchors so that no two labels overlap.
+ *
+ * Labels are placed greedily in order of priority; each label tries each
+ * `Position` around its anchor, and is hidden if none of them fit in the
+ * viewport without overlapping an already-placed label. Collision tests use a
+ * uniform grid, so each test only looks at labels in nearby cells, instead of
+ * every placed label.
+ *
+ * Placement is temporally coherent:
+ * - if no label has changed since the previous call, the previous result is
+ *   returned as-is
+ * - a label whose anchor moved by less than `CoherenceThreshold` tries its
+ *   previous position first, so labels don't jump between positions as
+ *   content moves
+ * - if the set of labels and their priorities are unchanged, the previous
+ *   priority order is reused instead of sorting again
+ *
+ * Labels are identified across calls by `Label::mID`.
+ */
+class LabelPlacer final {
+ public:
+  static constexpr SkScalar DefaultCellSize = 64;
+  static constexpr SkScalar CoherenceThreshold = 4;
+  // Between the anchor and the label
+  static constexpr SkScalar AnchorGap = 2;
+
+  enum class Position : uint8_t {
+    TopRight,
+    TopLeft,
+    BottomRight,
+    BottomLeft,
+    Hidden,
+  };
+
+  struct Label {
+    uint64_t mID {};
+    SkPoint mAnchor {};
+    SkSize mSize {};
+    // Higher values are placed first
+    float mPriority {};
+  };
+
+  struct Placement {
+    Position mPosition {Position::Hidden};
+    // Empty if hidden
+    SkRect mBounds {};
+  };
+
+  struct Stats {
+    size_t mLabels {};
+    size_t mPlaced {};
+    // Placed at the same position as in the previous call
+    size_t mKeptPosition {};
+    size_t mCollisionTests {};
+    bool mReusedOrder {};
+    bool mReusedResult {};
+  };
+
+  explicit LabelPlacer(SkScalar cellSize = DefaultCellSize);
+
+  /// The returned placements are in the same order as the labels
+  std::span<const Placement> Place(
+    std::span<const Label>,
+    const SkRect& viewport);
+
+  [[nodiscard]] Stats GetStats() const noexcept;
+
+ private:
+  struct Grid {
+    SkRect mBounds {};
+    int mColumns {};
+    int mRows {};
+    std::vector<std::vector<uint32_t>> mCells;
+  };
+
+  SkScalar mCellSize {};
+
+  std::vector<Label> mLabels;
+  std::vector<Placement> mPlacements;
+  // Indices into mLabels, highest priority first
+  std::vector<uint32_t> mOrder;
+  SkRect mViewport {};
+
+  // Reused between calls to avoid reallocating
+  Grid mGrid;
+  std::vector<SkRect> mPlaced;
+  // For each label, the position to try first
+  std::vector<Position> mPreferred;
+  struct PreviousPlacement {
+    SkPoint mAnchor {};
+    Position mPosition {Position::Hidden};
+  };
+  // Only used if the labels are not in the same order as the previous call
+  std::unordered_map<uint64_t, PreviousPlacement> mPrevious;
+
+  Stats mStats;
+
+  void ResetGrid(const SkRect& viewport);
+  /// Stops early if `f` returns true
+  template <class F>
+  void ForEachCell(const SkRect&, F&& f);
+  [[nodiscard]] bool Collides(const SkRect&);
+  void Insert(const SkRect&);
+};
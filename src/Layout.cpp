@@ -0,0 +1,353 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Layout.hpp"
+
+#include "TextMeasureCache.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Component-wise accessors so that rows and columns can share code
+struct Axes {
+  bool mIsRow {};
+
+  SkScalar Main(const SkSize& size) const {
+    return mIsRow ? size.width() : size.height();
+  }
+  SkScalar Cross(const SkSize& size) const {
+    return mIsRow ? size.height() : size.width();
+  }
+  SkSize MakeSize(SkScalar main, SkScalar cross) const {
+    return mIsRow ? SkSize::Make(main, cross) : SkSize::Make(cross, main);
+  }
+  LayoutNode::Constraints MakeConstraints(
+    SkScalar minMain,
+    SkScalar maxMain,
+    SkScalar minCross,
+    SkScalar maxCross) const {
+    if (mIsRow) {
+      return {minMain, maxMain, minCross, maxCross};
+    }
+    return {minCross, maxCross, minMain, maxMain};
+  }
+};
+
+SkScalar Clamp(SkScalar value, SkScalar min, SkScalar max) {
+  return std::max(min, std::min(value, max));
+}
+
+}// namespace
+
+LayoutNode::Constraints LayoutNode::Constraints::Tight(const SkSize& size) {
+  return {size.width(), size.width(), size.height(), size.height()};
+}
+
+LayoutNode::Constraints LayoutNode::Constraints::Loose(const SkSize& size) {
+  return {0, size.width(), 0, size.height()};
+}
+
+LayoutNode::LayoutNode(const Style& style) : mStyle(style) {
+}
+
+LayoutNode* LayoutNode::AppendChild(std::unique_ptr<LayoutNode> child) {
+  child->mParent = this;
+  auto ret = mChildren.emplace_back(std::move(child)).get();
+  this->MarkDirty();
+  return ret;
+}
+
+LayoutNode* LayoutNode::AppendChild() {
+  return this->AppendChild(std::make_unique<LayoutNode>());
+}
+
+LayoutNode* LayoutNode::AppendChild(const Style& style) {
+  return this->AppendChild(std::make_unique<LayoutNode>(style));
+}
+
+void LayoutNode::ClearChildren() {
+  mChildren.clear();
+  this->MarkDirty();
+}
+
+std::span<const std::unique_ptr<LayoutNode>> LayoutNode::GetChildren()
+  const noexcept {
+  return mChildren;
+}
+
+LayoutNode* LayoutNode::GetParent() const noexcept {
+  return mParent;
+}
+
+void LayoutNode::SetStyle(const Style& style) {
+  if (style == mStyle) {
+    return;
+  }
+  mStyle = style;
+  this->MarkDirty();
+}
+
+const LayoutNode::Style& LayoutNode::GetStyle() const noexcept {
+  return mStyle;
+}
+
+void LayoutNode::SetText(std::string_view text, const SkFont& font) {
+  if (text == mText && font == mFont) {
+    return;
+  }
+  mText = std::string {text};
+  mFont = font;
+  this->MarkDirty();
+}
+
+const std::string& LayoutNode::GetText() const noexcept {
+  return mText;
+}
+
+const SkFont& LayoutNode::GetFont() const noexcept {
+  return mFont;
+}
+
+void LayoutNode::MarkDirty() {
+  // If a node is dirty, its ancestors already are
+  for (auto node = this; node && !node->mDirty; node = node->mParent) {
+    node->mDirty = true;
+  }
+}
+
+bool LayoutNode::IsDirty() const noexcept {
+  return mDirty;
+}
+
+LayoutNode::Stats LayoutNode::Layout(
+  const Constraints& constraints,
+  TextMeasureCache* textMeasureCache) {
+  LayoutPass pass {.mTextMeasureCache = textMeasureCache};
+  this->LayoutSelf(constraints, pass);
+  return pass.mStats;
+}
+
+SkRect LayoutNode::GetFrame() const noexcept {
+  return mFrame;
+}
+
+SkRect LayoutNode::GetAbsoluteFrame() const noexcept {
+  auto ret = mFrame;
+  for (auto node = mParent; node; node = node->mParent) {
+    ret.offset(node->mFrame.x(), node->mFrame.y());
+  }
+  return ret;
+}
+
+SkScalar LayoutNode::GetBaseline() const noexcept {
+  return mBaseline;
+}
+
+SkSize LayoutNode::LayoutSelf(
+  const Constraints& constraints,
+  LayoutPass& pass) {
+  if (!mDirty && mLastConstraints == constraints) {
+    ++pass.mStats.mCacheHits;
+    return {mFrame.width(), mFrame.height()};
+  }
+  ++pass.mStats.mLayouts;
+
+  const auto resolved = this->ResolveConstraints(constraints);
+  const auto size = mChildren.empty()
+    ? this->MeasureLeaf(resolved, pass.mTextMeasureCache)
+    : this->LayoutChildren(resolved, pass);
+
+  // Our position is set by our parent
+  mFrame.setXYWH(mFrame.x(), mFrame.y(), size.width(), size.height());
+  mLastConstraints = constraints;
+  mDirty = false;
+  return size;
+}
+
+LayoutNode::Constraints LayoutNode::ResolveConstraints(
+  const Constraints& c) const {
+  // The parent's constraints win over our style
+  Constraints ret {
+    .mMinWidth = Clamp(mStyle.mMinWidth, c.mMinWidth, c.mMaxWidth),
+    .mMaxWidth = Clamp(mStyle.mMaxWidth, c.mMinWidth, c.mMaxWidth),
+    .mMinHeight = Clamp(mStyle.mMinHeight, c.mMinHeight, c.mMaxHeight),
+    .mMaxHeight = Clamp(mStyle.mMaxHeight, c.mMinHeight, c.mMaxHeight),
+  };
+  if (mStyle.mWidth) {
+    ret.mMinWidth = ret.mMaxWidth
+      = Clamp(*mStyle.mWidth, ret.mMinWidth, ret.mMaxWidth);
+  }
+  if (mStyle.mHeight) {
+    ret.mMinHeight = ret.mMaxHeight
+      = Clamp(*mStyle.mHeight, ret.mMinHeight, ret.mMaxHeight);
+  }
+  return ret;
+}
+
+SkSize LayoutNode::MeasureLeaf(
+  const Constraints& c,
+  TextMeasureCache* textMeasureCache) {
+  SkSize intrinsic {};
+  if (!mText.empty()) {
+    SkFontMetrics metrics {};
+    SkScalar width {};
+    if (textMeasureCache) {
+      metrics = textMeasureCache->GetMetrics(mFont);
+      width = textMeasureCache->MeasureText(mText, mFont);
+    } else {
+      mFont.getMetrics(&metrics);
+      width
+        = mFont.measureText(mText.data(), mText.size(), SkTextEncoding::kUTF8);
+    }
+    mBaseline = -metrics.fAscent;
+    intrinsic = SkSize::Make(width, metrics.fDescent - metrics.fAscent);
+  }
+  return SkSize::Make(
+    Clamp(intrinsic.width(), c.mMinWidth, c.mMaxWidth),
+    Clamp(intrinsic.height(), c.mMinHeight, c.mMaxHeight));
+}
+
+SkSize LayoutNode::LayoutChildren(const Constraints& c, LayoutPass& pass) {
+  const Axes axes {mStyle.mDirection == Direction::Row};
+  const auto& padding = mStyle.mPadding;
+  const auto paddingMain = axes.Main(SkSize::Make(
+    padding.mLeft + padding.mRight, padding.mTop + padding.mBottom));
+  const auto paddingCross = axes.Cross(SkSize::Make(
+    padding.mLeft + padding.mRight, padding.mTop + padding.mBottom));
+
+  const auto maxMain
+    = axes.Main(SkSize::Make(c.mMaxWidth, c.mMaxHeight)) - paddingMain;
+  const auto minMain
+    = axes.Main(SkSize::Make(c.mMinWidth, c.mMinHeight)) - paddingMain;
+  const auto maxCross
+    = axes.Cross(SkSize::Make(c.mMaxWidth, c.mMaxHeight)) - paddingCross;
+  const auto minCross
+    = axes.Cross(SkSize::Make(c.mMinWidth, c.mMinHeight)) - paddingCross;
+  const auto innerMaxMain = std::max<SkScalar>(0, maxMain);
+  const auto innerMaxCross = std::max<SkScalar>(0, maxCross);
+  const auto mainIsBounded = std::isfinite(innerMaxMain);
+
+  const auto stretch
+    = mStyle.mAlignItems == Align::Stretch && std::isfinite(innerMaxCross);
+  const auto childMinCross = stretch ? innerMaxCross : 0;
+
+  const auto gaps = mStyle.mGap * (mChildren.size() - 1);
+  std::vector<SkSize> sizes(mChildren.size());
+
+  // Pass 1: inflexible children get their preferred size
+  SkScalar used = gaps;
+  SkScalar totalGrow = 0;
+  for (size_t i = 0; i < mChildren.size(); ++i) {
+    auto& child = *mChildren.at(i);
+    if (mainIsBounded && child.mStyle.mFlexGrow > 0) {
+      totalGrow += child.mStyle.mFlexGrow;
+      continue;
+    }
+    sizes.at(i) = child.LayoutSelf(
+      axes.MakeConstraints(0, innerMaxMain, childMinCross, innerMaxCross),
+      pass);
+    used += axes.Main(sizes.at(i));
+  }
+
+  // Pass 2a: share any remaining space between flexible children
+  if (totalGrow > 0) {
+    const auto remaining = std::max<SkScalar>(0, innerMaxMain - used);
+    for (size_t i = 0; i < mChildren.size(); ++i) {
+      auto& child = *mChildren.at(i);
+      if (child.mStyle.mFlexGrow <= 0) {
+        continue;
+      }
+      const auto share = (remaining * child.mStyle.mFlexGrow) / totalGrow;
+      sizes.at(i) = child.LayoutSelf(
+        axes.MakeConstraints(share, share, childMinCross, innerMaxCross),
+        pass);
+      used += axes.Main(sizes.at(i));
+    }
+  }
+
+  // Pass 2b: if we overflowed, shrink children in proportion to their size
+  if (mainIsBounded && used > innerMaxMain) {
+    SkScalar totalShrink = 0;
+    for (size_t i = 0; i < mChildren.size(); ++i) {
+      totalShrink
+        += mChildren.at(i)->mStyle.mFlexShrink * axes.Main(sizes.at(i));
+    }
+    if (totalShrink > 0) {
+      const auto overflow = used - innerMaxMain;
+      used = gaps;
+      for (size_t i = 0; i < mChildren.size(); ++i) {
+        auto& child = *mChildren.at(i);
+        const auto base = axes.Main(sizes.at(i));
+        const auto weight = child.mStyle.mFlexShrink * base;
+        if (weight > 0) {
+          const auto target
+            = std::max<SkScalar>(0, base - ((overflow * weight) / totalShrink));
+          sizes.at(i) = child.LayoutSelf(
+            axes.MakeConstraints(0, target, childMinCross, innerMaxCross),
+            pass);
+        }
+        used += axes.Main(sizes.at(i));
+      }
+    }
+  }
+
+  SkScalar contentCross = 0;
+  for (const auto& size: sizes) {
+    contentCross = std::max(contentCross, axes.Cross(size));
+  }
+
+  const auto innerMain = (totalGrow > 0 && mainIsBounded)
+    ? innerMaxMain
+    : Clamp(used, std::max<SkScalar>(0, minMain), innerMaxMain);
+  const auto innerCross
+    = Clamp(contentCross, std::max<SkScalar>(0, minCross), innerMaxCross);
+
+  // Position children
+  const auto free = std::max<SkScalar>(0, innerMain - used);
+  SkScalar offset = 0;
+  SkScalar spacing = mStyle.mGap;
+  switch (mStyle.mJustifyContent) {
+    case Justify::Start:
+      break;
+    case Justify::Center:
+      offset = free / 2;
+      break;
+    case Justify::End:
+      offset = free;
+      break;
+    case Justify::SpaceBetween:
+      if (mChildren.size() > 1) {
+        spacing += free / (mChildren.size() - 1);
+      }
+      break;
+  }
+
+  const auto origin = axes.MakeSize(
+    axes.Main(SkSize::Make(padding.mLeft, padding.mTop)),
+    axes.Cross(SkSize::Make(padding.mLeft, padding.mTop)));
+  for (size_t i = 0; i < mChildren.size(); ++i) {
+    auto& child = *mChildren.at(i);
+    const auto& size = sizes.at(i);
+    SkScalar crossOffset = 0;
+    switch (mStyle.mAlignItems) {
+      case Align::Start:
+      case Align::Stretch:
+        break;
+      case Align::Center:
+        crossOffset = (innerCross - axes.Cross(size)) / 2;
+        break;
+      case Align::End:
+        crossOffset = innerCross - axes.Cross(size);
+        break;
+    }
+    const auto position = axes.MakeSize(
+      axes.Main(origin) + offset, axes.Cross(origin) + crossOffset);
+    child.mFrame = SkRect::MakeXYWH(
+      position.width(), position.height(), size.width(), size.height());
+    offset += axes.Main(size) + spacing;
+  }
+
+  return axes.MakeSize(innerMain + paddingMain, innerCross + paddingCross);
+}
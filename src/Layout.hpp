@@ -0,0 +1,159 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkFont.h>
+#include <skia/core/SkRect.h>
+
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class TextMeasureCache;
+
+/** A node in a flexbox-style layout tree.
+ *
+ * Layout is constraint-based: each parent passes minimum and maximum sizes
+ * to each child, the child picks its size, and the parent positions it.
+ *
+ * Results are cached between calls to `Layout()`: a node is only laid out
+ * again if it (or a descendant) was marked dirty, or if its parent passes
+ * different constraints. Changing a node's style, text, or children marks it
+ * and its ancestors dirty, so relayout after a change is proportional to the
+ * depth of the changed node, not the size of the tree.
+ */
+class LayoutNode final {
+ public:
+  enum class Direction {
+    Row,
+    Column,
+  };
+  enum class Justify {
+    Start,
+    Center,
+    End,
+    SpaceBetween,
+  };
+  enum class Align {
+    Start,
+    Center,
+    End,
+    Stretch,
+  };
+
+  struct Insets {
+    SkScalar mLeft {};
+    SkScalar mTop {};
+    SkScalar mRight {};
+    SkScalar mBottom {};
+
+    static constexpr Insets All(SkScalar value) {
+      return {value, value, value, value};
+    }
+    bool operator==(const Insets&) const noexcept = default;
+  };
+
+  struct Style {
+    Direction mDirection {Direction::Column};
+    Justify mJustifyContent {Justify::Start};
+    Align mAlignItems {Align::Stretch};
+    SkScalar mGap {};
+    Insets mPadding;
+
+    std::optional<SkScalar> mWidth;
+    std::optional<SkScalar> mHeight;
+    SkScalar mMinWidth {};
+    SkScalar mMaxWidth {SK_ScalarInfinity};
+    SkScalar mMinHeight {};
+    SkScalar mMaxHeight {SK_ScalarInfinity};
+
+    SkScalar mFlexGrow {};
+    SkScalar mFlexShrink {1};
+
+    bool operator==(const Style&) const noexcept = default;
+  };
+
+  struct Constraints {
+    SkScalar mMinWidth {};
+    SkScalar mMaxWidth {SK_ScalarInfinity};
+    SkScalar mMinHeight {};
+    SkScalar mMaxHeight {SK_ScalarInfinity};
+
+    static Constraints Tight(const SkSize&);
+    static Constraints Loose(const SkSize&);
+    bool operator==(const Constraints&) const noexcept = default;
+  };
+
+  struct Stats {
+    // Nodes that were laid out again
+    size_t mLayouts {};
+    // Nodes where the previous result was reused
+    size_t mCacheHits {};
+  };
+
+  LayoutNode() = default;
+  explicit LayoutNode(const Style&);
+  LayoutNode(const LayoutNode&) = delete;
+  LayoutNode(LayoutNode&&) = delete;
+  LayoutNode& operator=(const LayoutNode&) = delete;
+  LayoutNode& operator=(LayoutNode&&) = delete;
+
+  LayoutNode* AppendChild(std::unique_ptr<LayoutNode>);
+  LayoutNode* AppendChild();
+  LayoutNode* AppendChild(const Style&);
+  void ClearChildren();
+  [[nodiscard]] std::span<const std::unique_ptr<LayoutNode>> GetChildren()
+    const noexcept;
+  [[nodiscard]] LayoutNode* GetParent() const noexcept;
+
+  void SetStyle(const Style&);
+  [[nodiscard]] const Style& GetStyle() const noexcept;
+
+  /// Text nodes are sized to fit their text; they should not have children
+  void SetText(std::string_view, const SkFont&);
+  [[nodiscard]] const std::string& GetText() const noexcept;
+  [[nodiscard]] const SkFont& GetFont() const noexcept;
+
+  /// Marks this node and its ancestors as needing layout
+  void MarkDirty();
+  [[nodiscard]] bool IsDirty() const noexcept;
+
+  /** Call on the root node.
+   *
+   * If a `TextMeasureCache` is provided, it is used to measure text nodes.
+   */
+  Stats Layout(const Constraints&, TextMeasureCache* = nullptr);
+
+  /// Relative to the parent's frame
+  [[nodiscard]] SkRect GetFrame() const noexcept;
+  [[nodiscard]] SkRect GetAbsoluteFrame() const noexcept;
+  /// For text nodes, the offset of the baseline from the top of the frame
+  [[nodiscard]] SkScalar GetBaseline() const noexcept;
+
+ private:
+  LayoutNode* mParent {nullptr};
+  std::vector<std::unique_ptr<LayoutNode>> mChildren;
+  Style mStyle;
+
+  std::string mText;
+  SkFont mFont;
+
+  bool mDirty {true};
+  std::optional<Constraints> mLastConstraints;
+  SkRect mFrame {};
+  SkScalar mBaseline {};
+
+  struct LayoutPass {
+    Stats mStats;
+    TextMeasureCache* mTextMeasureCache {nullptr};
+  };
+
+  SkSize LayoutSelf(const Constraints&, LayoutPass&);
+  [[nodiscard]] Constraints ResolveConstraints(const Constraints&) const;
+  SkSize MeasureLeaf(const Constraints&, TextMeasureCache*);
+  SkSize LayoutChildren(const Constraints&, LayoutPass&);
+};
@@ -0,0 +1,288 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "Metrics.hpp"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+
+namespace {
+
+constexpr double DefaultTimeBuckets[] {
+  0.0001,
+  0.00025,
+  0.0005,
+  0.001,
+  0.0025,
+  0.005,
+  0.0075,
+  0.01,
+  0.0167,
+  0.025,
+  0.0333,
+  0.05,
+  0.1,
+  0.25,
+  0.5,
+  1,
+};
+
+/// Each thread always uses the same shard
+size_t GetShardIndex(size_t shardCount) {
+  static std::atomic<size_t> sNextIndex {};
+  thread_local const size_t index = sNextIndex++;
+  return index % shardCount;
+}
+
+std::string EscapeLabelValue(std::string_view value) {
+  std::string ret;
+  ret.reserve(value.size());
+  for (const auto c: value) {
+    switch (c) {
+      case '\\':
+        ret += "\\\\";
+        break;
+      case '"':
+        ret += "\\\"";
+        break;
+      case '\n':
+        ret += "\\n";
+        break;
+      default:
+        ret += c;
+    }
+  }
+  return ret;
+}
+
+std::string SerializeLabels(const MetricsRegistry::Labels& labels) {
+  std::string ret;
+  for (const auto& [key, value]: labels) {
+    if (!ret.empty()) {
+      ret += ',';
+    }
+    ret += std::format("{}=\"{}\"", key, EscapeLabelValue(value));
+  }
+  return ret;
+}
+
+std::string FormatDouble(double value) {
+  if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  }
+  if (std::isnan(value)) {
+    return "NaN";
+  }
+  return std::format("{}", value);
+}
+
+/// `name{labels,extra}`, leaving out empty parts
+std::string FormatSeries(
+  std::string_view name,
+  std::string_view labels,
+  std::string_view extra = {}) {
+  if (labels.empty() && extra.empty()) {
+    return std::string {name};
+  }
+  if (labels.empty() || extra.empty()) {
+    return std::format("{}{{{}{}}}", name, labels, extra);
+  }
+  return std::format("{}{{{},{}}}", name, labels, extra);
+}
+
+}// namespace
+
+void MetricsRegistry::Counter::Increment(uint64_t value) noexcept {
+  mShards[GetShardIndex(ShardCount)].mValue.fetch_add(
+    value, std::memory_order_relaxed);
+}
+
+uint64_t MetricsRegistry::Counter::GetValue() const noexcept {
+  uint64_t ret {};
+  for (const auto& shard: mShards) {
+    ret += shard.mValue.load(std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+void MetricsRegistry::Gauge::Set(double value) noexcept {
+  mValue.store(value, std::memory_order_relaxed);
+}
+
+double MetricsRegistry::Gauge::GetValue() const noexcept {
+  return mValue.load(std::memory_order_relaxed);
+}
+
+MetricsRegistry::Histogram::ScopedTimer::ScopedTimer(
+  Histogram* histogram) noexcept
+  : mHistogram(histogram),
+    mStart(std::chrono::steady_clock::now()) {
+}
+
+MetricsRegistry::Histogram::ScopedTimer::~ScopedTimer() {
+  if (mHistogram) {
+    mHistogram->Observe(std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - mStart)
+                          .count());
+  }
+}
+
+MetricsRegistry::Histogram::Histogram(std::span<const double> upperBounds)
+  : mUpperBounds(upperBounds.begin(), upperBounds.end()) {
+  std::ranges::sort(mUpperBounds);
+  for (auto& shard: mShards) {
+    shard.mBuckets
+      = std::make_unique<std::atomic<uint64_t>[]>(mUpperBounds.size() + 1);
+  }
+}
+
+void MetricsRegistry::Histogram::Observe(double value) noexcept {
+  // Buckets are inclusive upper bounds
+  const auto bucket = std::ranges::lower_bound(mUpperBounds, value)
+    - mUpperBounds.begin();
+  auto& shard = mShards[GetShardIndex(ShardCount)];
+  shard.mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  shard.mSum.fetch_add(value, std::memory_order_relaxed);
+}
+
+MetricsRegistry::Histogram::Snapshot
+MetricsRegistry::Histogram::GetSnapshot() const {
+  Snapshot ret {
+    .mUpperBounds = mUpperBounds,
+    .mBuckets = std::vector<uint64_t>(mUpperBounds.size() + 1),
+  };
+  for (const auto& shard: mShards) {
+    for (size_t i = 0; i < ret.mBuckets.size(); ++i) {
+      ret.mBuckets[i] += shard.mBuckets[i].load(std::memory_order_relaxed);
+    }
+    ret.mSum += shard.mSum.load(std::memory_order_relaxed);
+  }
+  uint64_t cumulative {};
+  for (auto& bucket: ret.mBuckets) {
+    cumulative += bucket;
+    bucket = cumulative;
+  }
+  ret.mCount = cumulative;
+  return ret;
+}
+
+std::span<const double> MetricsRegistry::GetDefaultTimeBuckets() {
+  return DefaultTimeBuckets;
+}
+
+template <class T, class... TArgs>
+T* MetricsRegistry::GetMetric(
+  std::string_view name,
+  std::string_view help,
+  const Labels& labels,
+  TArgs&&... args) {
+  std::unique_lock lock(mMutex);
+  auto family = mFamilies.find(name);
+  if (family == mFamilies.end()) {
+    family = mFamilies.emplace(std::string {name}, Family {std::string {help}})
+               .first;
+  }
+
+  auto& metrics = family->second.mMetrics;
+  if (
+    !metrics.empty()
+    && !std::holds_alternative<std::unique_ptr<T>>(metrics.begin()->second)) {
+    OutputDebugStringA(
+      std::format("Metric {} already has a different type\n", name).c_str());
+    return nullptr;
+  }
+
+  const auto key = SerializeLabels(labels);
+  auto it = metrics.find(key);
+  if (it == metrics.end()) {
+    it = metrics
+           .emplace(
+             key, std::make_unique<T>(std::forward<TArgs>(args)...))
+           .first;
+  }
+  return std::get<std::unique_ptr<T>>(it->second).get();
+}
+
+MetricsRegistry::Counter* MetricsRegistry::GetCounter(
+  std::string_view name,
+  std::string_view help,
+  const Labels& labels) {
+  return this->GetMetric<Counter>(name, help, labels);
+}
+
+MetricsRegistry::Gauge* MetricsRegistry::GetGauge(
+  std::string_view name,
+  std::string_view help,
+  const Labels& labels) {
+  return this->GetMetric<Gauge>(name, help, labels);
+}
+
+MetricsRegistry::Histogram* MetricsRegistry::GetHistogram(
+  std::string_view name,
+  std::string_view help,
+  std::span<const double> upperBounds,
+  const Labels& labels) {
+  return this->GetMetric<Histogram>(name, help, labels, upperBounds);
+}
+
+std::string MetricsRegistry::Serialize() const {
+  std::unique_lock lock(mMutex);
+  std::string ret;
+  for (const auto& [name, family]: mFamilies) {
+    if (family.mMetrics.empty()) {
+      continue;
+    }
+    const auto type = std::visit(
+      []<class T>(const std::unique_ptr<T>&) -> std::string_view {
+        if constexpr (std::same_as<T, Counter>) {
+          return "counter";
+        } else if constexpr (std::same_as<T, Gauge>) {
+          return "gauge";
+        } else {
+          return "histogram";
+        }
+      },
+      family.mMetrics.begin()->second);
+    ret += std::format(
+      "# HELP {} {}\n# TYPE {} {}\n", name, family.mHelp, name, type);
+
+    for (const auto& [labels, metric]: family.mMetrics) {
+      if (const auto counter = std::get_if<std::unique_ptr<Counter>>(&metric)) {
+        ret += std::format(
+          "{} {}\n", FormatSeries(name, labels), (*counter)->GetValue());
+        continue;
+      }
+      if (const auto gauge = std::get_if<std::unique_ptr<Gauge>>(&metric)) {
+        ret += std::format(
+          "{} {}\n",
+          FormatSeries(name, labels),
+          FormatDouble((*gauge)->GetValue()));
+        continue;
+      }
+
+      const auto snapshot
+        = std::get<std::unique_ptr<Histogram>>(metric)->GetSnapshot();
+      const auto bucketName = name + "_bucket";
+      for (size_t i = 0; i < snapshot.mBuckets.size(); ++i) {
+        const auto upperBound = (i < snapshot.mUpperBounds.size())
+          ? FormatDouble(snapshot.mUpperBounds.at(i))
+          : std::string {"+Inf"};
+        ret += std::format(
+          "{} {}\n",
+          FormatSeries(
+            bucketName, labels, std::format("le=\"{}\"", upperBound)),
+          snapshot.mBuckets.at(i));
+      }
+      ret += std::format(
+        "{} {}\n{} {}\n",
+        FormatSeries(name + "_sum", labels),
+        FormatDouble(snapshot.mSum),
+        FormatSeries(name + "_count", labels),
+        snapshot.mCount);
+    }
+  }
+  return ret;
+}
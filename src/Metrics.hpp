@@ -0,0 +1,139 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/** Counters, gauges, and histograms, exported in Prometheus' text format.
+ *
+ * Updating a metric is lock-free: counters and histograms are split into
+ * per-thread shards, each on its own cache line, so threads that update the
+ * same metric don't contend; shards are only summed by `Serialize()`.
+ *
+ * Metrics are created on first use, and live as long as the registry; keep
+ * the returned pointers instead of looking metrics up each frame.
+ */
+class MetricsRegistry final {
+ private:
+  static constexpr size_t ShardCount = 16;
+  static constexpr size_t CacheLineSize = 64;
+
+ public:
+  using Labels = std::vector<std::pair<std::string, std::string>>;
+
+  class Counter final {
+   public:
+    void Increment(uint64_t value = 1) noexcept;
+    [[nodiscard]] uint64_t GetValue() const noexcept;
+
+   private:
+    struct alignas(CacheLineSize) Shard {
+      std::atomic<uint64_t> mValue {};
+    };
+    std::array<Shard, ShardCount> mShards;
+  };
+
+  /// Last writer wins, so gauges are not sharded
+  class Gauge final {
+   public:
+    void Set(double) noexcept;
+    [[nodiscard]] double GetValue() const noexcept;
+
+   private:
+    std::atomic<double> mValue {};
+  };
+
+  class Histogram final {
+   public:
+    /// Observes the lifetime of the timer, in seconds
+    class ScopedTimer final {
+     public:
+      /// `histogram` can be `nullptr`
+      explicit ScopedTimer(Histogram* histogram) noexcept;
+      ~ScopedTimer();
+
+      ScopedTimer(const ScopedTimer&) = delete;
+      ScopedTimer(ScopedTimer&&) = delete;
+      ScopedTimer& operator=(const ScopedTimer&) = delete;
+      ScopedTimer& operator=(ScopedTimer&&) = delete;
+
+     private:
+      Histogram* mHistogram {nullptr};
+      std::chrono::steady_clock::time_point mStart;
+    };
+
+    struct Snapshot {
+      std::vector<double> mUpperBounds;
+      // Cumulative, as in Prometheus; the last bucket is +Inf
+      std::vector<uint64_t> mBuckets;
+      double mSum {};
+      uint64_t mCount {};
+    };
+
+    explicit Histogram(std::span<const double> upperBounds);
+
+    void Observe(double) noexcept;
+    [[nodiscard]] Snapshot GetSnapshot() const;
+
+   private:
+    struct alignas(CacheLineSize) Shard {
+      // One more than `mUpperBounds`, for +Inf
+      std::unique_ptr<std::atomic<uint64_t>[]> mBuckets;
+      std::atomic<double> mSum {};
+    };
+    std::vector<double> mUpperBounds;
+    std::array<Shard, ShardCount> mShards;
+  };
+
+  /// 100us to 1s, in seconds
+  static std::span<const double> GetDefaultTimeBuckets();
+
+  /// `nullptr` if `name` is already used by a different kind of metric
+  Counter*
+  GetCounter(std::string_view name, std::string_view help, const Labels& = {});
+  Gauge*
+  GetGauge(std::string_view name, std::string_view help, const Labels& = {});
+  Histogram* GetHistogram(
+    std::string_view name,
+    std::string_view help,
+    std::span<const double> upperBounds,
+    const Labels& = {});
+
+  /// Prometheus text exposition format, version 0.0.4
+  [[nodiscard]] std::string Serialize() const;
+
+ private:
+  using Metric = std::variant<
+    std::unique_ptr<Counter>,
+    std::unique_ptr<Gauge>,
+    std::unique_ptr<Histogram>>;
+
+  struct Family {
+    std::string mHelp;
+    // Keyed on the serialized labels, e.g. `phase="Flush"`
+    std::map<std::string, Metric> mMetrics;
+  };
+
+  mutable std::mutex mMutex;
+  std::map<std::string, Family, std::less<>> mFamilies;
+
+  template <class T, class... TArgs>
+  T* GetMetric(
+    std::string_view name,
+    std::string_view help,
+    const Labels&,
+    TArgs&&... args);
+};
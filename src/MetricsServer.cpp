@@ -0,0 +1,184 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+// Must be included before <Windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include "MetricsServer.hpp"
+
+#include "Metrics.hpp"
+
+#include <Windows.h>
+
+#include <format>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace {
+
+constexpr DWORD ReceiveTimeoutMilliseconds = 1000;
+// How long `select()` waits before checking if we've been asked to stop
+constexpr long PollIntervalMicroseconds = 100'000;
+constexpr size_t MaxRequestHeaderSize = 8192;
+
+bool SendAll(SOCKET socket, std::string_view data) {
+  while (!data.empty()) {
+    const auto sent
+      = send(socket, data.data(), static_cast<int>(data.size()), 0);
+    if (sent == SOCKET_ERROR) {
+      return false;
+    }
+    data.remove_prefix(sent);
+  }
+  return true;
+}
+
+std::string MakeResponse(
+  std::string_view status,
+  std::string_view contentType,
+  std::string_view body) {
+  return std::format(
+    "HTTP/1.1 {}\r\n"
+    "Content-Type: {}\r\n"
+    "Content-Length: {}\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "{}",
+    status,
+    contentType,
+    body.size(),
+    body);
+}
+
+}// namespace
+
+MetricsServer::MetricsServer(const MetricsRegistry& registry, uint16_t port)
+  : mRegistry(registry),
+    mListenSocket(INVALID_SOCKET) {
+  WSADATA wsaData {};
+  if (const auto error = WSAStartup(MAKEWORD(2, 2), &wsaData)) {
+    OutputDebugStringA(std::format("WSAStartup() failed: {}\n", error).c_str());
+    return;
+  }
+  mHaveWinsock = true;
+
+  const auto listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (listenSocket == INVALID_SOCKET) {
+    OutputDebugStringA(
+      std::format("socket() failed: {}\n", WSAGetLastError()).c_str());
+    return;
+  }
+
+  sockaddr_in address {
+    .sin_family = AF_INET,
+    .sin_port = htons(port),
+  };
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (
+    bind(
+      listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address))
+      == SOCKET_ERROR
+    || listen(listenSocket, SOMAXCONN) == SOCKET_ERROR) {
+    OutputDebugStringA(std::format(
+                         "Failed to listen on 127.0.0.1:{}: {}\n",
+                         port,
+                         WSAGetLastError())
+                         .c_str());
+    closesocket(listenSocket);
+    return;
+  }
+
+  mListenSocket = listenSocket;
+  mThread = std::jthread {std::bind_front(&MetricsServer::Run, this)};
+}
+
+MetricsServer::~MetricsServer() {
+  if (mThread.joinable()) {
+    mThread.request_stop();
+    mThread.join();
+  }
+  if (mListenSocket != INVALID_SOCKET) {
+    closesocket(mListenSocket);
+  }
+  if (mHaveWinsock) {
+    WSACleanup();
+  }
+}
+
+bool MetricsServer::IsListening() const noexcept {
+  return mListenSocket != INVALID_SOCKET;
+}
+
+void MetricsServer::Run(std::stop_token stopToken) {
+  SetThreadDescription(GetCurrentThread(), L"MetricsServer");
+
+  const auto listenSocket = static_cast<SOCKET>(mListenSocket);
+  while (!stopToken.stop_requested()) {
+    fd_set readable {};
+    FD_SET(listenSocket, &readable);
+    timeval timeout {.tv_usec = PollIntervalMicroseconds};
+    const auto ready = select(0, &readable, nullptr, nullptr, &timeout);
+    if (ready == SOCKET_ERROR) {
+      OutputDebugStringA(
+        std::format("select() failed: {}\n", WSAGetLastError()).c_str());
+      return;
+    }
+    if (ready == 0) {
+      continue;
+    }
+
+    const auto connection = accept(listenSocket, nullptr, nullptr);
+    if (connection == INVALID_SOCKET) {
+      continue;
+    }
+    this->HandleConnection(connection);
+    closesocket(connection);
+  }
+}
+
+void MetricsServer::HandleConnection(uintptr_t socket) {
+  const auto connection = static_cast<SOCKET>(socket);
+  // Don't let a client that never finishes its request stall the server
+  setsockopt(
+    connection,
+    SOL_SOCKET,
+    SO_RCVTIMEO,
+    reinterpret_cast<const char*>(&ReceiveTimeoutMilliseconds),
+    sizeof(ReceiveTimeoutMilliseconds));
+
+  // We only need the request line, but read the headers so that the client
+  // doesn't see a reset when we close the connection
+  std::string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == std::string::npos) {
+    if (request.size() >= MaxRequestHeaderSize) {
+      SendAll(
+        connection,
+        MakeResponse(
+          "431 Request Header Fields Too Large", "text/plain", {}));
+      return;
+    }
+    const auto received = recv(connection, buffer, sizeof(buffer), 0);
+    if (received <= 0) {
+      return;
+    }
+    request.append(buffer, received);
+  }
+
+  const std::string_view requestLine {
+    request.data(), request.find("\r\n")};
+  if (
+    requestLine != "GET /metrics HTTP/1.1"
+    && requestLine != "GET /metrics HTTP/1.0") {
+    SendAll(
+      connection, MakeResponse("404 Not Found", "text/plain", "Not Found\n"));
+    return;
+  }
+
+  SendAll(
+    connection,
+    MakeResponse(
+      "200 OK", "text/plain; version=0.0.4", mRegistry.Serialize()));
+}
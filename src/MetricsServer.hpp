@@ -0,0 +1,44 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <stop_token>
+#include <thread>
+
+class MetricsRegistry;
+
+/** Serves a `MetricsRegistry` over HTTP for Prometheus to scrape.
+ *
+ * Only listens on the loopback interface; `GET /metrics` returns the
+ * registry in Prometheus' text format, and everything else is a 404.
+ *
+ * Requests are handled one at a time on a background thread; as updating
+ * metrics is lock-free, scrapes never block the thread that renders frames.
+ */
+class MetricsServer final {
+ public:
+  MetricsServer(const MetricsRegistry&, uint16_t port);
+  ~MetricsServer();
+
+  MetricsServer() = delete;
+  MetricsServer(const MetricsServer&) = delete;
+  MetricsServer(MetricsServer&&) = delete;
+  MetricsServer& operator=(const MetricsServer&) = delete;
+  MetricsServer& operator=(MetricsServer&&) = delete;
+
+  [[nodiscard]] bool IsListening() const noexcept;
+
+ private:
+  const MetricsRegistry& mRegistry;
+  bool mHaveWinsock {false};
+  // A `SOCKET`; <winsock2.h> must be included before <Windows.h>, so keep it
+  // out of this header
+  uintptr_t mListenSocket {};
+
+  std::jthread mThread;
+
+  void Run(std::stop_token);
+  void HandleConnection(uintptr_t socket);
+};
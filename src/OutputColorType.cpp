@@ -0,0 +1,82 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "OutputColorType.hpp"
+
+#include <skia/core/SkCanvas.h>
+#include <skia/core/SkImage.h>
+#include <skia/core/SkPaint.h>
+
+#include <algorithm>
+
+namespace {
+
+constexpr NamedOutputColorType OutputColorTypes[] {
+  {"rgba8888", kRGBA_8888_SkColorType},
+  {"rgb565", kRGB_565_SkColorType},
+  {"gray8", kGray_8_SkColorType},
+  {"a8", kAlpha_8_SkColorType},
+};
+
+bool IsOpaque(SkColorType colorType) {
+  return colorType == kRGB_565_SkColorType || colorType == kGray_8_SkColorType;
+}
+
+}// namespace
+
+std::span<const NamedOutputColorType> GetOutputColorTypes() {
+  return OutputColorTypes;
+}
+
+std::optional<SkColorType> ParseOutputColorType(std::string_view name) {
+  const auto it
+    = std::ranges::find(OutputColorTypes, name, &NamedOutputColorType::mName);
+  if (it == std::ranges::end(OutputColorTypes)) {
+    return std::nullopt;
+  }
+  return it->mColorType;
+}
+
+std::string_view GetOutputColorTypeName(SkColorType colorType) {
+  const auto it = std::ranges::find(
+    OutputColorTypes, colorType, &NamedOutputColorType::mColorType);
+  if (it == std::ranges::end(OutputColorTypes)) {
+    return "unknown";
+  }
+  return it->mName;
+}
+
+SkImageInfo MakeOutputInfo(const SkImageInfo& info, SkColorType colorType) {
+  if (IsOpaque(colorType)) {
+    return info.makeColorType(colorType).makeAlphaType(kOpaque_SkAlphaType);
+  }
+  if (info.alphaType() == kOpaque_SkAlphaType) {
+    return info.makeColorType(colorType).makeAlphaType(kPremul_SkAlphaType);
+  }
+  return info.makeColorType(colorType);
+}
+
+bool ConvertPixels(const SkPixmap& source, const SkPixmap& dest) {
+  if (source.width() != dest.width() || source.height() != dest.height()) {
+    return false;
+  }
+  if (dest.colorType() != kRGB_565_SkColorType) {
+    // Skia's conversions drop color for alpha, use luminance for gray, and
+    // drop alpha - i.e. composite onto black - for opaque types
+    return source.readPixels(dest);
+  }
+
+  // 5-6 bits per channel band visibly without dithering, and only draws are
+  // dithered
+  auto canvas = SkCanvas::MakeRasterDirect(
+    dest.info(), dest.writable_addr(), dest.rowBytes());
+  auto image = SkImages::RasterFromPixmap(source, nullptr, nullptr);
+  if (!(canvas && image)) {
+    return false;
+  }
+  canvas->clear(SK_ColorBLACK);
+  SkPaint paint;
+  paint.setDither(true);
+  canvas->drawImage(image, 0, 0, SkSamplingOptions {}, &paint);
+  return true;
+}
@@ -0,0 +1,51 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkImageInfo.h>
+#include <skia/core/SkPixmap.h>
+
+#include <optional>
+#include <span>
+#include <string_view>
+
+/** Color types for raster output that needs less memory and bandwidth than
+ * 32-bit RGBA.
+ *
+ * - `rgba8888`: 4 bytes per pixel; the default
+ * - `rgb565`: 2 bytes per pixel; opaque, with 5-6 bits per channel
+ * - `gray8`: 1 byte per pixel; opaque luminance
+ * - `a8`: 1 byte per pixel; coverage only, e.g. for masks. Color is dropped,
+ *   so this is only useful for content that is drawn as shapes on a
+ *   transparent background
+ *
+ * Raster surfaces can use these directly; GPU rendering stays at 32 bits,
+ * and is converted with `ConvertPixels()` when it is read back. Skia
+ * converts them back to the destination's color type when they are drawn.
+ */
+struct NamedOutputColorType {
+  std::string_view mName;
+  SkColorType mColorType {};
+};
+
+std::span<const NamedOutputColorType> GetOutputColorTypes();
+/// `std::nullopt` if `name` is not in `GetOutputColorTypes()`
+std::optional<SkColorType> ParseOutputColorType(std::string_view name);
+/// `"unknown"` if the color type is not in `GetOutputColorTypes()`
+std::string_view GetOutputColorTypeName(SkColorType);
+
+/** `info`, converted to `colorType`, with a compatible alpha type.
+ *
+ * Opaque color types are `kOpaque_SkAlphaType`; others keep `info`'s alpha
+ * type, or premultiplied if it is opaque.
+ */
+SkImageInfo MakeOutputInfo(const SkImageInfo& info, SkColorType colorType);
+
+/** Converts `source` into `dest`, which must be the same size.
+ *
+ * Translucent pixels are composited onto black when converting to an opaque
+ * color type; converting to `rgb565` is dithered, to avoid banding in
+ * gradients; converting to `gray8` uses the pixels' luminance.
+ */
+bool ConvertPixels(const SkPixmap& source, const SkPixmap& dest);
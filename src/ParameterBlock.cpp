@@ -0,0 +1,311 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "ParameterBlock.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <new>
+#include <thread>
+
+std::unique_ptr<ParameterBlock> ParameterBlock::Create(
+  DWORD processID,
+  std::span<const Definition> definitions) {
+  const auto fail = [](std::string_view why) {
+    OutputDebugStringA(
+      std::format("Failed to create parameter block: {}\n", why).c_str());
+    return nullptr;
+  };
+
+  for (const auto& it: definitions) {
+    if (it.mName.empty() || it.mName.size() > MaxNameLength) {
+      return fail(std::format("invalid name '{}'", it.mName));
+    }
+    if (!IsValid(it.mType, it.mDefault, it.mMin, it.mMax)) {
+      return fail(std::format("invalid default for '{}'", it.mName));
+    }
+  }
+
+  const auto size = sizeof(SharedHeader)
+    + (definitions.size() * sizeof(SharedParameter));
+  std::unique_ptr<ParameterBlock> ret {new ParameterBlock()};
+  ret->mMapping.reset(CreateFileMappingW(
+    INVALID_HANDLE_VALUE,
+    nullptr,
+    PAGE_READWRITE,
+    0,
+    static_cast<DWORD>(size),
+    GetMappingName(processID).c_str()));
+  if (!ret->mMapping) {
+    return fail("CreateFileMappingW() failed");
+  }
+  if (GetLastError() == ERROR_ALREADY_EXISTS) {
+    return fail("already exists");
+  }
+  ret->mView.reset(static_cast<std::byte*>(
+    MapViewOfFile(ret->mMapping.get(), FILE_MAP_ALL_ACCESS, 0, 0, size)));
+  if (!ret->mView) {
+    return fail("MapViewOfFile() failed");
+  }
+
+  // Nothing else can have opened the block yet, as the header is invalid
+  // until the magic is written
+  auto parameters = reinterpret_cast<SharedParameter*>(
+    ret->mView.get() + sizeof(SharedHeader));
+  for (size_t i = 0; i < definitions.size(); ++i) {
+    const auto& definition = definitions[i];
+    auto it = new (parameters + i) SharedParameter {
+      .mType = definition.mType,
+      .mDefault = definition.mDefault,
+      .mMin = definition.mMin,
+      .mMax = definition.mMax,
+    };
+    memcpy(it->mName, definition.mName.data(), definition.mName.size());
+    it->mValue.store(definition.mDefault, std::memory_order_relaxed);
+  }
+  ret->mParameters = {parameters, definitions.size()};
+  // Names are not kept, as they may not outlive the block
+  for (const auto& definition: definitions) {
+    ret->mDefinitions.push_back({
+      .mType = definition.mType,
+      .mDefault = definition.mDefault,
+      .mMin = definition.mMin,
+      .mMax = definition.mMax,
+    });
+    ret->mValues.push_back(definition.mDefault);
+  }
+  ret->mHeader = new (ret->mView.get()) SharedHeader {
+    .mCount = static_cast<uint32_t>(definitions.size()),
+  };
+  std::atomic_thread_fence(std::memory_order_release);
+
+  ret->Poll();
+  return ret;
+}
+
+std::unique_ptr<ParameterBlock> ParameterBlock::Open(DWORD processID) {
+  const auto fail = [processID](std::string_view why) {
+    OutputDebugStringA(std::format(
+                         "Failed to open parameter block for process {}: {}\n",
+                         processID,
+                         why)
+                         .c_str());
+    return nullptr;
+  };
+
+  std::unique_ptr<ParameterBlock> ret {new ParameterBlock()};
+  ret->mMapping.reset(OpenFileMappingW(
+    FILE_MAP_READ | FILE_MAP_WRITE,
+    FALSE,
+    GetMappingName(processID).c_str()));
+  if (!ret->mMapping) {
+    return fail("OpenFileMappingW() failed");
+  }
+  ret->mView.reset(static_cast<std::byte*>(MapViewOfFile(
+    ret->mMapping.get(), FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0)));
+  if (!ret->mView) {
+    return fail("MapViewOfFile() failed");
+  }
+  MEMORY_BASIC_INFORMATION info {};
+  if (!VirtualQuery(ret->mView.get(), &info, sizeof(info))) {
+    return fail("VirtualQuery() failed");
+  }
+  if (info.RegionSize < sizeof(SharedHeader)) {
+    return fail("too small");
+  }
+
+  const auto header = reinterpret_cast<SharedHeader*>(ret->mView.get());
+  const SharedHeader expected;
+  if (memcmp(header->mMagic, expected.mMagic, sizeof(header->mMagic)) != 0) {
+    return fail("bad magic");
+  }
+  if (header->mVersion != Version) {
+    return fail(std::format("unsupported version {}", header->mVersion));
+  }
+  if (
+    sizeof(SharedHeader) + (header->mCount * sizeof(SharedParameter))
+    > info.RegionSize) {
+    return fail("truncated");
+  }
+
+  ret->mHeader = header;
+  ret->mParameters = {
+    reinterpret_cast<SharedParameter*>(
+      ret->mView.get() + sizeof(SharedHeader)),
+    header->mCount,
+  };
+  ret->Poll();
+  return ret;
+}
+
+ParameterBlock::~ParameterBlock() = default;
+
+bool ParameterBlock::Poll() {
+  const auto begin = mHeader->mSequence.load(std::memory_order_acquire);
+  if (begin == mLastSequence || (begin & 1)) {
+    return false;
+  }
+
+  mPolled.resize(mParameters.size());
+  for (size_t i = 0; i < mParameters.size(); ++i) {
+    mPolled[i] = mParameters[i].mValue.load(std::memory_order_relaxed);
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (mHeader->mSequence.load(std::memory_order_relaxed) != begin) {
+    // A writer started while we were copying; try again next frame
+    mLastSequence = ~0ull;
+    return false;
+  }
+  mLastSequence = begin;
+
+  if (mDefinitions.empty()) {
+    mValues = mPolled;
+    return true;
+  }
+  for (size_t i = 0; i < mDefinitions.size(); ++i) {
+    const auto& definition = mDefinitions.at(i);
+    const auto value = mPolled.at(i);
+    if (!IsValid(definition.mType, value, definition.mMin, definition.mMax)) {
+      OutputDebugStringA(
+        std::format("Ignoring invalid value {} for parameter {}\n", value, i)
+          .c_str());
+      continue;
+    }
+    mValues.at(i) = value;
+  }
+  return true;
+}
+
+double ParameterBlock::GetValue(size_t index) const noexcept {
+  return mValues.at(index);
+}
+
+std::vector<ParameterBlock::Parameter> ParameterBlock::GetParameters() const {
+  std::vector<Parameter> ret;
+  ret.reserve(mParameters.size());
+  for (const auto& it: mParameters) {
+    ret.push_back({
+      .mName = std::string {it.mName, strnlen(it.mName, sizeof(it.mName))},
+      .mType = it.mType,
+      .mValue = it.mValue.load(std::memory_order_relaxed),
+      .mDefault = it.mDefault,
+      .mMin = it.mMin,
+      .mMax = it.mMax,
+    });
+  }
+  return ret;
+}
+
+bool ParameterBlock::SetValue(std::string_view name, double value) {
+  const auto it = std::ranges::find_if(
+    mParameters, [name](const SharedParameter& parameter) {
+      return name == std::string_view {
+               parameter.mName,
+               strnlen(parameter.mName, sizeof(parameter.mName))};
+    });
+  if (it == mParameters.end()) {
+    return false;
+  }
+  if (!IsValid(it->mType, value, it->mMin, it->mMax)) {
+    return false;
+  }
+
+  // Take the 'lock' by making the sequence odd
+  auto sequence = mHeader->mSequence.load(std::memory_order_relaxed);
+  while ((sequence & 1)
+         || !mHeader->mSequence.compare_exchange_weak(
+           sequence, sequence + 1, std::memory_order_relaxed)) {
+    if (sequence & 1) {
+      std::this_thread::yield();
+      sequence = mHeader->mSequence.load(std::memory_order_relaxed);
+    }
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  it->mValue.store(value, std::memory_order_relaxed);
+  mHeader->mSequence.store(sequence + 2, std::memory_order_release);
+  return true;
+}
+
+std::string_view ParameterBlock::GetTypeName(Type type) noexcept {
+  switch (type) {
+    case Type::Integer:
+      return "integer";
+    case Type::Float:
+      return "float";
+    case Type::Boolean:
+      return "boolean";
+  }
+  return "unknown";
+}
+
+std::string ParameterBlock::FormatValue(Type type, double value) {
+  switch (type) {
+    case Type::Integer:
+      return std::format("{}", static_cast<int64_t>(value));
+    case Type::Float:
+      return std::format("{}", value);
+    case Type::Boolean:
+      return value ? "true" : "false";
+  }
+  return {};
+}
+
+std::optional<double> ParameterBlock::ParseValue(
+  Type type,
+  std::string_view text) {
+  const auto end = text.data() + text.size();
+  switch (type) {
+    case Type::Integer: {
+      int64_t value {};
+      const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+      if (ec != std::errc {} || ptr != end) {
+        return std::nullopt;
+      }
+      return static_cast<double>(value);
+    }
+    case Type::Float: {
+      double value {};
+      const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+      if (ec != std::errc {} || ptr != end) {
+        return std::nullopt;
+      }
+      return value;
+    }
+    case Type::Boolean:
+      if (text == "true" || text == "1" || text == "on") {
+        return 1.0;
+      }
+      if (text == "false" || text == "0" || text == "off") {
+        return 0.0;
+      }
+      return std::nullopt;
+  }
+  return std::nullopt;
+}
+
+std::wstring ParameterBlock::GetMappingName(DWORD processID) {
+  return std::format(L"Local\\HelloSkia-Parameters-{}", processID);
+}
+
+bool ParameterBlock::IsValid(
+  Type type,
+  double value,
+  double min,
+  double max) {
+  if (!std::isfinite(value) || value < min || value > max) {
+    return false;
+  }
+  switch (type) {
+    case Type::Integer:
+      return value == std::trunc(value);
+    case Type::Float:
+      return true;
+    case Type::Boolean:
+      return value == 0 || value == 1;
+  }
+  return false;
+}
@@ -0,0 +1,140 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <Windows.h>
+#include <wil/resource.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/** Typed parameters in shared memory, so they can be changed while running.
+ *
+ * The process being tuned calls `Create()` and polls once per frame; other
+ * processes - e.g. `HelloSkia-Parameters` - call `Open()` and `SetValue()`.
+ *
+ * The block is protected by a seqlock: writers make the sequence number odd
+ * while they update values, and readers retry - or rather, as readers poll
+ * every frame, keep their previous values until the next frame - if it was
+ * odd or changed while they copied. Readers never take a lock or make a
+ * system call, and polling is a single atomic load when nothing changed.
+ *
+ * Values are doubles; the type controls parsing, formatting, and
+ * validation.
+ *
+ * Any process in the session can write to the block, so `Poll()` validates
+ * values against the definitions passed to `Create()` - not against the
+ * ranges in shared memory - and keeps the previous value for any that are
+ * invalid.
+ */
+class ParameterBlock final {
+ public:
+  enum class Type : uint32_t {
+    Integer,
+    Float,
+    Boolean,
+  };
+
+  static constexpr size_t MaxNameLength = 47;
+
+  struct Definition {
+    std::string_view mName;
+    Type mType {Type::Integer};
+    double mDefault {};
+    double mMin {};
+    double mMax {};
+  };
+
+  struct Parameter {
+    std::string mName;
+    Type mType {Type::Integer};
+    double mValue {};
+    double mDefault {};
+    double mMin {};
+    double mMax {};
+  };
+
+  /// `nullptr` if the block can't be created, e.g. an invalid definition
+  static std::unique_ptr<ParameterBlock> Create(
+    DWORD processID,
+    std::span<const Definition>);
+  /// `nullptr` if `processID` hasn't created a compatible block
+  static std::unique_ptr<ParameterBlock> Open(DWORD processID);
+
+  ~ParameterBlock();
+  ParameterBlock(const ParameterBlock&) = delete;
+  ParameterBlock(ParameterBlock&&) = delete;
+  ParameterBlock& operator=(const ParameterBlock&) = delete;
+  ParameterBlock& operator=(ParameterBlock&&) = delete;
+
+  /** Updates the values returned by `GetValue()`.
+   *
+   * Returns true if any value changed since the last successful poll;
+   * call at a frame boundary, and apply changes if it returns true. Values
+   * are always within the range of their definition.
+   */
+  bool Poll();
+  /// The value as of the last successful `Poll()`, by definition index
+  [[nodiscard]] double GetValue(size_t index) const noexcept;
+
+  /// Reads the current values from shared memory
+  [[nodiscard]] std::vector<Parameter> GetParameters() const;
+  /// False if there's no such parameter, or `value` is invalid for it
+  bool SetValue(std::string_view name, double value);
+
+  [[nodiscard]] static std::string_view GetTypeName(Type) noexcept;
+  [[nodiscard]] static std::string FormatValue(Type, double);
+  [[nodiscard]] static std::optional<double> ParseValue(
+    Type,
+    std::string_view);
+
+ private:
+  static constexpr uint32_t Version = 1;
+
+  // Shared memory layout: SharedHeader, SharedParameter[mCount]
+  struct SharedHeader {
+    char mMagic[4] {'H', 'S', 'P', 'B'};
+    uint32_t mVersion {Version};
+    uint32_t mCount {};
+    uint32_t mReserved {};
+    // Odd while a writer is updating values
+    std::atomic<uint64_t> mSequence {};
+  };
+  // Only `mValue` changes after `Create()`
+  struct SharedParameter {
+    char mName[MaxNameLength + 1] {};
+    Type mType {Type::Integer};
+    uint32_t mReserved {};
+    double mDefault {};
+    double mMin {};
+    double mMax {};
+    std::atomic<double> mValue {};
+  };
+  static_assert(std::atomic<uint64_t>::is_always_lock_free);
+  static_assert(std::atomic<double>::is_always_lock_free);
+
+  ParameterBlock() = default;
+
+  wil::unique_handle mMapping;
+  wil::unique_mapview_ptr<std::byte> mView;
+  SharedHeader* mHeader {nullptr};
+  std::span<SharedParameter> mParameters;
+
+  // Reader state
+  uint64_t mLastSequence {~0ull};
+  std::vector<double> mValues;
+  // Copied by `Poll()` before validation
+  std::vector<double> mPolled;
+  // From `Create()`; empty for `Open()`, which is only used to write
+  std::vector<Definition> mDefinitions;
+
+  [[nodiscard]] static std::wstring GetMappingName(DWORD processID);
+  [[nodiscard]] static bool IsValid(Type, double value, double min, double max);
+};
@@ -0,0 +1,87 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "ParameterBlock.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <iostream>
+#include <string_view>
+
+namespace {
+
+void PrintParameter(const ParameterBlock::Parameter& it) {
+  using PB = ParameterBlock;
+  std::cout << std::format(
+    "{} = {} ({}, default {}, range [{}, {}])\n",
+    it.mName,
+    PB::FormatValue(it.mType, it.mValue),
+    PB::GetTypeName(it.mType),
+    PB::FormatValue(it.mType, it.mDefault),
+    PB::FormatValue(it.mType, it.mMin),
+    PB::FormatValue(it.mType, it.mMax));
+}
+
+}// namespace
+
+int main(int argc, char** argv) {
+  DWORD processID {};
+  if (argc < 2 || argc > 4) {
+    std::cerr << std::format("Usage: {} PID [NAME [VALUE]]\n", argv[0]);
+    return 1;
+  }
+  {
+    const std::string_view arg {argv[1]};
+    const auto end = arg.data() + arg.size();
+    const auto [ptr, ec] = std::from_chars(arg.data(), end, processID);
+    if (ec != std::errc {} || ptr != end) {
+      std::cerr << std::format("Invalid process ID '{}'\n", arg);
+      return 1;
+    }
+  }
+
+  const auto block = ParameterBlock::Open(processID);
+  if (!block) {
+    std::cerr << std::format(
+      "Process {} does not have a compatible parameter block\n", processID);
+    return 1;
+  }
+
+  const auto parameters = block->GetParameters();
+  if (argc == 2) {
+    for (const auto& it: parameters) {
+      PrintParameter(it);
+    }
+    return 0;
+  }
+
+  const std::string_view name {argv[2]};
+  const auto it = std::ranges::find(
+    parameters, name, &ParameterBlock::Parameter::mName);
+  if (it == parameters.end()) {
+    std::cerr << std::format("No parameter named '{}'\n", name);
+    return 1;
+  }
+  if (argc == 3) {
+    PrintParameter(*it);
+    return 0;
+  }
+
+  const std::string_view text {argv[3]};
+  const auto value = ParameterBlock::ParseValue(it->mType, text);
+  if (!value || !block->SetValue(name, *value)) {
+    std::cerr << std::format(
+      "'{}' is not a valid {} for {}\n",
+      text,
+      ParameterBlock::GetTypeName(it->mType),
+      name);
+    return 1;
+  }
+  std::cout << std::format(
+    "{}: {} -> {}\n",
+    name,
+    ParameterBlock::FormatValue(it->mType, it->mValue),
+    ParameterBlock::FormatValue(it->mType, *value));
+  return 0;
+}
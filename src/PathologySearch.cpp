@@ -0,0 +1,481 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "PathologySearch.hpp"
+
+#include "HashCombine.hpp"
+#include "SeededRandom.hpp"
+
+#include <skia/core/SkGraphics.h>
+#include <skia/core/SkPictureRecorder.h>
+#include <skia/core/SkStream.h>
+#include <skia/effects/SkDashPathEffect.h>
+#include <skia/effects/SkImageFilters.h>
+
+#include <algorithm>
+#include <format>
+#include <unordered_set>
+
+namespace {
+
+using Parameters = PathologySearch::Parameters;
+
+constexpr size_t MaxElementCount = 1024;
+constexpr size_t MaxPathPoints = 100'000;
+
+/// Aborts playback once the frame has taken too long
+class Deadline final : public SkPicture::AbortCallback {
+ public:
+  explicit Deadline(std::chrono::steady_clock::time_point deadline)
+    : mDeadline(deadline) {
+  }
+
+  bool abort() override {
+    return std::chrono::steady_clock::now() > mDeadline;
+  }
+
+ private:
+  std::chrono::steady_clock::time_point mDeadline;
+};
+
+SkPath MakePath(
+  SeededRandom& random,
+  const SkRect& bounds,
+  size_t points,
+  bool degenerate) {
+  const auto nextPoint = [&]() {
+    const auto x = random.Next(bounds.left(), bounds.right());
+    const auto y = random.Next(bounds.top(), bounds.bottom());
+    return SkPoint {x, y};
+  };
+
+  SkPath path;
+  SkPoint last = nextPoint();
+  path.moveTo(last);
+  for (size_t i = 1; i < points; ++i) {
+    if (degenerate && random.Next() < 0.5f) {
+      // Zero-length segment
+      path.lineTo(last);
+      continue;
+    }
+    last = nextPoint();
+    if (degenerate && random.Next() < 0.01f) {
+      last = {last.x() * 1e6f, last.y() * 1e6f};
+    }
+    path.lineTo(last);
+  }
+  path.close();
+  return path;
+}
+
+/// Which parameters differ from the defaults
+size_t GetSignature(const Parameters& params) {
+  const Parameters defaults;
+  size_t seed {};
+  HashCombine(seed, params.mElementCount != defaults.mElementCount);
+  HashCombine(seed, params.mScale != defaults.mScale);
+  HashCombine(seed, params.mBlurSigma != defaults.mBlurSigma);
+  HashCombine(seed, params.mSaveLayerDepth != defaults.mSaveLayerDepth);
+  HashCombine(seed, params.mPathPoints != defaults.mPathPoints);
+  HashCombine(seed, params.mDegeneratePaths != defaults.mDegeneratePaths);
+  HashCombine(seed, params.mStrokeWidth != defaults.mStrokeWidth);
+  HashCombine(seed, params.mDashedStrokes != defaults.mDashedStrokes);
+  HashCombine(seed, params.mClipPathPoints != defaults.mClipPathPoints);
+  return seed;
+}
+
+size_t GetHash(const Parameters& params) {
+  size_t seed {};
+  HashCombine(seed, params.mSeed);
+  HashCombine(seed, params.mElementCount);
+  HashCombine(seed, params.mScale);
+  HashCombine(seed, params.mBlurSigma);
+  HashCombine(seed, params.mSaveLayerDepth);
+  HashCombine(seed, params.mPathPoints);
+  HashCombine(seed, params.mDegeneratePaths);
+  HashCombine(seed, params.mStrokeWidth);
+  HashCombine(seed, params.mDashedStrokes);
+  HashCombine(seed, params.mClipPathPoints);
+  return seed;
+}
+
+/// In `[min, max]`
+size_t NextInRange(SeededRandom& random, size_t min, size_t max) {
+  return min + random.NextIndex(max - min + 1);
+}
+
+Parameters MakeRandomParameters(SeededRandom& random) {
+  const auto enabled = [&]() { return random.Next() < 0.3f; };
+
+  Parameters ret {
+    .mSeed = random.NextUInt64(),
+    .mElementCount = NextInRange(random, 1, 256),
+    .mScale = random.Next(0.05f, 1),
+  };
+  if (enabled()) {
+    ret.mBlurSigma = random.Next(1, 100);
+  }
+  if (enabled()) {
+    ret.mSaveLayerDepth = NextInRange(random, 1, 16);
+  }
+  if (enabled()) {
+    ret.mPathPoints = NextInRange(random, 3, 1000);
+  }
+  if (enabled()) {
+    ret.mDegeneratePaths = random.Next();
+  }
+  if (enabled()) {
+    ret.mStrokeWidth = random.Next(0.5f, 50);
+  }
+  if (enabled()) {
+    ret.mDashedStrokes = random.Next();
+  }
+  if (enabled()) {
+    ret.mClipPathPoints = NextInRange(random, 3, 100);
+  }
+  return ret;
+}
+
+/// Changes one parameter
+Parameters Mutate(SeededRandom& random, Parameters params) {
+  const auto factor = [&]() { return random.Next(0.5f, 4); };
+  const auto grow = [&]() { return random.Next() < 0.5f; };
+  const auto resize = [&](size_t value, size_t min, size_t max) {
+    return std::clamp<size_t>(grow() ? value * 2 : value / 2, min, max);
+  };
+
+  switch (random.NextIndex(10)) {
+    case 0:
+      params.mSeed = random.NextUInt64();
+      break;
+    case 1:
+      params.mElementCount
+        = resize(params.mElementCount, 1, MaxElementCount);
+      break;
+    case 2:
+      params.mScale
+        = std::clamp<SkScalar>(params.mScale * factor(), 0.01f, 4);
+      break;
+    case 3:
+      params.mBlurSigma = params.mBlurSigma
+        ? std::min<SkScalar>(params.mBlurSigma * factor(), 500)
+        : 4;
+      break;
+    case 4:
+      params.mSaveLayerDepth = grow()
+        ? std::min<size_t>(params.mSaveLayerDepth + 4, 64)
+        : params.mSaveLayerDepth / 2;
+      break;
+    case 5:
+      params.mPathPoints = resize(params.mPathPoints, 2, MaxPathPoints);
+      break;
+    case 6:
+      params.mDegeneratePaths = random.Next();
+      break;
+    case 7:
+      params.mStrokeWidth = params.mStrokeWidth
+        ? std::min<SkScalar>(params.mStrokeWidth * factor(), 500)
+        : 1;
+      break;
+    case 8:
+      params.mDashedStrokes = random.Next();
+      break;
+    case 9:
+      params.mClipPathPoints = params.mClipPathPoints
+        ? resize(params.mClipPathPoints, 3, MaxPathPoints)
+        : 8;
+      break;
+  }
+  return params;
+}
+
+sk_sp<SkPicture> Flatten(
+  std::span<const sk_sp<SkPicture>> elements,
+  const SkISize& size) {
+  SkPictureRecorder recorder;
+  const auto canvas = recorder.beginRecording(SkRect::Make(size));
+  for (const auto& element: elements) {
+    element->playback(canvas);
+  }
+  return recorder.finishRecordingAsPicture();
+}
+
+}// namespace
+
+PathologySearch::PathologySearch(
+  std::string_view backendName,
+  SkSurface* surface,
+  GrDirectContext* context)
+  : mBackendName(backendName),
+    mSurface(surface),
+    mContext(context) {
+}
+
+std::string_view PathologySearch::GetName(Objective objective) {
+  switch (objective) {
+    case Objective::FrameTime:
+      return "time";
+    case Objective::Memory:
+      return "memory";
+  }
+  return "unknown";
+}
+
+std::vector<sk_sp<SkPicture>> PathologySearch::Generate(
+  const Parameters& params,
+  const SkISize& size) {
+  SeededRandom random {params.mSeed};
+
+  const auto maxExtent = params.mScale * std::max(size.width(), size.height());
+  const auto bounds = SkRect::Make(size);
+  const auto blur = params.mBlurSigma > 0
+    ? SkImageFilters::Blur(params.mBlurSigma, params.mBlurSigma, nullptr)
+    : nullptr;
+  const SkScalar dashIntervals[] {2, 2};
+  const auto dash = SkDashPathEffect::Make(dashIntervals, 2, 0);
+
+  SkPaint layerPaint;
+  layerPaint.setAlphaf(0.9f);
+
+  std::vector<sk_sp<SkPicture>> ret;
+  const auto elementCount = std::min(params.mElementCount, MaxElementCount);
+  ret.reserve(elementCount);
+  for (size_t i = 0; i < elementCount; ++i) {
+    const auto x = random.Next(0, size.width());
+    const auto y = random.Next(0, size.height());
+    const auto width = maxExtent * random.Next(0.2f, 1);
+    const auto height = maxExtent * random.Next(0.2f, 1);
+    const auto rect = SkRect::MakeXYWH(x, y, width, height);
+
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    paint.setColor(SkColorSetA(random.NextColor(), 0xc0));
+    paint.setImageFilter(blur);
+    if (params.mStrokeWidth > 0) {
+      paint.setStyle(SkPaint::kStroke_Style);
+      paint.setStrokeWidth(params.mStrokeWidth);
+      paint.setStrokeCap(SkPaint::kRound_Cap);
+      if (random.Next() < params.mDashedStrokes) {
+        paint.setPathEffect(dash);
+      }
+    }
+
+    SkPictureRecorder recorder;
+    const auto canvas = recorder.beginRecording(bounds);
+    canvas->save();
+    if (params.mClipPathPoints > 0) {
+      canvas->clipPath(
+        MakePath(
+          random,
+          rect,
+          std::min(params.mClipPathPoints, MaxPathPoints),
+          false),
+        true);
+    } else {
+      canvas->clipRect(rect.makeOutset(maxExtent, maxExtent));
+    }
+    for (size_t layer = 0; layer < params.mSaveLayerDepth; ++layer) {
+      canvas->saveLayer(nullptr, &layerPaint);
+    }
+    canvas->drawPath(
+      MakePath(
+        random,
+        rect,
+        std::clamp<size_t>(params.mPathPoints, 2, MaxPathPoints),
+        random.Next() < params.mDegeneratePaths),
+      paint);
+    for (size_t layer = 0; layer < params.mSaveLayerDepth; ++layer) {
+      canvas->restore();
+    }
+    canvas->restore();
+    ret.push_back(recorder.finishRecordingAsPicture());
+  }
+  return ret;
+}
+
+void PathologySearch::DrawFrame(
+  std::span<const sk_sp<SkPicture>> elements) const {
+  Deadline deadline {std::chrono::steady_clock::now() + MaxFrameTime};
+  auto canvas = mSurface->getCanvas();
+  canvas->clear(SK_ColorBLACK);
+  for (const auto& element: elements) {
+    if (deadline.abort()) {
+      break;
+    }
+    element->playback(canvas, &deadline);
+  }
+  if (mContext) {
+    mContext->flushAndSubmit(mSurface, GrSyncCpu::kYes);
+  }
+}
+
+double PathologySearch::Measure(
+  Objective objective,
+  std::span<const sk_sp<SkPicture>> elements) const {
+  if (objective == Objective::Memory) {
+    SkGraphics::PurgeAllCaches();
+    if (mContext) {
+      mContext->freeGpuResources();
+    }
+    this->DrawFrame(elements);
+    auto bytes = SkGraphics::GetResourceCacheTotalBytesUsed()
+      + SkGraphics::GetFontCacheUsed();
+    if (mContext) {
+      size_t gpuBytes {};
+      mContext->getResourceCacheUsage(nullptr, &gpuBytes);
+      bytes += gpuBytes;
+    }
+    return static_cast<double>(bytes);
+  }
+
+  // Median of a few frames, after a warmup frame
+  static constexpr size_t FrameCount = 5;
+  this->DrawFrame(elements);
+  std::vector<double> times;
+  for (size_t i = 0; i < FrameCount; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    this->DrawFrame(elements);
+    times.push_back(std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - start)
+                      .count());
+    if (times.back() >= MaxFrameTime.count()) {
+      break;
+    }
+  }
+  std::ranges::sort(times);
+  return times.at(times.size() / 2);
+}
+
+PathologySearch::Parameters PathologySearch::Minimize(
+  const Options& options,
+  const Parameters& params,
+  double target) const {
+  const auto size = mSurface->imageInfo().dimensions();
+  const auto reproduces = [&](const Parameters& candidate) {
+    return this->Measure(options.mObjective, Generate(candidate, size))
+      >= target;
+  };
+
+  const Parameters defaults;
+  auto ret = params;
+  const auto tryReset = [&](auto member) {
+    if (ret.*member == defaults.*member) {
+      return;
+    }
+    auto candidate = ret;
+    candidate.*member = defaults.*member;
+    if (reproduces(candidate)) {
+      ret = candidate;
+    }
+  };
+  tryReset(&Parameters::mBlurSigma);
+  tryReset(&Parameters::mSaveLayerDepth);
+  tryReset(&Parameters::mPathPoints);
+  tryReset(&Parameters::mDegeneratePaths);
+  tryReset(&Parameters::mStrokeWidth);
+  tryReset(&Parameters::mDashedStrokes);
+  tryReset(&Parameters::mClipPathPoints);
+  tryReset(&Parameters::mScale);
+  return ret;
+}
+
+std::vector<sk_sp<SkPicture>> PathologySearch::MinimizeElements(
+  const Options& options,
+  std::vector<sk_sp<SkPicture>> elements,
+  double target) const {
+  // Remove runs of elements, halving the run length each pass
+  for (auto chunk = elements.size() / 2; chunk > 0; chunk /= 2) {
+    for (size_t begin = 0; begin < elements.size() && elements.size() > 1;) {
+      const auto end = std::min(begin + chunk, elements.size());
+      std::vector<sk_sp<SkPicture>> candidate;
+      candidate.reserve(elements.size() - (end - begin));
+      candidate.insert(
+        candidate.end(), elements.begin(), elements.begin() + begin);
+      candidate.insert(candidate.end(), elements.begin() + end, elements.end());
+      if (
+        !candidate.empty()
+        && this->Measure(options.mObjective, candidate) >= target) {
+        elements = std::move(candidate);
+      } else {
+        begin = end;
+      }
+    }
+  }
+  return elements;
+}
+
+std::vector<PathologySearch::Finding> PathologySearch::Run(
+  const Options& options,
+  const ProgressCallback& onFinding) {
+  static constexpr size_t PopulationSize = 8;
+
+  const auto size = mSurface->imageInfo().dimensions();
+  const auto baseline
+    = this->Measure(options.mObjective, Generate(Parameters {}, size));
+  const auto target = baseline * options.mThreshold;
+
+  SeededRandom random {options.mSeed};
+
+  struct Candidate {
+    Parameters mParameters;
+    double mScore {};
+  };
+  // Worst-first
+  std::vector<Candidate> population;
+  std::unordered_set<size_t> signatures;
+  std::vector<Finding> findings;
+
+  for (size_t i = 0; i < options.mIterations; ++i) {
+    auto params = (population.empty() || random.Next() < 0.3f)
+      ? MakeRandomParameters(random)
+      : Mutate(
+          random,
+          population.at(random.NextIndex(population.size())).mParameters);
+    const auto score
+      = this->Measure(options.mObjective, Generate(params, size));
+
+    population.push_back({params, score});
+    std::ranges::sort(population, std::ranges::greater {}, &Candidate::mScore);
+    if (population.size() > PopulationSize) {
+      population.pop_back();
+    }
+
+    if (score < target) {
+      continue;
+    }
+    params = this->Minimize(options, params, target);
+    if (!signatures.insert(GetSignature(params)).second) {
+      continue;
+    }
+
+    const auto elements
+      = this->MinimizeElements(options, Generate(params, size), target);
+    Finding finding {
+      .mParameters = params,
+      .mScore = this->Measure(options.mObjective, elements),
+      .mBaseline = baseline,
+      .mElementCount = elements.size(),
+      .mPath = options.mCorpusDirectory
+        / std::format(
+                 "{}-{}-{:016x}.skp",
+                 mBackendName,
+                 GetName(options.mObjective),
+                 GetHash(params)),
+    };
+
+    // `string()` is in the active code page; Skia's Windows file functions
+    // expect UTF-8
+    const std::string utf8Path {
+      reinterpret_cast<const char*>(finding.mPath.u8string().c_str())};
+    SkFILEWStream stream(utf8Path.c_str());
+    if (!stream.isValid()) {
+      continue;
+    }
+    Flatten(elements, size)->serialize(&stream);
+    if (onFinding) {
+      onFinding(finding);
+    }
+    findings.push_back(std::move(finding));
+  }
+  return findings;
+}
@@ -0,0 +1,125 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkPicture.h>
+#include <skia/core/SkSurface.h>
+#include <skia/gpu/GrDirectContext.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/** Searches for scenes that are pathologically slow, or use a lot of memory.
+ *
+ * Scenes are generated from `Parameters`, which cover draw patterns that have
+ * been slow in practice: large blurs, nested save layers, complex or
+ * degenerate paths, dashed strokes, and path clips. Candidates are either
+ * random, or mutations of the worst candidates found so far. The same
+ * `Parameters` - and the same `Options::mSeed` - give the same scenes on any
+ * platform, as with `SyntheticScene`.
+ *
+ * A candidate is a finding if its score is at least `mThreshold` times the
+ * score of the default parameters. Each finding is minimized - first by
+ * resetting every parameter that isn't needed to reproduce it, then by
+ * removing elements - and written to the corpus directory as an `.skp`.
+ * Only one finding is written for each combination of non-default
+ * parameters.
+ */
+class PathologySearch final {
+ public:
+  enum class Objective {
+    FrameTime,
+    // Skia's resource and font caches, and the GPU resource cache
+    Memory,
+  };
+
+  struct Parameters {
+    uint64_t mSeed {};
+    size_t mElementCount {16};
+    // Element size, relative to the surface
+    SkScalar mScale {0.25f};
+    // 0 for no blur
+    SkScalar mBlurSigma {};
+    // Unbounded save layers around each element
+    size_t mSaveLayerDepth {};
+    size_t mPathPoints {4};
+    // The fraction of paths with zero-length segments and distant points
+    float mDegeneratePaths {};
+    // 0 for fills
+    SkScalar mStrokeWidth {};
+    // The fraction of strokes that are dashed
+    float mDashedStrokes {};
+    // 0 for rect clips
+    size_t mClipPathPoints {};
+
+    bool operator==(const Parameters&) const noexcept = default;
+  };
+
+  struct Options {
+    Objective mObjective {Objective::FrameTime};
+    size_t mIterations {200};
+    uint64_t mSeed {};
+    double mThreshold {10};
+    std::filesystem::path mCorpusDirectory;
+  };
+
+  struct Finding {
+    Parameters mParameters;
+    // Milliseconds for `FrameTime`, bytes for `Memory`
+    double mScore {};
+    double mBaseline {};
+    size_t mElementCount {};
+    std::filesystem::path mPath;
+  };
+
+  using ProgressCallback = std::function<void(const Finding&)>;
+
+  /// `context` is `nullptr` for raster surfaces
+  PathologySearch(
+    std::string_view backendName,
+    SkSurface*,
+    GrDirectContext* context);
+  PathologySearch(const PathologySearch&) = delete;
+  PathologySearch(PathologySearch&&) = delete;
+  PathologySearch& operator=(const PathologySearch&) = delete;
+  PathologySearch& operator=(PathologySearch&&) = delete;
+
+  /// `onFinding` is called after each finding is written
+  std::vector<Finding> Run(const Options&, const ProgressCallback& onFinding);
+
+  /// One picture per element, so that elements can be removed independently
+  [[nodiscard]] static std::vector<sk_sp<SkPicture>> Generate(
+    const Parameters&,
+    const SkISize&);
+
+  [[nodiscard]] static std::string_view GetName(Objective);
+
+ private:
+  // Frames that take longer than this are aborted, and scored as this
+  static constexpr std::chrono::milliseconds MaxFrameTime {2000};
+
+  std::string mBackendName;
+  SkSurface* mSurface {nullptr};
+  GrDirectContext* mContext {nullptr};
+
+  [[nodiscard]] double Measure(
+    Objective,
+    std::span<const sk_sp<SkPicture>>) const;
+  void DrawFrame(std::span<const sk_sp<SkPicture>>) const;
+
+  [[nodiscard]] Parameters Minimize(
+    const Options&,
+    const Parameters&,
+    double target) const;
+  [[nodiscard]] std::vector<sk_sp<SkPicture>> MinimizeElements(
+    const Options&,
+    std::vector<sk_sp<SkPicture>> elements,
+    double target) const;
+};
@@ -0,0 +1,114 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "PathologySearch.hpp"
+
+#include <skia/gpu/ganesh/SkSurfaceGanesh.h>
+
+#include <charconv>
+#include <format>
+#include <iostream>
+#include <string_view>
+#include <tuple>
+
+namespace {
+
+template <class T>
+bool ParseNumber(std::string_view text, T& value) {
+  const auto end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+  return ec == std::errc {} && ptr == end;
+}
+
+bool ParseArguments(int argc, char** argv, PathologySearch::Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg {argv[i]};
+    const auto equals = arg.find('=');
+    if (equals == std::string_view::npos) {
+      return false;
+    }
+    const auto name = arg.substr(0, equals);
+    const auto value = arg.substr(equals + 1);
+    if (name == "--objective" && value == "time") {
+      options.mObjective = PathologySearch::Objective::FrameTime;
+    } else if (name == "--objective" && value == "memory") {
+      options.mObjective = PathologySearch::Objective::Memory;
+    } else if (name == "--iterations") {
+      if (!ParseNumber(value, options.mIterations)) {
+        return false;
+      }
+    } else if (name == "--seed") {
+      if (!ParseNumber(value, options.mSeed)) {
+        return false;
+      }
+    } else if (name == "--threshold") {
+      if (!ParseNumber(value, options.mThreshold)) {
+        return false;
+      }
+    } else if (name == "--corpus") {
+      options.mCorpusDirectory = value;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+}// namespace
+
+int main(int argc, char** argv) {
+  PathologySearch::Options options {.mCorpusDirectory = "pathologies"};
+  if (!ParseArguments(argc, argv, options)) {
+    std::cerr << std::format(
+      "Usage: {} [--objective=time|memory] [--iterations=N] [--seed=N] "
+      "[--threshold=X] [--corpus=DIRECTORY]\n",
+      argv[0]);
+    return 1;
+  }
+  std::filesystem::create_directories(options.mCorpusDirectory);
+
+  const auto info
+    = SkImageInfo::Make(1280, 720, kRGBA_8888_SkColorType, kPremul_SkAlphaType);
+  const auto rasterSurface = SkSurfaces::Raster(info);
+  const auto mockContext = GrDirectContext::MakeMock(nullptr);
+  const auto mockSurface
+    = SkSurfaces::RenderTarget(mockContext.get(), skgpu::Budgeted::kNo, info);
+
+  const auto printFinding = [](const PathologySearch::Finding& finding) {
+    const auto& params = finding.mParameters;
+    std::cout << std::format(
+      "{}: {:.1f}x baseline with {} elements (blur {}, save layers {}, "
+      "path points {}, degenerate {:.2f}, stroke {}, dashed {:.2f}, "
+      "clip path points {}, scale {:.2f})\n",
+      finding.mPath.filename().string(),
+      finding.mScore / finding.mBaseline,
+      finding.mElementCount,
+      params.mBlurSigma,
+      params.mSaveLayerDepth,
+      params.mPathPoints,
+      params.mDegeneratePaths,
+      params.mStrokeWidth,
+      params.mDashedStrokes,
+      params.mClipPathPoints,
+      params.mScale);
+  };
+
+  const std::tuple<std::string_view, SkSurface*, GrDirectContext*>
+    backends[] {
+      {"raster", rasterSurface.get(), nullptr},
+      {"mock", mockSurface.get(), mockContext.get()},
+    };
+  for (const auto& [name, surface, context]: backends) {
+    std::cout << std::format(
+      "## {}: searching for {} pathologies\n",
+      name,
+      PathologySearch::GetName(options.mObjective));
+    PathologySearch search {name, surface, context};
+    const auto findings = search.Run(options, printFinding);
+    std::cout << std::format(
+      "{} findings written to {}\n\n",
+      findings.size(),
+      options.mCorpusDirectory.string());
+  }
+  return 0;
+}
@@ -0,0 +1,400 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "PdfExporter.hpp"
+
+#include "HashCombine.hpp"
+
+#include <Windows.h>
+#include <skia/core/SkExecutor.h>
+#include <skia/core/SkPictureRecorder.h>
+#include <skia/core/SkStream.h>
+#include <skia/docs/SkPDFDocument.h>
+#include <skia/utils/SkPaintFilterCanvas.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <format>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+/* Maps images with identical content to a single `SkImage`.
+ *
+ * SkPDF writes each image once per unique ID; this lets images that were
+ * decoded or generated separately for each page share an ID too.
+ *
+ * Canonical images are kept alive so that later draws can be compared with
+ * them; to keep memory use independent of the page count, the least recently
+ * used are released when they exceed `maxBytes`. Releasing an image only
+ * loses deduplication: a later identical image is written again.
+ */
+class ImageDeduplicator final {
+ public:
+  explicit ImageDeduplicator(size_t maxBytes) : mMaxBytes(maxBytes) {
+  }
+
+  sk_sp<SkImage> GetCanonical(const SkImage* image, PdfExporter::Stats& stats) {
+    ++stats.mImageDraws;
+    if (const auto it = mByID.find(image->uniqueID()); it != mByID.end()) {
+      const auto canonical = it->second;
+      mLRU.splice(mLRU.begin(), mLRU, canonical);
+      if (canonical->mImage->uniqueID() != image->uniqueID()) {
+        ++stats.mImagesDeduplicated;
+      }
+      return canonical->mImage;
+    }
+
+    const auto content = GetContent(image);
+    const auto hash
+      = content ? std::optional {GetHash(image, *content)} : std::nullopt;
+    if (hash) {
+      const auto [first, last] = mByContent.equal_range(*hash);
+      for (auto it = first; it != last; ++it) {
+        const auto canonical = it->second;
+        if (IsSameContent(image, *content, canonical->mImage.get())) {
+          mLRU.splice(mLRU.begin(), mLRU, canonical);
+          canonical->mIDs.push_back(image->uniqueID());
+          mByID.emplace(image->uniqueID(), canonical);
+          ++stats.mImagesDeduplicated;
+          return canonical->mImage;
+        }
+      }
+    }
+
+    mLRU.push_front({
+      .mImage = sk_ref_sp(image),
+      .mHash = hash,
+      .mBytes = image->imageInfo().computeMinByteSize(),
+      .mIDs = {image->uniqueID()},
+    });
+    const auto canonical = mLRU.begin();
+    mByID.emplace(image->uniqueID(), canonical);
+    if (hash) {
+      mByContent.emplace(*hash, canonical);
+    }
+    mBytes += canonical->mBytes;
+    // Copy before evicting, as this image may be evicted too
+    auto ret = canonical->mImage;
+    while (mBytes > mMaxBytes && !mLRU.empty()) {
+      this->EvictOldest();
+      ++stats.mImagesReleased;
+    }
+    return ret;
+  }
+
+ private:
+  // Either the original encoded data, or raster pixels
+  struct Content {
+    sk_sp<SkData> mEncoded;
+    SkPixmap mPixels;
+  };
+
+  struct Canonical {
+    sk_sp<SkImage> mImage;
+    // `std::nullopt` if the content can't be read cheaply
+    std::optional<size_t> mHash;
+    size_t mBytes {};
+    // Every image that was mapped to this one, including itself; only a few
+    // bytes each, as the duplicates themselves are not kept alive
+    std::vector<uint32_t> mIDs;
+  };
+  using CanonicalIt = std::list<Canonical>::iterator;
+
+  size_t mMaxBytes {};
+  size_t mBytes {};
+  // Most recently used first
+  std::list<Canonical> mLRU;
+  std::unordered_map<uint32_t, CanonicalIt> mByID;
+  std::unordered_multimap<size_t, CanonicalIt> mByContent;
+
+  void EvictOldest() {
+    const auto oldest = std::prev(mLRU.end());
+    for (const auto id: oldest->mIDs) {
+      mByID.erase(id);
+    }
+    if (oldest->mHash) {
+      const auto [first, last] = mByContent.equal_range(*oldest->mHash);
+      const auto it = std::find_if(
+        first, last, [oldest](const auto& it) { return it.second == oldest; });
+      if (it != last) {
+        mByContent.erase(it);
+      }
+    }
+    mBytes -= oldest->mBytes;
+    mLRU.erase(oldest);
+  }
+
+  static std::optional<Content> GetContent(const SkImage* image) {
+    Content ret;
+    if (auto encoded = image->refEncodedData()) {
+      ret.mEncoded = std::move(encoded);
+      return ret;
+    }
+    // Texture-backed and lazily-generated images are not deduplicated, as
+    // reading them back would cost more than writing them twice
+    if (image->peekPixels(&ret.mPixels)) {
+      return ret;
+    }
+    return std::nullopt;
+  }
+
+  static std::string_view GetRow(const SkPixmap& pixels, int y) {
+    return {
+      reinterpret_cast<const char*>(pixels.addr8(0, y)),
+      pixels.info().minRowBytes()};
+  }
+
+  static size_t GetHash(const SkImage* image, const Content& content) {
+    size_t seed {};
+    HashCombine(seed, image->width());
+    HashCombine(seed, image->height());
+    if (content.mEncoded) {
+      HashCombine(
+        seed,
+        std::string_view {
+          static_cast<const char*>(content.mEncoded->data()),
+          content.mEncoded->size()});
+      return seed;
+    }
+    HashCombine(seed, static_cast<int>(content.mPixels.colorType()));
+    for (int y = 0; y < content.mPixels.height(); ++y) {
+      HashCombine(seed, GetRow(content.mPixels, y));
+    }
+    return seed;
+  }
+
+  static bool IsSameContent(
+    const SkImage* image,
+    const Content& content,
+    const SkImage* other) {
+    if (image->dimensions() != other->dimensions()) {
+      return false;
+    }
+    const auto otherContent = GetContent(other);
+    if (content.mEncoded) {
+      return otherContent && otherContent->mEncoded
+        && content.mEncoded->equals(otherContent->mEncoded.get());
+    }
+    if (!(otherContent && !otherContent->mEncoded)) {
+      return false;
+    }
+    const auto& pixels = content.mPixels;
+    const auto& otherPixels = otherContent->mPixels;
+    if (pixels.info() != otherPixels.info()) {
+      return false;
+    }
+    for (int y = 0; y < pixels.height(); ++y) {
+      if (GetRow(pixels, y) != GetRow(otherPixels, y)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/// Replaces every image drawn with its canonical equivalent
+class DeduplicatingCanvas final : public SkPaintFilterCanvas {
+ public:
+  DeduplicatingCanvas(
+    SkCanvas* canvas,
+    ImageDeduplicator* images,
+    PdfExporter::Stats* stats)
+    : SkPaintFilterCanvas(canvas),
+      mImages(images),
+      mStats(stats) {
+  }
+
+ protected:
+  bool onFilter(SkPaint&) const override {
+    return true;
+  }
+
+  void onDrawImage2(
+    const SkImage* image,
+    SkScalar x,
+    SkScalar y,
+    const SkSamplingOptions& sampling,
+    const SkPaint* paint) override {
+    const auto canonical = mImages->GetCanonical(image, *mStats);
+    SkPaintFilterCanvas::onDrawImage2(canonical.get(), x, y, sampling, paint);
+  }
+
+  void onDrawImageRect2(
+    const SkImage* image,
+    const SkRect& src,
+    const SkRect& dst,
+    const SkSamplingOptions& sampling,
+    const SkPaint* paint,
+    SrcRectConstraint constraint) override {
+    const auto canonical = mImages->GetCanonical(image, *mStats);
+    SkPaintFilterCanvas::onDrawImageRect2(
+      canonical.get(), src, dst, sampling, paint, constraint);
+  }
+
+ private:
+  ImageDeduplicator* mImages {nullptr};
+  PdfExporter::Stats* mStats {nullptr};
+};
+
+}// namespace
+
+std::optional<PdfExporter::Stats> PdfExporter::Export(
+  const std::filesystem::path& path,
+  size_t pageCount,
+  const DrawPageFn& drawPage,
+  const Options& options) {
+  // `string()` is in the active code page; Skia's Windows file functions
+  // expect UTF-8
+  const std::string utf8Path {
+    reinterpret_cast<const char*>(path.u8string().c_str())};
+  SkFILEWStream stream(utf8Path.c_str());
+  if (!stream.isValid()) {
+    OutputDebugStringA(
+      std::format("Failed to open `{}` for writing\n", utf8Path).c_str());
+    return std::nullopt;
+  }
+
+  const auto threads = options.mThreads
+    ? options.mThreads
+    // Leave a core for serialization
+    : std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1;
+  const auto maxInFlight = options.mMaxPagesInFlight
+    ? options.mMaxPagesInFlight
+    : threads * 2;
+
+  // Used by SkPDF to compress page content streams and images in parallel
+  const auto executor
+    = SkExecutor::MakeFIFOThreadPool(static_cast<int>(threads));
+  SkPDF::Metadata metadata;
+  metadata.fTitle = SkString(options.mTitle.c_str());
+  metadata.fCreator = SkString("HelloSkia");
+  metadata.fExecutor = executor.get();
+  const auto document = SkPDF::MakeDocument(&stream, metadata);
+  if (!document) {
+    return std::nullopt;
+  }
+
+  const auto pageRect = SkRect::MakeSize(options.mPageSize);
+
+  Stats stats {.mPages = pageCount};
+  std::mutex mutex;
+  std::condition_variable_any pageRecorded;
+  std::condition_variable_any pageSerialized;
+  size_t nextToRecord {};
+  size_t nextToSerialize {};
+  std::unordered_map<size_t, sk_sp<SkPicture>> recorded;
+  // Set if `drawPage` throws; stops both the workers and serialization
+  bool failed {false};
+
+  const auto recordPages = [&](std::stop_token stopToken) {
+    while (true) {
+      size_t pageIndex {};
+      {
+        std::unique_lock lock(mutex);
+        const auto canRecord
+          = pageSerialized.wait(lock, stopToken, [&]() {
+              return failed || nextToRecord >= pageCount
+                || nextToRecord < nextToSerialize + maxInFlight;
+            });
+        if (!(canRecord && !failed && nextToRecord < pageCount)) {
+          return;
+        }
+        pageIndex = nextToRecord++;
+      }
+
+      const auto start = std::chrono::steady_clock::now();
+      sk_sp<SkPicture> picture;
+      try {
+        SkPictureRecorder recorder;
+        drawPage(recorder.beginRecording(pageRect), pageIndex);
+        picture = recorder.finishRecordingAsPicture();
+      } catch (const std::exception& e) {
+        OutputDebugStringA(
+          std::format("Failed to draw PDF page {}: {}\n", pageIndex, e.what())
+            .c_str());
+      } catch (...) {
+        OutputDebugStringA(
+          std::format("Failed to draw PDF page {}\n", pageIndex).c_str());
+      }
+      if (!picture) {
+        {
+          std::unique_lock lock(mutex);
+          failed = true;
+        }
+        pageRecorded.notify_all();
+        pageSerialized.notify_all();
+        return;
+      }
+      const auto elapsed = std::chrono::steady_clock::now() - start;
+
+      {
+        std::unique_lock lock(mutex);
+        recorded.emplace(pageIndex, std::move(picture));
+        stats.mRecordTime += elapsed;
+        stats.mPeakPagesInFlight
+          = std::max(stats.mPeakPagesInFlight, recorded.size());
+      }
+      pageRecorded.notify_all();
+    }
+  };
+
+  std::vector<std::jthread> workers;
+  for (size_t i = 0; i < std::min(threads, pageCount); ++i) {
+    workers.emplace_back(recordPages);
+  }
+
+  ImageDeduplicator images {options.mMaxImageBytes};
+  for (size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex) {
+    sk_sp<SkPicture> picture;
+    {
+      std::unique_lock lock(mutex);
+      pageRecorded.wait(
+        lock, [&]() { return failed || recorded.contains(pageIndex); });
+      if (failed) {
+        break;
+      }
+      picture = std::move(recorded.at(pageIndex));
+      recorded.erase(pageIndex);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto canvas
+      = document->beginPage(pageRect.width(), pageRect.height(), &pageRect);
+    {
+      DeduplicatingCanvas dedup(canvas, &images, &stats);
+      picture->playback(&dedup);
+    }
+    // Writes the page to the stream; only shared resources such as fonts are
+    // kept until the document is closed
+    document->endPage();
+    picture.reset();
+    stats.mSerializeTime += std::chrono::steady_clock::now() - start;
+
+    {
+      std::unique_lock lock(mutex);
+      nextToSerialize = pageIndex + 1;
+    }
+    pageSerialized.notify_all();
+  }
+  workers.clear();
+  if (failed) {
+    document->abort();
+    return std::nullopt;
+  }
+
+  // Writes the subset fonts and cross-reference table
+  const auto start = std::chrono::steady_clock::now();
+  document->close();
+  stats.mSerializeTime += std::chrono::steady_clock::now() - start;
+  stream.flush();
+  stats.mBytesWritten = stream.bytesWritten();
+  return stats;
+}
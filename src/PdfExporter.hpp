@@ -0,0 +1,68 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkCanvas.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+
+/** Exports many pages to a PDF file with bounded memory use.
+ *
+ * Pages are recorded into `SkPicture`s by worker threads, and serialized into
+ * an `SkPDF` document in page order by the calling thread; each page is
+ * streamed to the file when it is finished. Memory use depends on
+ * `mMaxPagesInFlight` and `mMaxImageBytes` rather than on the number of
+ * pages, apart from SkPDF's per-object bookkeeping and font subsets.
+ *
+ * SkPDF embeds each typeface once, subset to the glyphs used on every page,
+ * and writes each `SkImage` once, keyed on its unique ID. Images that are
+ * drawn directly are also deduplicated by content while serializing, so
+ * identical images that were created separately for each page are only
+ * written once, as long as the first is within `mMaxImageBytes`. To share
+ * typefaces, draw every page with the same `SkTypeface` objects.
+ *
+ * `drawPage` is called concurrently from the worker threads.
+ */
+class PdfExporter final {
+ public:
+  using DrawPageFn = std::function<void(SkCanvas*, size_t pageIndex)>;
+
+  struct Options {
+    // Points; the default is US Letter
+    SkSize mPageSize {612, 792};
+    std::string mTitle;
+    // 0 picks a count based on the number of cores
+    size_t mThreads {};
+    // Recorded pages waiting to be serialized; 0 is twice `mThreads`
+    size_t mMaxPagesInFlight {};
+    // Images kept for deduplication; the least recently used are released
+    size_t mMaxImageBytes {64 * 1024 * 1024};
+  };
+
+  struct Stats {
+    size_t mPages {};
+    size_t mPeakPagesInFlight {};
+    size_t mImageDraws {};
+    // Image draws that reused an identical image from an earlier draw
+    size_t mImagesDeduplicated {};
+    // Released to stay within `mMaxImageBytes`
+    size_t mImagesReleased {};
+    size_t mBytesWritten {};
+    // Summed across worker threads
+    std::chrono::nanoseconds mRecordTime {};
+    std::chrono::nanoseconds mSerializeTime {};
+  };
+
+  /// `std::nullopt` if the file can't be written, or `drawPage` throws
+  static std::optional<Stats> Export(
+    const std::filesystem::path&,
+    size_t pageCount,
+    const DrawPageFn& drawPage,
+    const Options&);
+};
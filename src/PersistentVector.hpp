@@ -0,0 +1,146 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/** An immutable vector, where modified copies share unchanged structure.
+ *
+ * Elements are stored in a 32-way trie; `Set()` and `PushBack()` copy the
+ * path from the root to the changed leaf, and share everything else with
+ * the original, so the cost of an update is proportional to the size of
+ * the change, not the size of the vector.
+ *
+ * As nodes are immutable and reference-counted, a vector can be read by
+ * any number of threads while another thread builds modified copies.
+ */
+template <class T>
+class PersistentVector final {
+ public:
+  static constexpr size_t Bits = 5;
+  static constexpr size_t Width = 1 << Bits;
+  static constexpr size_t Mask = Width - 1;
+
+  PersistentVector() = default;
+
+  [[nodiscard]] size_t GetSize() const noexcept {
+    return mSize;
+  }
+
+  [[nodiscard]] const T& operator[](size_t index) const {
+    const Node* node = mRoot.get();
+    for (auto shift = mShift; shift > 0; shift -= Bits) {
+      node = node->mChildren[(index >> shift) & Mask].get();
+    }
+    return node->mValues[index & Mask];
+  }
+
+  /// Copies the nodes on the path to `index`, which must be in range
+  [[nodiscard]] PersistentVector Set(size_t index, T value) const {
+    auto ret = *this;
+    ret.mRoot = SetIn(mRoot, mShift, index, std::move(value));
+    return ret;
+  }
+
+  [[nodiscard]] PersistentVector PushBack(T value) const {
+    auto ret = *this;
+    ++ret.mSize;
+    if (!mRoot) {
+      ret.mRoot = NewPath(0, std::move(value));
+      return ret;
+    }
+    // Full; add a level
+    if (mSize == (size_t {1} << (mShift + Bits))) {
+      auto root = std::make_shared<Node>();
+      root->mChildren = {mRoot, NewPath(mShift, std::move(value))};
+      ret.mRoot = std::move(root);
+      ret.mShift += Bits;
+      return ret;
+    }
+    ret.mRoot = PushIn(mRoot, mShift, mSize, std::move(value));
+    return ret;
+  }
+
+  template <class F>
+  void ForEach(F&& f) const {
+    if (mRoot) {
+      ForEachIn(*mRoot, mShift, f);
+    }
+  }
+
+ private:
+  // Leaves have values, other nodes have children
+  struct Node {
+    std::vector<std::shared_ptr<const Node>> mChildren;
+    std::vector<T> mValues;
+  };
+  using NodePtr = std::shared_ptr<const Node>;
+
+  NodePtr mRoot;
+  size_t mSize {};
+  // Of the root; 0 if the root is a leaf
+  size_t mShift {};
+
+  static NodePtr SetIn(
+    const NodePtr& node,
+    size_t shift,
+    size_t index,
+    T value) {
+    auto copy = std::make_shared<Node>(*node);
+    const auto slot = (index >> shift) & Mask;
+    if (shift == 0) {
+      copy->mValues[slot] = std::move(value);
+    } else {
+      copy->mChildren[slot]
+        = SetIn(node->mChildren[slot], shift - Bits, index, std::move(value));
+    }
+    return copy;
+  }
+
+  static NodePtr PushIn(
+    const NodePtr& node,
+    size_t shift,
+    size_t index,
+    T value) {
+    auto copy = std::make_shared<Node>(*node);
+    if (shift == 0) {
+      copy->mValues.push_back(std::move(value));
+      return copy;
+    }
+    const auto slot = (index >> shift) & Mask;
+    if (slot < copy->mChildren.size()) {
+      copy->mChildren[slot]
+        = PushIn(node->mChildren[slot], shift - Bits, index, std::move(value));
+    } else {
+      copy->mChildren.push_back(NewPath(shift - Bits, std::move(value)));
+    }
+    return copy;
+  }
+
+  static NodePtr NewPath(size_t shift, T value) {
+    auto node = std::make_shared<Node>();
+    if (shift == 0) {
+      node->mValues.reserve(Width);
+      node->mValues.push_back(std::move(value));
+    } else {
+      node->mChildren.push_back(NewPath(shift - Bits, std::move(value)));
+    }
+    return node;
+  }
+
+  template <class F>
+  static void ForEachIn(const Node& node, size_t shift, F& f) {
+    if (shift == 0) {
+      for (const auto& value: node.mValues) {
+        f(value);
+      }
+      return;
+    }
+    for (const auto& child: node.mChildren) {
+      ForEachIn(*child, shift - Bits, f);
+    }
+  }
+};
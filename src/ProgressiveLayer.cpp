@@ -0,0 +1,106 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "ProgressiveLayer.hpp"
+
+#include <utility>
+
+ProgressiveLayer::ProgressiveLayer(
+  GrDirectContext* context,
+  SkSurface* compatible,
+  const SkISize& size,
+  const Options& options)
+  : mContext(context),
+    mOptions(options),
+    mColumns((size.width() + options.mTileSize - 1) / options.mTileSize),
+    mRows((size.height() + options.mTileSize - 1) / options.mTileSize) {
+  const auto info = compatible->imageInfo().makeWH(size.width(), size.height());
+  mFront = compatible->makeSurface(info);
+  mBack = compatible->makeSurface(info);
+}
+
+ProgressiveLayer::~ProgressiveLayer() = default;
+
+void ProgressiveLayer::SetContent(sk_sp<SkPicture> picture) {
+  if (mPending) {
+    ++mStats.mVersionsAbandoned;
+  }
+  mPending = std::move(picture);
+  mNextTile = 0;
+  mPendingStart = std::chrono::steady_clock::now();
+  mPendingAdvances = 0;
+}
+
+bool ProgressiveLayer::Advance() {
+  if (!(mPending && mBack)) {
+    return false;
+  }
+  ++mPendingAdvances;
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto deadline = start + mOptions.mTimeSlice;
+  const auto tileCount = mColumns * mRows;
+
+  auto canvas = mBack->getCanvas();
+  size_t rendered {};
+  while (mNextTile < tileCount) {
+    const auto tileStart = std::chrono::steady_clock::now();
+    if (rendered > 0 && tileStart + mTileCost > deadline) {
+      break;
+    }
+
+    const auto tile = SkIRect::MakeXYWH(
+      (mNextTile % mColumns) * mOptions.mTileSize,
+      (mNextTile / mColumns) * mOptions.mTileSize,
+      mOptions.mTileSize,
+      mOptions.mTileSize);
+    {
+      SkAutoCanvasRestore restore {canvas, true};
+      canvas->clipIRect(tile);
+      canvas->clear(SK_ColorTRANSPARENT);
+      canvas->drawPicture(mPending);
+    }
+    if (mContext) {
+      // Submit each tile, so that the GPU work is also spread over frames
+      mContext->flushAndSubmit(mBack.get(), GrSyncCpu::kNo);
+    }
+    ++mNextTile;
+    ++rendered;
+    ++mStats.mTilesRendered;
+
+    const auto cost = std::chrono::steady_clock::now() - tileStart;
+    mTileCost = (mTileCost == decltype(mTileCost) {})
+      ? cost
+      : ((mTileCost * 7) + cost) / 8;
+  }
+
+  if (mNextTile < tileCount) {
+    return false;
+  }
+
+  std::swap(mFront, mBack);
+  mHaveFront = true;
+  mPending = nullptr;
+  ++mStats.mVersionsCompleted;
+  mStats.mLastTimeToComplete = std::chrono::steady_clock::now() - mPendingStart;
+  mStats.mLastAdvancesToComplete = mPendingAdvances;
+  return true;
+}
+
+void ProgressiveLayer::Draw(SkCanvas* canvas, SkScalar x, SkScalar y) const {
+  if (mHaveFront) {
+    mFront->draw(canvas, x, y);
+  }
+}
+
+bool ProgressiveLayer::HasPendingVersion() const noexcept {
+  return static_cast<bool>(mPending);
+}
+
+bool ProgressiveLayer::HasCompleteVersion() const noexcept {
+  return mHaveFront;
+}
+
+ProgressiveLayer::Stats ProgressiveLayer::GetStats() const noexcept {
+  return mStats;
+}
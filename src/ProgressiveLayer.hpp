@@ -0,0 +1,99 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkCanvas.h>
+#include <skia/core/SkPicture.h>
+#include <skia/core/SkSurface.h>
+#include <skia/gpu/GrDirectContext.h>
+
+#include <chrono>
+#include <cstdint>
+
+/** Rasterizes content that is too heavy for one frame over several frames.
+ *
+ * The content is split into tiles, and each call to `Advance()` rasterizes
+ * as many tiles as fit in its time slice. Tiles are rendered into a back
+ * buffer; `Draw()` shows the last complete version from the front buffer,
+ * so the rest of the UI keeps running at full rate, and partially-rendered
+ * content is never shown.
+ *
+ * Record content with a bounding box hierarchy - e.g. `SkRTreeFactory` - so
+ * that each tile only replays the operations that intersect it.
+ *
+ * Not thread-safe.
+ */
+class ProgressiveLayer final {
+ public:
+  struct Options {
+    int mTileSize {256};
+    std::chrono::microseconds mTimeSlice {4000};
+  };
+
+  struct Stats {
+    size_t mVersionsCompleted {};
+    // Replaced by `SetContent()` before they were complete
+    size_t mVersionsAbandoned {};
+    size_t mTilesRendered {};
+    // For the most recently completed version, from `SetContent()`
+    std::chrono::steady_clock::duration mLastTimeToComplete {};
+    size_t mLastAdvancesToComplete {};
+  };
+
+  /** Buffers are created by `compatible->makeSurface()`.
+   *
+   * `context` should be `nullptr` for raster surfaces.
+   */
+  ProgressiveLayer(
+    GrDirectContext* context,
+    SkSurface* compatible,
+    const SkISize& size,
+    const Options&);
+  ~ProgressiveLayer();
+
+  ProgressiveLayer() = delete;
+  ProgressiveLayer(const ProgressiveLayer&) = delete;
+  ProgressiveLayer(ProgressiveLayer&&) = delete;
+  ProgressiveLayer& operator=(const ProgressiveLayer&) = delete;
+  ProgressiveLayer& operator=(ProgressiveLayer&&) = delete;
+
+  /// Starts rendering a new version, abandoning any incomplete version
+  void SetContent(sk_sp<SkPicture>);
+
+  /** Renders tiles of the pending version for up to the time slice.
+   *
+   * At least one tile is rendered, so that progress is always made; after
+   * that, a tile is only started if it is expected to finish in time.
+   *
+   * Returns true if this completed a version.
+   */
+  bool Advance();
+
+  /// Draws the last complete version, if any
+  void Draw(SkCanvas*, SkScalar x, SkScalar y) const;
+
+  [[nodiscard]] bool HasPendingVersion() const noexcept;
+  [[nodiscard]] bool HasCompleteVersion() const noexcept;
+  [[nodiscard]] Stats GetStats() const noexcept;
+
+ private:
+  GrDirectContext* mContext {nullptr};
+  Options mOptions;
+  int mColumns {};
+  int mRows {};
+
+  sk_sp<SkSurface> mFront;
+  sk_sp<SkSurface> mBack;
+  bool mHaveFront {false};
+
+  sk_sp<SkPicture> mPending;
+  int mNextTile {};
+  std::chrono::steady_clock::time_point mPendingStart {};
+  size_t mPendingAdvances {};
+
+  // Exponential moving average of the cost of a tile
+  std::chrono::steady_clock::duration mTileCost {};
+
+  Stats mStats;
+};
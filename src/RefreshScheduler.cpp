@@ -0,0 +1,98 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "RefreshScheduler.hpp"
+
+#include <algorithm>
+
+RefreshScheduler::RefreshScheduler(
+  GrDirectContext* context,
+  SkSurface* compatible)
+  : mContext(context),
+    mCompatible(compatible) {
+}
+
+RefreshScheduler::~RefreshScheduler() = default;
+
+RefreshScheduler::DomainID RefreshScheduler::AddDomain(Domain domain) {
+  mDomains.push_back({.mDomain = std::move(domain)});
+  return mDomains.size() - 1;
+}
+
+void RefreshScheduler::Invalidate(DomainID id) {
+  mDomains.at(id).mDirty = true;
+}
+
+bool RefreshScheduler::Update(Clock::time_point now) {
+  for (auto& it: mDomains) {
+    if (now < it.mNextTick) {
+      continue;
+    }
+    // Stay on the domain's own grid, unless we're a whole interval late
+    it.mNextTick += it.mDomain.mInterval;
+    if (it.mNextTick <= now) {
+      it.mNextTick = now + it.mDomain.mInterval;
+    }
+
+    if (!(it.mDirty || it.mDomain.mContinuous)) {
+      ++it.mStats.mCleanTicks;
+      continue;
+    }
+
+    const auto& bounds = it.mDomain.mBounds;
+    if (!it.mLayer) {
+      it.mLayer = mCompatible->makeSurface(
+        mCompatible->imageInfo().makeWH(bounds.width(), bounds.height()));
+      if (!it.mLayer) {
+        continue;
+      }
+    }
+    auto canvas = it.mLayer->getCanvas();
+    {
+      SkAutoCanvasRestore restore {canvas, true};
+      canvas->clear(SK_ColorTRANSPARENT);
+      it.mDomain.mDraw(canvas, it.mStats.mFrames);
+    }
+    if (mContext) {
+      mContext->flushAndSubmit(it.mLayer.get(), GrSyncCpu::kNo);
+    }
+    ++it.mStats.mFrames;
+    it.mDirty = false;
+    mNeedsComposite = true;
+  }
+  return mNeedsComposite;
+}
+
+void RefreshScheduler::Composite(SkCanvas* canvas) {
+  for (const auto& it: mDomains) {
+    if (it.mLayer) {
+      it.mLayer->draw(
+        canvas,
+        static_cast<SkScalar>(it.mDomain.mBounds.x()),
+        static_cast<SkScalar>(it.mDomain.mBounds.y()));
+    }
+  }
+  mNeedsComposite = false;
+  ++mComposites;
+}
+
+RefreshScheduler::Clock::time_point RefreshScheduler::GetNextDeadline()
+  const {
+  auto ret = Clock::time_point::max();
+  for (const auto& it: mDomains) {
+    // Clean, non-continuous domains don't need to wake us up
+    if (it.mDirty || it.mDomain.mContinuous) {
+      ret = std::min(ret, it.mNextTick);
+    }
+  }
+  return ret;
+}
+
+RefreshScheduler::DomainStats RefreshScheduler::GetDomainStats(
+  DomainID id) const {
+  return mDomains.at(id).mStats;
+}
+
+size_t RefreshScheduler::GetCompositeCount() const noexcept {
+  return mComposites;
+}
@@ -0,0 +1,97 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkCanvas.h>
+#include <skia/core/SkSurface.h>
+#include <skia/gpu/GrDirectContext.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/** Renders regions of a target at independent frame rates.
+ *
+ * Each refresh domain is a rectangle of the target with its own interval,
+ * e.g. 120Hz for a cursor or a scrolling list, and 10Hz for a dashboard.
+ * Domains are rendered into their own layers, and only when they are due
+ * and their content changed - either because they are continuous, or they
+ * were invalidated. The target only needs to be composited when at least
+ * one domain rendered.
+ *
+ * Hosts should wait until `GetNextDeadline()`, call `Update()`, and only
+ * composite and present if it returns true.
+ *
+ * Not thread-safe.
+ */
+class RefreshScheduler final {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using DomainID = size_t;
+  /// Drawn in the domain's coordinates; `frame` counts the domain's frames
+  using DrawFn = std::function<void(SkCanvas*, uint64_t frame)>;
+
+  struct Domain {
+    std::string mName;
+    SkIRect mBounds {};
+    Clock::duration mInterval {};
+    // Content changes every frame, e.g. an animation; otherwise, only
+    // rendered when invalidated
+    bool mContinuous {false};
+    DrawFn mDraw;
+  };
+
+  struct DomainStats {
+    size_t mFrames {};
+    // The domain was due, but clean
+    size_t mCleanTicks {};
+  };
+
+  /** Layers are created by `compatible->makeSurface()`.
+   *
+   * `context` should be `nullptr` for raster surfaces.
+   */
+  RefreshScheduler(GrDirectContext* context, SkSurface* compatible);
+  ~RefreshScheduler();
+
+  RefreshScheduler() = delete;
+  RefreshScheduler(const RefreshScheduler&) = delete;
+  RefreshScheduler(RefreshScheduler&&) = delete;
+  RefreshScheduler& operator=(const RefreshScheduler&) = delete;
+  RefreshScheduler& operator=(RefreshScheduler&&) = delete;
+
+  /// The domain is rendered at the next call to `Update()`
+  DomainID AddDomain(Domain);
+  /// Renders the domain at its next tick
+  void Invalidate(DomainID);
+
+  /** Renders the domains that are due and dirty.
+   *
+   * Returns true if the target needs to be composited.
+   */
+  bool Update(Clock::time_point now = Clock::now());
+  /// Draws every domain's layer
+  void Composite(SkCanvas*);
+
+  [[nodiscard]] Clock::time_point GetNextDeadline() const;
+  [[nodiscard]] DomainStats GetDomainStats(DomainID) const;
+  [[nodiscard]] size_t GetCompositeCount() const noexcept;
+
+ private:
+  struct DomainState {
+    Domain mDomain;
+    sk_sp<SkSurface> mLayer;
+    Clock::time_point mNextTick {};
+    bool mDirty {true};
+    DomainStats mStats;
+  };
+
+  GrDirectContext* mContext {nullptr};
+  SkSurface* mCompatible {nullptr};
+  std::vector<DomainState> mDomains;
+  bool mNeedsComposite {false};
+  size_t mComposites {};
+};
@@ -0,0 +1,202 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "RoundRectBatch.hpp"
+
+#include <Windows.h>
+#include <skia/core/SkBlender.h>
+#include <skia/core/SkRRect.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <format>
+
+namespace {
+
+constexpr char VertexShader[] = R"SKSL(
+Varyings main(const Attributes a) {
+  Varyings v;
+  v.position = a.position;
+  v.local = a.local;
+  v.halfSize = a.halfSize;
+  v.radius = a.radius;
+  v.strokeWidth = a.strokeWidth;
+  v.color = a.color;
+  return v;
+}
+)SKSL";
+
+constexpr char FragmentShader[] = R"SKSL(
+float2 main(const Varyings v, out half4 color) {
+  float2 q = abs(v.local) - v.halfSize + v.radius;
+  float d = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - v.radius;
+  if (v.strokeWidth > 0) {
+    d = abs(d) - (v.strokeWidth * 0.5);
+  }
+  half coverage = half(saturate(0.5 - d));
+  color = half4(v.color.rgb * v.color.a, v.color.a) * coverage;
+  return v.local;
+}
+)SKSL";
+
+uint32_t ToRGBA8(const SkColor color) {
+  return SkColorGetR(color) | (SkColorGetG(color) << 8)
+    | (SkColorGetB(color) << 16) | (SkColorGetA(color) << 24);
+}
+
+}// namespace
+
+RoundRectBatch::RoundRectBatch() {
+  using Attribute = SkMeshSpecification::Attribute;
+  using Varying = SkMeshSpecification::Varying;
+  const Attribute attributes[] {
+    {Attribute::Type::kFloat2,
+     offsetof(Vertex, mPosition),
+     SkString {"position"}},
+    {Attribute::Type::kFloat2, offsetof(Vertex, mLocal), SkString {"local"}},
+    {Attribute::Type::kFloat2,
+     offsetof(Vertex, mHalfSize),
+     SkString {"halfSize"}},
+    {Attribute::Type::kFloat, offsetof(Vertex, mRadius), SkString {"radius"}},
+    {Attribute::Type::kFloat,
+     offsetof(Vertex, mStrokeWidth),
+     SkString {"strokeWidth"}},
+    {Attribute::Type::kUByte4_unorm,
+     offsetof(Vertex, mColor),
+     SkString {"color"}},
+  };
+  const Varying varyings[] {
+    {Varying::Type::kFloat2, SkString {"local"}},
+    {Varying::Type::kFloat2, SkString {"halfSize"}},
+    {Varying::Type::kFloat, SkString {"radius"}},
+    {Varying::Type::kFloat, SkString {"strokeWidth"}},
+    {Varying::Type::kHalf4, SkString {"color"}},
+  };
+
+  auto [specification, error] = SkMeshSpecification::Make(
+    attributes,
+    sizeof(Vertex),
+    varyings,
+    SkString {VertexShader},
+    SkString {FragmentShader});
+  if (!specification) {
+    OutputDebugStringA(
+      std::format("Failed to create SkMeshSpecification: {}\n", error.c_str())
+        .c_str());
+    return;
+  }
+  mSpecification = std::move(specification);
+}
+
+void RoundRectBatch::Clear() {
+  mShapes.clear();
+}
+
+void RoundRectBatch::AddFill(
+  const SkRect& rect,
+  SkScalar radius,
+  SkColor color) {
+  this->Add({rect, radius, 0, color});
+}
+
+void RoundRectBatch::AddStroke(
+  const SkRect& rect,
+  SkScalar radius,
+  SkScalar strokeWidth,
+  SkColor color) {
+  this->Add({rect, radius, strokeWidth, color});
+}
+
+void RoundRectBatch::Add(const Shape& shape) {
+  mShapes.push_back(shape);
+}
+
+size_t RoundRectBatch::GetShapeCount() const noexcept {
+  return mShapes.size();
+}
+
+void RoundRectBatch::Draw(SkCanvas* canvas) const {
+  if (mShapes.empty()) {
+    return;
+  }
+  if (!mSpecification) {
+    this->DrawFallback(canvas);
+    return;
+  }
+
+  // The fragment shader's output is the color; the paint's color is ignored
+  SkPaint paint;
+  paint.setColor(SK_ColorWHITE);
+  const auto blender = SkBlender::Mode(SkBlendMode::kModulate);
+
+  std::vector<Vertex> vertices;
+  vertices.reserve(
+    std::min(mShapes.size(), MaxShapesPerMesh) * VerticesPerShape);
+  for (size_t first = 0; first < mShapes.size(); first += MaxShapesPerMesh) {
+    const auto last = std::min(first + MaxShapesPerMesh, mShapes.size());
+    vertices.clear();
+    SkRect bounds = SkRect::MakeEmpty();
+    for (size_t i = first; i < last; ++i) {
+      const auto& shape = mShapes.at(i);
+      // Half the stroke is outside the rect, and we need an extra pixel for AA
+      const auto outset = (shape.mStrokeWidth / 2) + 1;
+      const auto quad = shape.mRect.makeOutset(outset, outset);
+      bounds.join(quad);
+
+      const auto center = shape.mRect.center();
+      const SkPoint halfSize {
+        shape.mRect.width() / 2, shape.mRect.height() / 2};
+      const auto radius
+        = std::min({shape.mRadius, halfSize.x(), halfSize.y()});
+      const auto rgba = ToRGBA8(shape.mColor);
+      const auto vertex = [&](SkScalar x, SkScalar y) {
+        return Vertex {
+          .mPosition = {x, y},
+          .mLocal = {x - center.x(), y - center.y()},
+          .mHalfSize = halfSize,
+          .mRadius = radius,
+          .mStrokeWidth = shape.mStrokeWidth,
+          .mColor = rgba,
+        };
+      };
+      const auto tl = vertex(quad.left(), quad.top());
+      const auto tr = vertex(quad.right(), quad.top());
+      const auto bl = vertex(quad.left(), quad.bottom());
+      const auto br = vertex(quad.right(), quad.bottom());
+      vertices.insert(vertices.end(), {tl, tr, bl, bl, tr, br});
+    }
+
+    auto vertexBuffer = SkMeshes::MakeVertexBuffer(
+      vertices.data(), vertices.size() * sizeof(Vertex));
+    auto [mesh, error] = SkMesh::Make(
+      mSpecification,
+      SkMesh::Mode::kTriangles,
+      std::move(vertexBuffer),
+      vertices.size(),
+      0,
+      nullptr,
+      {},
+      bounds);
+    if (!mesh.isValid()) {
+      OutputDebugStringA(
+        std::format("Failed to create SkMesh: {}\n", error.c_str()).c_str());
+      continue;
+    }
+    canvas->drawMesh(mesh, blender, paint);
+  }
+}
+
+void RoundRectBatch::DrawFallback(SkCanvas* canvas) const {
+  SkPaint paint;
+  paint.setAntiAlias(true);
+  for (const auto& shape: mShapes) {
+    paint.setColor(shape.mColor);
+    if (shape.mStrokeWidth > 0) {
+      paint.setStyle(SkPaint::kStroke_Style);
+      paint.setStrokeWidth(shape.mStrokeWidth);
+    } else {
+      paint.setStyle(SkPaint::kFill_Style);
+    }
+    canvas->drawRoundRect(shape.mRect, shape.mRadius, shape.mRadius, paint);
+  }
+}
@@ -0,0 +1,67 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkCanvas.h>
+#include <skia/core/SkMesh.h>
+
+#include <vector>
+
+/** Draws many rounded rects with a small number of `SkMesh` draws.
+ *
+ * Each rounded rect is a quad; edges and corners are evaluated in the fragment
+ * shader as a signed distance field, instead of Skia building geometry for
+ * each shape. Anti-aliasing assumes that one local unit is roughly one pixel,
+ * i.e. that the canvas is not scaled.
+ *
+ * If the mesh specification can't be created (e.g. the backend doesn't
+ * support meshes), `Draw()` falls back to a `drawRRect()` per shape.
+ */
+class RoundRectBatch final {
+ public:
+  RoundRectBatch();
+
+  void Clear();
+  void AddFill(const SkRect&, SkScalar radius, SkColor);
+  void AddStroke(
+    const SkRect&,
+    SkScalar radius,
+    SkScalar strokeWidth,
+    SkColor);
+
+  void Draw(SkCanvas*) const;
+
+  [[nodiscard]] size_t GetShapeCount() const noexcept;
+
+ private:
+  // Keep each mesh's vertex buffer reasonably sized
+  static constexpr size_t MaxShapesPerMesh = 16384;
+  static constexpr size_t VerticesPerShape = 6;
+
+  struct Vertex {
+    SkPoint mPosition;
+    // Relative to the center of the rect
+    SkPoint mLocal;
+    SkPoint mHalfSize;
+    float mRadius {};
+    // 0 for fills
+    float mStrokeWidth {};
+    // RGBA8 unorm
+    uint32_t mColor {};
+  };
+  static_assert(sizeof(Vertex) == 36);
+
+  struct Shape {
+    SkRect mRect;
+    SkScalar mRadius {};
+    SkScalar mStrokeWidth {};
+    SkColor mColor {};
+  };
+
+  sk_sp<SkMeshSpecification> mSpecification;
+  std::vector<Shape> mShapes;
+
+  void Add(const Shape&);
+  void DrawFallback(SkCanvas*) const;
+};
@@ -0,0 +1,645 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "SamplingProfiler.hpp"
+
+#include "HashCombine.hpp"
+
+#include <Windows.h>
+#include <dbghelp.h>
+#include <psapi.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace {
+
+// Back off to at most this interval to stay within the overhead budget
+constexpr std::chrono::microseconds MaxInterval {100'000};
+
+#if defined(_M_X64)
+DWORD64 GetProgramCounter(const CONTEXT& context) {
+  return context.Rip;
+}
+
+DWORD64 GetStackPointer(const CONTEXT& context) {
+  return context.Rsp;
+}
+
+/// Applies `f` to every register that can hold a pointer into the stack
+void ForEachIntegerRegister(CONTEXT& context, auto&& f) {
+  static constexpr DWORD64 CONTEXT::* Registers[] {
+    &CONTEXT::Rax,
+    &CONTEXT::Rcx,
+    &CONTEXT::Rdx,
+    &CONTEXT::Rbx,
+    &CONTEXT::Rsp,
+    &CONTEXT::Rbp,
+    &CONTEXT::Rsi,
+    &CONTEXT::Rdi,
+    &CONTEXT::R8,
+    &CONTEXT::R9,
+    &CONTEXT::R10,
+    &CONTEXT::R11,
+    &CONTEXT::R12,
+    &CONTEXT::R13,
+    &CONTEXT::R14,
+    &CONTEXT::R15,
+  };
+  for (const auto it: Registers) {
+    f(context.*it);
+  }
+}
+#elif defined(_M_ARM64)
+DWORD64 GetProgramCounter(const CONTEXT& context) {
+  return context.Pc;
+}
+
+DWORD64 GetStackPointer(const CONTEXT& context) {
+  return context.Sp;
+}
+
+/// Applies `f` to every register that can hold a pointer into the stack
+void ForEachIntegerRegister(CONTEXT& context, auto&& f) {
+  // Includes Fp and Lr
+  for (auto& it: context.X) {
+    f(it);
+  }
+  f(context.Sp);
+}
+#else
+#error "SamplingProfiler only supports x64 and ARM64"
+#endif
+
+/** A copy of the top of the profiled thread's stack.
+ *
+ * `RtlVirtualUnwind()` reads saved registers and return addresses through
+ * the stack and frame pointers; while unwinding, those are moved into the
+ * copy, so the original stack is never read after the thread is resumed.
+ */
+class StackCopy final {
+ public:
+  StackCopy(DWORD64 original, std::span<const std::byte> bytes)
+    : mOriginal(original),
+      mBytes(bytes) {
+  }
+
+  /// `address` is in the original stack
+  [[nodiscard]] bool Contains(DWORD64 address, size_t size) const noexcept {
+    return address >= mOriginal && address - mOriginal <= mBytes.size()
+      && size <= mBytes.size() - (address - mOriginal);
+  }
+
+  /// Caller must check `Contains(address, sizeof(DWORD64))`
+  [[nodiscard]] DWORD64 Read(DWORD64 address) const noexcept {
+    DWORD64 ret {};
+    memcpy(&ret, mBytes.data() + (address - mOriginal), sizeof(ret));
+    return ret;
+  }
+
+  void ToCopy(CONTEXT& context) const noexcept {
+    const auto copy = reinterpret_cast<DWORD64>(mBytes.data());
+    ForEachIntegerRegister(context, [copy, this](DWORD64& value) {
+      if (this->Contains(value, 0)) {
+        value = copy + (value - mOriginal);
+      }
+    });
+  }
+
+  /// Registers that were restored from the stack already point at the
+  /// original, so only pointers into the copy are changed
+  void FromCopy(CONTEXT& context) const noexcept {
+    const auto copy = reinterpret_cast<DWORD64>(mBytes.data());
+    ForEachIntegerRegister(context, [copy, this](DWORD64& value) {
+      if (value >= copy && value - copy <= mBytes.size()) {
+        value = mOriginal + (value - copy);
+      }
+    });
+  }
+
+ private:
+  DWORD64 mOriginal {};
+  std::span<const std::byte> mBytes;
+};
+
+/** `RtlVirtualUnwind()`, returning false on access violations.
+ *
+ * A clobbered frame pointer can point outside of the stack copy, e.g. in
+ * code that was unwound incorrectly because it lacks unwind data.
+ */
+bool VirtualUnwind(
+  DWORD64 imageBase,
+  DWORD64 pc,
+  PRUNTIME_FUNCTION function,
+  CONTEXT& context) {
+  __try {
+    void* handlerData {};
+    DWORD64 establisherFrame {};
+    RtlVirtualUnwind(
+      UNW_FLAG_NHANDLER,
+      imageBase,
+      pc,
+      function,
+      &context,
+      &handlerData,
+      &establisherFrame,
+      nullptr);
+    return true;
+  } __except (
+    GetExceptionCode() == EXCEPTION_ACCESS_VIOLATION
+      ? EXCEPTION_EXECUTE_HANDLER
+      : EXCEPTION_CONTINUE_SEARCH) {
+    return false;
+  }
+}
+
+/* Called after the profiled thread has been resumed, so this may take the
+ * loader and function table locks; the stack itself must only be read from
+ * `stack`, as the thread may have changed it since.
+ */
+bool UnwindFrame(CONTEXT& context, const StackCopy& stack) {
+  const auto sp = GetStackPointer(context);
+  if (!stack.Contains(sp, sizeof(DWORD64))) {
+    return false;
+  }
+  const auto pc = GetProgramCounter(context);
+  DWORD64 imageBase {};
+  const auto function = RtlLookupFunctionEntry(pc, &imageBase, nullptr);
+  if (!function) {
+    // Leaf functions don't have unwind data, as they don't touch the stack
+    // pointer or non-volatile registers
+#if defined(_M_X64)
+    context.Rip = stack.Read(sp);
+    context.Rsp += sizeof(DWORD64);
+#else
+    if (context.Pc == context.Lr) {
+      return false;
+    }
+    context.Pc = context.Lr;
+#endif
+    return true;
+  }
+
+  stack.ToCopy(context);
+  const auto unwound = VirtualUnwind(imageBase, pc, function, context);
+  stack.FromCopy(context);
+  // Callers' frames are at higher addresses; anything else is corrupt
+  return unwound && GetStackPointer(context) >= sp;
+}
+
+/// Just enough of the protobuf wire format for pprof
+class ProtobufWriter final {
+ public:
+  void UInt64(uint32_t field, uint64_t value) {
+    this->Tag(field, WireType::Varint);
+    this->Varint(value);
+  }
+
+  void Bool(uint32_t field, bool value) {
+    this->UInt64(field, value ? 1 : 0);
+  }
+
+  void Bytes(uint32_t field, std::string_view value) {
+    this->Tag(field, WireType::LengthDelimited);
+    this->Varint(value.size());
+    mBuffer.append(value);
+  }
+
+  void Message(uint32_t field, const ProtobufWriter& message) {
+    this->Bytes(field, message.mBuffer);
+  }
+
+  void PackedUInt64(uint32_t field, std::span<const uint64_t> values) {
+    ProtobufWriter packed;
+    for (const auto value: values) {
+      packed.Varint(value);
+    }
+    this->Bytes(field, packed.mBuffer);
+  }
+
+  [[nodiscard]] const std::string& GetBuffer() const noexcept {
+    return mBuffer;
+  }
+
+ private:
+  enum class WireType : uint8_t {
+    Varint = 0,
+    LengthDelimited = 2,
+  };
+
+  std::string mBuffer;
+
+  void Varint(uint64_t value) {
+    while (value >= 0x80) {
+      mBuffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+      value >>= 7;
+    }
+    mBuffer.push_back(static_cast<char>(value));
+  }
+
+  void Tag(uint32_t field, WireType type) {
+    this->Varint(
+      (static_cast<uint64_t>(field) << 3) | static_cast<uint64_t>(type));
+  }
+};
+
+/// pprof refers to strings by index; index 0 must be the empty string
+class StringTable final {
+ public:
+  uint64_t Get(std::string_view value) {
+    const auto [it, inserted]
+      = mIndices.try_emplace(std::string {value}, mStrings.size());
+    if (inserted) {
+      mStrings.emplace_back(value);
+    }
+    return it->second;
+  }
+
+  void Write(ProtobufWriter& profile) const {
+    for (const auto& value: mStrings) {
+      profile.Bytes(6, value);
+    }
+  }
+
+ private:
+  std::vector<std::string> mStrings {""};
+  std::unordered_map<std::string, uint64_t> mIndices {{"", 0}};
+};
+
+ProtobufWriter MakeValueType(
+  StringTable& strings,
+  std::string_view type,
+  std::string_view unit) {
+  ProtobufWriter ret;
+  ret.UInt64(1, strings.Get(type));
+  ret.UInt64(2, strings.Get(unit));
+  return ret;
+}
+
+}// namespace
+
+double SamplingProfiler::Stats::GetOverhead() const noexcept {
+  if (mProfiledTime.count() == 0) {
+    return 0;
+  }
+  return static_cast<double>(mSuspendedTime.count()) / mProfiledTime.count();
+}
+
+SamplingProfiler::ScopedPhase::ScopedPhase(
+  SamplingProfiler* profiler,
+  const char* phase) noexcept
+  : mProfiler(profiler) {
+  if (mProfiler) {
+    mPrevious = mProfiler->mPhase.exchange(phase, std::memory_order_relaxed);
+  }
+}
+
+SamplingProfiler::ScopedPhase::~ScopedPhase() {
+  if (mProfiler) {
+    mProfiler->mPhase.store(mPrevious, std::memory_order_relaxed);
+  }
+}
+
+size_t SamplingProfiler::StackKeyHash::operator()(
+  const StackKey& key) const noexcept {
+  size_t seed {};
+  HashCombine(seed, key.mPhase);
+  for (const auto frame: key.mFrames) {
+    HashCombine(seed, frame);
+  }
+  return seed;
+}
+
+SamplingProfiler::SamplingProfiler(const Options& options)
+  : mOptions(options),
+    mCreationTime(std::chrono::system_clock::now()) {
+  DuplicateHandle(
+    GetCurrentProcess(),
+    GetCurrentThread(),
+    GetCurrentProcess(),
+    mThread.put(),
+    THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION,
+    FALSE,
+    0);
+
+  const auto ringSize
+    = std::bit_ceil(std::max<size_t>(mOptions.mBufferSamples, 2));
+  mRing = std::make_unique<Sample[]>(ringSize);
+  mRingMask = ringSize - 1;
+  mIntervalMicroseconds = mOptions.mInterval.count();
+
+  // Reads StackBase and DeallocationStack from the calling - i.e. profiled -
+  // thread's TEB
+  ULONG_PTR stackLow {};
+  ULONG_PTR stackHigh {};
+  GetCurrentThreadStackLimits(&stackLow, &stackHigh);
+  mStackLow = stackLow;
+  mStackHigh = stackHigh;
+  mStackCopySize
+    = std::min<size_t>(mOptions.mMaxStackBytes, mStackHigh - mStackLow);
+  mStackCopy = std::make_unique_for_overwrite<std::byte[]>(mStackCopySize);
+}
+
+SamplingProfiler::~SamplingProfiler() {
+  this->Stop();
+}
+
+void SamplingProfiler::Start() {
+  if (mSampler.joinable() || !mThread) {
+    return;
+  }
+  mSampler
+    = std::jthread {std::bind_front(&SamplingProfiler::RunSampler, this)};
+}
+
+void SamplingProfiler::Stop() {
+  // Requests stop and joins
+  mSampler = {};
+}
+
+SamplingProfiler::Stats SamplingProfiler::GetStats() const {
+  return {
+    .mSamples = mSamples.load(),
+    .mDroppedSamples = mDroppedSamples.load(),
+    .mFailedSamples = mFailedSamples.load(),
+    .mSuspendedTime = std::chrono::nanoseconds {mSuspendedNanoseconds.load()},
+    .mProfiledTime = std::chrono::nanoseconds {mProfiledNanoseconds.load()},
+    .mCurrentInterval
+    = std::chrono::microseconds {mIntervalMicroseconds.load()},
+  };
+}
+
+void SamplingProfiler::RunSampler(std::stop_token stopToken) {
+  wil::unique_handle timer {CreateWaitableTimerExW(
+    nullptr,
+    nullptr,
+    CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+    TIMER_ALL_ACCESS)};
+  if (!timer) {
+    OutputDebugStringA(std::format(
+                         "SamplingProfiler: CreateWaitableTimerExW() failed: "
+                         "{}\n",
+                         GetLastError())
+                         .c_str());
+    return;
+  }
+
+  auto interval = mOptions.mInterval;
+  // Exponentially-weighted moving average
+  double overhead {};
+  auto lastTick = std::chrono::steady_clock::now();
+
+  while (!stopToken.stop_requested()) {
+    // Relative, in 100ns units
+    const LARGE_INTEGER dueTime {.QuadPart = -10 * interval.count()};
+    SetWaitableTimer(timer.get(), &dueTime, 0, nullptr, nullptr, FALSE);
+    WaitForSingleObject(timer.get(), INFINITE);
+    if (stopToken.stop_requested()) {
+      return;
+    }
+
+    const auto tick = std::chrono::steady_clock::now();
+    mProfiledNanoseconds += std::chrono::nanoseconds {tick - lastTick}.count();
+    lastTick = tick;
+
+    const auto write = mRingWrite.load(std::memory_order_relaxed);
+    if (write - mRingRead.load(std::memory_order_acquire) > mRingMask) {
+      ++mDroppedSamples;
+      continue;
+    }
+    auto& sample = mRing[write & mRingMask];
+    sample.mWeight = interval;
+    std::chrono::steady_clock::duration suspended {};
+    const auto captured = this->CaptureSample(sample, suspended);
+    mSuspendedNanoseconds += std::chrono::nanoseconds {suspended}.count();
+    if (captured) {
+      mRingWrite.store(write + 1, std::memory_order_release);
+      ++mSamples;
+    } else {
+      ++mFailedSamples;
+    }
+
+    overhead = (0.9 * overhead)
+      + (0.1
+         * std::chrono::duration<double>(suspended).count()
+         / std::chrono::duration<double>(interval).count());
+    if (overhead > mOptions.mMaxOverhead && interval < MaxInterval) {
+      interval = std::min(interval * 2, MaxInterval);
+    } else if (
+      overhead < mOptions.mMaxOverhead / 4 && interval > mOptions.mInterval) {
+      interval = std::max(interval / 2, mOptions.mInterval);
+    }
+    mIntervalMicroseconds = interval.count();
+  }
+}
+
+bool SamplingProfiler::CaptureSample(
+  Sample& sample,
+  std::chrono::steady_clock::duration& suspended) {
+  const auto start = std::chrono::steady_clock::now();
+  if (SuspendThread(mThread.get()) == static_cast<DWORD>(-1)) {
+    return false;
+  }
+  // Nothing from here until ResumeThread() may allocate or lock
+  CONTEXT context {};
+  context.ContextFlags = CONTEXT_FULL;
+  // Also waits for the suspension to take effect
+  const bool haveContext = GetThreadContext(mThread.get(), &context);
+  sample.mPhase = mPhase.load(std::memory_order_relaxed);
+  const auto sp = GetStackPointer(context);
+  size_t stackBytes = 0;
+  if (haveContext && sp >= mStackLow && sp < mStackHigh) {
+    stackBytes = std::min<size_t>(mStackHigh - sp, mStackCopySize);
+    memcpy(mStackCopy.get(), reinterpret_cast<const void*>(sp), stackBytes);
+  }
+  ResumeThread(mThread.get());
+  suspended = std::chrono::steady_clock::now() - start;
+  if (stackBytes == 0) {
+    return false;
+  }
+
+  const StackCopy stack {sp, {mStackCopy.get(), stackBytes}};
+  sample.mDepth = 0;
+  while (sample.mDepth < MaxStackDepth) {
+    const auto pc = GetProgramCounter(context);
+    if (pc == 0) {
+      break;
+    }
+    sample.mFrames[sample.mDepth++] = pc;
+    if (!UnwindFrame(context, stack)) {
+      break;
+    }
+  }
+  return sample.mDepth > 0;
+}
+
+void SamplingProfiler::Collect() {
+  std::unique_lock lock(mAggregateMutex);
+  const auto write = mRingWrite.load(std::memory_order_acquire);
+  for (auto read = mRingRead.load(std::memory_order_relaxed); read != write;
+       ++read) {
+    const auto& sample = mRing[read & mRingMask];
+    StackKey key {sample.mPhase};
+    key.mFrames.reserve(sample.mDepth);
+    for (size_t i = 0; i < sample.mDepth; ++i) {
+      // Callers' addresses are return addresses; step back into the call
+      // instruction so they're attributed to the right line
+      key.mFrames.push_back(sample.mFrames[i] - (i > 0 ? 1 : 0));
+    }
+    auto& aggregate = mAggregates[std::move(key)];
+    ++aggregate.mCount;
+    aggregate.mWeight += sample.mWeight;
+  }
+  mRingRead.store(write, std::memory_order_release);
+}
+
+bool SamplingProfiler::WriteProfile(const std::filesystem::path& path) {
+  this->Collect();
+  std::unique_lock lock(mAggregateMutex);
+
+  StringTable strings;
+  ProtobufWriter profile;
+  // Profile.sample_type
+  profile.Message(1, MakeValueType(strings, "samples", "count"));
+  profile.Message(1, MakeValueType(strings, "cpu", "nanoseconds"));
+
+  // Location IDs are indices into `addresses`, plus 1
+  std::unordered_map<uint64_t, uint64_t> locationIDs;
+  std::vector<uint64_t> addresses;
+  const auto phaseKey = strings.Get("phase");
+  for (const auto& [key, aggregate]: mAggregates) {
+    std::vector<uint64_t> locations;
+    locations.reserve(key.mFrames.size());
+    for (const auto address: key.mFrames) {
+      const auto [it, inserted]
+        = locationIDs.try_emplace(address, addresses.size() + 1);
+      if (inserted) {
+        addresses.push_back(address);
+      }
+      locations.push_back(it->second);
+    }
+    const uint64_t values[] {
+      aggregate.mCount,
+      static_cast<uint64_t>(aggregate.mWeight.count()),
+    };
+
+    ProtobufWriter sample;
+    sample.PackedUInt64(1, locations);
+    sample.PackedUInt64(2, values);
+    if (key.mPhase) {
+      ProtobufWriter label;
+      label.UInt64(1, phaseKey);
+      label.UInt64(2, strings.Get(key.mPhase));
+      sample.Message(3, label);
+    }
+    // Profile.sample
+    profile.Message(2, sample);
+  }
+
+  const auto process = GetCurrentProcess();
+  const bool haveSymbols = SymInitialize(process, nullptr, TRUE);
+  std::unordered_map<HMODULE, uint64_t> mappingIDs;
+  std::unordered_map<std::string, uint64_t> functionIDs;
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    const auto address = addresses.at(i);
+    ProtobufWriter location;
+    location.UInt64(1, i + 1);
+    location.UInt64(3, address);
+
+    HMODULE module {};
+    if (GetModuleHandleExW(
+          GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS
+            | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+          reinterpret_cast<LPCWSTR>(address),
+          &module)) {
+      const auto [it, inserted]
+        = mappingIDs.try_emplace(module, mappingIDs.size() + 1);
+      if (inserted) {
+        MODULEINFO info {};
+        GetModuleInformation(process, module, &info, sizeof(info));
+        wchar_t fileName[MAX_PATH] {};
+        GetModuleFileNameW(module, fileName, MAX_PATH);
+        const auto base = reinterpret_cast<uint64_t>(info.lpBaseOfDll);
+
+        ProtobufWriter mapping;
+        mapping.UInt64(1, it->second);
+        mapping.UInt64(2, base);
+        mapping.UInt64(3, base + info.SizeOfImage);
+        mapping.UInt64(4, 0);
+        mapping.UInt64(
+          5, strings.Get(std::filesystem::path {fileName}.string()));
+        mapping.Bool(7, haveSymbols);
+        // Profile.mapping
+        profile.Message(3, mapping);
+      }
+      location.UInt64(2, it->second);
+    }
+
+    alignas(SYMBOL_INFO) std::byte symbolBuffer[sizeof(SYMBOL_INFO)
+                                                + MAX_SYM_NAME] {};
+    auto symbol = reinterpret_cast<SYMBOL_INFO*>(symbolBuffer);
+    symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+    symbol->MaxNameLen = MAX_SYM_NAME;
+    DWORD64 displacement {};
+    if (haveSymbols && SymFromAddr(process, address, &displacement, symbol)) {
+      IMAGEHLP_LINE64 lineInfo {.SizeOfStruct = sizeof(IMAGEHLP_LINE64)};
+      DWORD lineDisplacement {};
+      const bool haveLine = SymGetLineFromAddr64(
+        process, address, &lineDisplacement, &lineInfo);
+
+      const auto [it, inserted]
+        = functionIDs.try_emplace(symbol->Name, functionIDs.size() + 1);
+      if (inserted) {
+        ProtobufWriter function;
+        function.UInt64(1, it->second);
+        function.UInt64(2, strings.Get(symbol->Name));
+        function.UInt64(3, strings.Get(symbol->Name));
+        if (haveLine) {
+          function.UInt64(4, strings.Get(lineInfo.FileName));
+        }
+        // Profile.function
+        profile.Message(5, function);
+      }
+
+      ProtobufWriter line;
+      line.UInt64(1, it->second);
+      if (haveLine) {
+        line.UInt64(2, lineInfo.LineNumber);
+      }
+      location.Message(4, line);
+    }
+    // Profile.location
+    profile.Message(4, location);
+  }
+  if (haveSymbols) {
+    SymCleanup(process);
+  }
+
+  const auto now = std::chrono::system_clock::now();
+  // Profile.time_nanos and Profile.duration_nanos
+  profile.UInt64(
+    9,
+    std::chrono::nanoseconds {mCreationTime.time_since_epoch()}.count());
+  profile.UInt64(10, std::chrono::nanoseconds {now - mCreationTime}.count());
+  // Profile.period_type and Profile.period
+  profile.Message(11, MakeValueType(strings, "cpu", "nanoseconds"));
+  profile.UInt64(12, std::chrono::nanoseconds {mOptions.mInterval}.count());
+  // Must be last, as everything above adds strings
+  strings.Write(profile);
+
+  std::ofstream f(path, std::ios::binary | std::ios::trunc);
+  if (!f) {
+    OutputDebugStringA(
+      std::format("Failed to open profile {}\n", path.string()).c_str());
+    return false;
+  }
+  const auto& buffer = profile.GetBuffer();
+  f.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  return f.good();
+}
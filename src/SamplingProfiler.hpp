@@ -0,0 +1,167 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <Windows.h>
+#include <wil/resource.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/** An in-process sampling profiler for a single thread.
+ *
+ * A timer thread periodically suspends the profiled thread, copies its
+ * registers and stack, and resumes it; this is the Windows equivalent of a
+ * `SIGPROF` handler. While the thread is suspended, the sampler must not
+ * allocate or take locks that the profiled thread might hold - including
+ * the loader locks taken by `RtlLookupFunctionEntry()` - so the copy is
+ * only unwound with `RtlVirtualUnwind()` once the thread has been resumed.
+ * Unwinding stops when the stack pointer leaves the copy. Stacks are written
+ * into a preallocated lock-free ring buffer, and aggregated later by
+ * `Collect()` or `WriteProfile()`.
+ *
+ * Each sample is tagged with the phase set by the innermost `ScopedPhase`.
+ *
+ * Overhead is the fraction of time that the profiled thread spends
+ * suspended; if it exceeds `mMaxOverhead`, the sampling interval is doubled
+ * until it doesn't, and it returns towards `mInterval` when there is
+ * headroom.
+ *
+ * Profiles are written in pprof's protobuf format, uncompressed, with
+ * function names from DbgHelp where symbols are available.
+ */
+class SamplingProfiler final {
+ public:
+  static constexpr size_t MaxStackDepth = 64;
+
+  struct Options {
+    std::chrono::microseconds mInterval {1000};
+    double mMaxOverhead {0.01};
+    // Rounded up to a power of two
+    size_t mBufferSamples {4096};
+    // Copied while the thread is suspended; deeper frames are not unwound
+    size_t mMaxStackBytes {256 * 1024};
+  };
+
+  struct Stats {
+    size_t mSamples {};
+    // The ring buffer was full
+    size_t mDroppedSamples {};
+    // The thread could not be suspended or unwound
+    size_t mFailedSamples {};
+    std::chrono::nanoseconds mSuspendedTime {};
+    std::chrono::nanoseconds mProfiledTime {};
+    std::chrono::microseconds mCurrentInterval {};
+
+    [[nodiscard]] double GetOverhead() const noexcept;
+  };
+
+  /// Sets the phase of the profiled thread until destroyed
+  class ScopedPhase final {
+   public:
+    /// `profiler` can be `nullptr`; `phase` must be a string literal
+    ScopedPhase(SamplingProfiler* profiler, const char* phase) noexcept;
+    ~ScopedPhase();
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase(ScopedPhase&&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(ScopedPhase&&) = delete;
+
+   private:
+    SamplingProfiler* mProfiler {nullptr};
+    const char* mPrevious {nullptr};
+  };
+
+  /// Profiles the calling thread; call `Start()` to begin sampling
+  explicit SamplingProfiler(const Options&);
+  ~SamplingProfiler();
+
+  SamplingProfiler() = delete;
+  SamplingProfiler(const SamplingProfiler&) = delete;
+  SamplingProfiler(SamplingProfiler&&) = delete;
+  SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+  SamplingProfiler& operator=(SamplingProfiler&&) = delete;
+
+  void Start();
+  void Stop();
+
+  /** Aggregates samples from the ring buffer.
+   *
+   * Call regularly - e.g. once per frame - so that the buffer does not fill
+   * up; when it is full, new samples are dropped.
+   */
+  void Collect();
+
+  /// Includes every sample since the profiler was created
+  bool WriteProfile(const std::filesystem::path&);
+
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  struct Sample {
+    const char* mPhase {nullptr};
+    // The sampling interval when this sample was taken
+    std::chrono::nanoseconds mWeight {};
+    size_t mDepth {};
+    std::array<uint64_t, MaxStackDepth> mFrames {};
+  };
+
+  struct StackKey {
+    const char* mPhase {nullptr};
+    std::vector<uint64_t> mFrames;
+
+    bool operator==(const StackKey&) const noexcept = default;
+  };
+  struct StackKeyHash {
+    size_t operator()(const StackKey&) const noexcept;
+  };
+  struct Aggregate {
+    size_t mCount {};
+    std::chrono::nanoseconds mWeight {};
+  };
+
+  Options mOptions;
+  wil::unique_handle mThread;
+  const std::chrono::system_clock::time_point mCreationTime;
+  std::atomic<const char*> mPhase {nullptr};
+
+  // The profiled thread's stack, from its TEB
+  uintptr_t mStackLow {};
+  uintptr_t mStackHigh {};
+  // Preallocated, as it's filled while the thread is suspended
+  std::unique_ptr<std::byte[]> mStackCopy;
+  size_t mStackCopySize {};
+
+  // Single producer (the sampler thread), single consumer (`Collect()`)
+  std::unique_ptr<Sample[]> mRing;
+  size_t mRingMask {};
+  std::atomic<size_t> mRingWrite {};
+  std::atomic<size_t> mRingRead {};
+
+  // Written by the sampler thread
+  std::atomic<size_t> mSamples {};
+  std::atomic<size_t> mDroppedSamples {};
+  std::atomic<size_t> mFailedSamples {};
+  std::atomic<int64_t> mSuspendedNanoseconds {};
+  std::atomic<int64_t> mProfiledNanoseconds {};
+  std::atomic<int64_t> mIntervalMicroseconds {};
+
+  std::mutex mAggregateMutex;
+  std::unordered_map<StackKey, Aggregate, StackKeyHash> mAggregates;
+
+  std::jthread mSampler;
+
+  void RunSampler(std::stop_token);
+  bool CaptureSample(Sample&, std::chrono::steady_clock::duration& suspended);
+};
@@ -0,0 +1,52 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkColor.h>
+
+#include <cstdint>
+#include <random>
+
+/** Random numbers that are the same on every platform for the same seed.
+ *
+ * Only the `std::mt19937_64` engine is fully specified by the standard; the
+ * standard distributions are not, so different platforms would generate
+ * different content from the same seed.
+ */
+class SeededRandom final {
+ public:
+  explicit SeededRandom(uint64_t seed) : mEngine(seed) {
+  }
+
+  uint64_t NextUInt64() {
+    return mEngine();
+  }
+
+  /// [0, 1)
+  float Next() {
+    return static_cast<float>(mEngine() >> 40) * 0x1p-24f;
+  }
+
+  float Next(float min, float max) {
+    return min + (this->Next() * (max - min));
+  }
+
+  size_t NextIndex(size_t count) {
+    return static_cast<size_t>(mEngine() % count);
+  }
+
+  SkColor NextColor() {
+    const auto channel = [this]() {
+      return static_cast<uint8_t>(this->Next(0x40, 0x100));
+    };
+    return SkColorSetARGB(
+      static_cast<uint8_t>(this->Next(0xc0, 0x100)),
+      channel(),
+      channel(),
+      channel());
+  }
+
+ private:
+  std::mt19937_64 mEngine;
+};
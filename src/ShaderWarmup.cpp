@@ -0,0 +1,233 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "ShaderWarmup.hpp"
+
+#include <Windows.h>
+#include <skia/core/SkCanvas.h>
+#include <skia/core/SkStream.h>
+#include <skia/core/SkString.h>
+#include <skia/core/SkSurface.h>
+#include <skia/gpu/ganesh/SkSurfaceGanesh.h>
+
+#include <algorithm>
+#include <format>
+
+namespace {
+
+class StopTokenAbort final : public SkPicture::AbortCallback {
+ public:
+  explicit StopTokenAbort(std::stop_token token) : mToken(std::move(token)) {
+  }
+
+  bool abort() override {
+    return mToken.stop_requested();
+  }
+
+ private:
+  std::stop_token mToken;
+};
+
+}// namespace
+
+sk_sp<SkData> ShaderWarmup::Cache::load(const SkData& key) {
+  const std::string_view keyView {
+    static_cast<const char*>(key.data()), key.size()};
+  std::unique_lock lock(mMutex);
+  const auto it = mEntries.find(std::string {keyView});
+  if (it == mEntries.end()) {
+    ++mStats.mMisses;
+    return nullptr;
+  }
+  ++mStats.mHits;
+  return it->second;
+}
+
+void ShaderWarmup::Cache::store(
+  const SkData& key,
+  const SkData& data,
+  const SkString&) {
+  std::string keyString {static_cast<const char*>(key.data()), key.size()};
+  auto value = SkData::MakeWithCopy(data.data(), data.size());
+  std::unique_lock lock(mMutex);
+  const auto [it, inserted]
+    = mEntries.insert_or_assign(std::move(keyString), std::move(value));
+  if (inserted) {
+    ++mStats.mEntries;
+    mStats.mBytes += it->first.size() + data.size();
+  }
+}
+
+ShaderWarmup::Cache::Stats ShaderWarmup::Cache::GetStats() const {
+  std::unique_lock lock(mMutex);
+  return mStats;
+}
+
+ShaderWarmup::ShaderWarmup(
+  Cache* cache,
+  ContextFactory contextFactory,
+  std::vector<sk_sp<SkPicture>> corpus,
+  const Options& options)
+  : mCache(cache),
+    mContextFactory(std::move(contextFactory)),
+    mCorpus(std::move(corpus)),
+    mOptions(options) {
+  mThread = std::jthread {std::bind_front(&ShaderWarmup::Run, this)};
+}
+
+ShaderWarmup::ShaderWarmup(
+  Cache* cache,
+  ContextFactory contextFactory,
+  std::filesystem::path corpusDirectory,
+  const Options& options)
+  : mCache(cache),
+    mContextFactory(std::move(contextFactory)),
+    mCorpusDirectory(std::move(corpusDirectory)),
+    mOptions(options) {
+  mThread = std::jthread {std::bind_front(&ShaderWarmup::Run, this)};
+}
+
+ShaderWarmup::~ShaderWarmup() {
+  this->Cancel();
+}
+
+void ShaderWarmup::RequestStop() {
+  mThread.request_stop();
+}
+
+void ShaderWarmup::Cancel() {
+  if (mThread.joinable()) {
+    mThread.request_stop();
+    mThread.join();
+  }
+}
+
+void ShaderWarmup::Wait() {
+  if (mThread.joinable()) {
+    mThread.join();
+  }
+}
+
+bool ShaderWarmup::IsFinished() const noexcept {
+  return mFinished.load(std::memory_order_acquire);
+}
+
+ShaderWarmup::Stats ShaderWarmup::GetStats() const {
+  return mStats;
+}
+
+std::vector<sk_sp<SkPicture>> ShaderWarmup::LoadCorpus(
+  const std::filesystem::path& directory) {
+  std::error_code ec;
+  if (!std::filesystem::is_directory(directory, ec)) {
+    return {};
+  }
+
+  std::vector<std::filesystem::path> paths;
+  for (const auto& entry:
+       std::filesystem::directory_iterator {directory, ec}) {
+    if (entry.path().extension() == ".skp") {
+      paths.push_back(entry.path());
+    }
+  }
+  // Stable, so that warmups are repeatable
+  std::ranges::sort(paths);
+
+  std::vector<sk_sp<SkPicture>> ret;
+  for (const auto& path: paths) {
+    // `string()` is in the active code page; Skia's Windows file functions
+    // expect UTF-8
+    const std::string utf8Path {
+      reinterpret_cast<const char*>(path.u8string().c_str())};
+    SkFILEStream stream {utf8Path.c_str()};
+    auto picture = SkPicture::MakeFromStream(&stream);
+    if (!picture) {
+      OutputDebugStringA(
+        std::format("Failed to load warmup capture `{}`\n", utf8Path)
+          .c_str());
+      continue;
+    }
+    ret.push_back(std::move(picture));
+  }
+  return ret;
+}
+
+void ShaderWarmup::Run(std::stop_token stopToken) {
+  SetThreadDescription(GetCurrentThread(), L"HelloSkia Shader Warmup");
+  const auto start = std::chrono::steady_clock::now();
+  const auto finish = [&] {
+    mStats.mCancelled = stopToken.stop_requested();
+    mStats.mDuration = std::chrono::steady_clock::now() - start;
+    mFinished.store(true, std::memory_order_release);
+  };
+
+  if (!mCorpusDirectory.empty()) {
+    mCorpus = LoadCorpus(mCorpusDirectory);
+  }
+  // Creating a context can take longer than the first frame, so check both
+  // before and after
+  if (mCorpus.empty() || stopToken.stop_requested()) {
+    finish();
+    return;
+  }
+
+  GrContextOptions contextOptions;
+  contextOptions.fPersistentCache = mCache;
+  auto context = mContextFactory(contextOptions);
+  if (stopToken.stop_requested()) {
+    // The context must be destroyed on the thread that created it
+    context.reset();
+    finish();
+    return;
+  }
+  const auto tileSize = mOptions.mTileSize;
+  auto surface = context ? SkSurfaces::RenderTarget(
+                             context.get(),
+                             skgpu::Budgeted::kNo,
+                             SkImageInfo::MakeN32Premul(tileSize, tileSize))
+                         : nullptr;
+  if (!surface) {
+    OutputDebugStringA("Failed to create a shader warmup surface\n");
+    context.reset();
+    finish();
+    return;
+  }
+
+  StopTokenAbort abort {stopToken};
+  auto canvas = surface->getCanvas();
+  for (const auto& picture: mCorpus) {
+    const auto bounds = picture->cullRect().roundOut();
+    size_t tiles = 0;
+    for (auto y = bounds.top(); y < bounds.bottom(); y += tileSize) {
+      for (auto x = bounds.left(); x < bounds.right(); x += tileSize) {
+        if (stopToken.stop_requested()) {
+          break;
+        }
+        if (tiles >= mOptions.mMaxTilesPerPicture) {
+          break;
+        }
+        canvas->clear(SK_ColorTRANSPARENT);
+        {
+          SkAutoCanvasRestore restore {canvas, true};
+          canvas->translate(
+            static_cast<SkScalar>(-x), static_cast<SkScalar>(-y));
+          picture->playback(canvas, &abort);
+        }
+        // Pipelines are created when ops are prepared for execution
+        context->flushAndSubmit(surface.get(), GrSyncCpu::kNo);
+        ++tiles;
+      }
+    }
+    mStats.mTiles += tiles;
+    if (stopToken.stop_requested()) {
+      break;
+    }
+    ++mStats.mPictures;
+  }
+
+  // The context must be destroyed on the thread that uses it
+  context->flushAndSubmit(GrSyncCpu::kYes);
+  surface.reset();
+  context.reset();
+  finish();
+}
@@ -0,0 +1,127 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkData.h>
+#include <skia/core/SkPicture.h>
+#include <skia/gpu/GrContextOptions.h>
+#include <skia/gpu/GrDirectContext.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/** Compiles shaders and pipelines before the first real frame.
+ *
+ * A corpus of representative captures is replayed on a background thread,
+ * into tiles of a small offscreen surface at their original scale, so that
+ * draws take the same paths - and need the same pipelines - as real frames.
+ *
+ * Ganesh contexts are not thread-safe, so the warmup creates its own
+ * context; the two contexts share compiled shaders through a `Cache`, which
+ * must be the `GrContextOptions::fPersistentCache` of both.
+ *
+ * Stop the warmup when real rendering starts, so that it doesn't compete
+ * with real frames; playback is aborted between draws. `RequestStop()` does
+ * not block, so the render thread can request a stop, then release the
+ * warmup once `IsFinished()`.
+ */
+class ShaderWarmup final {
+ public:
+  /// An in-memory, thread-safe `GrContextOptions::PersistentCache`
+  class Cache final : public GrContextOptions::PersistentCache {
+   public:
+    struct Stats {
+      size_t mEntries {};
+      size_t mBytes {};
+      size_t mHits {};
+      size_t mMisses {};
+    };
+
+    sk_sp<SkData> load(const SkData& key) override;
+    void store(
+      const SkData& key,
+      const SkData& data,
+      const SkString& description) override;
+
+    [[nodiscard]] Stats GetStats() const;
+
+   private:
+    mutable std::mutex mMutex;
+    std::unordered_map<std::string, sk_sp<SkData>> mEntries;
+    Stats mStats;
+  };
+
+  /// Called on the warmup thread; the context must be created with `options`
+  using ContextFactory
+    = std::function<sk_sp<GrDirectContext>(const GrContextOptions& options)>;
+
+  struct Options {
+    int mTileSize {512};
+    // Large captures are only partially replayed
+    size_t mMaxTilesPerPicture {16};
+  };
+
+  struct Stats {
+    size_t mPictures {};
+    size_t mTiles {};
+    bool mCancelled {false};
+    std::chrono::steady_clock::duration mDuration {};
+  };
+
+  /// Starts the warmup thread
+  ShaderWarmup(
+    Cache*,
+    ContextFactory,
+    std::vector<sk_sp<SkPicture>> corpus,
+    const Options&);
+  /// Starts the warmup thread, which loads the corpus with `LoadCorpus()`
+  ShaderWarmup(
+    Cache*,
+    ContextFactory,
+    std::filesystem::path corpusDirectory,
+    const Options&);
+  /// Cancels the warmup
+  ~ShaderWarmup();
+
+  ShaderWarmup() = delete;
+  ShaderWarmup(const ShaderWarmup&) = delete;
+  ShaderWarmup(ShaderWarmup&&) = delete;
+  ShaderWarmup& operator=(const ShaderWarmup&) = delete;
+  ShaderWarmup& operator=(ShaderWarmup&&) = delete;
+
+  /// Asks the thread to stop as soon as possible, without waiting for it
+  void RequestStop();
+  /// Stops as soon as possible, and waits for the thread to exit
+  void Cancel();
+  /// Waits for the corpus to be replayed
+  void Wait();
+  [[nodiscard]] bool IsFinished() const noexcept;
+  /// Only valid once `IsFinished()`
+  [[nodiscard]] Stats GetStats() const;
+
+  /// Every `.skp` in `directory`; empty if it doesn't exist
+  static std::vector<sk_sp<SkPicture>> LoadCorpus(
+    const std::filesystem::path& directory);
+
+ private:
+  Cache* mCache {nullptr};
+  ContextFactory mContextFactory;
+  // If set, `mCorpus` is loaded from here by the warmup thread
+  std::filesystem::path mCorpusDirectory;
+  std::vector<sk_sp<SkPicture>> mCorpus;
+  Options mOptions;
+
+  Stats mStats;
+  std::atomic_bool mFinished {false};
+  std::jthread mThread;
+
+  void Run(std::stop_token);
+};
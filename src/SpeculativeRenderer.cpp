@@ -0,0 +1,149 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "SpeculativeRenderer.hpp"
+
+#include <algorithm>
+
+SpeculativeRenderer::SpeculativeRenderer(
+  GrDirectContext* context,
+  DrawFrameFn drawFrame,
+  size_t maxFramesAhead)
+  : mContext(context),
+    mDrawFrame(std::move(drawFrame)),
+    mMaxFramesAhead(maxFramesAhead) {
+}
+
+SpeculativeRenderer::~SpeculativeRenderer() = default;
+
+void SpeculativeRenderer::Invalidate() {
+  for (auto& slot: mSlots) {
+    this->Discard(slot);
+  }
+}
+
+void SpeculativeRenderer::SetStateHash(size_t hash) {
+  if (hash == mStateHash) {
+    return;
+  }
+  mStateHash = hash;
+  this->Invalidate();
+}
+
+void SpeculativeRenderer::SetMaxFramesAhead(size_t maxFramesAhead) {
+  mMaxFramesAhead = maxFramesAhead;
+  if (mSlots.size() <= maxFramesAhead) {
+    return;
+  }
+  for (auto i = maxFramesAhead; i < mSlots.size(); ++i) {
+    this->Discard(mSlots.at(i));
+  }
+  mSlots.resize(maxFramesAhead);
+}
+
+bool SpeculativeRenderer::DrawFrame(SkCanvas* canvas, uint64_t frame) {
+  for (auto& slot: mSlots) {
+    if (slot.mFrame && *slot.mFrame < frame) {
+      this->Discard(slot);
+    }
+  }
+
+  if (auto slot = this->FindSlot(frame)) {
+    const auto size = canvas->getBaseLayerSize();
+    if (
+      slot->mSurface->width() == size.width()
+      && slot->mSurface->height() == size.height()) {
+      slot->mSurface->draw(canvas, 0, 0);
+      slot->mFrame = std::nullopt;
+      ++mStats.mHits;
+      return true;
+    }
+    this->Discard(*slot);
+  }
+
+  mDrawFrame(canvas, frame);
+  ++mStats.mMisses;
+  return false;
+}
+
+size_t SpeculativeRenderer::RenderAhead(
+  SkSurface* compatible,
+  uint64_t currentFrame,
+  std::chrono::steady_clock::time_point deadline) {
+  if (mMaxFramesAhead == 0 || !compatible) {
+    return 0;
+  }
+
+  const auto info = compatible->imageInfo();
+  for (auto& slot: mSlots) {
+    if (slot.mFrame && *slot.mFrame <= currentFrame) {
+      this->Discard(slot);
+    }
+    if (slot.mSurface && slot.mSurface->imageInfo() != info) {
+      this->Discard(slot);
+      slot.mSurface = nullptr;
+    }
+  }
+
+  size_t rendered {};
+  for (auto frame = currentFrame + 1; frame <= currentFrame + mMaxFramesAhead;
+       ++frame) {
+    if (this->FindSlot(frame)) {
+      continue;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    if (start + mFrameCost > deadline) {
+      break;
+    }
+
+    auto slot = std::ranges::find_if(
+      mSlots, [](const Slot& it) { return !it.mFrame.has_value(); });
+    if (slot == mSlots.end()) {
+      if (mSlots.size() >= mMaxFramesAhead) {
+        break;
+      }
+      slot = mSlots.emplace(mSlots.end());
+    }
+    if (!slot->mSurface) {
+      slot->mSurface = compatible->makeSurface(info);
+      if (!slot->mSurface) {
+        break;
+      }
+    }
+
+    auto canvas = slot->mSurface->getCanvas();
+    {
+      SkAutoCanvasRestore restore {canvas, true};
+      canvas->clear(SK_ColorTRANSPARENT);
+      mDrawFrame(canvas, frame);
+    }
+    if (mContext) {
+      mContext->flushAndSubmit(slot->mSurface.get(), GrSyncCpu::kNo);
+    }
+    slot->mFrame = frame;
+    ++mStats.mPreRendered;
+    ++rendered;
+
+    const auto cost = std::chrono::steady_clock::now() - start;
+    mFrameCost = (mFrameCost == decltype(mFrameCost) {})
+      ? cost
+      : ((mFrameCost * 7) + cost) / 8;
+  }
+  return rendered;
+}
+
+SpeculativeRenderer::Stats SpeculativeRenderer::GetStats() const noexcept {
+  return mStats;
+}
+
+void SpeculativeRenderer::Discard(Slot& slot) {
+  if (slot.mFrame) {
+    slot.mFrame = std::nullopt;
+    ++mStats.mDiscarded;
+  }
+}
+
+SpeculativeRenderer::Slot* SpeculativeRenderer::FindSlot(uint64_t frame) {
+  const auto it = std::ranges::find(mSlots, frame, &Slot::mFrame);
+  return (it == mSlots.end()) ? nullptr : &*it;
+}
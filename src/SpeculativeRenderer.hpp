@@ -0,0 +1,111 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkCanvas.h>
+#include <skia/core/SkSurface.h>
+#include <skia/gpu/GrDirectContext.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+/** Renders frames ahead of time while idle, and draws them when they're due.
+ *
+ * This only works for content that is a pure function of the frame number
+ * and of a caller-provided state hash; pre-rendered frames are discarded
+ * when `SetStateHash()` is called with a different hash. Determinism can't
+ * be detected beyond that: call `Invalidate()` whenever anything that isn't
+ * in the hash but affects drawing changes, e.g. input or settings.
+ *
+ * The draw callback is called for frames that may never be shown, so it
+ * must not update per-frame state such as cache ages or counters; do that
+ * once per presented frame, outside of the callback.
+ *
+ * Frames are pre-rendered into offscreen surfaces that are compatible with
+ * the target, starting from transparent, so drawing them is a single image
+ * draw, which absorbs CPU spikes in later frames. As each frame is
+ * composited with source-over, content must only use blend modes for which
+ * that is equivalent to drawing it directly - e.g. source-over.
+ *
+ * Not thread-safe.
+ */
+class SpeculativeRenderer final {
+ public:
+  using DrawFrameFn = std::function<void(SkCanvas*, uint64_t frame)>;
+
+  struct Stats {
+    // Pre-rendered frames that were drawn
+    size_t mHits {};
+    // Frames that were not pre-rendered, so were drawn directly
+    size_t mMisses {};
+    size_t mPreRendered {};
+    // Pre-rendered, but invalidated or skipped before they were drawn
+    size_t mDiscarded {};
+  };
+
+  /// `context` should be `nullptr` for raster surfaces
+  SpeculativeRenderer(
+    GrDirectContext* context,
+    DrawFrameFn drawFrame,
+    size_t maxFramesAhead);
+  ~SpeculativeRenderer();
+
+  SpeculativeRenderer() = delete;
+  SpeculativeRenderer(const SpeculativeRenderer&) = delete;
+  SpeculativeRenderer(SpeculativeRenderer&&) = delete;
+  SpeculativeRenderer& operator=(const SpeculativeRenderer&) = delete;
+  SpeculativeRenderer& operator=(SpeculativeRenderer&&) = delete;
+
+  /// Discards all pre-rendered frames
+  void Invalidate();
+  /// Discards all pre-rendered frames if `hash` has changed
+  void SetStateHash(size_t hash);
+  /// Discards pre-rendered frames beyond the new limit; 0 disables
+  void SetMaxFramesAhead(size_t);
+
+  /** Draws `frame`, from a pre-rendered frame if there is one.
+   *
+   * Returns true if a pre-rendered frame was used. Pre-rendered frames
+   * before `frame` are discarded.
+   */
+  bool DrawFrame(SkCanvas*, uint64_t frame);
+
+  /** Pre-renders the frames after `currentFrame` until `deadline`.
+   *
+   * A frame is only started if it is expected to finish before the
+   * deadline, based on previous frames. Surfaces are created by
+   * `compatible->makeSurface()`.
+   *
+   * Returns the number of frames pre-rendered.
+   */
+  size_t RenderAhead(
+    SkSurface* compatible,
+    uint64_t currentFrame,
+    std::chrono::steady_clock::time_point deadline);
+
+  [[nodiscard]] Stats GetStats() const noexcept;
+
+ private:
+  struct Slot {
+    sk_sp<SkSurface> mSurface;
+    std::optional<uint64_t> mFrame;
+  };
+
+  GrDirectContext* mContext {nullptr};
+  DrawFrameFn mDrawFrame;
+  size_t mMaxFramesAhead {};
+  size_t mStateHash {};
+  // Surfaces are reused, even if they don't currently hold a frame
+  std::vector<Slot> mSlots;
+  // Exponential moving average of the cost of pre-rendering a frame
+  std::chrono::steady_clock::duration mFrameCost {};
+
+  Stats mStats;
+
+  void Discard(Slot&);
+  [[nodiscard]] Slot* FindSlot(uint64_t frame);
+};
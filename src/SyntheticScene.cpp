@@ -0,0 +1,388 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "SyntheticScene.hpp"
+
+#include "SeededRandom.hpp"
+
+#include <skia/core/SkMaskFilter.h>
+#include <skia/core/SkRRect.h>
+#include <skia/core/SkSurface.h>
+#include <skia/effects/SkGradientShader.h>
+#include <skia/effects/SkImageFilters.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace {
+
+constexpr SyntheticScene::ShapeMix UIMix {
+  .mRects = 2,
+  .mRoundRects = 4,
+  .mText = 4,
+};
+constexpr SyntheticScene::ShapeMix EverythingMix {
+  .mRects = 2,
+  .mRoundRects = 2,
+  .mPaths = 1,
+  .mText = 3,
+  .mImages = 1,
+  .mEffects = 0.25f,
+};
+
+constexpr SyntheticScene::NamedConfig StandardCorpus[] {
+  {"ui-sparse",
+   {.mSeed = 1,
+    .mElementCount = 200,
+    .mShapeMix = UIMix,
+    .mDepth = 3,
+    .mAnimationRate = 0.02f}},
+  {"ui-dense",
+   {.mSeed = 2,
+    .mElementCount = 5'000,
+    .mShapeMix = UIMix,
+    .mOverlap = 0.2f,
+    .mDepth = 5,
+    .mAnimationRate = 0.05f}},
+  {"text-heavy",
+   {.mSeed = 3,
+    .mElementCount = 10'000,
+    .mShapeMix = {.mRects = 1, .mText = 8},
+    .mDepth = 3}},
+  {"vector-paths",
+   {.mSeed = 4,
+    .mElementCount = 5'000,
+    .mShapeMix = {.mPaths = 1},
+    .mOverlap = 0.3f,
+    .mDepth = 2}},
+  {"images",
+   {.mSeed = 5,
+    .mElementCount = 2'000,
+    .mShapeMix = {.mImages = 1},
+    .mDepth = 2}},
+  {"effects",
+   {.mSeed = 6,
+    .mElementCount = 500,
+    .mShapeMix = {.mRoundRects = 1, .mEffects = 1},
+    .mDepth = 2}},
+  {"deep-nesting",
+   {.mSeed = 7,
+    .mElementCount = 2'000,
+    .mShapeMix = UIMix,
+    .mDepth = 12}},
+  {"high-overlap",
+   {.mSeed = 8,
+    .mElementCount = 5'000,
+    .mShapeMix = EverythingMix,
+    .mOverlap = 0.9f,
+    .mDepth = 2}},
+  {"animated",
+   {.mSeed = 9,
+    .mElementCount = 5'000,
+    .mShapeMix = EverythingMix,
+    .mDepth = 4,
+    .mAnimationRate = 1}},
+  {"mixed-large",
+   {.mSeed = 10,
+    .mElementCount = 50'000,
+    .mShapeMix = EverythingMix,
+    .mOverlap = 0.1f,
+    .mDepth = 6,
+    .mAnimationRate = 0.1f}},
+};
+
+constexpr std::string_view Words[] {
+  "Lorem",
+  "ipsum",
+  "dolor",
+  "sit amet",
+  "Settings",
+  "OK",
+  "Cancel",
+  "1,234.56",
+  "Frame time",
+  "GPU",
+};
+
+sk_sp<SkImage> MakeImage(SeededRandom& random) {
+  static constexpr int Size = 64;
+  auto surface = SkSurfaces::Raster(SkImageInfo::MakeN32Premul(Size, Size));
+  auto canvas = surface->getCanvas();
+
+  const SkPoint points[] {{0, 0}, {Size, Size}};
+  const SkColor colors[] {random.NextColor(), random.NextColor()};
+  SkPaint paint;
+  paint.setShader(SkGradientShader::MakeLinear(
+    points, colors, nullptr, 2, SkTileMode::kClamp));
+  canvas->drawPaint(paint);
+
+  paint.setShader(nullptr);
+  paint.setAntiAlias(true);
+  paint.setColor(random.NextColor());
+  canvas->drawCircle(Size / 2, Size / 2, Size / 3, paint);
+  return surface->makeImageSnapshot();
+}
+
+SkPath MakePolygon(SeededRandom& random, const SkRect& rect) {
+  const auto points = 5 + random.NextIndex(7);
+  const auto cx = rect.centerX();
+  const auto cy = rect.centerY();
+  SkPath path;
+  for (size_t i = 0; i < points; ++i) {
+    const auto theta
+      = (2 * std::numbers::pi_v<SkScalar> * i) / static_cast<SkScalar>(points);
+    const auto r = random.Next(0.4f, 1);
+    const auto x = cx + (std::cos(theta) * r * rect.width() / 2);
+    const auto y = cy + (std::sin(theta) * r * rect.height() / 2);
+    if (i == 0) {
+      path.moveTo(x, y);
+    } else {
+      path.lineTo(x, y);
+    }
+  }
+  path.close();
+  return path;
+}
+
+}// namespace
+
+std::span<const SyntheticScene::NamedConfig>
+SyntheticScene::GetStandardCorpus() {
+  return StandardCorpus;
+}
+
+const SyntheticScene::Config* SyntheticScene::FindInStandardCorpus(
+  std::string_view name) {
+  const auto it = std::ranges::find(
+    StandardCorpus, name, &NamedConfig::mName);
+  if (it == std::end(StandardCorpus)) {
+    return nullptr;
+  }
+  return &it->mConfig;
+}
+
+SyntheticScene::SyntheticScene(
+  const Config& config,
+  const SkISize& size,
+  const SkFont& font)
+  : mConfig(config) {
+  SeededRandom random {config.mSeed};
+
+  const auto& mix = config.mShapeMix;
+  const float weights[] {
+    mix.mRects,
+    mix.mRoundRects,
+    mix.mPaths,
+    mix.mText,
+    mix.mImages,
+    mix.mEffects,
+  };
+  float totalWeight = 0;
+  for (const auto weight: weights) {
+    totalWeight += weight;
+  }
+  const auto pickKind = [&]() {
+    auto remaining = random.Next() * totalWeight;
+    for (size_t i = 0; i < std::size(weights); ++i) {
+      if (remaining < weights[i]) {
+        return static_cast<Kind>(i);
+      }
+      remaining -= weights[i];
+    }
+    return Kind::Rect;
+  };
+
+  if (mix.mImages > 0) {
+    for (size_t i = 0; i < 4; ++i) {
+      mImages.push_back(MakeImage(random));
+    }
+  }
+  // Shared between elements, as real content shares styles
+  const sk_sp<SkMaskFilter> blurs[] {
+    SkMaskFilter::MakeBlur(kNormal_SkBlurStyle, 2),
+    SkMaskFilter::MakeBlur(kNormal_SkBlurStyle, 6),
+  };
+  const auto shadow = SkImageFilters::DropShadow(
+    2, 4, 4, 4, SkColorSetARGB(0x80, 0, 0, 0), nullptr);
+
+  const auto addElement = [&](const SkRect& region, size_t countInGroup) {
+    const auto baseSize = std::clamp<SkScalar>(
+      0.9f * std::sqrt(region.width() * region.height() / countInGroup),
+      4,
+      160);
+    const auto spread = 1 - (0.9f * config.mOverlap);
+    const auto cx = region.width() * (0.5f + ((random.Next() - 0.5f) * spread));
+    const auto cy
+      = region.height() * (0.5f + ((random.Next() - 0.5f) * spread));
+    const auto width = baseSize * random.Next(0.5f, 1.5f);
+    const auto height = baseSize * random.Next(0.5f, 1.5f);
+
+    Element element {
+      .mKind = pickKind(),
+      .mRect = SkRect::MakeXYWH(
+        cx - (width / 2), cy - (height / 2), width, height),
+    };
+    element.mPaint.setAntiAlias(true);
+    element.mPaint.setColor(random.NextColor());
+    if (random.Next() < config.mAnimationRate) {
+      element.mAmplitude = random.Next(4, 16);
+      element.mPhase = random.Next(0, 2 * std::numbers::pi_v<SkScalar>);
+    }
+
+    switch (element.mKind) {
+      case Kind::Rect:
+        break;
+      case Kind::RoundRect:
+        element.mRadius = std::min(width, height) * random.Next(0.1f, 0.4f);
+        if (random.Next() < 0.5f) {
+          element.mPaint.setStyle(SkPaint::kStroke_Style);
+          element.mPaint.setStrokeWidth(random.Next(1, 4));
+        }
+        break;
+      case Kind::Path:
+        element.mPath = MakePolygon(random, element.mRect);
+        if (random.Next() < 0.5f) {
+          element.mPaint.setStyle(SkPaint::kStroke_Style);
+          element.mPaint.setStrokeWidth(random.Next(1, 3));
+        }
+        break;
+      case Kind::Text: {
+        SkFont elementFont = font;
+        elementFont.setSize(std::clamp<SkScalar>(height * 0.8f, 6, 48));
+        const auto word = Words[random.NextIndex(std::size(Words))];
+        element.mTextBlob = SkTextBlob::MakeFromText(
+          word.data(), word.size(), elementFont, SkTextEncoding::kUTF8);
+        break;
+      }
+      case Kind::Image:
+        element.mImage = mImages.at(random.NextIndex(mImages.size()));
+        break;
+      case Kind::Effect:
+        element.mRadius = std::min(width, height) * 0.25f;
+        if (random.Next() < 0.5f) {
+          element.mPaint.setMaskFilter(
+            blurs[random.NextIndex(std::size(blurs))]);
+        } else {
+          element.mPaint.setImageFilter(shadow);
+        }
+        break;
+    }
+    mElements.push_back(std::move(element));
+  };
+
+  // Each group splits its region between two children, along its longest
+  // side, until `mDepth` is reached
+  const auto depth = std::max<size_t>(config.mDepth, 1);
+  const auto addGroup = [&](
+                          const auto& self,
+                          const SkRect& region,
+                          const SkPoint& parentOrigin,
+                          size_t level,
+                          size_t elementCount) -> size_t {
+    const auto index = mGroups.size();
+    mGroups.push_back({
+      .mOffset = {region.x() - parentOrigin.x(), region.y() - parentOrigin.y()},
+      .mClip = SkRect::MakeWH(region.width(), region.height()),
+    });
+
+    if (level + 1 >= depth || elementCount < 2) {
+      mGroups.at(index).mFirstElement = mElements.size();
+      mGroups.at(index).mElementCount = elementCount;
+      for (size_t i = 0; i < elementCount; ++i) {
+        addElement(region, elementCount);
+      }
+      return index;
+    }
+
+    const auto split = random.Next(0.35f, 0.65f);
+    SkRect first = region;
+    SkRect second = region;
+    if (region.width() > region.height()) {
+      first.fRight = second.fLeft = region.x() + (region.width() * split);
+    } else {
+      first.fBottom = second.fTop = region.y() + (region.height() * split);
+    }
+    const SkPoint origin {region.x(), region.y()};
+    const auto firstCount = elementCount / 2;
+    const auto firstIndex = self(self, first, origin, level + 1, firstCount);
+    const auto secondIndex
+      = self(self, second, origin, level + 1, elementCount - firstCount);
+    mGroups.at(index).mChildren = {firstIndex, secondIndex};
+    return index;
+  };
+
+  mElements.reserve(config.mElementCount);
+  addGroup(addGroup, SkRect::Make(size), {0, 0}, 0, config.mElementCount);
+}
+
+const SyntheticScene::Config& SyntheticScene::GetConfig() const noexcept {
+  return mConfig;
+}
+
+size_t SyntheticScene::GetGroupCount() const noexcept {
+  return mGroups.size();
+}
+
+void SyntheticScene::Draw(SkCanvas* canvas, size_t frame) const {
+  this->DrawGroup(canvas, mGroups.front(), frame);
+}
+
+void SyntheticScene::DrawGroup(
+  SkCanvas* canvas,
+  const Group& group,
+  size_t frame) const {
+  canvas->save();
+  canvas->translate(group.mOffset.x(), group.mOffset.y());
+  canvas->clipRect(group.mClip);
+  for (const auto child: group.mChildren) {
+    this->DrawGroup(canvas, mGroups.at(child), frame);
+  }
+  for (size_t i = 0; i < group.mElementCount; ++i) {
+    this->DrawElement(canvas, mElements.at(group.mFirstElement + i), frame);
+  }
+  canvas->restore();
+}
+
+void SyntheticScene::DrawElement(
+  SkCanvas* canvas,
+  const Element& element,
+  size_t frame) const {
+  const bool animated = element.mAmplitude > 0;
+  if (animated) {
+    const auto t = (static_cast<SkScalar>(frame) * 0.05f) + element.mPhase;
+    canvas->save();
+    canvas->translate(
+      element.mAmplitude * std::sin(t), element.mAmplitude * std::cos(t));
+  }
+
+  const auto& rect = element.mRect;
+  switch (element.mKind) {
+    case Kind::Rect:
+      canvas->drawRect(rect, element.mPaint);
+      break;
+    case Kind::RoundRect:
+    case Kind::Effect:
+      canvas->drawRoundRect(
+        rect, element.mRadius, element.mRadius, element.mPaint);
+      break;
+    case Kind::Path:
+      canvas->drawPath(element.mPath, element.mPaint);
+      break;
+    case Kind::Text:
+      canvas->drawTextBlob(
+        element.mTextBlob, rect.left(), rect.bottom(), element.mPaint);
+      break;
+    case Kind::Image:
+      canvas->drawImageRect(
+        element.mImage,
+        rect,
+        SkSamplingOptions {SkFilterMode::kLinear},
+        &element.mPaint);
+      break;
+  }
+
+  if (animated) {
+    canvas->restore();
+  }
+}
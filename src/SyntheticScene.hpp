@@ -0,0 +1,115 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkCanvas.h>
+#include <skia/core/SkFont.h>
+#include <skia/core/SkImage.h>
+#include <skia/core/SkPaint.h>
+#include <skia/core/SkPath.h>
+#include <skia/core/SkTextBlob.h>
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/** A procedurally-generated scene for benchmarks.
+ *
+ * The same `Config` always produces the same scene, on any platform: the
+ * generator uses `std::mt19937_64` directly instead of the standard
+ * distributions, as their output is implementation-defined.
+ *
+ * Elements are grouped into a tree of `mDepth` levels; each group translates
+ * and clips to its own region of the canvas, like nested views in a UI.
+ */
+class SyntheticScene final {
+ public:
+  /// Relative weights; they do not need to add up to anything in particular
+  struct ShapeMix {
+    float mRects {};
+    float mRoundRects {};
+    float mPaths {};
+    float mText {};
+    float mImages {};
+    // Blurred or shadowed round rects
+    float mEffects {};
+  };
+
+  struct Config {
+    uint64_t mSeed {};
+    size_t mElementCount {};
+    ShapeMix mShapeMix;
+    // 0 spreads elements over their group; 1 piles them into its center
+    float mOverlap {};
+    // Levels of nested save/translate/clip; at least 1
+    size_t mDepth {1};
+    // The fraction of elements that move each frame
+    float mAnimationRate {};
+  };
+
+  struct NamedConfig {
+    std::string_view mName;
+    Config mConfig;
+  };
+
+  /// Configurations shared by every benchmark that uses synthetic scenes
+  static std::span<const NamedConfig> GetStandardCorpus();
+  /// `nullptr` if there is no configuration with that name
+  static const Config* FindInStandardCorpus(std::string_view name);
+
+  SyntheticScene(const Config&, const SkISize&, const SkFont&);
+  SyntheticScene(const SyntheticScene&) = delete;
+  SyntheticScene(SyntheticScene&&) = delete;
+  SyntheticScene& operator=(const SyntheticScene&) = delete;
+  SyntheticScene& operator=(SyntheticScene&&) = delete;
+
+  void Draw(SkCanvas*, size_t frame) const;
+
+  [[nodiscard]] const Config& GetConfig() const noexcept;
+  [[nodiscard]] size_t GetGroupCount() const noexcept;
+
+ private:
+  enum class Kind {
+    Rect,
+    RoundRect,
+    Path,
+    Text,
+    Image,
+    Effect,
+  };
+
+  struct Element {
+    Kind mKind {};
+    // In the coordinate space of the element's group
+    SkRect mRect {};
+    SkScalar mRadius {};
+    SkPaint mPaint;
+    SkPath mPath;
+    sk_sp<SkTextBlob> mTextBlob;
+    sk_sp<SkImage> mImage;
+    // 0 for static elements
+    SkScalar mAmplitude {};
+    SkScalar mPhase {};
+  };
+
+  struct Group {
+    // Relative to the parent group
+    SkPoint mOffset {};
+    SkRect mClip {};
+    std::vector<size_t> mChildren;
+    // Only leaf groups contain elements
+    size_t mFirstElement {};
+    size_t mElementCount {};
+  };
+
+  Config mConfig;
+  std::vector<sk_sp<SkImage>> mImages;
+  std::vector<Element> mElements;
+  // The first group is the root
+  std::vector<Group> mGroups;
+
+  void DrawGroup(SkCanvas*, const Group&, size_t frame) const;
+  void DrawElement(SkCanvas*, const Element&, size_t frame) const;
+};
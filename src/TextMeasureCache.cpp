@@ -0,0 +1,205 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "TextMeasureCache.hpp"
+
+#include "HashCombine.hpp"
+
+#include <skia/core/SkTypeface.h>
+
+#include <cstring>
+
+namespace {
+
+// Rough per-node cost of the map and LRU list, for the byte budget
+constexpr size_t NodeOverhead = 64;
+
+bool IsASCII(std::string_view text) {
+  // Branch-free over 8 bytes at a time, so that the compiler can vectorize
+  static constexpr uint64_t HighBits = 0x8080'8080'8080'8080;
+  uint64_t bits {};
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= text.size(); i += sizeof(uint64_t)) {
+    uint64_t chunk {};
+    memcpy(&chunk, text.data() + i, sizeof(chunk));
+    bits |= chunk;
+  }
+  for (; i < text.size(); ++i) {
+    bits |= static_cast<uint8_t>(text[i]);
+  }
+  return (bits & HighBits) == 0;
+}
+
+SkScalar SumAdvances(
+  const std::array<SkScalar, 128>& advances,
+  std::string_view text) {
+  // Independent accumulators, so that the adds can be pipelined
+  SkScalar sums[4] {};
+  const auto bytes = reinterpret_cast<const uint8_t*>(text.data());
+  size_t i = 0;
+  for (; i + 4 <= text.size(); i += 4) {
+    sums[0] += advances[bytes[i]];
+    sums[1] += advances[bytes[i + 1]];
+    sums[2] += advances[bytes[i + 2]];
+    sums[3] += advances[bytes[i + 3]];
+  }
+  for (; i < text.size(); ++i) {
+    sums[0] += advances[bytes[i]];
+  }
+  return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+}// namespace
+
+double TextMeasureCache::Stats::GetHitRate() const noexcept {
+  if (mLookups == 0) {
+    return 0;
+  }
+  return static_cast<double>(mTableHits + mStringHits) / mLookups;
+}
+
+size_t TextMeasureCache::Hash::operator()(const FontKey& key) const noexcept {
+  size_t seed {};
+  HashCombine(seed, key.mTypefaceID);
+  HashCombine(seed, key.mSize);
+  HashCombine(seed, key.mScaleX);
+  HashCombine(seed, key.mSkewX);
+  HashCombine(seed, static_cast<int>(key.mEdging));
+  HashCombine(seed, static_cast<int>(key.mHinting));
+  return seed;
+}
+
+size_t TextMeasureCache::Hash::operator()(
+  const StringKey& key) const noexcept {
+  size_t seed = std::hash<std::string> {}(key.mText);
+  HashCombine(seed, (*this)(key.mFont));
+  return seed;
+}
+
+TextMeasureCache::TextMeasureCache(size_t byteBudget)
+  : mByteBudget(byteBudget) {
+}
+
+const TextMeasureCache::FontEntry& TextMeasureCache::GetFontEntry(
+  const SkFont& font) {
+  const auto typeface = font.getTypeface();
+  FontKey key {
+    .mTypefaceID = typeface ? typeface->uniqueID() : SkTypefaceID {},
+    .mSize = font.getSize(),
+    .mScaleX = font.getScaleX(),
+    .mSkewX = font.getSkewX(),
+    .mEdging = font.getEdging(),
+    .mHinting = font.getHinting(),
+    .mEmbolden = font.isEmbolden(),
+    .mSubpixel = font.isSubpixel(),
+    .mLinearMetrics = font.isLinearMetrics(),
+  };
+
+  if (auto it = mFonts.find(key); it != mFonts.end()) {
+    auto& entry = it->second;
+    mFontLRU.splice(mFontLRU.begin(), mFontLRU, entry.mLRUPosition);
+    return entry;
+  }
+
+  ++mStats.mFontMisses;
+  auto [it, inserted] = mFonts.emplace(std::move(key), FontEntry {});
+  auto& entry = it->second;
+
+  // Each ASCII character is a single UTF-8 byte
+  char chars[128];
+  for (size_t i = 0; i < std::size(chars); ++i) {
+    chars[i] = static_cast<char>(i);
+  }
+  SkGlyphID glyphs[128];
+  font.textToGlyphs(
+    chars, std::size(chars), SkTextEncoding::kUTF8, glyphs, std::size(glyphs));
+  font.getWidths(glyphs, std::size(glyphs), entry.mAdvances.data());
+  font.getMetrics(&entry.mMetrics);
+
+  mFontLRU.push_front(&it->first);
+  entry.mLRUPosition = mFontLRU.begin();
+  mStats.mBytes += sizeof(FontKey) + sizeof(FontEntry) + NodeOverhead;
+  this->EnforceBudget();
+  return entry;
+}
+
+SkScalar TextMeasureCache::MeasureText(
+  std::string_view text,
+  const SkFont& font) {
+  ++mStats.mLookups;
+  const auto& fontEntry = this->GetFontEntry(font);
+  if (IsASCII(text)) {
+    ++mStats.mTableHits;
+    return SumAdvances(fontEntry.mAdvances, text);
+  }
+
+  // The font entry is the most recently used, so we know it's in the front
+  // of the LRU list
+  StringKey key {std::string {text}, *mFontLRU.front()};
+  if (auto it = mStrings.find(key); it != mStrings.end()) {
+    ++mStats.mStringHits;
+    auto& entry = it->second;
+    mStringLRU.splice(mStringLRU.begin(), mStringLRU, entry.mLRUPosition);
+    return entry.mWidth;
+  }
+
+  ++mStats.mStringMisses;
+  const auto width
+    = font.measureText(text.data(), text.size(), SkTextEncoding::kUTF8);
+  const auto bytes
+    = sizeof(StringKey) + sizeof(StringEntry) + text.size() + NodeOverhead;
+  auto [it, inserted]
+    = mStrings.emplace(std::move(key), StringEntry {width, bytes});
+  mStringLRU.push_front(&it->first);
+  it->second.mLRUPosition = mStringLRU.begin();
+  mStats.mBytes += bytes;
+  this->EnforceBudget();
+  return width;
+}
+
+SkFontMetrics TextMeasureCache::GetMetrics(const SkFont& font) {
+  return this->GetFontEntry(font).mMetrics;
+}
+
+void TextMeasureCache::EnforceBudget() {
+  // Strings are cheaper to measure again than fonts are, so go first. The
+  // most recently used entry is never evicted, as the caller is using it.
+  while (mStats.mBytes > mByteBudget && mStringLRU.size() > 1) {
+    const auto it = mStrings.find(*mStringLRU.back());
+    mStats.mBytes -= it->second.mBytes;
+    mStringLRU.pop_back();
+    mStrings.erase(it);
+    ++mStats.mEvictions;
+  }
+  while (mStats.mBytes > mByteBudget && mFontLRU.size() > 1) {
+    const auto it = mFonts.find(*mFontLRU.back());
+    mFontLRU.pop_back();
+    mFonts.erase(it);
+    mStats.mBytes -= sizeof(FontKey) + sizeof(FontEntry) + NodeOverhead;
+    ++mStats.mEvictions;
+  }
+}
+
+void TextMeasureCache::SetByteBudget(size_t byteBudget) {
+  mByteBudget = byteBudget;
+  this->EnforceBudget();
+}
+
+void TextMeasureCache::Clear() {
+  mStrings.clear();
+  mStringLRU.clear();
+  mFonts.clear();
+  mFontLRU.clear();
+  mStats.mBytes = 0;
+}
+
+TextMeasureCache::Stats TextMeasureCache::GetStats() const noexcept {
+  auto ret = mStats;
+  ret.mStrings = mStrings.size();
+  ret.mFonts = mFonts.size();
+  return ret;
+}
+
+void TextMeasureCache::ResetStats() noexcept {
+  mStats = {.mBytes = mStats.mBytes};
+}
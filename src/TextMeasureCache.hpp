@@ -0,0 +1,124 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkFont.h>
+#include <skia/core/SkFontMetrics.h>
+
+#include <array>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/** Caches the widths of strings, and the metrics of fonts.
+ *
+ * For each font (typeface, size, and rendering options), we keep a table of
+ * the advances of the 128 ASCII characters; measuring an ASCII string is then
+ * a sum of table lookups, without converting to glyphs or asking the glyph
+ * cache. Other strings are measured by Skia, and the result is cached by
+ * string and font.
+ *
+ * Like `SkFont::measureText()`, widths are the sum of the glyph advances;
+ * kerning is not applied.
+ *
+ * When the estimated size of the cache goes over the byte budget, the least
+ * recently used strings are evicted first, then the least recently used
+ * fonts.
+ *
+ * Not thread-safe.
+ */
+class TextMeasureCache final {
+ public:
+  static constexpr size_t DefaultByteBudget = 1024 * 1024;
+
+  struct Stats {
+    size_t mLookups {};
+    // ASCII strings that were measured with an advance table
+    size_t mTableHits {};
+    size_t mStringHits {};
+    size_t mStringMisses {};
+    // Advance tables that were built
+    size_t mFontMisses {};
+    size_t mEvictions {};
+
+    size_t mStrings {};
+    size_t mFonts {};
+    size_t mBytes {};
+
+    [[nodiscard]] double GetHitRate() const noexcept;
+  };
+
+  explicit TextMeasureCache(size_t byteBudget = DefaultByteBudget);
+  TextMeasureCache(const TextMeasureCache&) = delete;
+  TextMeasureCache(TextMeasureCache&&) = delete;
+  TextMeasureCache& operator=(const TextMeasureCache&) = delete;
+  TextMeasureCache& operator=(TextMeasureCache&&) = delete;
+
+  /// UTF-8
+  [[nodiscard]] SkScalar MeasureText(std::string_view, const SkFont&);
+  [[nodiscard]] SkFontMetrics GetMetrics(const SkFont&);
+
+  void Clear();
+  /// Evicts entries if the cache is now over budget
+  void SetByteBudget(size_t);
+
+  [[nodiscard]] Stats GetStats() const noexcept;
+  /// Resets counters; sizes are unchanged
+  void ResetStats() noexcept;
+
+ private:
+  struct FontKey {
+    SkTypefaceID mTypefaceID {};
+    SkScalar mSize {};
+    SkScalar mScaleX {};
+    SkScalar mSkewX {};
+    SkFont::Edging mEdging {};
+    SkFontHinting mHinting {};
+    bool mEmbolden {};
+    bool mSubpixel {};
+    bool mLinearMetrics {};
+
+    bool operator==(const FontKey&) const noexcept = default;
+  };
+  struct StringKey {
+    std::string mText;
+    FontKey mFont;
+
+    bool operator==(const StringKey&) const noexcept = default;
+  };
+  struct Hash {
+    size_t operator()(const FontKey&) const noexcept;
+    size_t operator()(const StringKey&) const noexcept;
+  };
+
+  // Most recently used first; these point to keys in the maps, which are
+  // stable as `std::unordered_map` is node-based
+  using FontLRU = std::list<const FontKey*>;
+  using StringLRU = std::list<const StringKey*>;
+
+  struct FontEntry {
+    // Contiguous, so that summing can be vectorized
+    std::array<SkScalar, 128> mAdvances {};
+    SkFontMetrics mMetrics {};
+    FontLRU::iterator mLRUPosition;
+  };
+  struct StringEntry {
+    SkScalar mWidth {};
+    size_t mBytes {};
+    StringLRU::iterator mLRUPosition;
+  };
+
+  size_t mByteBudget {};
+
+  std::unordered_map<FontKey, FontEntry, Hash> mFonts;
+  FontLRU mFontLRU;
+  std::unordered_map<StringKey, StringEntry, Hash> mStrings;
+  StringLRU mStringLRU;
+
+  Stats mStats;
+
+  const FontEntry& GetFontEntry(const SkFont&);
+  void EnforceBudget();
+};
@@ -0,0 +1,187 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "ThumbnailBatcher.hpp"
+
+#include "OutputColorType.hpp"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <format>
+
+ThumbnailBatcher::ThumbnailBatcher(
+  GrDirectContext* context,
+  SkSurface* compatible,
+  const Options& options)
+  : mContext(context),
+    mCompatible(compatible),
+    mOptions(options) {
+}
+
+ThumbnailBatcher::~ThumbnailBatcher() = default;
+
+std::vector<SkBitmap> ThumbnailBatcher::Render(
+  std::span<const Thumbnail> thumbnails) {
+  const auto& atlasSize = mOptions.mAtlasSize;
+  std::vector<SkBitmap> ret(thumbnails.size());
+
+  // Shelf packing: fill rows left-to-right, and start a new row - or a new
+  // atlas - when the next thumbnail doesn't fit
+  std::vector<Cell> cells;
+  SkIPoint cursor {0, 0};
+  int shelfHeight = 0;
+  for (size_t i = 0; i < thumbnails.size(); ++i) {
+    const auto& size = thumbnails[i].mSize;
+    ++mStats.mThumbnails;
+    if (size.isEmpty()) {
+      continue;
+    }
+    if (
+      size.width() > atlasSize.width() || size.height() > atlasSize.height()) {
+      ++mStats.mOversized;
+      ret.at(i) = this->RenderAlone(thumbnails[i]);
+      continue;
+    }
+
+    if (cursor.x() + size.width() > atlasSize.width()) {
+      cursor = {0, cursor.y() + shelfHeight};
+      shelfHeight = 0;
+    }
+    if (cursor.y() + size.height() > atlasSize.height()) {
+      this->RenderAtlas(thumbnails, cells, ret);
+      cells.clear();
+      cursor = {0, 0};
+      shelfHeight = 0;
+    }
+    cells.push_back({i, cursor});
+    cursor.fX += size.width();
+    shelfHeight = std::max(shelfHeight, size.height());
+  }
+  if (!cells.empty()) {
+    this->RenderAtlas(thumbnails, cells, ret);
+  }
+  return ret;
+}
+
+void ThumbnailBatcher::RenderAtlas(
+  std::span<const Thumbnail> thumbnails,
+  std::span<const Cell> cells,
+  std::vector<SkBitmap>& results) {
+  if (!mAtlas) {
+    mAtlas = mCompatible->makeSurface(mCompatible->imageInfo().makeWH(
+      mOptions.mAtlasSize.width(), mOptions.mAtlasSize.height()));
+    if (!mAtlas) {
+      OutputDebugStringA("Failed to create thumbnail atlas\n");
+      mStats.mFailed += cells.size();
+      return;
+    }
+  }
+
+  int usedHeight = 0;
+  for (const auto& cell: cells) {
+    usedHeight = std::max(
+      usedHeight, cell.mOrigin.y() + thumbnails[cell.mIndex].mSize.height());
+  }
+  const auto usedWidth = mOptions.mAtlasSize.width();
+
+  auto canvas = mAtlas->getCanvas();
+  {
+    SkAutoCanvasRestore restore {canvas, true};
+    canvas->clipIRect(SkIRect::MakeWH(usedWidth, usedHeight));
+    canvas->clear(mOptions.mBackground);
+  }
+  for (const auto& cell: cells) {
+    const auto& thumbnail = thumbnails[cell.mIndex];
+    SkAutoCanvasRestore restore {canvas, true};
+    canvas->translate(
+      static_cast<SkScalar>(cell.mOrigin.x()),
+      static_cast<SkScalar>(cell.mOrigin.y()));
+    canvas->clipIRect(SkIRect::MakeSize(thumbnail.mSize));
+    thumbnail.mDraw(canvas);
+  }
+
+  if (mContext) {
+    mContext->flushAndSubmit(mAtlas.get(), GrSyncCpu::kYes);
+  }
+  // Only read back the shelves that were used
+  SkBitmap pixels;
+  if (
+    !pixels.tryAllocPixels(mAtlas->imageInfo().makeWH(usedWidth, usedHeight))
+    || !mAtlas->readPixels(pixels, 0, 0)) {
+    OutputDebugStringA(
+      std::format(
+        "Failed to read back a {}x{} thumbnail atlas\n", usedWidth, usedHeight)
+        .c_str());
+    mStats.mFailed += cells.size();
+    return;
+  }
+  pixels = this->ConvertForOutput(std::move(pixels));
+  if (pixels.drawsNothing()) {
+    mStats.mFailed += cells.size();
+    return;
+  }
+  pixels.setImmutable();
+  ++mStats.mAtlases;
+
+  for (const auto& cell: cells) {
+    pixels.extractSubset(
+      &results.at(cell.mIndex),
+      SkIRect::MakeXYWH(
+        cell.mOrigin.x(),
+        cell.mOrigin.y(),
+        thumbnails[cell.mIndex].mSize.width(),
+        thumbnails[cell.mIndex].mSize.height()));
+  }
+}
+
+SkBitmap ThumbnailBatcher::RenderAlone(const Thumbnail& thumbnail) {
+  const auto info = mCompatible->imageInfo().makeWH(
+    thumbnail.mSize.width(), thumbnail.mSize.height());
+  auto surface = mCompatible->makeSurface(info);
+  SkBitmap ret;
+  if (!(surface && ret.tryAllocPixels(info))) {
+    ++mStats.mFailed;
+    return {};
+  }
+
+  auto canvas = surface->getCanvas();
+  canvas->clear(mOptions.mBackground);
+  thumbnail.mDraw(canvas);
+  if (mContext) {
+    mContext->flushAndSubmit(surface.get(), GrSyncCpu::kYes);
+  }
+  if (!surface->readPixels(ret, 0, 0)) {
+    ++mStats.mFailed;
+    return {};
+  }
+  ret = this->ConvertForOutput(std::move(ret));
+  if (ret.drawsNothing()) {
+    ++mStats.mFailed;
+    return {};
+  }
+  ret.setImmutable();
+  return ret;
+}
+
+SkBitmap ThumbnailBatcher::ConvertForOutput(SkBitmap pixels) const {
+  if (!mOptions.mColorType || *mOptions.mColorType == pixels.colorType()) {
+    return pixels;
+  }
+  SkBitmap ret;
+  if (
+    !ret.tryAllocPixels(MakeOutputInfo(pixels.info(), *mOptions.mColorType))
+    || !ConvertPixels(pixels.pixmap(), ret.pixmap())) {
+    OutputDebugStringA(
+      std::format(
+        "Failed to convert thumbnails to {}\n",
+        GetOutputColorTypeName(*mOptions.mColorType))
+        .c_str());
+    return {};
+  }
+  return ret;
+}
+
+ThumbnailBatcher::Stats ThumbnailBatcher::GetStats() const noexcept {
+  return mStats;
+}
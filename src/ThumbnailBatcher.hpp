@@ -0,0 +1,100 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <skia/core/SkBitmap.h>
+#include <skia/core/SkCanvas.h>
+#include <skia/core/SkSurface.h>
+#include <skia/gpu/GrDirectContext.h>
+
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+/** Renders many small scenes into shared atlas surfaces.
+ *
+ * Creating, flushing, and reading back a surface per thumbnail spends most
+ * of the time on per-surface overhead. Instead, thumbnails are packed into
+ * shelves of an atlas, each translated and clipped to its own cell; each
+ * atlas is flushed and read back once, and the thumbnails are slices of the
+ * read-back pixels.
+ *
+ * Not thread-safe.
+ */
+class ThumbnailBatcher final {
+ public:
+  /// Draws with the thumbnail's top left at the origin, clipped to its size
+  using DrawFn = std::function<void(SkCanvas*)>;
+
+  struct Thumbnail {
+    SkISize mSize {};
+    DrawFn mDraw;
+  };
+
+  struct Options {
+    // Larger atlases need fewer flushes and readbacks, but more memory
+    SkISize mAtlasSize {2048, 2048};
+    SkColor mBackground {SK_ColorTRANSPARENT};
+    // Of the returned thumbnails; see `GetOutputColorTypes()`. Atlases are
+    // rendered in the compatible surface's color type, and converted when
+    // they're read back. Defaults to the compatible surface's color type.
+    std::optional<SkColorType> mColorType;
+  };
+
+  struct Stats {
+    size_t mThumbnails {};
+    size_t mAtlases {};
+    // Larger than an atlas, so rendered with their own surface
+    size_t mOversized {};
+    size_t mFailed {};
+  };
+
+  /** The atlas is created by `compatible->makeSurface()`.
+   *
+   * `context` should be `nullptr` for raster surfaces.
+   */
+  ThumbnailBatcher(
+    GrDirectContext* context,
+    SkSurface* compatible,
+    const Options&);
+  ~ThumbnailBatcher();
+
+  ThumbnailBatcher() = delete;
+  ThumbnailBatcher(const ThumbnailBatcher&) = delete;
+  ThumbnailBatcher(ThumbnailBatcher&&) = delete;
+  ThumbnailBatcher& operator=(const ThumbnailBatcher&) = delete;
+  ThumbnailBatcher& operator=(ThumbnailBatcher&&) = delete;
+
+  /** Renders every thumbnail, in the same order as `thumbnails`.
+   *
+   * Thumbnails from the same atlas share its pixels, so slicing is free, but
+   * keeping any of them keeps the whole atlas in memory; use
+   * `SkBitmap::copyTo()` or similar for long-lived thumbnails. Empty or
+   * failed thumbnails are empty bitmaps.
+   */
+  std::vector<SkBitmap> Render(std::span<const Thumbnail> thumbnails);
+
+  [[nodiscard]] Stats GetStats() const noexcept;
+
+ private:
+  struct Cell {
+    size_t mIndex {};
+    SkIPoint mOrigin {};
+  };
+
+  GrDirectContext* mContext {nullptr};
+  SkSurface* mCompatible {nullptr};
+  Options mOptions;
+  sk_sp<SkSurface> mAtlas;
+  Stats mStats;
+
+  void RenderAtlas(
+    std::span<const Thumbnail>,
+    std::span<const Cell>,
+    std::vector<SkBitmap>& results);
+  SkBitmap RenderAlone(const Thumbnail&);
+  /// `pixels` if no conversion is needed; empty on failure
+  SkBitmap ConvertForOutput(SkBitmap pixels) const;
+};
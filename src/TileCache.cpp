@@ -0,0 +1,478 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "TileCache.hpp"
+
+#include "OutputColorType.hpp"
+
+#include <lz4.h>
+#include <skia/codec/SkCodec.h>
+#include <skia/codec/SkJpegDecoder.h>
+#include <skia/core/SkBitmap.h>
+#include <skia/gpu/ganesh/SkImageGanesh.h>
+
+#include <algorithm>
+#include <format>
+#include <tuple>
+
+namespace {
+
+size_t GetByteSize(const SkImage* image) {
+  return image->imageInfo().computeMinByteSize();
+}
+
+/// Decodes directly if the codec supports it - e.g. JPEG to RGB565 -
+/// otherwise decodes to N32 and converts
+std::tuple<sk_sp<SkImage>, SkCodec::Result> DecodeAs(
+  SkCodec* codec,
+  SkColorType colorType) {
+  SkBitmap bitmap;
+  if (!bitmap.tryAllocPixels(MakeOutputInfo(codec->getInfo(), colorType))) {
+    return {nullptr, SkCodec::kInternalError};
+  }
+  auto result
+    = codec->getPixels(bitmap.info(), bitmap.getPixels(), bitmap.rowBytes());
+  if (result == SkCodec::kInvalidConversion) {
+    const auto [decoded, decodeResult] = codec->getImage();
+    SkPixmap pixels;
+    if (!(decoded && decoded->peekPixels(&pixels))) {
+      return {nullptr, decodeResult};
+    }
+    result = ConvertPixels(pixels, bitmap.pixmap())
+      ? SkCodec::kSuccess
+      : SkCodec::kInvalidConversion;
+  }
+  if (result != SkCodec::kSuccess) {
+    return {nullptr, result};
+  }
+  bitmap.setImmutable();
+  return {SkImages::RasterFromBitmap(bitmap), result};
+}
+
+}// namespace
+
+double TileCache::Stats::GetMissRate() const noexcept {
+  if (mLookups == 0) {
+    return 0;
+  }
+  return static_cast<double>(mMisses) / mLookups;
+}
+
+template <class T>
+typename TileCache::Tier<T>::Entry* TileCache::Tier<T>::Find(
+  const TileKey& key,
+  uint64_t frame) {
+  const auto it = mEntries.find(key);
+  if (it == mEntries.end()) {
+    return nullptr;
+  }
+  mLRU.splice(mLRU.begin(), mLRU, it->second.mLRUPosition);
+  it->second.mLastUsedFrame = frame;
+  return &it->second;
+}
+
+template <class T>
+void TileCache::Tier<T>::Insert(
+  const TileKey& key,
+  T value,
+  size_t bytes,
+  uint64_t frame) {
+  if (mEntries.contains(key)) {
+    return;
+  }
+  mLRU.push_front(key);
+  mEntries.emplace(key, Entry {std::move(value), bytes, frame, mLRU.begin()});
+  mBytes += bytes;
+}
+
+template <class T>
+std::optional<T> TileCache::Tier<T>::Remove(const TileKey& key) {
+  const auto it = mEntries.find(key);
+  if (it == mEntries.end()) {
+    return std::nullopt;
+  }
+  auto ret = std::move(it->second.mValue);
+  mBytes -= it->second.mBytes;
+  mLRU.erase(it->second.mLRUPosition);
+  mEntries.erase(it);
+  return ret;
+}
+
+template <class T>
+template <class TOnEvict>
+size_t TileCache::Tier<T>::Evict(
+  uint64_t unusedSinceFrame,
+  TOnEvict&& onEvict) {
+  size_t evicted = 0;
+  // Keep the most recently used tile, even if it's over budget by itself
+  while (mLRU.size() > 1) {
+    const auto it = mEntries.find(mLRU.back());
+    if (mBytes <= mBudget && it->second.mLastUsedFrame >= unusedSinceFrame) {
+      break;
+    }
+    mBytes -= it->second.mBytes;
+    onEvict(it->first, std::move(it->second.mValue));
+    mEntries.erase(it);
+    mLRU.pop_back();
+    ++evicted;
+  }
+  return evicted;
+}
+
+TileCache::TileCache(
+  const TileContainer& container,
+  GrDirectContext* context,
+  const Budget& budget,
+  size_t decodeThreads)
+  : mContainer(container),
+    mContext(context) {
+  mGPU.mBudget = budget.mGPUBytes;
+  mCPU.mBudget = budget.mCPUBytes;
+  mCompressed.mBudget = mCompressionPolicy.mBudgetBytes;
+
+  if (decodeThreads == 0) {
+    // Leave a core for the render thread
+    decodeThreads
+      = std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 5) - 1;
+  }
+  for (size_t i = 0; i < decodeThreads; ++i) {
+    mWorkers.emplace_back(std::bind_front(&TileCache::RunJobs, this));
+  }
+}
+
+TileCache::~TileCache() {
+  // Request stop and join before anything the workers use is destroyed
+  mWorkers.clear();
+}
+
+void TileCache::SetCompressionPolicy(const CompressionPolicy& policy) {
+  mCompressionPolicy = policy;
+  mCompressed.mBudget = policy.mEnabled ? policy.mBudgetBytes : 0;
+}
+
+TileCache::CompressionPolicy TileCache::GetCompressionPolicy()
+  const noexcept {
+  return mCompressionPolicy;
+}
+
+void TileCache::SetColorType(SkColorType colorType) {
+  mColorType = colorType;
+}
+
+SkColorType TileCache::GetColorType() const noexcept {
+  return mColorType;
+}
+
+void TileCache::BeginFrame() {
+  ++mFrame;
+
+  decltype(mDecoded) decoded;
+  decltype(mCompressedResults) compressed;
+  {
+    std::unique_lock lock(mMutex);
+    decoded = std::exchange(mDecoded, {});
+    compressed = std::exchange(mCompressedResults, {});
+
+    const auto workerStats = std::exchange(mWorkerStats, {});
+    mStats.mDecodes += workerStats.mDecodes;
+    mStats.mDecompressions += workerStats.mDecompressions;
+    mStats.mCompressions += workerStats.mCompressions;
+    mStats.mDecodeTime += workerStats.mDecodeTime;
+    mStats.mDecompressTime += workerStats.mDecompressTime;
+    mStats.mCompressTime += workerStats.mCompressTime;
+
+    for (const auto& job: mVisibleQueue) {
+      mPending.erase(job.mKey);
+    }
+    for (const auto& job: mPrefetchQueue) {
+      mPending.erase(job.mKey);
+    }
+    mVisibleQueue.clear();
+    mPrefetchQueue.clear();
+  }
+
+  for (auto&& [key, image]: decoded) {
+    // No-op unless this was decompressed
+    mCompressed.Remove(key);
+    const auto bytes = GetByteSize(image.get());
+    mCPU.Insert(key, std::move(image), bytes, mFrame);
+  }
+
+  for (auto&& [key, image]: compressed) {
+    // If it's not in mCompressing, it was used again while compressing, and
+    // is back in the CPU tier
+    if (mCompressing.erase(key) && image.mData) {
+      const auto bytes = image.mData->size();
+      mCompressed.Insert(key, std::move(image), bytes, mFrame);
+    }
+  }
+  mStats.mCompressedEvictions
+    += mCompressed.Evict(0, [](const TileKey&, CompressedImage&&) {});
+
+  this->EvictFromCPU();
+}
+
+void TileCache::EvictFromCPU() {
+  const auto& policy = mCompressionPolicy;
+  if (!policy.mEnabled) {
+    mStats.mCPUEvictions
+      += mCPU.Evict(0, [](const TileKey&, sk_sp<SkImage>&&) {});
+    return;
+  }
+
+  const auto unusedSince
+    = (mFrame > policy.mColdFrames) ? (mFrame - policy.mColdFrames) : 0;
+  mStats.mCPUEvictions += mCPU.Evict(
+    unusedSince, [this](const TileKey& key, sk_sp<SkImage>&& image) {
+      this->Compress(key, std::move(image));
+    });
+}
+
+void TileCache::Compress(const TileKey& key, sk_sp<SkImage> image) {
+  mCompressing.emplace(key, image);
+  {
+    std::unique_lock lock(mMutex);
+    mCompressQueue.push_back({
+      .mKind = Job::Kind::Compress,
+      .mKey = key,
+      .mImage = std::move(image),
+      .mAcceleration = mCompressionPolicy.mAcceleration,
+    });
+  }
+  mWorkAvailable.notify_one();
+}
+
+sk_sp<SkImage> TileCache::Get(const TileKey& key) {
+  auto ret = this->FindImpl(key, /* countStats = */ true);
+  if (!ret) {
+    this->Request(key, Priority::Visible);
+  }
+  return ret;
+}
+
+sk_sp<SkImage> TileCache::Find(const TileKey& key) {
+  return this->FindImpl(key, /* countStats = */ false);
+}
+
+sk_sp<SkImage> TileCache::FindImpl(const TileKey& key, bool countStats) {
+  if (countStats) {
+    ++mStats.mLookups;
+  }
+
+  if (const auto entry = mGPU.Find(key, mFrame)) {
+    if (countStats) {
+      ++mStats.mGPUHits;
+    }
+    return entry->mValue;
+  }
+
+  sk_sp<SkImage> image;
+  if (const auto entry = mCPU.Find(key, mFrame)) {
+    if (countStats) {
+      ++mStats.mCPUHits;
+    }
+    image = entry->mValue;
+  } else if (const auto it = mCompressing.find(key);
+             it != mCompressing.end()) {
+    if (countStats) {
+      ++mStats.mCPUHits;
+    }
+    image = std::move(it->second);
+    mCompressing.erase(it);
+    mCPU.Insert(key, image, GetByteSize(image.get()), mFrame);
+    this->EvictFromCPU();
+  } else if (
+    countStats && mCompressionPolicy.mDecompressOnRenderThread
+    && mCompressed.mEntries.contains(key)) {
+    const auto start = std::chrono::steady_clock::now();
+    image = Decompress(*mCompressed.Remove(key));
+    mStats.mDecompressTime += std::chrono::steady_clock::now() - start;
+    ++mStats.mDecompressions;
+    if (image) {
+      ++mStats.mCompressedHits;
+      mCPU.Insert(key, image, GetByteSize(image.get()), mFrame);
+      this->EvictFromCPU();
+    }
+  }
+
+  if (!image) {
+    if (countStats) {
+      ++mStats.mMisses;
+    }
+    return nullptr;
+  }
+
+  if (!mContext) {
+    return image;
+  }
+
+  // Keep the CPU copy too, so that if the texture is evicted, it can be
+  // uploaded again without decoding
+  auto texture = SkImages::TextureFromImage(
+    mContext, image, skgpu::Mipmapped::kNo, skgpu::Budgeted::kYes);
+  if (!texture) {
+    return image;
+  }
+  ++mStats.mUploads;
+  mGPU.Insert(key, texture, GetByteSize(texture.get()), mFrame);
+  mStats.mGPUEvictions
+    += mGPU.Evict(0, [](const TileKey&, sk_sp<SkImage>&&) {});
+  return texture;
+}
+
+bool TileCache::Request(const TileKey& key, Priority priority) {
+  if (
+    mGPU.mEntries.contains(key) || mCPU.mEntries.contains(key)
+    || mCompressing.contains(key)) {
+    return false;
+  }
+
+  Job job {
+    .mKind = Job::Kind::Decode,
+    .mKey = key,
+    .mColorType = mColorType,
+  };
+  if (const auto it = mCompressed.mEntries.find(key);
+      it != mCompressed.mEntries.end()) {
+    job.mKind = Job::Kind::Decompress;
+    // Shares the compressed buffer
+    job.mCompressed = it->second.mValue;
+  }
+
+  {
+    std::unique_lock lock(mMutex);
+    if (!mPending.insert(key).second) {
+      return false;
+    }
+    (priority == Priority::Visible ? mVisibleQueue : mPrefetchQueue)
+      .push_back(std::move(job));
+  }
+  mWorkAvailable.notify_one();
+  return true;
+}
+
+void TileCache::RunJobs(std::stop_token stopToken) {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock lock(mMutex);
+      const auto haveWork = mWorkAvailable.wait(lock, stopToken, [this]() {
+        return !(
+          mVisibleQueue.empty() && mPrefetchQueue.empty()
+          && mCompressQueue.empty());
+      });
+      if (!haveWork) {
+        // Stop requested
+        return;
+      }
+      auto& queue = !mVisibleQueue.empty()
+        ? mVisibleQueue
+        : (!mPrefetchQueue.empty() ? mPrefetchQueue : mCompressQueue);
+      job = std::move(queue.front());
+      queue.pop_front();
+    }
+    this->RunJob(job);
+  }
+}
+
+void TileCache::RunJob(Job& job) {
+  const auto& key = job.mKey;
+  const auto start = std::chrono::steady_clock::now();
+
+  if (job.mKind == Job::Kind::Compress) {
+    CompressedImage compressed;
+    SkPixmap pixels;
+    if (job.mImage->peekPixels(&pixels)) {
+      const auto sourceBytes = pixels.computeByteSize();
+      std::vector<char> buffer(LZ4_compressBound(sourceBytes));
+      const auto size = LZ4_compress_fast(
+        static_cast<const char*>(pixels.addr()),
+        buffer.data(),
+        static_cast<int>(sourceBytes),
+        static_cast<int>(buffer.size()),
+        job.mAcceleration);
+      if (size > 0) {
+        compressed = {
+          SkData::MakeWithCopy(buffer.data(), size),
+          pixels.info(),
+          pixels.rowBytes(),
+          sourceBytes,
+        };
+      }
+    }
+
+    std::unique_lock lock(mMutex);
+    mWorkerStats.mCompressTime += std::chrono::steady_clock::now() - start;
+    ++mWorkerStats.mCompressions;
+    // Added even if it failed, so that it's removed from mCompressing
+    mCompressedResults.emplace_back(key, std::move(compressed));
+    return;
+  }
+
+  sk_sp<SkImage> image;
+  SkCodec::Result result {};
+  if (job.mKind == Job::Kind::Decompress) {
+    image = Decompress(job.mCompressed);
+  } else if (auto codec = SkJpegDecoder::Decode(
+               mContainer.GetEncodedTile(key), &result)) {
+    std::tie(image, result) = (job.mColorType == kN32_SkColorType)
+      ? codec->getImage()
+      : DecodeAs(codec.get(), job.mColorType);
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  std::unique_lock lock(mMutex);
+  if (job.mKind == Job::Kind::Decompress) {
+    ++mWorkerStats.mDecompressions;
+    mWorkerStats.mDecompressTime += elapsed;
+  } else {
+    ++mWorkerStats.mDecodes;
+    mWorkerStats.mDecodeTime += elapsed;
+  }
+
+  if (!image) {
+    OutputDebugStringA(std::format(
+                         "Failed to load tile {}/{}/{}: {}\n",
+                         key.mLevel,
+                         key.mX,
+                         key.mY,
+                         static_cast<int>(result))
+                         .c_str());
+    // Leave it pending, so that it isn't requested again
+    return;
+  }
+  mPending.erase(key);
+  mDecoded.emplace_back(key, std::move(image));
+}
+
+sk_sp<SkImage> TileCache::Decompress(const CompressedImage& compressed) {
+  if (!compressed.mData) {
+    return nullptr;
+  }
+  auto pixels = SkData::MakeUninitialized(compressed.mSourceBytes);
+  const auto size = LZ4_decompress_safe(
+    static_cast<const char*>(compressed.mData->data()),
+    static_cast<char*>(pixels->writable_data()),
+    static_cast<int>(compressed.mData->size()),
+    static_cast<int>(compressed.mSourceBytes));
+  if (size < 0 || static_cast<size_t>(size) != compressed.mSourceBytes) {
+    return nullptr;
+  }
+  return SkImages::RasterFromData(
+    compressed.mInfo, std::move(pixels), compressed.mRowBytes);
+}
+
+TileCache::Stats TileCache::GetStats() const {
+  auto ret = mStats;
+  ret.mGPUBytes = mGPU.mBytes;
+  ret.mCPUBytes = mCPU.mBytes;
+  ret.mCompressedBytes = mCompressed.mBytes;
+  for (const auto& [key, entry]: mCompressed.mEntries) {
+    ret.mCompressedSourceBytes += entry.mValue.mSourceBytes;
+  }
+  return ret;
+}
+
+void TileCache::ResetStats() {
+  mStats = {};
+}
@@ -0,0 +1,235 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "TileContainer.hpp"
+
+#include <skia/core/SkImage.h>
+#include <skia/gpu/GrDirectContext.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/** A multi-level LRU cache of decoded tiles, with background decoding.
+ *
+ * - the GPU tier holds textures uploaded from the CPU tier; it is unused if
+ *   there is no `GrDirectContext`
+ * - the CPU tier holds decoded raster images
+ * - the compressed tier holds LZ4-compressed pixels of tiles that went cold
+ *   in the CPU tier; see `CompressionPolicy`
+ *
+ * Tiles that are not in any tier are decoded from the `TileContainer` by
+ * worker threads; decoded tiles are added to the CPU tier by `BeginFrame()`.
+ * The same workers compress and decompress tiles.
+ *
+ * Requests that have not started decoding are dropped by `BeginFrame()`, so
+ * each frame should request the tiles it needs, most important first. This
+ * stops workers decoding tiles that are no longer needed after a fast pan.
+ *
+ * Apart from the worker threads, not thread-safe.
+ */
+class TileCache final {
+ public:
+  struct Budget {
+    size_t mGPUBytes {256 * 1024 * 1024};
+    size_t mCPUBytes {512 * 1024 * 1024};
+  };
+
+  /** When and how to compress tiles.
+   *
+   * Tiles are compressed when they are evicted from the CPU tier, or when
+   * they have not been used for `mColdFrames`, whichever comes first.
+   * Decompressing is much cheaper than decoding a JPEG, but is still work on
+   * the path of a cache hit; `mDecompressOnRenderThread` picks between adding
+   * that latency to the frame, or treating the tile as missing until a
+   * worker has decompressed it.
+   */
+  struct CompressionPolicy {
+    bool mEnabled {true};
+    size_t mBudgetBytes {256 * 1024 * 1024};
+    uint64_t mColdFrames {120};
+    bool mDecompressOnRenderThread {true};
+    // Passed to `LZ4_compress_fast()`; higher is faster, but compresses less
+    int mAcceleration {1};
+  };
+
+  enum class Priority {
+    Visible,
+    Prefetch,
+  };
+
+  struct Stats {
+    size_t mLookups {};
+    size_t mGPUHits {};
+    size_t mCPUHits {};
+    // Decompressed on the render thread
+    size_t mCompressedHits {};
+    size_t mMisses {};
+
+    size_t mDecodes {};
+    size_t mUploads {};
+    size_t mCompressions {};
+    size_t mDecompressions {};
+    size_t mGPUEvictions {};
+    size_t mCPUEvictions {};
+    size_t mCompressedEvictions {};
+
+    // Total time spent, on any thread
+    std::chrono::nanoseconds mDecodeTime {};
+    std::chrono::nanoseconds mCompressTime {};
+    std::chrono::nanoseconds mDecompressTime {};
+
+    size_t mGPUBytes {};
+    size_t mCPUBytes {};
+    size_t mCompressedBytes {};
+    // The uncompressed size of the tiles in the compressed tier
+    size_t mCompressedSourceBytes {};
+
+    [[nodiscard]] double GetMissRate() const noexcept;
+  };
+
+  /// `decodeThreads` of 0 picks a count based on the number of cores
+  TileCache(
+    const TileContainer&,
+    GrDirectContext*,
+    const Budget&,
+    size_t decodeThreads = 0);
+  ~TileCache();
+  TileCache(const TileCache&) = delete;
+  TileCache(TileCache&&) = delete;
+  TileCache& operator=(const TileCache&) = delete;
+  TileCache& operator=(TileCache&&) = delete;
+
+  void SetCompressionPolicy(const CompressionPolicy&);
+  [[nodiscard]] CompressionPolicy GetCompressionPolicy() const noexcept;
+
+  /** The color type of decoded tiles; see `GetOutputColorTypes()`.
+   *
+   * Smaller color types fit more tiles in each tier, and make compressing
+   * and uploading cheaper. Only affects tiles that are decoded afterwards.
+   */
+  void SetColorType(SkColorType);
+  [[nodiscard]] SkColorType GetColorType() const noexcept;
+
+  /// Adds finished work to the caches, and drops stale requests
+  void BeginFrame();
+
+  /** Returns the tile if it is in the GPU or CPU tier.
+   *
+   * If it is compressed, it is decompressed as described by the
+   * `CompressionPolicy`. Otherwise, this requests it with
+   * `Priority::Visible`, and returns `nullptr`. Counted in the stats.
+   */
+  sk_sp<SkImage> Get(const TileKey&);
+  /// Like `Get()`, but does not request or decompress the tile, and is not
+  /// counted
+  sk_sp<SkImage> Find(const TileKey&);
+  /** Queues the tile for decoding or decompression.
+   *
+   * Returns false if the tile is already cached or requested.
+   */
+  bool Request(const TileKey&, Priority);
+
+  [[nodiscard]] Stats GetStats() const;
+  void ResetStats();
+
+ private:
+  struct CompressedImage {
+    sk_sp<SkData> mData;
+    SkImageInfo mInfo;
+    size_t mRowBytes {};
+    size_t mSourceBytes {};
+  };
+
+  using LRU = std::list<TileKey>;
+  template <class T>
+  struct Tier {
+    struct Entry {
+      T mValue;
+      size_t mBytes {};
+      uint64_t mLastUsedFrame {};
+      LRU::iterator mLRUPosition;
+    };
+    std::unordered_map<TileKey, Entry> mEntries;
+    // Most recently used first
+    LRU mLRU;
+    size_t mBytes {};
+    size_t mBudget {};
+
+    Entry* Find(const TileKey&, uint64_t frame);
+    void Insert(const TileKey&, T, size_t bytes, uint64_t frame);
+    std::optional<T> Remove(const TileKey&);
+    /** Evicts least recently used entries while over budget, or while they
+     * were last used before `frame`.
+     *
+     * `onEvict(key, value)` is called for each evicted entry; returns the
+     * number of evicted entries.
+     */
+    template <class TOnEvict>
+    size_t Evict(uint64_t unusedSinceFrame, TOnEvict&& onEvict);
+  };
+
+  struct Job {
+    enum class Kind {
+      Decode,
+      Decompress,
+      Compress,
+    };
+    Kind mKind {};
+    TileKey mKey;
+    // For Decode
+    SkColorType mColorType {};
+    // For Compress
+    sk_sp<SkImage> mImage;
+    int mAcceleration {};
+    // For Decompress
+    CompressedImage mCompressed;
+  };
+
+  const TileContainer& mContainer;
+  GrDirectContext* mContext {nullptr};
+  CompressionPolicy mCompressionPolicy;
+  SkColorType mColorType {kN32_SkColorType};
+  uint64_t mFrame {};
+
+  Tier<sk_sp<SkImage>> mGPU;
+  Tier<sk_sp<SkImage>> mCPU;
+  Tier<CompressedImage> mCompressed;
+  // Evicted from the CPU tier, and waiting for a worker to compress them;
+  // if they're used again in the meantime, they go back in the CPU tier
+  std::unordered_map<TileKey, sk_sp<SkImage>> mCompressing;
+  Stats mStats;
+
+  // Shared with the workers
+  mutable std::mutex mMutex;
+  std::condition_variable_any mWorkAvailable;
+  std::deque<Job> mVisibleQueue;
+  std::deque<Job> mPrefetchQueue;
+  // Lowest priority
+  std::deque<Job> mCompressQueue;
+  // Decodes and decompressions that are queued or in progress
+  std::unordered_set<TileKey> mPending;
+  std::vector<std::pair<TileKey, sk_sp<SkImage>>> mDecoded;
+  std::vector<std::pair<TileKey, CompressedImage>> mCompressedResults;
+  // Added to mStats by BeginFrame()
+  Stats mWorkerStats;
+
+  std::vector<std::jthread> mWorkers;
+
+  void RunJobs(std::stop_token);
+  void RunJob(Job&);
+
+  sk_sp<SkImage> FindImpl(const TileKey&, bool countStats);
+  void EvictFromCPU();
+  void Compress(const TileKey&, sk_sp<SkImage>);
+  static sk_sp<SkImage> Decompress(const CompressedImage&);
+};
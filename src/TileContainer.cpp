@@ -0,0 +1,258 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#include "TileContainer.hpp"
+
+#include "HashCombine.hpp"
+
+#include <skia/core/SkSurface.h>
+#include <skia/encode/SkJpegEncoder.h>
+
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <fstream>
+
+namespace {
+
+uint32_t DivideRoundingUp(uint32_t a, uint32_t b) {
+  return (a + b - 1) / b;
+}
+
+}// namespace
+
+size_t std::hash<TileKey>::operator()(const TileKey& key) const noexcept {
+  size_t seed {};
+  HashCombine(seed, key.mLevel);
+  HashCombine(seed, key.mX);
+  HashCombine(seed, key.mY);
+  return seed;
+}
+
+TileContainer::~TileContainer() = default;
+
+std::unique_ptr<TileContainer> TileContainer::Open(
+  const std::filesystem::path& path) {
+  const auto fail = [&path](std::string_view why) {
+    OutputDebugStringA(
+      std::format("Failed to open tile container {}: {}\n", path.string(), why)
+        .c_str());
+    return nullptr;
+  };
+
+  std::unique_ptr<TileContainer> ret {new TileContainer()};
+  ret->mFile.reset(CreateFileW(
+    path.wstring().c_str(),
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    nullptr,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,
+    nullptr));
+  if (!ret->mFile) {
+    return fail("CreateFileW() failed");
+  }
+  LARGE_INTEGER fileSize {};
+  if (!GetFileSizeEx(ret->mFile.get(), &fileSize)) {
+    return fail("GetFileSizeEx() failed");
+  }
+  if (static_cast<uint64_t>(fileSize.QuadPart) < sizeof(FileHeader)) {
+    return fail("too small");
+  }
+
+  ret->mMapping.reset(CreateFileMappingW(
+    ret->mFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+  if (!ret->mMapping) {
+    return fail("CreateFileMappingW() failed");
+  }
+  ret->mView.reset(static_cast<std::byte*>(
+    MapViewOfFile(ret->mMapping.get(), FILE_MAP_READ, 0, 0, 0)));
+  if (!ret->mView) {
+    return fail("MapViewOfFile() failed");
+  }
+  ret->mData = {ret->mView.get(), static_cast<size_t>(fileSize.QuadPart)};
+
+  FileHeader header;
+  const FileHeader expected;
+  memcpy(&header, ret->mData.data(), sizeof(header));
+  if (memcmp(header.mMagic, expected.mMagic, sizeof(header.mMagic)) != 0) {
+    return fail("bad magic");
+  }
+  if (header.mVersion != Version) {
+    return fail(std::format("unsupported version {}", header.mVersion));
+  }
+  if (header.mTileSize == 0 || header.mLevelCount == 0) {
+    return fail("invalid header");
+  }
+
+  const auto levelsSize = sizeof(FileLevel) * header.mLevelCount;
+  if (
+    header.mIndexOffset > ret->mData.size()
+    || ret->mData.size() - header.mIndexOffset < levelsSize) {
+    return fail("truncated level index");
+  }
+
+  ret->mSize = SkISize::Make(header.mWidth, header.mHeight);
+  ret->mTileSize = header.mTileSize;
+
+  size_t tileCount = 0;
+  for (uint32_t i = 0; i < header.mLevelCount; ++i) {
+    FileLevel level;
+    memcpy(
+      &level,
+      ret->mData.data() + header.mIndexOffset + (i * sizeof(FileLevel)),
+      sizeof(level));
+    const auto columns = DivideRoundingUp(level.mWidth, header.mTileSize);
+    const auto rows = DivideRoundingUp(level.mHeight, header.mTileSize);
+    ret->mLevels.push_back({level.mWidth, level.mHeight, columns, rows});
+    ret->mFirstTiles.push_back(tileCount);
+    tileCount += static_cast<size_t>(columns) * rows;
+  }
+
+  const auto tilesOffset = header.mIndexOffset + levelsSize;
+  if (
+    (ret->mData.size() - tilesOffset) / sizeof(FileTile) < tileCount
+    || (tilesOffset % alignof(FileTile)) != 0) {
+    return fail("truncated tile index");
+  }
+  // The mapping is page-aligned, and we checked the offset's alignment
+  ret->mTiles = {
+    reinterpret_cast<const FileTile*>(ret->mData.data() + tilesOffset),
+    tileCount};
+  for (const auto& tile: ret->mTiles) {
+    if (
+      tile.mOffset > ret->mData.size()
+      || ret->mData.size() - tile.mOffset < tile.mSize) {
+      return fail("tile out of bounds");
+    }
+  }
+
+  return ret;
+}
+
+bool TileContainer::Write(
+  const std::filesystem::path& path,
+  const SkISize& size,
+  uint32_t tileSize,
+  const std::function<void(SkCanvas*)>& drawSource) {
+  std::ofstream f(path, std::ios::binary | std::ios::trunc);
+  if (!f) {
+    return false;
+  }
+
+  FileHeader header {
+    .mWidth = static_cast<uint32_t>(size.width()),
+    .mHeight = static_cast<uint32_t>(size.height()),
+    .mTileSize = tileSize,
+  };
+  // Written again once we know the index offset
+  f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  // Halve until the whole image fits in one tile
+  std::vector<FileLevel> levels {{header.mWidth, header.mHeight}};
+  while (levels.back().mWidth > tileSize || levels.back().mHeight > tileSize) {
+    levels.push_back({
+      DivideRoundingUp(levels.back().mWidth, 2),
+      DivideRoundingUp(levels.back().mHeight, 2),
+    });
+  }
+
+  std::vector<FileTile> tiles;
+  auto surface = SkSurfaces::Raster(SkImageInfo::Make(
+    tileSize, tileSize, kRGBA_8888_SkColorType, kPremul_SkAlphaType));
+  auto canvas = surface->getCanvas();
+  for (size_t i = 0; i < levels.size(); ++i) {
+    const auto& level = levels.at(i);
+    const auto scale = std::ldexp(1.0f, -static_cast<int>(i));
+    for (uint32_t y = 0; y < level.mHeight; y += tileSize) {
+      for (uint32_t x = 0; x < level.mWidth; x += tileSize) {
+        canvas->clear(SK_ColorBLACK);
+        canvas->save();
+        canvas->translate(-static_cast<SkScalar>(x), -static_cast<SkScalar>(y));
+        canvas->scale(scale, scale);
+        drawSource(canvas);
+        canvas->restore();
+
+        // Edge tiles are smaller
+        const auto subset = SkIRect::MakeXYWH(
+          0,
+          0,
+          std::min(tileSize, level.mWidth - x),
+          std::min(tileSize, level.mHeight - y));
+        SkPixmap pixels;
+        if (!surface->peekPixels(&pixels)) {
+          return false;
+        }
+        SkPixmap tilePixels;
+        pixels.extractSubset(&tilePixels, subset);
+
+        SkDynamicMemoryWStream encoded;
+        if (!SkJpegEncoder::Encode(&encoded, tilePixels, {.fQuality = 85})) {
+          return false;
+        }
+        tiles.push_back({
+          static_cast<uint64_t>(f.tellp()),
+          encoded.bytesWritten(),
+        });
+        const auto data = encoded.detachAsData();
+        f.write(static_cast<const char*>(data->data()), data->size());
+      }
+    }
+  }
+
+  // Keep the FileTile array aligned in the file, so that it can be used
+  // directly from the mapping
+  while ((static_cast<uint64_t>(f.tellp()) % alignof(FileTile)) != 0) {
+    f.put(0);
+  }
+  header.mIndexOffset = f.tellp();
+  header.mLevelCount = static_cast<uint32_t>(levels.size());
+  static_assert(sizeof(FileLevel) % alignof(FileTile) == 0);
+  f.write(
+    reinterpret_cast<const char*>(levels.data()),
+    sizeof(FileLevel) * levels.size());
+  f.write(
+    reinterpret_cast<const char*>(tiles.data()),
+    sizeof(FileTile) * tiles.size());
+
+  f.seekp(0);
+  f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  return f.good();
+}
+
+SkISize TileContainer::GetSize() const noexcept {
+  return mSize;
+}
+
+uint32_t TileContainer::GetTileSize() const noexcept {
+  return mTileSize;
+}
+
+std::span<const TileContainer::Level> TileContainer::GetLevels()
+  const noexcept {
+  return mLevels;
+}
+
+SkRect TileContainer::GetTileBounds(const TileKey& key) const {
+  const auto scale = static_cast<SkScalar>(uint64_t {1} << key.mLevel);
+  const auto size = mTileSize * scale;
+  auto ret = SkRect::MakeXYWH(key.mX * size, key.mY * size, size, size);
+  if (!ret.intersect(SkRect::Make(mSize))) {
+    return SkRect::MakeEmpty();
+  }
+  return ret;
+}
+
+sk_sp<SkData> TileContainer::GetEncodedTile(const TileKey& key) const {
+  if (key.mLevel >= mLevels.size()) {
+    return nullptr;
+  }
+  const auto& level = mLevels.at(key.mLevel);
+  if (key.mX >= level.mColumns || key.mY >= level.mRows) {
+    return nullptr;
+  }
+  const auto& tile = mTiles[mFirstTiles.at(key.mLevel)
+                            + (static_cast<size_t>(key.mY) * level.mColumns)
+                            + key.mX];
+  return SkData::MakeWithoutCopy(mData.data() + tile.mOffset, tile.mSize);
+}
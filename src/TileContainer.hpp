@@ -0,0 +1,114 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <Windows.h>
+#include <skia/core/SkCanvas.h>
+#include <skia/core/SkData.h>
+#include <wil/resource.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+/// Level 0 is full resolution; each level is half the size of the previous
+struct TileKey {
+  uint32_t mLevel {};
+  uint32_t mX {};
+  uint32_t mY {};
+
+  bool operator==(const TileKey&) const noexcept = default;
+};
+
+template <>
+struct std::hash<TileKey> {
+  size_t operator()(const TileKey&) const noexcept;
+};
+
+/** A read-only, memory-mapped file containing a pyramid of JPEG tiles.
+ *
+ * Encoded tiles are returned without copying them out of the mapping, so
+ * only the pages that are actually decoded are read from disk.
+ *
+ * `GetEncodedTile()` is thread-safe.
+ */
+class TileContainer final {
+ public:
+  struct Level {
+    uint32_t mWidth {};
+    uint32_t mHeight {};
+    uint32_t mColumns {};
+    uint32_t mRows {};
+  };
+
+  /// `nullptr` if the file can't be opened, or is not a valid container
+  static std::unique_ptr<TileContainer> Open(const std::filesystem::path&);
+
+  /** Writes a container by rendering each tile of each level.
+   *
+   * `drawSource` draws the full-resolution image; the canvas is transformed
+   * and clipped for each tile.
+   */
+  static bool Write(
+    const std::filesystem::path&,
+    const SkISize& size,
+    uint32_t tileSize,
+    const std::function<void(SkCanvas*)>& drawSource);
+
+  ~TileContainer();
+  TileContainer(const TileContainer&) = delete;
+  TileContainer(TileContainer&&) = delete;
+  TileContainer& operator=(const TileContainer&) = delete;
+  TileContainer& operator=(TileContainer&&) = delete;
+
+  [[nodiscard]] SkISize GetSize() const noexcept;
+  [[nodiscard]] uint32_t GetTileSize() const noexcept;
+  [[nodiscard]] std::span<const Level> GetLevels() const noexcept;
+  /// In level 0 coordinates, clipped to the image
+  [[nodiscard]] SkRect GetTileBounds(const TileKey&) const;
+
+  /// `nullptr` if the key is out of range; valid for the life of `this`
+  [[nodiscard]] sk_sp<SkData> GetEncodedTile(const TileKey&) const;
+
+ private:
+  static constexpr uint32_t Version = 1;
+
+  // File layout: FileHeader, tile data, FileLevel[], FileTile[]
+  struct FileHeader {
+    char mMagic[4] {'H', 'S', 'T', 'C'};
+    uint32_t mVersion {Version};
+    uint32_t mWidth {};
+    uint32_t mHeight {};
+    uint32_t mTileSize {};
+    uint32_t mLevelCount {};
+    // Offset of the FileLevel array
+    uint64_t mIndexOffset {};
+  };
+  struct FileLevel {
+    uint32_t mWidth {};
+    uint32_t mHeight {};
+  };
+  // Row-major within each level, level 0 first
+  struct FileTile {
+    uint64_t mOffset {};
+    uint64_t mSize {};
+  };
+
+  TileContainer() = default;
+
+  wil::unique_hfile mFile;
+  wil::unique_handle mMapping;
+  wil::unique_mapview_ptr<std::byte> mView;
+  std::span<const std::byte> mData;
+
+  SkISize mSize {};
+  uint32_t mTileSize {};
+  std::vector<Level> mLevels;
+  // Index of the first tile of each level in mTiles
+  std::vector<size_t> mFirstTiles;
+  std::span<const FileTile> mTiles;
+};
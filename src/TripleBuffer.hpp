@@ -0,0 +1,71 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+/** Hands the latest value from one writer thread to one reader thread.
+ *
+ * There are three slots: the writer owns one, the reader owns one, and the
+ * third holds the most recently published value. Publishing and acquiring
+ * each swap a slot with the middle one using a single atomic exchange, so
+ * neither thread ever waits for the other; values that are published
+ * faster than they are read are dropped.
+ *
+ * Pair with persistent data structures - e.g. `PersistentVector` - so that
+ * each value is cheap to build and to copy.
+ */
+template <class T>
+class TripleBuffer final {
+ public:
+  explicit TripleBuffer(const T& initial = {}) {
+    mSlots.fill({initial});
+  }
+
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer(TripleBuffer&&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(TripleBuffer&&) = delete;
+
+  /// Writer thread only
+  void Publish(T value) {
+    mSlots[mBack].mValue = std::move(value);
+    const auto previous
+      = mMiddle.exchange(mBack | NewFlag, std::memory_order_acq_rel);
+    mBack = previous & IndexMask;
+  }
+
+  /** Reader thread only; the latest published value.
+   *
+   * The reference is valid until the next call to `Acquire()`.
+   */
+  const T& Acquire() {
+    if (mMiddle.load(std::memory_order_relaxed) & NewFlag) {
+      const auto previous
+        = mMiddle.exchange(mFront, std::memory_order_acq_rel);
+      mFront = previous & IndexMask;
+    }
+    return mSlots[mFront].mValue;
+  }
+
+ private:
+  static constexpr uint8_t IndexMask = 0b11;
+  // The middle slot was published since the reader last swapped
+  static constexpr uint8_t NewFlag = 0b100;
+
+  // Separate cache lines, as the threads write to different slots
+  struct alignas(64) Slot {
+    T mValue;
+  };
+
+  std::array<Slot, 3> mSlots;
+  alignas(64) std::atomic<uint8_t> mMiddle {1};
+  // Only used by the writer
+  alignas(64) uint8_t mBack {2};
+  // Only used by the reader
+  alignas(64) uint8_t mFront {0};
+};
@@ -3,62 +3,46 @@
 
 #include "Win32-Ganesh-D3D12.hpp"
 
-#include <shlobj_core.h>
+#include "HashCombine.hpp"
+#include "Win32Helpers.hpp"
+
 #include <skia/core/SkCanvas.h>
 #include <skia/core/SkColorSpace.h>
 #include <skia/core/SkFontMgr.h>
 #include <skia/core/SkImageInfo.h>
 #include <skia/gpu/GrBackendSemaphore.h>
 #include <skia/gpu/GrBackendSurface.h>
+#include <skia/gpu/GrContextOptions.h>
 #include <skia/gpu/GrDirectContext.h>
 #include <skia/gpu/d3d/GrD3DBackendContext.h>
 #include <skia/gpu/ganesh/SkSurfaceGanesh.h>
 #include <skia/ports/SkFontMgr_empty.h>
 
+#include <charconv>
 #include <chrono>
-#include <filesystem>
 #include <format>
-#include <source_location>
+#include <string>
 
-static inline void CheckHResult(
-  const HRESULT ret,
-  const std::source_location& caller = std::source_location::current()) {
-  if (SUCCEEDED(ret)) [[likely]] {
-    return;
-  }
+namespace {
 
-  const std::error_code ec {ret, std::system_category()};
+constexpr SkScalar BorderStrokeWidth = 2;
 
-  const auto msg = std::format(
-    "HRESULT failed: {:#010x} @ {} - {}:{}:{} - {}\n",
-    std::bit_cast<uint32_t>(ret),
-    caller.function_name(),
-    caller.file_name(),
-    caller.line(),
-    caller.column(),
-    ec.message());
-  OutputDebugStringA(msg.c_str());
-  throw std::system_error(ec);
+std::string GetLabelText(uint64_t frame) {
+  return std::format("Hello Skia: Win32+Ganesh+D3D12 frame {}", frame);
 }
 
-template <const GUID& TFolderID>
-std::filesystem::path GetKnownFolderPath() {
-  wil::unique_cotaskmem_string buf;
-  CheckHResult(
-    SHGetKnownFolderPath(TFolderID, KF_FLAG_DEFAULT, nullptr, buf.put()));
-  std::filesystem::path path {std::wstring_view {buf.get()}};
-  if (std::filesystem::exists(path)) {
-    return std::filesystem::canonical(path);
-  }
-  return {};
-}
+}// namespace
 
 HelloSkiaWindow::HelloSkiaWindow(HINSTANCE instance) {
   gInstance = this;
 
+  this->InitializeProfiler();
+  this->InitializeMetrics();
+  this->InitializeParameters();
   this->CreateNativeWindow(instance);
   this->InitializeD3D();
   this->InitializeSkia();
+  this->CreateLayout();
   this->CreateRenderTargets();
 }
 
@@ -132,7 +116,7 @@ void HelloSkiaWindow::InitializeD3D() {
   {
     D3D12_DESCRIPTOR_HEAP_DESC desc {
       .Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV,
-      .NumDescriptors = SwapChainLength,
+      .NumDescriptors = MaxSwapChainLength,
       .Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE,
     };
     CheckHResult(
@@ -155,7 +139,7 @@ void HelloSkiaWindow::InitializeD3D() {
     .Format = DXGI_FORMAT_R8G8B8A8_UNORM,
     .SampleDesc = {1, 0},
     .BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT,
-    .BufferCount = SwapChainLength,
+    .BufferCount = mSwapChainLength,
     .SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD,
     .AlphaMode = DXGI_ALPHA_MODE_IGNORE,
   };
@@ -177,7 +161,10 @@ void HelloSkiaWindow::InitializeSkia() {
   skiaD3DContext.fDevice.retain(mD3DDevice.get());
   skiaD3DContext.fQueue.retain(mD3DCommandQueue.get());
   // skiaD3DContext.fMemoryAllocator can be left as nullptr
-  mSkContext = GrDirectContext::MakeDirect3D(skiaD3DContext);
+  GrContextOptions options;
+  options.fPersistentCache = &mShaderCache;
+  mSkContext = GrDirectContext::MakeDirect3D(skiaD3DContext, options);
+  this->StartShaderWarmup();
 
   auto fontPath = GetKnownFolderPath<FOLDERID_Fonts>();
   if (fontPath.empty()) {
@@ -189,6 +176,129 @@ void HelloSkiaWindow::InitializeSkia() {
   mSkFont = SkFont {typeface};
 }
 
+void HelloSkiaWindow::StartShaderWarmup() {
+  std::filesystem::path directory;
+  wchar_t path[MAX_PATH] {};
+  const auto length
+    = GetEnvironmentVariableW(L"HELLOSKIA_WARMUP_DIR", path, MAX_PATH);
+  if (length > 0 && length < MAX_PATH) {
+    directory = std::wstring_view {path, length};
+  } else {
+    const auto exeLength = GetModuleFileNameW(nullptr, path, MAX_PATH);
+    if (exeLength == 0 || exeLength >= MAX_PATH) {
+      return;
+    }
+    directory = std::filesystem::path {std::wstring_view {path, exeLength}}
+                  .parent_path()
+      / "warmup";
+  }
+
+  // The corpus is loaded by the warmup thread, as parsing captures would
+  // otherwise delay the first frame
+  mShaderWarmup = std::make_unique<ShaderWarmup>(
+    &mShaderCache,
+    [adapter = mDXGIAdapter, device = mD3DDevice](
+      const GrContextOptions& options) -> sk_sp<GrDirectContext> {
+      // A separate queue, so that warmup submissions don't need to be
+      // synchronized with ours
+      wil::com_ptr<ID3D12CommandQueue> queue;
+      D3D12_COMMAND_QUEUE_DESC desc {
+        .Type = D3D12_COMMAND_LIST_TYPE_DIRECT,
+        .Flags = D3D12_COMMAND_QUEUE_FLAG_NONE,
+      };
+      if (FAILED(
+            device->CreateCommandQueue(&desc, IID_PPV_ARGS(queue.put())))) {
+        return nullptr;
+      }
+      GrD3DBackendContext backendContext {};
+      backendContext.fAdapter.retain(adapter.get());
+      backendContext.fDevice.retain(device.get());
+      backendContext.fQueue.retain(queue.get());
+      return GrDirectContext::MakeDirect3D(backendContext, options);
+    },
+    std::move(directory),
+    ShaderWarmup::Options {});
+}
+
+void HelloSkiaWindow::FinishShaderWarmup() {
+  if (!mShaderWarmup) {
+    return;
+  }
+  // Real frames take priority over anything that hasn't been warmed up yet;
+  // don't wait for the thread here, as it may be in the middle of a draw or
+  // creating its context
+  mShaderWarmup->RequestStop();
+  if (!mShaderWarmup->IsFinished()) {
+    return;
+  }
+  const auto stats = mShaderWarmup->GetStats();
+  const auto cacheStats = mShaderCache.GetStats();
+  OutputDebugStringA(
+    std::format(
+      "Shader warmup {}: {} captures, {} tiles in {}ms; {} cached "
+      "programs ({} bytes)\n",
+      stats.mCancelled ? "cancelled" : "finished",
+      stats.mPictures,
+      stats.mTiles,
+      std::chrono::duration_cast<std::chrono::milliseconds>(stats.mDuration)
+        .count(),
+      cacheStats.mEntries,
+      cacheStats.mBytes)
+      .c_str());
+  mShaderWarmup.reset();
+}
+
+void HelloSkiaWindow::InitializeProfiler() {
+  wchar_t path[MAX_PATH] {};
+  const auto length
+    = GetEnvironmentVariableW(L"HELLOSKIA_PROFILE", path, MAX_PATH);
+  if (length == 0 || length >= MAX_PATH) {
+    return;
+  }
+  mProfilePath = std::wstring_view {path, length};
+  mProfiler = std::make_unique<SamplingProfiler>(SamplingProfiler::Options {});
+  mProfiler->Start();
+}
+
+void HelloSkiaWindow::WriteProfile() {
+  if (!mProfiler) {
+    return;
+  }
+  if (!mProfiler->WriteProfile(mProfilePath)) {
+    return;
+  }
+  const auto stats = mProfiler->GetStats();
+  OutputDebugStringA(std::format(
+                       "Wrote profile to {}: {} samples ({} dropped, {} "
+                       "failed), {:.2f}% overhead, {}us interval\n",
+                       mProfilePath.string(),
+                       stats.mSamples,
+                       stats.mDroppedSamples,
+                       stats.mFailedSamples,
+                       stats.GetOverhead() * 100,
+                       stats.mCurrentInterval.count())
+                       .c_str());
+}
+
+void HelloSkiaWindow::CreateLayout() {
+  mLayoutRoot.SetStyle({.mPadding = LayoutNode::Insets::All(10)});
+  mBorderLayout = mLayoutRoot.AppendChild({
+    .mGap = 10,
+    .mPadding = LayoutNode::Insets::All(20),
+    .mFlexGrow = 1,
+  });
+  mLabelLayout = mBorderLayout->AppendChild();
+  mWidgetsLayout = mBorderLayout->AppendChild({.mFlexGrow = 1});
+  mUI.emplace(mSkFont);
+
+  mSpeculativeRenderer.emplace(
+    mSkContext.get(),
+    [this](SkCanvas* canvas, uint64_t frame) {
+      this->DrawSkiaContent(canvas, frame);
+    },
+    2);
+}
+
 void HelloSkiaWindow::CreateCommandListAndAllocators() {
   for (auto& frame: mFrames) {
     CheckHResult(mD3DDevice->CreateCommandAllocator(
@@ -245,8 +355,176 @@ void HelloSkiaWindow::ConfigureD3DDebugLayer() {
 #endif
 }
 
+void HelloSkiaWindow::InitializeMetrics() {
+  auto& m = mFrameMetrics;
+  const auto timeBuckets = MetricsRegistry::GetDefaultTimeBuckets();
+  m.mFrames = mMetrics.GetCounter(
+    "helloskia_frames_total", "Frames rendered and presented");
+  m.mDroppedFrames = mMetrics.GetCounter(
+    "helloskia_dropped_frames_total",
+    "Refreshes where the previous frame was shown again");
+  m.mFrameSeconds = mMetrics.GetHistogram(
+    "helloskia_frame_seconds",
+    "Time spent rendering and presenting each frame",
+    timeBuckets);
+
+  const auto phase = [&](const char* name) {
+    return mMetrics.GetHistogram(
+      "helloskia_phase_seconds",
+      "Time spent in each phase of a frame",
+      timeBuckets,
+      {{"phase", name}});
+  };
+  m.mPhaseSeconds = {
+    .mWaitForFrame = phase("WaitForFrame"),
+    .mRenderNonSkiaContent = phase("RenderNonSkiaContent"),
+    .mRenderSkiaContent = phase("RenderSkiaContent"),
+    .mFlush = phase("Flush"),
+    .mPresent = phase("Present"),
+  };
+
+  m.mGpuResourceCacheBytes = mMetrics.GetGauge(
+    "helloskia_gpu_resource_cache_bytes",
+    "Bytes used by Skia's GPU resource cache");
+  m.mTextMeasureCacheBytes = mMetrics.GetGauge(
+    "helloskia_text_measure_cache_bytes", "Bytes used by TextMeasureCache");
+  m.mTextMeasureCacheHitRatio = mMetrics.GetGauge(
+    "helloskia_text_measure_cache_hit_ratio",
+    "Fraction of TextMeasureCache lookups that were hits");
+  const auto interner = [&](const char* table) {
+    return mMetrics.GetGauge(
+      "helloskia_interner_hit_ratio",
+      "Fraction of Interner lookups that were hits",
+      {{"table", table}});
+  };
+  m.mInternerPathHitRatio = interner("paths");
+  m.mInternerPaintHitRatio = interner("paints");
+  m.mInternerTextBlobHitRatio = interner("text_blobs");
+
+  const auto optimization = [&](const char* rule) {
+    return mMetrics.GetCounter(
+      "helloskia_display_list_optimizations_total",
+      "Commands removed or rewritten by DisplayList::Optimize()",
+      {{"rule", rule}});
+  };
+  m.mCulledDraws = optimization("cull_draw");
+  m.mRedundantClips = optimization("redundant_clip");
+  m.mFoldedLayers = optimization("fold_layer_alpha");
+  m.mEmptySaves = optimization("empty_save");
+
+  char port[8] {};
+  const auto length
+    = GetEnvironmentVariableA("HELLOSKIA_METRICS_PORT", port, sizeof(port));
+  if (length == 0 || length >= sizeof(port)) {
+    return;
+  }
+  uint16_t portNumber {};
+  const auto [end, ec] = std::from_chars(port, port + length, portNumber);
+  if (ec != std::errc {} || end != port + length || portNumber == 0) {
+    OutputDebugStringA(
+      std::format("Invalid HELLOSKIA_METRICS_PORT: '{}'\n", port).c_str());
+    return;
+  }
+  mMetricsServer = std::make_unique<MetricsServer>(mMetrics, portNumber);
+  if (!mMetricsServer->IsListening()) {
+    mMetricsServer.reset();
+  }
+}
+
+void HelloSkiaWindow::UpdateMetrics() {
+  auto& m = mFrameMetrics;
+  m.mFrames->Increment();
+
+  // With a sync interval of 1, each present should be shown for exactly one
+  // refresh; any extra refreshes repeated an older frame
+  DXGI_FRAME_STATISTICS statistics {};
+  if (SUCCEEDED(mSwapChain->GetFrameStatistics(&statistics))) {
+    if (m.mLastFrameStatistics) {
+      const auto& last = *m.mLastFrameStatistics;
+      const auto presents = statistics.PresentCount - last.PresentCount;
+      const auto refreshes
+        = statistics.PresentRefreshCount - last.PresentRefreshCount;
+      if (refreshes > presents) {
+        m.mDroppedFrames->Increment(refreshes - presents);
+      }
+    }
+    m.mLastFrameStatistics = statistics;
+  } else {
+    // e.g. DXGI_ERROR_FRAME_STATISTICS_DISJOINT after a mode change
+    m.mLastFrameStatistics = std::nullopt;
+  }
+
+  size_t gpuResourceBytes {};
+  mSkContext->getResourceCacheUsage(nullptr, &gpuResourceBytes);
+  m.mGpuResourceCacheBytes->Set(static_cast<double>(gpuResourceBytes));
+
+  const auto textStats = mTextMeasureCache.GetStats();
+  m.mTextMeasureCacheBytes->Set(static_cast<double>(textStats.mBytes));
+  m.mTextMeasureCacheHitRatio->Set(textStats.GetHitRate());
+
+  const auto internerStats = mInterner.GetStats();
+  m.mInternerPathHitRatio->Set(internerStats.mPaths.GetHitRate());
+  m.mInternerPaintHitRatio->Set(internerStats.mPaints.GetHitRate());
+  m.mInternerTextBlobHitRatio->Set(internerStats.mTextBlobs.GetHitRate());
+}
+
+void HelloSkiaWindow::InitializeParameters() {
+  using Type = ParameterBlock::Type;
+  // Indexed by `Parameter`; defaults must match the initial member values
+  const ParameterBlock::Definition definitions[] {
+    {"swap_chain_length", Type::Integer, 3, 2, MaxSwapChainLength},
+    {"minimum_frame_rate", Type::Integer, 5, 1, 240},
+    {"reorder_display_list", Type::Boolean, 1, 0, 1},
+    {"gpu_resource_cache_mib", Type::Integer, 256, 0, 4096},
+    {
+      "text_measure_cache_kib",
+      Type::Integer,
+      TextMeasureCache::DefaultByteBudget / 1024,
+      0,
+      64 * 1024,
+    },
+    {"speculative_frames", Type::Integer, 2, 0, MaxSpeculativeFrames},
+    {"optimize_display_list", Type::Boolean, 1, 0, 1},
+  };
+  mParameters = ParameterBlock::Create(GetCurrentProcessId(), definitions);
+  if (mParameters) {
+    OutputDebugStringA(
+      std::format(
+        "Change parameters with `HelloSkia-Parameters {}`\n",
+        GetCurrentProcessId())
+        .c_str());
+  }
+}
+
+void HelloSkiaWindow::ApplyParameters() {
+  if (!(mParameters && mParameters->Poll())) {
+    return;
+  }
+  const auto get = [this](Parameter parameter) {
+    return mParameters->GetValue(static_cast<size_t>(parameter));
+  };
+
+  const auto swapChainLength
+    = static_cast<UINT>(get(Parameter::SwapChainLength));
+  if (swapChainLength != mSwapChainLength) {
+    mPendingSwapChainLength = swapChainLength;
+  }
+  mMinimumFrameRate = static_cast<UINT>(get(Parameter::MinimumFrameRate));
+  mReorderDisplayList = get(Parameter::ReorderDisplayList) != 0;
+  mOptimizeDisplayList = get(Parameter::OptimizeDisplayList) != 0;
+  mSkContext->setResourceCacheLimit(
+    static_cast<size_t>(get(Parameter::GpuResourceCacheMiB)) * 1024 * 1024);
+  mTextMeasureCache.SetByteBudget(
+    static_cast<size_t>(get(Parameter::TextMeasureCacheKiB)) * 1024);
+  mSpeculativeRenderer->SetMaxFramesAhead(
+    static_cast<size_t>(get(Parameter::SpeculativeFrames)));
+  // Pre-rendered frames might have used the old values
+  mSpeculativeRenderer->Invalidate();
+}
+
 HelloSkiaWindow::~HelloSkiaWindow() {
   this->CleanupFrameContexts();
+  this->WriteProfile();
 
   gInstance = nullptr;
 }
@@ -255,7 +533,7 @@ void HelloSkiaWindow::CreateRenderTargets() {
   const auto rtvStart = mD3DRTVHeap->GetCPUDescriptorHandleForHeapStart();
   const auto rtvStep = mD3DDevice->GetDescriptorHandleIncrementSize(
     D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-  for (UINT i = 0; i < SwapChainLength; ++i) {
+  for (UINT i = 0; i < mSwapChainLength; ++i) {
     auto& frame = mFrames[i];
     CheckHResult(
       mSwapChain->GetBuffer(i, IID_PPV_ARGS(frame.mRenderTarget.put())));
@@ -324,27 +602,98 @@ void HelloSkiaWindow::RenderNonSkiaContent(FrameContext& frame) {
   CheckHResult(mD3DCommandQueue->Signal(mD3DFence.get(), frame.mFenceValue));
 }
 
-void HelloSkiaWindow::RenderSkiaContent(SkCanvas* canvas) {
-  static constexpr auto strokeWidth = 2;
+void HelloSkiaWindow::BeginSkiaFrame(uint64_t frame) {
+  mLabelLayout->SetText(GetLabelText(frame), mSkFont);
+  mLayoutRoot.Layout(
+    LayoutNode::Constraints::Tight(SkSize::Make(
+      mWindowSize.mWidth, mWindowSize.mHeight - BorderStrokeWidth)),
+    &mTextMeasureCache);
+
   SkPaint paint;
   paint.setColor(SkColorSetRGB(0x66, 0x66, 0xcc));
   paint.setStyle(SkPaint::kStroke_Style);
-  paint.setStrokeWidth(strokeWidth);
-  canvas->drawRoundRect(
-    SkRect::MakeIWH(mWindowSize.mWidth, mWindowSize.mHeight - strokeWidth)
-      .makeInset(10.0, 10.0),
-    10,
-    10,
-    paint);
-
+  paint.setStrokeWidth(BorderStrokeWidth);
+  mBorderPaint = mInterner.Intern(paint).mValue;
   paint.setStyle(SkPaint::kFill_Style);
-  canvas->drawString(
-    std::format("Hello Skia: Win32+Ganesh+D3D12 frame {}", mFrameCounter)
-      .c_str(),
-    40,
-    40,
+  mLabelPaint = mInterner.Intern(paint).mValue;
+
+  // Everything DrawSkiaContent() uses apart from the frame number. The
+  // label's size depends on its text, so only its position is included.
+  size_t stateHash {};
+  const auto border = mBorderLayout->GetAbsoluteFrame();
+  const auto label = mLabelLayout->GetAbsoluteFrame();
+  const auto widgets = mWidgetsLayout->GetAbsoluteFrame();
+  for (const auto value: {
+         border.fLeft,
+         border.fTop,
+         border.fRight,
+         border.fBottom,
+         label.fLeft,
+         label.fTop,
+         mLabelLayout->GetBaseline(),
+         widgets.fLeft,
+         widgets.fTop,
+         widgets.fRight,
+         widgets.fBottom,
+       }) {
+    HashCombine(stateHash, value);
+  }
+  HashCombine(stateHash, mBorderPaint.getColor());
+  HashCombine(stateHash, mLabelPaint.getColor());
+  HashCombine(stateHash, mOptimizeDisplayList);
+  HashCombine(stateHash, mReorderDisplayList);
+  mSpeculativeRenderer->SetStateHash(stateHash);
+}
+
+void HelloSkiaWindow::DrawSkiaContent(SkCanvas* canvas, uint64_t frame) {
+  mDisplayList.Clear();
+  mDisplayList.DrawRoundRect(
+    mBorderLayout->GetAbsoluteFrame(), 10, 10, mBorderPaint);
+
+  const auto labelFrame = mLabelLayout->GetAbsoluteFrame();
+  mDisplayList.DrawString(
+    GetLabelText(frame),
+    labelFrame.x(),
+    labelFrame.y() + mLabelLayout->GetBaseline(),
     mSkFont,
-    paint);
+    mLabelPaint);
+
+  if (mOptimizeDisplayList) {
+    mOptimizeStats.insert_or_assign(
+      frame, mDisplayList.Optimize(canvas->getLocalClipBounds()));
+  }
+  if (mReorderDisplayList) {
+    mDisplayList.ReorderForBatching();
+  }
+  mDisplayList.Replay(canvas);
+
+  mUI->BeginFrame(
+    canvas,
+    mWidgetsLayout->GetAbsoluteFrame(),
+    ImmediateUI::FrameKind::Speculative);
+  mUI->Label(ImmediateUI::MakeID("progress-label"), "Progress");
+  mUI->ProgressBar(
+    ImmediateUI::MakeID("progress"),
+    static_cast<float>(frame % 1000) / 1000,
+    mWidgetsLayout->GetFrame().width());
+  mUI->EndFrame();
+}
+
+void HelloSkiaWindow::EndSkiaFrame(uint64_t frame) {
+  mInterner.EndFrame();
+  mUI->AdvanceFrame();
+
+  // The frame may have been drawn - and optimized - ahead of time
+  if (const auto it = mOptimizeStats.find(frame); it != mOptimizeStats.end()) {
+    const auto& stats = it->second;
+    auto& m = mFrameMetrics;
+    m.mCulledDraws->Increment(stats.mCulledDraws);
+    m.mRedundantClips->Increment(stats.mRedundantClips);
+    m.mFoldedLayers->Increment(stats.mFoldedLayers);
+    m.mEmptySaves->Increment(stats.mEmptySaves);
+  }
+  mOptimizeStats.erase(
+    mOptimizeStats.begin(), mOptimizeStats.upper_bound(frame));
 }
 
 void HelloSkiaWindow::RenderSkiaContent(FrameContext& frame) {
@@ -371,8 +720,19 @@ void HelloSkiaWindow::RenderSkiaContent(FrameContext& frame) {
     frame.mSkSurface.get(), SkSurfaces::BackendHandleAccess::kFlushWrite);
   brt.setD3DResourceState(D3D12_RESOURCE_STATE_RENDER_TARGET);
 
-  this->RenderSkiaContent(frame.mSkSurface->getCanvas());
+  {
+    SamplingProfiler::ScopedPhase phase {mProfiler.get(), "RenderSkiaContent"};
+    MetricsRegistry::Histogram::ScopedTimer timer {
+      mFrameMetrics.mPhaseSeconds.mRenderSkiaContent};
+    this->BeginSkiaFrame(mFrameCounter);
+    mSpeculativeRenderer->DrawFrame(
+      frame.mSkSurface->getCanvas(), mFrameCounter);
+    this->EndSkiaFrame(mFrameCounter);
+  }
 
+  SamplingProfiler::ScopedPhase phase {mProfiler.get(), "Flush"};
+  MetricsRegistry::Histogram::ScopedTimer timer {
+    mFrameMetrics.mPhaseSeconds.mFlush};
   fenceInfo.fValue = ++mFenceValue;
   frame.mFenceValue = fenceInfo.fValue;
   GrBackendSemaphore flushSemaphore;
@@ -389,26 +749,38 @@ void HelloSkiaWindow::RenderSkiaContent(FrameContext& frame) {
 }
 
 void HelloSkiaWindow::RenderFrame() {
-  if (mPendingResize) {
+  MetricsRegistry::Histogram::ScopedTimer frameTimer {
+    mFrameMetrics.mFrameSeconds};
+  this->FinishShaderWarmup();
+  this->ApplyParameters();
+
+  if (mPendingResize || mPendingSwapChainLength) {
     this->CleanupFrameContexts();
+    const auto size = mPendingResize.value_or(mWindowSize);
+    mSwapChainLength = mPendingSwapChainLength.value_or(mSwapChainLength);
     CheckHResult(mSwapChain->ResizeBuffers(
-      0,
-      mPendingResize->mWidth,
-      mPendingResize->mHeight,
+      mSwapChainLength,
+      size.mWidth,
+      size.mHeight,
       DXGI_FORMAT_UNKNOWN,
       0));
     this->CreateRenderTargets();
+    mSpeculativeRenderer->Invalidate();
 
-    mWindowSize = *mPendingResize;
+    mWindowSize = size;
     mPendingResize = std::nullopt;
+    mPendingSwapChainLength = std::nullopt;
   }
 
   ++mFrameCounter;
   auto& frame = mFrames.at(mFrameIndex);
-  mFrameIndex = (mFrameIndex + 1) % SwapChainLength;
+  mFrameIndex = (mFrameIndex + 1) % mSwapChainLength;
 
   auto commandList = mD3DCommandList.get();
   if (frame.mFenceValue) {
+    SamplingProfiler::ScopedPhase phase {mProfiler.get(), "WaitForFrame"};
+    MetricsRegistry::Histogram::ScopedTimer timer {
+      mFrameMetrics.mPhaseSeconds.mWaitForFrame};
     mD3DFence->SetEventOnCompletion(frame.mFenceValue, mFenceEvent.get());
     WaitForSingleObject(mFenceEvent.get(), INFINITE);
   }
@@ -416,15 +788,30 @@ void HelloSkiaWindow::RenderFrame() {
   frame.mFenceValue = ++mFenceValue;
   CheckHResult(commandList->Reset(frame.mCommandAllocator.get(), nullptr));
 
-  RenderNonSkiaContent(frame);
+  {
+    SamplingProfiler::ScopedPhase phase {
+      mProfiler.get(), "RenderNonSkiaContent"};
+    MetricsRegistry::Histogram::ScopedTimer timer {
+      mFrameMetrics.mPhaseSeconds.mRenderNonSkiaContent};
+    RenderNonSkiaContent(frame);
+  }
   RenderSkiaContent(frame);
 
-  CheckHResult(mSwapChain->Present(1, 0));
+  {
+    SamplingProfiler::ScopedPhase phase {mProfiler.get(), "Present"};
+    MetricsRegistry::Histogram::ScopedTimer timer {
+      mFrameMetrics.mPhaseSeconds.mPresent};
+    CheckHResult(mSwapChain->Present(1, 0));
+  }
+
+  this->UpdateMetrics();
+
+  if (mProfiler) {
+    mProfiler->Collect();
+  }
 }
 
 int HelloSkiaWindow::Run() noexcept {
-  std::chrono::milliseconds frameInterval {1000 / MinimumFrameRate};
-
   while (!mExitCode) {
     const auto frameStart = std::chrono::steady_clock::now();
 
@@ -439,6 +826,15 @@ int HelloSkiaWindow::Run() noexcept {
 
     this->RenderFrame();
 
+    const std::chrono::milliseconds frameInterval {1000 / mMinimumFrameRate};
+    {
+      SamplingProfiler::ScopedPhase phase {mProfiler.get(), "Speculate"};
+      mSpeculativeRenderer->RenderAhead(
+        mFrames.front().mSkSurface.get(),
+        mFrameCounter,
+        frameStart + frameInterval);
+    }
+
     const auto frameDuration = std::chrono::steady_clock::now() - frameStart;
     if (frameDuration > frameInterval) {
       continue;
@@ -446,6 +842,7 @@ int HelloSkiaWindow::Run() noexcept {
     const auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
                           frameInterval - frameDuration)
                           .count();
+    SamplingProfiler::ScopedPhase phase {mProfiler.get(), "Idle"};
     MsgWaitForMultipleObjects(0, nullptr, false, millis, QS_ALLINPUT);
   }
 
@@ -467,6 +864,10 @@ HelloSkiaWindow::WindowProc(
   if (uMsg == WM_CLOSE) {
     gInstance->mExitCode = 0;
   }
+  if (uMsg == WM_KEYDOWN && wParam == VK_F9) {
+    gInstance->WriteProfile();
+    return 0;
+  }
   return DefWindowProcW(hwnd, uMsg, wParam, lParam);
 }
 
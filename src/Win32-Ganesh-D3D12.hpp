@@ -3,6 +3,18 @@
 
 #pragma once
 
+#include "DisplayList.hpp"
+#include "ImmediateUI.hpp"
+#include "Interner.hpp"
+#include "Layout.hpp"
+#include "Metrics.hpp"
+#include "MetricsServer.hpp"
+#include "ParameterBlock.hpp"
+#include "SamplingProfiler.hpp"
+#include "ShaderWarmup.hpp"
+#include "SpeculativeRenderer.hpp"
+#include "TextMeasureCache.hpp"
+
 #include <Windows.h>
 #include <core/SkCanvas.h>
 #include <d3d12.h>
@@ -12,6 +24,9 @@
 #include <wil/com.h>
 #include <wil/resource.h>
 
+#include <filesystem>
+#include <map>
+#include <memory>
 #include <optional>
 
 class HelloSkiaWindow final {
@@ -23,6 +38,7 @@ class HelloSkiaWindow final {
   HelloSkiaWindow& operator=(HelloSkiaWindow&&) = delete;
 
   void InitializeSkia();
+  void CreateLayout();
   explicit HelloSkiaWindow(HINSTANCE instance);
   ~HelloSkiaWindow();
 
@@ -30,11 +46,34 @@ class HelloSkiaWindow final {
   [[nodiscard]] int Run() noexcept;
 
  private:
-  static constexpr UINT SwapChainLength = 3;
-  static constexpr UINT MinimumFrameRate = 5;
+  // The largest value of the `swap_chain_length` parameter
+  static constexpr UINT MaxSwapChainLength = 4;
+  // The largest value of the `speculative_frames` parameter
+  static constexpr UINT MaxSpeculativeFrames = 4;
+
+  // Indices into the definitions in InitializeParameters()
+  enum class Parameter : size_t {
+    SwapChainLength,
+    MinimumFrameRate,
+    ReorderDisplayList,
+    GpuResourceCacheMiB,
+    TextMeasureCacheKiB,
+    SpeculativeFrames,
+    OptimizeDisplayList,
+  };
 
   static HelloSkiaWindow* gInstance;
 
+  // Tunable while running with `HelloSkia-Parameters`; see ApplyParameters()
+  std::unique_ptr<ParameterBlock> mParameters;
+  UINT mSwapChainLength {3};
+  std::optional<UINT> mPendingSwapChainLength;
+  UINT mMinimumFrameRate {5};
+  // See DisplayList::ReorderForBatching()
+  bool mReorderDisplayList {true};
+  // See DisplayList::Optimize()
+  bool mOptimizeDisplayList {true};
+
   wil::unique_hwnd mHwnd;
   std::optional<int> mExitCode;
 
@@ -57,8 +96,75 @@ class HelloSkiaWindow final {
   wil::unique_handle mFenceEvent {CreateEventW(nullptr, FALSE, FALSE, nullptr)};
   uint64_t mFenceValue = 0;
 
+  // Shared with the warmup context; must outlive both contexts
+  ShaderWarmup::Cache mShaderCache;
   sk_sp<GrDirectContext> mSkContext;
+  // Replays the `HELLOSKIA_WARMUP_DIR` - or `warmup` next to the executable -
+  // captures until the first frame, and is released once its thread exits;
+  // see StartShaderWarmup() and FinishShaderWarmup()
+  std::unique_ptr<ShaderWarmup> mShaderWarmup;
   SkFont mSkFont;
+  DisplayList mDisplayList;
+  Interner mInterner;
+  // Interned once per presented frame by BeginSkiaFrame()
+  SkPaint mBorderPaint;
+  SkPaint mLabelPaint;
+  // Recorded when each frame is drawn, which may be ahead of time, and
+  // counted by EndSkiaFrame() when it is presented
+  std::map<uint64_t, DisplayList::OptimizeStats> mOptimizeStats;
+
+  TextMeasureCache mTextMeasureCache;
+  LayoutNode mLayoutRoot;
+  LayoutNode* mBorderLayout {nullptr};
+  LayoutNode* mLabelLayout {nullptr};
+  LayoutNode* mWidgetsLayout {nullptr};
+  // Needs the font, so created in CreateLayout()
+  std::optional<ImmediateUI> mUI;
+  // Our content is a pure function of the frame number and the state hashed
+  // by BeginSkiaFrame(), so frames are pre-rendered while idle; see Run().
+  // Anything else that affects the content - e.g. input or parameters - must
+  // call `Invalidate()`
+  std::optional<SpeculativeRenderer> mSpeculativeRenderer;
+
+  // Only created if the `HELLOSKIA_PROFILE` environment variable is set to
+  // the path to write profiles to; press F9 to write a profile
+  std::unique_ptr<SamplingProfiler> mProfiler;
+  std::filesystem::path mProfilePath;
+
+  // Always recorded; only served if the `HELLOSKIA_METRICS_PORT` environment
+  // variable is set, e.g. to 9464
+  MetricsRegistry mMetrics;
+  std::unique_ptr<MetricsServer> mMetricsServer;
+  struct PhaseHistograms {
+    MetricsRegistry::Histogram* mWaitForFrame {nullptr};
+    MetricsRegistry::Histogram* mRenderNonSkiaContent {nullptr};
+    MetricsRegistry::Histogram* mRenderSkiaContent {nullptr};
+    MetricsRegistry::Histogram* mFlush {nullptr};
+    MetricsRegistry::Histogram* mPresent {nullptr};
+  };
+  struct FrameMetrics {
+    MetricsRegistry::Counter* mFrames {nullptr};
+    MetricsRegistry::Counter* mDroppedFrames {nullptr};
+    MetricsRegistry::Histogram* mFrameSeconds {nullptr};
+    PhaseHistograms mPhaseSeconds;
+
+    MetricsRegistry::Gauge* mGpuResourceCacheBytes {nullptr};
+    MetricsRegistry::Gauge* mTextMeasureCacheBytes {nullptr};
+    MetricsRegistry::Gauge* mTextMeasureCacheHitRatio {nullptr};
+    MetricsRegistry::Gauge* mInternerPathHitRatio {nullptr};
+    MetricsRegistry::Gauge* mInternerPaintHitRatio {nullptr};
+    MetricsRegistry::Gauge* mInternerTextBlobHitRatio {nullptr};
+
+    // One per rule in DisplayList::Optimize()
+    MetricsRegistry::Counter* mCulledDraws {nullptr};
+    MetricsRegistry::Counter* mRedundantClips {nullptr};
+    MetricsRegistry::Counter* mFoldedLayers {nullptr};
+    MetricsRegistry::Counter* mEmptySaves {nullptr};
+
+    // From `IDXGISwapChain::GetFrameStatistics()`
+    std::optional<DXGI_FRAME_STATISTICS> mLastFrameStatistics;
+  };
+  FrameMetrics mFrameMetrics;
 
   struct FrameContext {
     wil::com_ptr<ID3D12CommandAllocator> mCommandAllocator;
@@ -68,15 +174,24 @@ class HelloSkiaWindow final {
 
     uint64_t mFenceValue {};
   };
-  std::array<FrameContext, SwapChainLength> mFrames;
+  // Only the first `mSwapChainLength` are used
+  std::array<FrameContext, MaxSwapChainLength> mFrames;
   uint8_t mFrameIndex {}; // Used to index into mFrames; reset when buffer reset
 
   uint64_t mFrameCounter {}; // Displayed to the user, not used for correctness
 
   void CreateNativeWindow(HINSTANCE);
+  void InitializeProfiler();
+  void WriteProfile();
+  void InitializeMetrics();
+  void InitializeParameters();
+  void ApplyParameters();
+  void UpdateMetrics();
   void InitializeD3D();
   void ConfigureD3DDebugLayer();
   void CreateCommandListAndAllocators();
+  void StartShaderWarmup();
+  void FinishShaderWarmup();
 
   void CreateRenderTargets();
   void CleanupFrameContexts();
@@ -90,7 +205,17 @@ class HelloSkiaWindow final {
    */
   void RenderNonSkiaContent(FrameContext& frame);
   void RenderSkiaContent(FrameContext& frame);
-  void RenderSkiaContent(SkCanvas* canvas);
+
+  /** Per-frame bookkeeping, once for each presented frame.
+   *
+   * `DrawSkiaContent()` is also used to pre-render frames that may never be
+   * shown, so layout, interning, cache aging, and metrics are done here
+   * instead.
+   */
+  void BeginSkiaFrame(uint64_t frame);
+  void EndSkiaFrame(uint64_t frame);
+  /// A pure function of the frame number and the state from BeginSkiaFrame()
+  void DrawSkiaContent(SkCanvas* canvas, uint64_t frame);
 
   static LRESULT
   WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) noexcept;
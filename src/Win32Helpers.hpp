@@ -0,0 +1,47 @@
+// Copyright 2024 Fred Emmott <fred@fredemmott.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <Windows.h>
+#include <shlobj_core.h>
+#include <wil/resource.h>
+
+#include <bit>
+#include <filesystem>
+#include <format>
+#include <source_location>
+#include <system_error>
+
+inline void CheckHResult(
+  const HRESULT ret,
+  const std::source_location& caller = std::source_location::current()) {
+  if (SUCCEEDED(ret)) [[likely]] {
+    return;
+  }
+
+  const std::error_code ec {ret, std::system_category()};
+
+  const auto msg = std::format(
+    "HRESULT failed: {:#010x} @ {} - {}:{}:{} - {}\n",
+    std::bit_cast<uint32_t>(ret),
+    caller.function_name(),
+    caller.file_name(),
+    caller.line(),
+    caller.column(),
+    ec.message());
+  OutputDebugStringA(msg.c_str());
+  throw std::system_error(ec);
+}
+
+template <const GUID& TFolderID>
+std::filesystem::path GetKnownFolderPath() {
+  wil::unique_cotaskmem_string buf;
+  CheckHResult(
+    SHGetKnownFolderPath(TFolderID, KF_FLAG_DEFAULT, nullptr, buf.put()));
+  std::filesystem::path path {std::wstring_view {buf.get()}};
+  if (std::filesystem::exists(path)) {
+    return std::filesystem::canonical(path);
+  }
+  return {};
+}